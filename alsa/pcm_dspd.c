@@ -143,6 +143,13 @@ static int dspd_alsa_stop(snd_pcm_ioplug_t *io)
 }
 
 
+/*
+  These are also the mmap path.  The ioplug layer allocates the buffer that
+  snd_pcm_mmap_begin() returns and calls these on every commit, so there is
+  always one copy between that buffer and the fifo.  Pointing the mmap areas
+  into the fifo would need a native PCM type, and alsa-lib only lets
+  external plugins use ioplug and extplug.
+*/
 static snd_pcm_sframes_t dspd_alsa_read_pcm(snd_pcm_ioplug_t *io,
 					    const snd_pcm_channel_area_t *areas,
 					    snd_pcm_uframes_t offset,
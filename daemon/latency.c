@@ -1,12 +1,67 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../lib/sslib.h"
+static const char * const iostat_names[DSPD_IOSTAT_COUNT] = {
+  [DSPD_IOSTAT_WAKEUP_JITTER] = "JITTER(us)",
+  [DSPD_IOSTAT_CYCLE_TIME] = "CYCLE(us)",
+  [DSPD_IOSTAT_CLIENTS] = "CLIENTS",
+  [DSPD_IOSTAT_REWINDS] = "REWINDS",
+};
+
+static double iostat_value(uint32_t hist, uint64_t val)
+{
+  if ( hist == DSPD_IOSTAT_WAKEUP_JITTER || hist == DSPD_IOSTAT_CYCLE_TIME )
+    return val / 1000.0;
+  return val;
+}
+
+static int print_iostat(struct dspd_conn *conn, uint32_t dev, bool reset)
+{
+  struct dspd_iostat_req req;
+  struct dspd_iostat st;
+  size_t br;
+  int err = 0;
+  uint32_t i;
+  const struct dspd_hist *h = &st.data;
+  for ( i = 0; i < DSPD_IOSTAT_COUNT; i++ )
+    {
+      req.hist = i;
+      //All of them are reset at once, so only do it on the last one.
+      req.flags = (reset && i == (DSPD_IOSTAT_COUNT - 1)) ? DSPD_IOSTAT_RESET : 0;
+      err = dspd_stream_ctl(conn,
+			    dev,
+			    DSPD_SCTL_SERVER_IOSTAT,
+			    &req,
+			    sizeof(req),
+			    &st,
+			    sizeof(st),
+			    &br);
+      if ( err != 0 || br != sizeof(st) )
+	break;
+      if ( i == 0 )
+	fprintf(stderr, "  XRUNS=%llu RECOVERIES=%llu\n",
+		(unsigned long long)st.xruns,
+		(unsigned long long)st.recoveries);
+      fprintf(stderr, "  %-11s N=%llu AVG=%.1f P50=%.1f P90=%.1f P99=%.1f P99.9=%.1f MAX=%.1f\n",
+	      iostat_names[i],
+	      (unsigned long long)h->count,
+	      h->count ? iostat_value(i, h->sum) / h->count : 0.0,
+	      iostat_value(i, dspd_hist_percentile(h, 50.0)),
+	      iostat_value(i, dspd_hist_percentile(h, 90.0)),
+	      iostat_value(i, dspd_hist_percentile(h, 99.0)),
+	      iostat_value(i, dspd_hist_percentile(h, 99.9)),
+	      iostat_value(i, h->max));
+    }
+  return err;
+}
+
 static int print_usage(const char *name)
 {
-  fprintf(stderr, "Usage: %s [-i INTERVAL] [-a ADDRESS]\n"
+  fprintf(stderr, "Usage: %s [-i INTERVAL] [-a ADDRESS] [-r]\n"
 	  "-i     Poll interval in seconds (default is 5)\n"
 	  "       Run once and exit if the interval is 0\n"
-	  "-a     Server address\n",
+	  "-a     Server address\n"
+	  "-r     Reset the io statistics after each interval\n",
 	  name);
   return 1;
 }
@@ -24,6 +79,7 @@ int main(int argc, char **argv)
   const char *addr = NULL;
   int interval = 5;
   int nextarg;
+  bool reset = false;
   for ( i = 1; i < (size_t)argc; i++ )
     {
       nextarg = i + 1;
@@ -38,6 +94,9 @@ int main(int argc, char **argv)
 	    addr = argv[nextarg];
 	  else
 	    return print_usage(argv[0]);
+	} else if ( strcmp(argv[i], "-r") == 0 )
+	{
+	  reset = true;
 	} else if ( strcmp(argv[i], "-i") == 0 )
 	{
 	  if ( nextarg != argc )
@@ -120,7 +179,7 @@ int main(int argc, char **argv)
 			  us2,
 			  devinfo.refcount,
 			  (long long)devinfo.hotplug_event_id);
-			  
+		  print_iostat(conn, dev, reset);
 		}
 	    }
 	}
@@ -0,0 +1,629 @@
+/*
+  Synthetic load generator.  Runs many clients against one device and
+  reports xruns, delay and fill levels, and the cpu time used by the
+  daemon.  With -s it adds clients until something xruns or fails, which
+  gives the number of streams a host can handle at a given period.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../lib/sslib.h"
+
+struct lg_stats {
+  uint64_t frames;
+  uint32_t xruns;
+  uint32_t errors;
+  int32_t  last_error;
+  uint32_t opens;
+  uint32_t restarts;
+  uint32_t min_fill, max_fill, min_delay, max_delay;
+  uint64_t sum_fill, sum_delay, count;
+};
+
+struct lg_client {
+  uint32_t                index;
+  int32_t                 sbit;
+  bool                    started;
+  struct dspd_cli_params  params;
+  uint32_t                seed;
+  struct lg_stats        *stats;
+};
+
+struct lg_options {
+  const char *device;
+  const char *addr;
+  uint32_t    nclients;
+  uint32_t    step;
+  uint32_t    duration;
+  uint32_t    period;
+  uint32_t    nproc;
+  uint32_t    churn;
+  uint32_t    capture_every;
+  bool        uniform;
+  bool        verbose;
+  pid_t       daemon_pid;
+  uint32_t    seed;
+};
+
+static struct lg_options options = {
+  .nclients = 8,
+  .duration = 10,
+  .period = 10000,
+  .nproc = 1,
+  .seed = 1,
+};
+
+static dspd_time_t round_end;
+
+static const int32_t formats[] = {
+  DSPD_PCM_FORMAT_S16_LE,
+  DSPD_PCM_FORMAT_FLOAT_LE,
+  DSPD_PCM_FORMAT_S32_LE,
+  DSPD_PCM_FORMAT_S24_3LE,
+};
+static const int32_t rates[] = { 48000, 44100, 32000, 96000 };
+static const int32_t channels[] = { 2, 1, 4 };
+static const int32_t multipliers[] = { 1, 2, 4 };
+
+static void set_info_complete(void *context, struct dspd_async_op *op)
+{
+  bool *done = op->data;
+  *done = true;
+}
+
+static int32_t client_restart(struct lg_client *c, struct dspd_pcmcli *cli)
+{
+  int32_t ret;
+  ret = dspd_pcmcli_prepare(cli, NULL, NULL);
+  //Playback starts when the buffer is full.
+  c->started = false;
+  if ( ret == 0 && c->sbit == DSPD_PCM_SBIT_CAPTURE )
+    {
+      ret = dspd_pcmcli_start(cli, DSPD_PCM_SBIT_CAPTURE, NULL, NULL);
+      c->started = (ret == 0);
+    }
+  return ret;
+}
+
+static int32_t client_open(struct lg_client *c, struct dspd_pcmcli **cli)
+{
+  struct dspd_cli_info info;
+  bool done = false;
+  int32_t ret;
+  ret = dspd_pcmcli_new(cli, c->sbit, 0);
+  if ( ret < 0 )
+    return ret;
+  ret = dspd_pcmcli_open_device(*cli,
+				options.addr,
+				options.device ? dspd_pcmcli_select_byname_cb : NULL,
+				(void*)options.device);
+  if ( ret < 0 )
+    goto out;
+  memset(&info, 0, sizeof(info));
+  info.stream = -1;
+  info.pid = getpid();
+  info.gid = getgid();
+  info.uid = getuid();
+  snprintf(info.name, sizeof(info.name), "loadgen %u", c->index);
+  ret = dspd_pcmcli_set_info(*cli, &info, set_info_complete, &done);
+  while ( ret == 0 && ! done )
+    {
+      ret = dspd_pcmcli_process_io(*cli, 0, -1);
+      if ( ret == -EINPROGRESS )
+	ret = 0;
+    }
+  if ( ret < 0 )
+    goto out;
+  ret = dspd_pcmcli_set_hwparams(*cli, &c->params, NULL, NULL, true);
+  if ( ret < 0 )
+    goto out;
+  ret = client_restart(c, *cli);
+  if ( ret == 0 )
+    c->stats->opens++;
+
+ out:
+  if ( ret < 0 )
+    {
+      dspd_pcmcli_delete(*cli);
+      *cli = NULL;
+    }
+  return ret;
+}
+
+//Same statistics as lib/test_playback.c
+static void client_status(struct lg_client *c, struct dspd_pcmcli *cli)
+{
+  struct dspd_pcmcli_status status;
+  struct lg_stats *s = c->stats;
+  uint32_t fill;
+  if ( dspd_pcmcli_get_status(cli, c->sbit, true, &status) < 0 )
+    return;
+  if ( c->sbit == DSPD_PCM_SBIT_PLAYBACK )
+    fill = status.appl_ptr - status.hw_ptr;
+  else
+    fill = status.avail;
+  if ( status.delay >= 0 )
+    {
+      if ( s->min_delay > (uint32_t)status.delay )
+	s->min_delay = status.delay;
+      if ( s->max_delay < (uint32_t)status.delay )
+	s->max_delay = status.delay;
+      s->sum_delay += status.delay;
+    }
+  if ( s->min_fill > fill )
+    s->min_fill = fill;
+  if ( s->max_fill < fill )
+    s->max_fill = fill;
+  s->sum_fill += fill;
+  s->count++;
+}
+
+/*
+  Run until the end of the round or until the churn interval is over.
+  Returns 0 to keep the stream, 1 to stop and restart it, 2 to close it, or
+  a fatal error.
+*/
+static int32_t client_run(struct lg_client *c, struct dspd_pcmcli *cli, void *buf)
+{
+  dspd_time_t end = round_end, now;
+  ssize_t ret;
+  int32_t err;
+  if ( options.churn )
+    {
+      //Spread the events out so clients do not all churn at once.
+      now = dspd_get_time();
+      now += ((dspd_time_t)options.churn * 1000000ULL / 2ULL) +
+	(rand_r(&c->seed) % options.churn) * 1000000ULL;
+      if ( now < end )
+	end = now;
+    }
+  while ( dspd_get_time() < end )
+    {
+      if ( c->sbit == DSPD_PCM_SBIT_PLAYBACK )
+	ret = dspd_pcmcli_write_frames(cli, NULL, c->params.fragsize);
+      else
+	ret = dspd_pcmcli_read_frames(cli, buf, c->params.fragsize);
+      if ( ret == -EAGAIN && c->started == false )
+	{
+	  err = dspd_pcmcli_start(cli, c->sbit, NULL, NULL);
+	  if ( err < 0 )
+	    return err;
+	  c->started = true;
+	  ret = 0;
+	} else if ( ret == -EPIPE )
+	{
+	  c->stats->xruns++;
+	  err = client_restart(c, cli);
+	  if ( err < 0 )
+	    return err;
+	  continue;
+	} else if ( ret < 0 && ret != -EAGAIN )
+	{
+	  return ret;
+	}
+      if ( ret > 0 )
+	c->stats->frames += ret;
+      if ( c->started )
+	client_status(c, cli);
+    }
+  if ( options.churn == 0 || end == round_end )
+    return 0;
+  return rand_r(&c->seed) % 3;
+}
+
+static void *client_thread(void *arg)
+{
+  struct lg_client *c = arg;
+  struct dspd_pcmcli *cli = NULL;
+  void *buf;
+  int32_t ret;
+  buf = calloc(c->params.fragsize, c->params.channels * sizeof(double));
+  if ( ! buf )
+    {
+      c->stats->errors++;
+      c->stats->last_error = -ENOMEM;
+      return NULL;
+    }
+  while ( dspd_get_time() < round_end )
+    {
+      if ( cli == NULL )
+	{
+	  ret = client_open(c, &cli);
+	  if ( ret < 0 )
+	    {
+	      c->stats->errors++;
+	      c->stats->last_error = ret;
+	      usleep(100000);
+	      continue;
+	    }
+	}
+      ret = client_run(c, cli, buf);
+      if ( ret == 1 )
+	{
+	  c->stats->restarts++;
+	  ret = dspd_pcmcli_stop(cli, c->sbit, NULL, NULL);
+	  if ( ret == 0 )
+	    ret = client_restart(c, cli);
+	}
+      if ( ret < 0 )
+	{
+	  c->stats->errors++;
+	  c->stats->last_error = ret;
+	}
+      if ( ret < 0 || ret == 2 )
+	{
+	  dspd_pcmcli_delete(cli);
+	  cli = NULL;
+	}
+    }
+  if ( cli )
+    dspd_pcmcli_delete(cli);
+  free(buf);
+  return NULL;
+}
+
+static void client_setup(struct lg_client *c, uint32_t index, struct lg_stats *stats)
+{
+  int32_t mult = 1;
+  memset(c, 0, sizeof(*c));
+  c->index = index;
+  c->stats = stats;
+  c->seed = options.seed + (index * 2654435761U);
+  if ( options.capture_every && (index % options.capture_every) == options.capture_every - 1U )
+    c->sbit = DSPD_PCM_SBIT_CAPTURE;
+  else
+    c->sbit = DSPD_PCM_SBIT_PLAYBACK;
+  c->params.format = DSPD_PCM_FORMAT_S16_LE;
+  c->params.rate = 48000;
+  c->params.channels = 2;
+  if ( ! options.uniform )
+    {
+      c->params.format = formats[rand_r(&c->seed) % ARRAY_SIZE(formats)];
+      c->params.rate = rates[rand_r(&c->seed) % ARRAY_SIZE(rates)];
+      c->params.channels = channels[rand_r(&c->seed) % ARRAY_SIZE(channels)];
+      mult = multipliers[rand_r(&c->seed) % ARRAY_SIZE(multipliers)];
+    }
+  c->params.latency = ((uint64_t)options.period * c->params.rate / 1000000ULL) * mult;
+  if ( c->params.latency < 32 )
+    c->params.latency = 32;
+  c->params.fragsize = c->params.latency;
+  c->params.bufsize = c->params.latency * 4;
+  c->params.stream = c->sbit;
+  c->params.flags = DSPD_CLI_FLAG_SHM;
+  stats->min_fill = UINT32_MAX;
+  stats->min_delay = UINT32_MAX;
+}
+
+static int run_clients(struct lg_client *clients, uint32_t nclients, uint32_t proc)
+{
+  pthread_t *threads;
+  bool *running;
+  uint32_t i;
+  int ret = 0;
+  threads = calloc(nclients, sizeof(*threads));
+  running = calloc(nclients, sizeof(*running));
+  if ( ! (threads && running) )
+    {
+      ret = -ENOMEM;
+      goto out;
+    }
+  for ( i = proc; i < nclients; i += options.nproc )
+    {
+      if ( pthread_create(&threads[i], NULL, client_thread, &clients[i]) == 0 )
+	running[i] = true;
+      else
+	ret = -errno;
+    }
+  for ( i = 0; i < nclients; i++ )
+    {
+      if ( running[i] )
+	pthread_join(threads[i], NULL);
+    }
+ out:
+  free(threads);
+  free(running);
+  return ret;
+}
+
+static pid_t find_daemon(void)
+{
+  DIR *dir;
+  struct dirent *de;
+  char path[sizeof(de->d_name) + 16], comm[32];
+  FILE *fp;
+  pid_t ret = 0;
+  dir = opendir("/proc");
+  if ( ! dir )
+    return 0;
+  while ( ret == 0 && (de = readdir(dir)) )
+    {
+      if ( de->d_name[0] < '0' || de->d_name[0] > '9' )
+	continue;
+      snprintf(path, sizeof(path), "/proc/%s/comm", de->d_name);
+      fp = fopen(path, "r");
+      if ( ! fp )
+	continue;
+      if ( fgets(comm, sizeof(comm), fp) && strcmp(comm, "dspd\n") == 0 )
+	ret = atoi(de->d_name);
+      fclose(fp);
+    }
+  closedir(dir);
+  return ret;
+}
+
+//User and system time of all daemon threads in clock ticks.
+static int64_t daemon_cputime(pid_t pid)
+{
+  char path[64], buf[1024], *p;
+  unsigned long long utime, stime;
+  FILE *fp;
+  int64_t ret = -1;
+  if ( pid <= 0 )
+    return -1;
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+  fp = fopen(path, "r");
+  if ( ! fp )
+    return -1;
+  if ( fgets(buf, sizeof(buf), fp) )
+    {
+      //The name may contain spaces, so start after it.
+      p = strrchr(buf, ')');
+      if ( p && sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+		       &utime, &stime) == 2 )
+	ret = utime + stime;
+    }
+  fclose(fp);
+  return ret;
+}
+
+static void print_client(const struct lg_client *c)
+{
+  const struct lg_stats *s = c->stats;
+  uint64_t avgfill = 0, avgdelay = 0;
+  if ( s->count )
+    {
+      avgfill = s->sum_fill / s->count;
+      avgdelay = s->sum_delay / s->count;
+    }
+  printf("CLIENT[%u]: stream=%s format=%s rate=%d channels=%d latency=%d "
+	 "frames=%llu xruns=%u errors=%u opens=%u restarts=%u "
+	 "min_delay=%u max_delay=%u min_fill=%u max_fill=%u avgfill=%llu avgdelay=%llu\n",
+	 c->index,
+	 c->sbit == DSPD_PCM_SBIT_PLAYBACK ? "playback" : "capture",
+	 dspd_pcm_name_from_format(c->params.format),
+	 c->params.rate,
+	 c->params.channels,
+	 c->params.latency,
+	 (unsigned long long)s->frames,
+	 s->xruns,
+	 s->errors,
+	 s->opens,
+	 s->restarts,
+	 s->count ? s->min_delay : 0,
+	 s->max_delay,
+	 s->count ? s->min_fill : 0,
+	 s->max_fill,
+	 (unsigned long long)avgfill,
+	 (unsigned long long)avgdelay);
+  if ( s->last_error )
+    printf("CLIENT[%u]: last error %d\n", c->index, s->last_error);
+}
+
+/*
+  Run one round with nclients clients.  Returns the number of xruns plus the
+  number of client errors, or a negative error code.
+*/
+static int64_t run_round(uint32_t nclients, bool print_clients)
+{
+  struct lg_client *clients;
+  struct lg_stats *stats;
+  size_t len = sizeof(*stats) * nclients;
+  uint32_t i, p, errors = 0, xruns = 0;
+  uint64_t frames = 0;
+  int64_t cpu0, cpu1, ret = 0;
+  dspd_time_t t0, t1;
+  pid_t *pids = NULL;
+  double cpu = -1.0;
+  int status;
+  //Shared so that child processes can report back.
+  stats = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if ( stats == MAP_FAILED )
+    return -errno;
+  clients = calloc(nclients, sizeof(*clients));
+  if ( ! clients )
+    {
+      ret = -ENOMEM;
+      goto out;
+    }
+  for ( i = 0; i < nclients; i++ )
+    client_setup(&clients[i], i, &stats[i]);
+
+  cpu0 = daemon_cputime(options.daemon_pid);
+  t0 = dspd_get_time();
+  round_end = t0 + ((dspd_time_t)options.duration * 1000000000ULL);
+  if ( options.nproc <= 1 )
+    {
+      ret = run_clients(clients, nclients, 0);
+    } else
+    {
+      pids = calloc(options.nproc, sizeof(*pids));
+      if ( ! pids )
+	{
+	  ret = -ENOMEM;
+	  goto out;
+	}
+      for ( p = 0; p < options.nproc; p++ )
+	{
+	  pids[p] = fork();
+	  if ( pids[p] == 0 )
+	    _exit(run_clients(clients, nclients, p) < 0);
+	  else if ( pids[p] < 0 )
+	    ret = -errno;
+	}
+      for ( p = 0; p < options.nproc; p++ )
+	{
+	  if ( pids[p] > 0 && waitpid(pids[p], &status, 0) == pids[p] &&
+	       (! WIFEXITED(status) || WEXITSTATUS(status) != 0) )
+	    ret = -ECHILD;
+	}
+    }
+  t1 = dspd_get_time();
+  cpu1 = daemon_cputime(options.daemon_pid);
+  if ( cpu0 >= 0 && cpu1 >= cpu0 && t1 > t0 )
+    cpu = ((cpu1 - cpu0) * 100.0 / sysconf(_SC_CLK_TCK)) / ((t1 - t0) / 1000000000.0);
+
+  for ( i = 0; i < nclients; i++ )
+    {
+      xruns += stats[i].xruns;
+      errors += stats[i].errors;
+      frames += stats[i].frames;
+      if ( print_clients || options.verbose )
+	print_client(&clients[i]);
+    }
+  printf("ROUND: clients=%u period=%uus duration=%us xruns=%u errors=%u frames=%llu daemon_cpu=",
+	 nclients, options.period, options.duration, xruns, errors, (unsigned long long)frames);
+  if ( cpu < 0.0 )
+    printf("unknown\n");
+  else
+    printf("%.1f%%\n", cpu);
+  fflush(stdout);
+  if ( ret == 0 )
+    ret = xruns + errors;
+
+ out:
+  free(pids);
+  free(clients);
+  munmap(stats, len);
+  return ret;
+}
+
+static int print_usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [OPTIONS]\n"
+	  "-n CLIENTS  Number of clients, or the limit with -s (default is 8)\n"
+	  "-s STEP     Add STEP clients each round until there are xruns or errors\n"
+	  "-t SECONDS  Duration of each round (default is 10)\n"
+	  "-l USEC     Client period in microseconds (default is 10000)\n"
+	  "-p NPROC    Split clients across NPROC processes (default is 1)\n"
+	  "-c MSEC     Stop, restart, or reopen each client about every MSEC ms\n"
+	  "-C N        Every Nth client is a capture client\n"
+	  "-u          All clients use S16_LE, 48000Hz, 2 channels and the same period\n"
+	  "-S SEED     Seed for choosing client formats\n"
+	  "-d DEVICE   Device name (default is the default device)\n"
+	  "-a ADDRESS  Server address\n"
+	  "-P PID      Daemon process id (default is to look for dspd)\n"
+	  "-v          Print every client for every round\n",
+	  name);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+  int64_t ret;
+  uint32_t n, last_ok = 0;
+  bool failed = false;
+  for ( i = 1; i < argc; i++ )
+    {
+      if ( strcmp(argv[i], "-u") == 0 )
+	{
+	  options.uniform = true;
+	} else if ( strcmp(argv[i], "-v") == 0 )
+	{
+	  options.verbose = true;
+	} else if ( argv[i][0] == '-' && argv[i][1] != 0 && argv[i][2] == 0 && (i + 1) < argc )
+	{
+	  i++;
+	  switch(argv[i-1][1])
+	    {
+	    case 'n':
+	      options.nclients = atoi(argv[i]);
+	      break;
+	    case 's':
+	      options.step = atoi(argv[i]);
+	      break;
+	    case 't':
+	      options.duration = atoi(argv[i]);
+	      break;
+	    case 'l':
+	      options.period = atoi(argv[i]);
+	      break;
+	    case 'p':
+	      options.nproc = atoi(argv[i]);
+	      break;
+	    case 'c':
+	      options.churn = atoi(argv[i]);
+	      break;
+	    case 'C':
+	      options.capture_every = atoi(argv[i]);
+	      break;
+	    case 'S':
+	      options.seed = atoi(argv[i]);
+	      break;
+	    case 'd':
+	      options.device = argv[i];
+	      break;
+	    case 'a':
+	      options.addr = argv[i];
+	      break;
+	    case 'P':
+	      options.daemon_pid = atoi(argv[i]);
+	      break;
+	    default:
+	      return print_usage(argv[0]);
+	    }
+	} else
+	{
+	  return print_usage(argv[0]);
+	}
+    }
+  if ( options.nclients == 0 || options.duration == 0 || options.period == 0 )
+    return print_usage(argv[0]);
+  if ( options.nproc == 0 )
+    options.nproc = 1;
+
+  dspd_time_init();
+  signal(SIGPIPE, SIG_IGN);
+  if ( options.daemon_pid == 0 )
+    options.daemon_pid = find_daemon();
+  if ( options.daemon_pid == 0 )
+    fprintf(stderr, "Could not find the daemon, cpu usage will not be reported\n");
+
+  if ( options.step == 0 )
+    {
+      ret = run_round(options.nclients, true);
+      if ( ret < 0 )
+	{
+	  fprintf(stderr, "Error %d\n", (int)ret);
+	  return 1;
+	}
+      return 0;
+    }
+
+  /*
+    Capacity test: keep adding clients until a round has xruns or a client
+    fails to open, start, or keep running.  The last clean round is the limit
+    for this period.
+  */
+  for ( n = options.step; n <= options.nclients; n += options.step )
+    {
+      ret = run_round(n, false);
+      if ( ret < 0 )
+	{
+	  fprintf(stderr, "Error %d\n", (int)ret);
+	  return 1;
+	}
+      if ( ret > 0 )
+	{
+	  failed = true;
+	  break;
+	}
+      last_ok = n;
+    }
+  printf("CAPACITY: period=%uus streams=%u%s\n",
+	 options.period, last_ok, failed ? "" : " (limit not reached)");
+  return 0;
+}
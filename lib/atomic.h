@@ -7,6 +7,13 @@
 #define dspd_rmb() AO_nop_read()
 #define dspd_mb() AO_nop_full()
 
+/*
+  Shared memory structures pad data written by different cores to this
+  size so they don't share a cache line.
+*/
+#define DSPD_CACHELINE_SIZE 64U
+#define DSPD_CACHELINE_ALIGN(_n) (((_n) + (DSPD_CACHELINE_SIZE - 1U)) & ~((size_t)DSPD_CACHELINE_SIZE - 1U))
+
 static inline int8_t dspd_test_bit(const uint8_t *mask, uintptr_t bit)
 {
   uintptr_t i = bit >> 3U;
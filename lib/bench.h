@@ -0,0 +1,64 @@
+#ifndef _DSPD_BENCH_H_
+#define _DSPD_BENCH_H_
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sslib.h"
+/*
+  Shared code for the bench_*.bin programs.  Every result is one line:
+
+  BENCH: name=<group.case> frames=<n> ns_per_frame=<x> frames_per_sec=<y>
+
+  so the output can be grepped and compared between releases.  The first
+  argument is an optional substring to select cases by name.  DSPD_BENCH_MS
+  sets the minimum run time of each case (default 200ms).
+*/
+
+typedef void (*dspd_bench_fn_t)(void *arg, size_t frames);
+
+static const char *dspd_bench_filter;
+static uint64_t dspd_bench_min_ns = 200000000ULL;
+
+static void dspd_bench_init(int argc, char **argv)
+{
+  const char *ms = getenv("DSPD_BENCH_MS");
+  DSPD_ASSERT(dspd_time_init() == 0);
+  if ( argc > 1 )
+    dspd_bench_filter = argv[1];
+  if ( ms && atoi(ms) > 0 )
+    dspd_bench_min_ns = atoi(ms) * 1000000ULL;
+}
+
+/*
+  Call fn with the given number of frames until the minimum run time is
+  reached.  The count doubles each round so the clock is not read in the
+  timed loop.
+*/
+static void dspd_bench_run(const char *name, dspd_bench_fn_t fn, void *arg, size_t frames)
+{
+  uint64_t i, count = 1, total = 0;
+  dspd_time_t start, elapsed = 0;
+  double nspf;
+  if ( dspd_bench_filter && ! strstr(name, dspd_bench_filter) )
+    return;
+  fn(arg, frames); //Warm up caches and lazy init
+  while ( elapsed < dspd_bench_min_ns )
+    {
+      start = dspd_get_time();
+      for ( i = 0; i < count; i++ )
+	fn(arg, frames);
+      elapsed += dspd_get_time() - start;
+      total += count;
+      count *= 2ULL;
+    }
+  total *= frames;
+  nspf = (double)elapsed / total;
+  printf("BENCH: name=%s frames=%llu ns_per_frame=%.3f frames_per_sec=%.0f\n",
+	 name,
+	 (unsigned long long)total,
+	 nspf,
+	 1000000000.0 / nspf);
+  fflush(stdout);
+}
+
+#endif
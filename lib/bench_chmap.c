@@ -0,0 +1,139 @@
+#include "bench.h"
+
+/*
+  Channel map mixing: the generic write and read routines, the 32 bit
+  versions, and whatever dspd_pcm_chmap_get_write_buf() picks for each
+  common layout.
+*/
+
+#define BENCH_FRAMES 1024UL
+
+struct bench_map {
+  const char                      *name;
+  struct dspd_pcm_chmap_container  m;
+  dspd_chmap_write_t               write;
+  dspd_chmap_write32_t             write32;
+  void (*read)(const struct dspd_pcm_chmap * __restrict map,
+	       const float * __restrict inbuf,
+	       float * __restrict outbuf,
+	       size_t frames,
+	       float volume);
+};
+
+static float  inbuf[BENCH_FRAMES * 8UL];
+static double outbuf[BENCH_FRAMES * 8UL];
+static float  outbuf32[BENCH_FRAMES * 8UL];
+
+static struct bench_map *cur;
+
+static void b_write(void *arg, size_t frames)
+{
+  cur->write(&cur->m.map, inbuf, outbuf, frames, 0.75);
+}
+static void b_write32(void *arg, size_t frames)
+{
+  cur->write32(&cur->m.map, inbuf, outbuf32, frames, 0.75);
+}
+static void b_write_best(void *arg, size_t frames)
+{
+  dspd_chmap_write_t w = arg;
+  w(&cur->m.map, inbuf, outbuf, frames, 0.75);
+}
+static void b_write32_best(void *arg, size_t frames)
+{
+  dspd_chmap_write32_t w = arg;
+  w(&cur->m.map, inbuf, outbuf32, frames, 0.75);
+}
+static void b_read(void *arg, size_t frames)
+{
+  cur->read(&cur->m.map, inbuf, outbuf32, frames, 0.75f);
+}
+
+static struct bench_map maps[5];
+
+static void init_maps(void)
+{
+  struct bench_map *b;
+  size_t i;
+  static const uint32_t dm[] = { 0, 0, 1, 1, 2, 0, 3, 1, 4, 0, 4, 1 };
+
+  b = &maps[0];
+  b->name = "simple_2to2";
+  b->m.map.flags = DSPD_CHMAP_SIMPLE;
+  b->m.map.ichan = b->m.map.ochan = b->m.map.count = 2;
+  b->write = dspd_pcm_chmap_write_buf_simple;
+  b->write32 = dspd_pcm_chmap_write_buf32_simple;
+  b->read = dspd_pcm_chmap_read_buf_simple;
+
+  b = &maps[1];
+  b->name = "matrix_2to2";
+  b->m.map.flags = DSPD_CHMAP_MATRIX;
+  b->m.map.ichan = b->m.map.ochan = b->m.map.count = 2;
+  b->m.map.pos[0] = 0;
+  b->m.map.pos[1] = 1;
+  b->write = dspd_pcm_chmap_write_buf;
+  b->write32 = dspd_pcm_chmap_write_buf32;
+  b->read = dspd_pcm_chmap_read_buf;
+
+  b = &maps[2];
+  b->name = "multi_1to2";
+  b->m.map.flags = DSPD_CHMAP_MATRIX | DSPD_CHMAP_MULTI;
+  b->m.map.ichan = 1;
+  b->m.map.ochan = 2;
+  b->m.map.count = 4;
+  b->m.map.pos[3] = 1;
+  b->write = dspd_pcm_chmap_write_buf_multi;
+  b->write32 = dspd_pcm_chmap_write_buf32_multi;
+  b->read = dspd_pcm_chmap_read_buf_multi;
+
+  b = &maps[3];
+  b->name = "multi_6to2";
+  b->m.map.flags = DSPD_CHMAP_MATRIX | DSPD_CHMAP_MULTI;
+  b->m.map.ichan = 6;
+  b->m.map.ochan = 2;
+  for ( i = 0; i < ARRAY_SIZE(dm); i++ )
+    b->m.map.pos[i] = dm[i];
+  b->m.map.count = ARRAY_SIZE(dm);
+  b->write = dspd_pcm_chmap_write_buf_multi;
+  b->write32 = dspd_pcm_chmap_write_buf32_multi;
+  b->read = NULL; //Not a valid capture map
+
+  b = &maps[4];
+  b->name = "matrix_6to3";
+  b->m.map.flags = DSPD_CHMAP_MATRIX;
+  b->m.map.ichan = b->m.map.count = 6;
+  b->m.map.ochan = 3;
+  for ( i = 0; i < 6; i++ )
+    b->m.map.pos[i] = i % 3;
+  b->write = dspd_pcm_chmap_write_buf;
+  b->write32 = dspd_pcm_chmap_write_buf32;
+  b->read = NULL;
+}
+
+int main(int argc, char **argv)
+{
+  size_t i;
+  char name[128];
+  dspd_bench_init(argc, argv);
+  for ( i = 0; i < ARRAY_SIZE(inbuf); i++ )
+    inbuf[i] = (float)((i * 37UL) % 101UL) / 50.0f - 1.0f;
+  init_maps();
+  for ( i = 0; i < ARRAY_SIZE(maps); i++ )
+    {
+      cur = &maps[i];
+      snprintf(name, sizeof(name), "chmap.write.%s", cur->name);
+      dspd_bench_run(name, b_write, NULL, BENCH_FRAMES);
+      snprintf(name, sizeof(name), "chmap.write_best.%s", cur->name);
+      dspd_bench_run(name, b_write_best, dspd_pcm_chmap_get_write_buf(&cur->m.map), BENCH_FRAMES);
+      snprintf(name, sizeof(name), "chmap.write32.%s", cur->name);
+      dspd_bench_run(name, b_write32, NULL, BENCH_FRAMES);
+      snprintf(name, sizeof(name), "chmap.write32_best.%s", cur->name);
+      dspd_bench_run(name, b_write32_best, dspd_pcm_chmap_get_write_buf32(&cur->m.map), BENCH_FRAMES);
+      if ( cur->read )
+	{
+	  snprintf(name, sizeof(name), "chmap.read.%s", cur->name);
+	  dspd_bench_run(name, b_read, NULL, BENCH_FRAMES);
+	}
+    }
+  return 0;
+}
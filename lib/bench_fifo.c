@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include "bench.h"
+
+/*
+  Shared memory fifo and mailbox operations.  The fifo cases move 256
+  frames per call like a client and device would.  The mailbox cases
+  count one status update as one frame, so ns_per_frame is per call.
+  The spsc case has a reader on another thread, so the fifo pointers move
+  between cores like they do between a client and the io thread.  The
+  layout cases do the same with a bare pair of counters, once in one cache
+  line like the old fifo header and once on separate lines like the
+  current one.  With 2 or more CPUs the threads are pinned to CPU 0 and 1
+  so they really are on different cores.
+*/
+
+#define BENCH_CHUNK    256UL
+#define BENCH_FIFO_LEN 4096UL
+#define BENCH_CHANNELS 2UL
+
+static float chunk[BENCH_CHUNK * BENCH_CHANNELS];
+
+//Client writes with wiov/wcommit and the device reads with riov/rcommit.
+static void b_fifo_iov(void *arg, size_t frames)
+{
+  struct dspd_fifo_header *fifo = arg;
+  void *ptr;
+  uint32_t len, offset = 0;
+  while ( offset < frames )
+    {
+      DSPD_ASSERT(dspd_fifo_wiov(fifo, &ptr, &len) == 0);
+      if ( len > (frames - offset) )
+	len = frames - offset;
+      memcpy(ptr, &chunk[offset * BENCH_CHANNELS], len * sizeof(float) * BENCH_CHANNELS);
+      dspd_fifo_wcommit(fifo, len);
+      offset += len;
+    }
+  offset = 0;
+  while ( offset < frames )
+    {
+      DSPD_ASSERT(dspd_fifo_riov(fifo, &ptr, &len) == 0);
+      if ( len > (frames - offset) )
+	len = frames - offset;
+      memcpy(&chunk[offset * BENCH_CHANNELS], ptr, len * sizeof(float) * BENCH_CHANNELS);
+      dspd_fifo_rcommit(fifo, len);
+      offset += len;
+    }
+}
+
+//Both readable segments at once, which is what the resampled playback path does.
+static void b_fifo_riov2(void *arg, size_t frames)
+{
+  struct dspd_fifo_header *fifo = arg;
+  void *p1, *p2;
+  uint32_t n1, n2;
+  DSPD_ASSERT(dspd_fifo_write(fifo, chunk, frames) == (int32_t)frames);
+  DSPD_ASSERT(dspd_fifo_riov2(fifo, &p1, &n1, &p2, &n2) == 0);
+  DSPD_ASSERT((n1 + n2) == frames);
+  dspd_fifo_rcommit(fifo, n1 + n2);
+}
+
+static bool pin_threads;
+static void pin_cpu(int cpu)
+{
+  cpu_set_t set;
+  if ( ! pin_threads )
+    return;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  DSPD_ASSERT(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+}
+
+struct bench_spsc {
+  struct dspd_fifo_header *fifo;
+  volatile AO_t            done;
+};
+
+static void *spsc_reader(void *arg)
+{
+  struct bench_spsc *b = arg;
+  void *ptr;
+  uint32_t len;
+  pin_cpu(1);
+  while ( ! AO_load(&b->done) )
+    {
+      if ( dspd_fifo_riov(b->fifo, &ptr, &len) == 0 && len > 0 )
+	{
+	  if ( len > 32U )
+	    len = 32U;
+	  dspd_fifo_rcommit(b->fifo, len);
+	} else
+	{
+	  //Don't starve the writer if both threads share a core.
+	  sched_yield();
+	}
+    }
+  return NULL;
+}
+
+//Write small pieces as fast as the reader on the other core takes them.
+static void b_fifo_spsc(void *arg, size_t frames)
+{
+  struct bench_spsc *b = arg;
+  void *ptr;
+  uint32_t len, off, offset = 0;
+  while ( offset < frames )
+    {
+      len = frames - offset;
+      if ( len > 32U )
+	len = 32U;
+      DSPD_ASSERT(dspd_fifo_wiov_ex(b->fifo, &ptr, &off, &len) == 0);
+      if ( len == 0 )
+	sched_yield();
+      offset += len;
+      dspd_fifo_wcommit(b->fifo, len);
+    }
+}
+
+//A producer index and a consumer index, packed or on their own cache lines.
+struct bench_packed {
+  volatile AO_t in, out;
+};
+struct bench_split {
+  volatile AO_t in;
+  char          pad_in[DSPD_CACHELINE_SIZE - sizeof(AO_t)];
+  volatile AO_t out;
+  char          pad_out[DSPD_CACHELINE_SIZE - sizeof(AO_t)];
+};
+struct bench_layout {
+  volatile AO_t *in, *out;
+  volatile AO_t  done;
+};
+
+static void *layout_reader(void *arg)
+{
+  struct bench_layout *b = arg;
+  pin_cpu(1);
+  while ( ! AO_load(&b->done) )
+    {
+      if ( AO_load(b->in) != AO_load(b->out) )
+	AO_store(b->out, AO_load(b->out) + 1U);
+      else if ( ! pin_threads )
+	sched_yield();
+    }
+  return NULL;
+}
+
+//Produce one frame at a time and wait for the consumer to take it.
+static void b_layout(void *arg, size_t frames)
+{
+  struct bench_layout *b = arg;
+  size_t i;
+  for ( i = 0; i < frames; i++ )
+    {
+      AO_store(b->in, AO_load(b->in) + 1U);
+      while ( AO_load(b->out) != AO_load(b->in) )
+	{
+	  if ( ! pin_threads )
+	    sched_yield();
+	}
+    }
+}
+
+static void run_layout(const char *name, volatile AO_t *in, volatile AO_t *out)
+{
+  struct bench_layout b;
+  pthread_t thr;
+  b.in = in;
+  b.out = out;
+  b.done = 0;
+  DSPD_ASSERT(pthread_create(&thr, NULL, layout_reader, &b) == 0);
+  dspd_bench_run(name, b_layout, &b, 64);
+  AO_store(&b.done, 1);
+  pthread_join(thr, NULL);
+}
+
+static void b_mbx_write(void *arg, size_t frames)
+{
+  struct dspd_mbx_header *mbx = arg;
+  struct dspd_pcm_status *s;
+  int32_t idx;
+  size_t i;
+  for ( i = 0; i < frames; i++ )
+    {
+      s = dspd_mbx_write_lock(mbx, &idx);
+      s->appl_ptr++;
+      s->hw_ptr++;
+      dspd_mbx_write_unlock(mbx, idx);
+    }
+}
+
+static void b_mbx_read(void *arg, size_t frames)
+{
+  struct dspd_mbx_header *mbx = arg;
+  struct dspd_pcm_status s;
+  size_t i;
+  for ( i = 0; i < frames; i++ )
+    DSPD_ASSERT(dspd_mbx_read(mbx, &s, sizeof(s)) != NULL);
+}
+
+int main(int argc, char **argv)
+{
+  struct dspd_fifo_header *fifo;
+  struct dspd_mbx_header *mbx;
+  struct bench_spsc spsc;
+  static struct bench_packed packed;
+  static struct bench_split split __attribute__((aligned(DSPD_CACHELINE_SIZE)));
+  pthread_t thr;
+  dspd_bench_init(argc, argv);
+  pin_threads = sysconf(_SC_NPROCESSORS_ONLN) >= 2;
+  pin_cpu(0);
+
+  DSPD_ASSERT(dspd_fifo_new(&fifo, BENCH_FIFO_LEN, sizeof(float) * BENCH_CHANNELS, NULL) == 0);
+  dspd_bench_run("fifo.wiov_wcommit_riov_rcommit", b_fifo_iov, fifo, BENCH_CHUNK);
+  //An odd size makes the fifo wrap around at different places.
+  dspd_bench_run("fifo.write_riov2_rcommit", b_fifo_riov2, fifo, BENCH_CHUNK - 3UL);
+  dspd_fifo_reset(fifo);
+  spsc.fifo = fifo;
+  spsc.done = 0;
+  DSPD_ASSERT(pthread_create(&thr, NULL, spsc_reader, &spsc) == 0);
+  dspd_bench_run("fifo.spsc_2threads", b_fifo_spsc, &spsc, BENCH_CHUNK);
+  AO_store(&spsc.done, 1);
+  pthread_join(thr, NULL);
+  dspd_fifo_delete(fifo);
+
+  run_layout("layout.packed_2threads", &packed.in, &packed.out);
+  run_layout("layout.split_2threads", &split.in, &split.out);
+
+  DSPD_ASSERT(dspd_mbx_new(&mbx, sizeof(struct dspd_pcm_status), NULL) == 0);
+  dspd_bench_run("mbx.write_lock_unlock", b_mbx_write, mbx, 64);
+  dspd_bench_run("mbx.read", b_mbx_read, mbx, 64);
+  dspd_mbx_delete(mbx);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <pthread.h>
+#include "bench.h"
+
+/*
+  The per cycle client handshake on the device side.  One frame is one
+  dspd_client_srv_trylock() and dspd_client_srv_unlock() pair.  The keyed
+  mutex cases do the same thing the way it was done before the entries got
+  a generation counter so the two can be compared on the same machine.
+  The contended cases have a writer thread taking the entry every 50us like
+  a client changing its parameters.
+*/
+
+#define BENCH_ENTRIES 4U
+#define BENCH_KEY     1U
+#define BENCH_WRITER_USEC 50
+
+struct bench_lock {
+  struct dspd_slist *list;
+  uint32_t           index;
+  //The old keyed lock
+  pthread_mutex_t    mutex;
+  volatile AO_t      key;
+  volatile AO_t      done;
+  bool               keyed;
+};
+
+static void b_srv_trylock(void *arg, size_t frames)
+{
+  struct bench_lock *b = arg;
+  size_t i;
+  for ( i = 0; i < frames; i++ )
+    {
+      if ( dspd_client_srv_trylock(b->list, b->index, BENCH_KEY) )
+	dspd_client_srv_unlock(b->list, b->index, BENCH_KEY);
+    }
+}
+
+static inline bool keyed_trylock(struct bench_lock *b, uint32_t key)
+{
+  bool ret = false;
+  if ( AO_load(&b->key) == key && pthread_mutex_trylock(&b->mutex) == 0 )
+    {
+      ret = AO_load(&b->key) == key;
+      if ( ! ret )
+	pthread_mutex_unlock(&b->mutex);
+    }
+  return ret;
+}
+
+static void b_keyed_trylock(void *arg, size_t frames)
+{
+  struct bench_lock *b = arg;
+  size_t i;
+  for ( i = 0; i < frames; i++ )
+    {
+      if ( keyed_trylock(b, BENCH_KEY) )
+	pthread_mutex_unlock(&b->mutex);
+    }
+}
+
+static void *writer(void *arg)
+{
+  struct bench_lock *b = arg;
+  while ( ! AO_load(&b->done) )
+    {
+      if ( b->keyed )
+	{
+	  pthread_mutex_lock(&b->mutex);
+	  pthread_mutex_unlock(&b->mutex);
+	} else
+	{
+	  dspd_slist_entry_srvlock(b->list, b->index);
+	  dspd_slist_entry_srvunlock(b->list, b->index);
+	}
+      usleep(BENCH_WRITER_USEC);
+    }
+  return NULL;
+}
+
+static void run_contended(const char *name, dspd_bench_fn_t fn, struct bench_lock *b, bool keyed)
+{
+  pthread_t thr;
+  b->keyed = keyed;
+  AO_store(&b->done, 0);
+  DSPD_ASSERT(pthread_create(&thr, NULL, writer, b) == 0);
+  dspd_bench_run(name, fn, b, 64UL);
+  AO_store(&b->done, 1);
+  pthread_join(thr, NULL);
+}
+
+int main(int argc, char **argv)
+{
+  struct bench_lock b;
+  intptr_t idx;
+  dspd_bench_init(argc, argv);
+  memset(&b, 0, sizeof(b));
+  b.list = dspd_slist_new(BENCH_ENTRIES);
+  DSPD_ASSERT(b.list != NULL);
+  idx = dspd_slist_get_free(b.list, -1);
+  DSPD_ASSERT(idx >= 0);
+  b.index = idx;
+  dspd_slist_entry_set_pointers(b.list, b.index, &b, NULL, NULL);
+  dspd_slist_entry_set_key(b.list, b.index, BENCH_KEY);
+  dspd_slist_entry_set_used(b.list, b.index, true);
+  dspd_slist_entry_srvunlock(b.list, b.index);
+  dspd_slist_entry_rw_unlock(b.list, b.index);
+  DSPD_ASSERT(pthread_mutex_init(&b.mutex, NULL) == 0);
+  AO_store(&b.key, BENCH_KEY);
+
+  dspd_bench_run("lock.srv_trylock_unlock", b_srv_trylock, &b, 64UL);
+  dspd_bench_run("lock.keyed_mutex", b_keyed_trylock, &b, 64UL);
+  run_contended("lock.srv_trylock_unlock_contended", b_srv_trylock, &b, false);
+  run_contended("lock.keyed_mutex_contended", b_keyed_trylock, &b, true);
+
+  pthread_mutex_destroy(&b.mutex);
+  dspd_slist_delete(b.list);
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include "bench.h"
+
+/*
+  Synthetic playback io cycle with N fake clients.  process_clients_once()
+  needs a running device, client list and scheduler, so this does the same
+  work per client without them: read the client fifo, resample if the rate
+  differs, mix with the channel map and volume, and post a status update.
+  The mix buffer is then converted to S16 like a driver would.  Results are
+  per device frame, so they show the cost of one io cycle per client count.
+*/
+
+#define BENCH_CYCLE    1024UL
+#define BENCH_CHANNELS 2UL
+#define BENCH_FIFO_LEN 8192UL
+#define BENCH_RATE     48000U
+#define BENCH_SRC_RATE 44100U
+
+struct bench_client {
+  struct dspd_fifo_header *fifo;
+  struct dspd_mbx_header  *mbx;
+  dspd_src_t               src;
+  dspd_chmap_write_t       write;
+  float                    volume;
+};
+
+struct bench_mix {
+  struct bench_client         *clients;
+  size_t                       count;
+  struct dspd_pcm_chmap_container map;
+  const struct pcm_conv       *conv;
+  double                      *mixbuf;
+  float                       *srcbuf;
+  int16_t                     *devbuf;
+};
+
+static void client_mix(struct bench_mix *m, struct bench_client *c, size_t frames)
+{
+  void *p1, *p2;
+  uint32_t n1, n2;
+  size_t fi, fo, offset;
+  struct dspd_src_iov iov[2];
+  struct dspd_pcm_status *s;
+  int32_t idx;
+  DSPD_ASSERT(dspd_fifo_riov2(c->fifo, &p1, &n1, &p2, &n2) == 0);
+  if ( c->src )
+    {
+      iov[0].buf = p1;
+      iov[0].frames = n1;
+      iov[1].buf = p2;
+      iov[1].frames = n2;
+      fo = frames;
+      DSPD_ASSERT(dspd_src_process_v(c->src, false, iov, 2, &fi, m->srcbuf, &fo) == 0);
+      c->write(&m->map.map, m->srcbuf, m->mixbuf, fo, c->volume);
+    } else
+    {
+      fi = frames;
+      offset = n1 < fi ? n1 : fi;
+      c->write(&m->map.map, p1, m->mixbuf, offset, c->volume);
+      if ( offset < fi )
+	c->write(&m->map.map, p2, &m->mixbuf[offset * BENCH_CHANNELS], fi - offset, c->volume);
+    }
+  dspd_fifo_rcommit(c->fifo, fi);
+  //The client refills its fifo.  The data is still there, so just move the pointer.
+  dspd_fifo_wcommit(c->fifo, fi);
+
+  s = dspd_mbx_write_lock(c->mbx, &idx);
+  s->appl_ptr += fi;
+  s->hw_ptr += fi;
+  dspd_mbx_write_unlock(c->mbx, idx);
+}
+
+static void b_cycle(void *arg, size_t frames)
+{
+  struct bench_mix *m = arg;
+  size_t i;
+  memset(m->mixbuf, 0, frames * BENCH_CHANNELS * sizeof(*m->mixbuf));
+  for ( i = 0; i < m->count; i++ )
+    client_mix(m, &m->clients[i], frames);
+  m->conv->fromfloat64(m->mixbuf, m->devbuf, frames * BENCH_CHANNELS);
+}
+
+/*
+  Every src_every'th client runs at 44.1k.  A value of 0 means all of
+  them run at the device rate.
+*/
+static void bench_clients(size_t count, size_t src_every)
+{
+  struct bench_mix m;
+  struct bench_client *c;
+  float *data;
+  size_t i;
+  char name[128];
+  memset(&m, 0, sizeof(m));
+  m.count = count;
+  m.clients = calloc(count, sizeof(*m.clients));
+  m.mixbuf = calloc(BENCH_CYCLE * BENCH_CHANNELS, sizeof(*m.mixbuf));
+  m.srcbuf = calloc(BENCH_CYCLE * BENCH_CHANNELS, sizeof(*m.srcbuf));
+  m.devbuf = calloc(BENCH_CYCLE * BENCH_CHANNELS, sizeof(*m.devbuf));
+  DSPD_ASSERT(m.clients && m.mixbuf && m.srcbuf && m.devbuf);
+  m.conv = dspd_getconv(DSPD_PCM_FORMAT_S16_NE);
+  m.map.map.flags = DSPD_CHMAP_SIMPLE;
+  m.map.map.ichan = m.map.map.ochan = m.map.map.count = BENCH_CHANNELS;
+
+  data = calloc(BENCH_FIFO_LEN * BENCH_CHANNELS, sizeof(*data));
+  DSPD_ASSERT(data);
+  for ( i = 0; i < BENCH_FIFO_LEN * BENCH_CHANNELS; i++ )
+    data[i] = (float)((i * 37UL) % 101UL) / 50.0f - 1.0f;
+  for ( i = 0; i < count; i++ )
+    {
+      c = &m.clients[i];
+      DSPD_ASSERT(dspd_fifo_new(&c->fifo, BENCH_FIFO_LEN, sizeof(float) * BENCH_CHANNELS, NULL) == 0);
+      //Start at a different place in each fifo so they wrap at different times.
+      dspd_fifo_wcommit(c->fifo, (i * 997UL) % BENCH_FIFO_LEN);
+      dspd_fifo_rcommit(c->fifo, (i * 997UL) % BENCH_FIFO_LEN);
+      DSPD_ASSERT(dspd_fifo_write(c->fifo, data, BENCH_FIFO_LEN) == (int32_t)BENCH_FIFO_LEN);
+      DSPD_ASSERT(dspd_mbx_new(&c->mbx, sizeof(struct dspd_pcm_status), NULL) == 0);
+      if ( src_every && (i % src_every) == 0 )
+	{
+	  DSPD_ASSERT(dspd_src_new(&c->src, 0, BENCH_CHANNELS) == 0);
+	  DSPD_ASSERT(dspd_src_set_rates(c->src, BENCH_SRC_RATE, BENCH_RATE) == 0);
+	}
+      c->write = dspd_pcm_chmap_get_write_buf(&m.map.map);
+      c->volume = 1.0f / count;
+    }
+  free(data);
+
+  if ( src_every )
+    snprintf(name, sizeof(name), "mix.cycle_src%zu.%zuclients", src_every, count);
+  else
+    snprintf(name, sizeof(name), "mix.cycle.%zuclients", count);
+  dspd_bench_run(name, b_cycle, &m, BENCH_CYCLE);
+
+  for ( i = 0; i < count; i++ )
+    {
+      c = &m.clients[i];
+      if ( c->src )
+	dspd_src_delete(c->src);
+      dspd_mbx_delete(c->mbx);
+      dspd_fifo_delete(c->fifo);
+    }
+  free(m.clients);
+  free(m.mixbuf);
+  free(m.srcbuf);
+  free(m.devbuf);
+}
+
+int main(int argc, char **argv)
+{
+  static const size_t counts[] = { 1, 8, 32, 128 };
+  size_t i, n;
+  dspd_bench_init(argc, argv);
+  //A client count after the filter replaces the default list.
+  if ( argc > 2 && (n = strtoul(argv[2], NULL, 10)) > 0 )
+    {
+      bench_clients(n, 0);
+      bench_clients(n, 4);
+      return 0;
+    }
+  for ( i = 0; i < ARRAY_SIZE(counts); i++ )
+    {
+      bench_clients(counts[i], 0);
+      bench_clients(counts[i], 4);
+    }
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "bench.h"
+
+/*
+  Every struct pcm_conv entry for the common device formats with each
+  instruction set the CPU supports.
+*/
+
+#define BENCH_FRAMES   1024UL
+#define BENCH_CHANNELS 2UL
+#define BENCH_SAMPLES  (BENCH_FRAMES * BENCH_CHANNELS)
+
+static const int32_t bench_formats[] = {
+  DSPD_PCM_FORMAT_U8,
+  DSPD_PCM_FORMAT_S16_NE,
+  DSPD_PCM_FORMAT_S24_NE,
+  DSPD_PCM_FORMAT_S24_3LE,
+  DSPD_PCM_FORMAT_S32_NE,
+  DSPD_PCM_FORMAT_FLOAT_NE,
+  DSPD_PCM_FORMAT_FLOAT64_NE,
+};
+
+static float32 buf32[BENCH_SAMPLES];
+static float64 buf64[BENCH_SAMPLES];
+static uint8_t raw[BENCH_SAMPLES * 8UL];
+
+static const struct pcm_conv *cur;
+
+static void b_tofloat32(void *arg, size_t frames)
+{
+  cur->tofloat32(raw, buf32, frames * BENCH_CHANNELS);
+}
+static void b_tofloat64(void *arg, size_t frames)
+{
+  cur->tofloat64(raw, buf64, frames * BENCH_CHANNELS);
+}
+static void b_tofloat32wv(void *arg, size_t frames)
+{
+  cur->tofloat32wv(raw, buf32, frames * BENCH_CHANNELS, 0.5);
+}
+static void b_tofloat64wv(void *arg, size_t frames)
+{
+  cur->tofloat64wv(raw, buf64, frames * BENCH_CHANNELS, 0.5);
+}
+static void b_fromfloat32(void *arg, size_t frames)
+{
+  cur->fromfloat32(buf32, raw, frames * BENCH_CHANNELS);
+}
+static void b_fromfloat64(void *arg, size_t frames)
+{
+  cur->fromfloat64(buf64, raw, frames * BENCH_CHANNELS);
+}
+static void b_fromfloat32wv(void *arg, size_t frames)
+{
+  cur->fromfloat32wv(buf32, raw, frames * BENCH_CHANNELS, 0.5);
+}
+static void b_fromfloat64wv(void *arg, size_t frames)
+{
+  cur->fromfloat64wv(buf64, raw, frames * BENCH_CHANNELS, 0.5);
+}
+
+#define bench_entry(_fmt, _isa, _fn)					\
+  if ( cur->_fn ) {							\
+    snprintf(name, sizeof(name), "pcmconv.%s.%s.%s",			\
+	     #_fn, dspd_pcm_name_from_format(_fmt), dspd_pcm_isa_name(_isa)); \
+    dspd_bench_run(name, b_##_fn, NULL, BENCH_FRAMES);			\
+  }
+
+int main(int argc, char **argv)
+{
+  size_t i, f;
+  int32_t isa;
+  char name[128];
+  dspd_bench_init(argc, argv);
+  for ( i = 0; i < BENCH_SAMPLES; i++ )
+    {
+      buf64[i] = ((double)((i * 7919UL) % 2001UL) / 1000.0) - 1.0;
+      buf32[i] = buf64[i];
+    }
+  for ( f = 0; f < ARRAY_SIZE(bench_formats); f++ )
+    {
+      //Float input must be real samples so denormals and NaNs don't skew the results.
+      if ( bench_formats[f] == DSPD_PCM_FORMAT_FLOAT_NE )
+	memcpy(raw, buf32, sizeof(buf32));
+      else if ( bench_formats[f] == DSPD_PCM_FORMAT_FLOAT64_NE )
+	memcpy(raw, buf64, sizeof(buf64));
+      else
+	for ( i = 0; i < sizeof(raw); i++ )
+	  raw[i] = (i * 131UL) >> 3;
+      for ( isa = 0; isa < DSPD_PCM_ISA_COUNT; isa++ )
+	{
+	  cur = dspd_getconv_isa(bench_formats[f], isa);
+	  if ( ! cur )
+	    continue;
+	  bench_entry(bench_formats[f], isa, tofloat32);
+	  bench_entry(bench_formats[f], isa, tofloat64);
+	  bench_entry(bench_formats[f], isa, tofloat32wv);
+	  bench_entry(bench_formats[f], isa, tofloat64wv);
+	  bench_entry(bench_formats[f], isa, fromfloat32);
+	  bench_entry(bench_formats[f], isa, fromfloat64);
+	  bench_entry(bench_formats[f], isa, fromfloat32wv);
+	  bench_entry(bench_formats[f], isa, fromfloat64wv);
+	}
+    }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "bench.h"
+#include "src_poly.h"
+
+/*
+  Sample rate conversion with the builtin backends (bcr and every polyphase
+  quality level).  The speex and libsamplerate modules are only installed
+  by the daemon, so they are not covered here.  Results are per output frame.
+*/
+
+#define BENCH_FRAMES   1024UL
+#define BENCH_CHANNELS 2UL
+//Input split in two like a fifo that wrapped around
+#define BENCH_SPLIT    333UL
+
+static float inbuf[BENCH_FRAMES * 2UL * BENCH_CHANNELS];
+static float outbuf[BENCH_FRAMES * BENCH_CHANNELS];
+
+struct bench_src {
+  dspd_src_t src;
+  uint32_t   rate_in, rate_out;
+};
+
+static size_t input_frames(const struct bench_src *b, size_t frames)
+{
+  return dspd_src_get_frame_count(b->rate_out, b->rate_in, frames) + 1UL;
+}
+
+static void b_process(void *arg, size_t frames)
+{
+  struct bench_src *b = arg;
+  size_t fi = input_frames(b, frames), fo = frames;
+  DSPD_ASSERT(dspd_src_process(b->src, false, inbuf, &fi, outbuf, &fo) == 0);
+}
+
+static void b_process_v(void *arg, size_t frames)
+{
+  struct bench_src *b = arg;
+  size_t fi, fo = frames, n = input_frames(b, frames);
+  struct dspd_src_iov iov[2] = {
+    { .buf = inbuf, .frames = BENCH_SPLIT },
+    { .buf = &inbuf[BENCH_SPLIT * BENCH_CHANNELS], .frames = n - BENCH_SPLIT },
+  };
+  DSPD_ASSERT(dspd_src_process_v(b->src, false, iov, 2, &fi, outbuf, &fo) == 0);
+}
+
+static void bench_rates(int quality, uint32_t rate_in, uint32_t rate_out)
+{
+  struct bench_src b;
+  char name[128];
+  uint32_t q;
+  b.rate_in = rate_in;
+  b.rate_out = rate_out;
+  //Quality 0 is bcr, which dspd_src_new() only gives out as the minimum.
+  DSPD_ASSERT(dspd_src_new(&b.src, quality ? -quality : 1, BENCH_CHANNELS) == 0);
+  DSPD_ASSERT(dspd_src_set_rates(b.src, rate_in, rate_out) == 0);
+  dspd_src_get_params(b.src, &q, NULL, NULL);
+  snprintf(name, sizeof(name), "src.process.q%u.%u_%u", q, rate_in, rate_out);
+  dspd_bench_run(name, b_process, &b, BENCH_FRAMES);
+  snprintf(name, sizeof(name), "src.process_v.q%u.%u_%u", q, rate_in, rate_out);
+  dspd_bench_run(name, b_process_v, &b, BENCH_FRAMES);
+  dspd_src_delete(b.src);
+}
+
+int main(int argc, char **argv)
+{
+  size_t i;
+  int q;
+  dspd_bench_init(argc, argv);
+  for ( i = 0; i < ARRAY_SIZE(inbuf); i++ )
+    inbuf[i] = (float)((i * 37UL) % 101UL) / 50.0f - 1.0f;
+  for ( q = 0; q <= DSPD_SRC_POLY_MAX_QUALITY; q++ )
+    {
+      bench_rates(q, 44100, 48000);
+      bench_rates(q, 48000, 44100);
+      bench_rates(q, 22050, 48000);
+    }
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ *  CAPCACHE - Shared channel map conversions for capture clients
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "sslib.h"
+#include "capcache.h"
+
+//Called with the capture params before the io thread starts.
+int32_t dspd_capcache_init(struct dspd_capcache *cache, size_t bufsize, size_t channels)
+{
+  size_t i;
+  memset(cache, 0, sizeof(*cache));
+  cache->bufsize = bufsize;
+  cache->nsamples = bufsize * MAX(channels, DSPD_CAPCACHE_CHANNELS);
+  for ( i = 0; i < DSPD_CAPCACHE_SLOTS; i++ )
+    {
+      cache->slots[i].buf = malloc(cache->nsamples * sizeof(*cache->slots[i].buf));
+      if ( ! cache->slots[i].buf )
+	{
+	  dspd_capcache_destroy(cache);
+	  return -ENOMEM;
+	}
+    }
+  return 0;
+}
+
+void dspd_capcache_destroy(struct dspd_capcache *cache)
+{
+  size_t i;
+  for ( i = 0; i < DSPD_CAPCACHE_SLOTS; i++ )
+    {
+      free(cache->slots[i].buf);
+      cache->slots[i].buf = NULL;
+    }
+}
+
+void dspd_capcache_next_cycle(struct dspd_capcache *cache)
+{
+  cache->cycle++;
+}
+
+static struct dspd_capcache_slot *get_slot(struct dspd_capcache *cache,
+					   const struct dspd_pcm_chmap *map)
+{
+  struct dspd_capcache_slot *c, *slot = NULL;
+  size_t i, len = dspd_pcm_chmap_sizeof(map->count, map->flags);
+  if ( len == 0 || len > sizeof(c->map) )
+    return NULL;
+  if ( cache->slots[0].buf == NULL || cache->bufsize * map->ochan > cache->nsamples )
+    return NULL;
+  for ( i = 0; i < DSPD_CAPCACHE_SLOTS; i++ )
+    {
+      c = &cache->slots[i];
+      if ( c->maplen == len && memcmp(&c->map, map, len) == 0 )
+	return c;
+      //Take an empty slot or the one that has been unused the longest.
+      if ( slot == NULL || c->maplen == 0 ||
+	   (slot->maplen != 0 && c->cycle < slot->cycle) )
+	slot = c;
+    }
+  memcpy(&slot->map, map, len);
+  slot->maplen = len;
+  slot->src = NULL;
+  slot->frames = 0;
+  slot->cycle = 0;
+  slot->users = 0;
+  slot->last_users = 0;
+  return slot;
+}
+
+const float *dspd_capcache_map(struct dspd_capcache *cache,
+			       const struct dspd_pcm_chmap *map,
+			       dspd_chmap_read_t read,
+			       const float *buf,
+			       uintptr_t frames)
+{
+  struct dspd_capcache_slot *c = get_slot(cache, map);
+  if ( ! c )
+    return NULL;
+  if ( c->cycle != cache->cycle )
+    {
+      c->last_users = (c->cycle + 1U == cache->cycle) ? c->users : 0;
+      c->users = 0;
+      c->cycle = cache->cycle;
+      c->src = NULL;
+      c->frames = 0;
+    }
+  c->users++;
+  if ( c->src == NULL )
+    {
+      //A lone client converts straight into its own fifo.
+      if ( c->users < 2U && c->last_users < 2U )
+	return NULL;
+      c->src = buf;
+    } else if ( c->src != buf )
+    {
+      //A rewind or pointer adjustment put this client somewhere else.
+      return NULL;
+    }
+  if ( frames * map->ochan > cache->nsamples )
+    return NULL;
+  if ( frames > c->frames )
+    {
+      //The map only adds to the output, so unmapped channels must be cleared.
+      memset(&c->buf[c->frames * map->ochan], 0,
+	     (frames - c->frames) * map->ochan * sizeof(*c->buf));
+      read(map,
+	   &buf[c->frames * map->ichan],
+	   &c->buf[c->frames * map->ochan],
+	   frames - c->frames,
+	   1.0f);
+      c->frames = frames;
+    }
+  return c->buf;
+}
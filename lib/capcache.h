@@ -0,0 +1,49 @@
+#ifndef _DSPD_CAPCACHE_H_
+#define _DSPD_CAPCACHE_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+/*
+  Capture cache.  Capture clients at unity volume with the same channel map
+  get the same samples, so the conversion is done once per io cycle and the
+  other clients copy it (or resample straight out of it).  A slot is only
+  filled when its map had more than one client last cycle so a lone capture
+  client still converts directly into its fifo.  The buffers are allocated
+  with the device and hold a full buffer of DSPD_CAPCACHE_CHANNELS or the
+  device channel count, whichever is more.  A client with more channels than
+  that doesn't use the cache.
+*/
+#define DSPD_CAPCACHE_SLOTS 4
+#define DSPD_CAPCACHE_CHANNELS 2
+struct dspd_capcache_slot {
+  struct dspd_pcm_chmap_container map;
+  size_t       maplen;     //0 if the slot is free
+  const float *src;        //Device buffer the cached frames came from
+  uintptr_t    frames;     //Frames converted so far
+  float       *buf;
+  uint64_t     cycle;      //Cache cycle of the last lookup
+  uint32_t     users;      //Lookups during cycle
+  uint32_t     last_users; //Lookups during the cycle before that
+};
+
+struct dspd_capcache {
+  struct dspd_capcache_slot slots[DSPD_CAPCACHE_SLOTS];
+  size_t                    bufsize;  //Device buffer size in frames
+  size_t                    nsamples; //Size of each slot buffer
+  uint64_t                  cycle;
+};
+
+int32_t dspd_capcache_init(struct dspd_capcache *cache, size_t bufsize, size_t channels);
+void dspd_capcache_destroy(struct dspd_capcache *cache);
+//Start a new io cycle.  Frames cached during the last one are not used again.
+void dspd_capcache_next_cycle(struct dspd_capcache *cache);
+/*
+  Convert frames from buf with map at unity volume.  Returns the converted
+  frames, or NULL if the caller should convert them itself.
+*/
+const float *dspd_capcache_map(struct dspd_capcache *cache,
+			       const struct dspd_pcm_chmap *map,
+			       dspd_chmap_read_t read,
+			       const float *buf,
+			       uintptr_t frames);
+#endif
@@ -767,6 +767,279 @@ void dspd_pcm_chmap_write_buf_simple(const struct dspd_pcm_chmap * __restrict ma
 }
 
 
+/*
+  Single precision versions for devices with a float32 mix buffer.  The volume
+  is applied at single precision so the loops vectorize at full width.
+*/
+void dspd_pcm_chmap_write_buf32(const struct dspd_pcm_chmap * __restrict map, 
+				const float                 * __restrict inbuf,
+				float                       * __restrict outbuf,
+				size_t                                   frames,
+				double                                   volume)
+{
+  size_t i, j;
+  float v = volume;
+  for ( i = 0; i < frames; i++ )
+    {
+      for ( j = 0; j < map->count; j++ )
+	outbuf[map->pos[j]] += (inbuf[j] * v); 
+      inbuf = &inbuf[map->ichan];
+      outbuf = &outbuf[map->ochan];
+    }
+}
+
+void dspd_pcm_chmap_write_buf32_multi(const struct dspd_pcm_chmap * __restrict map, 
+				      const float                 * __restrict inbuf,
+				      float                       * __restrict outbuf,
+				      size_t                                   frames,
+				      double                                   volume)
+{
+  size_t i, j;
+  float v = volume;
+  for ( i = 0; i < frames; i++ )
+    {
+      for ( j = 0; j < map->count; j += 2UL )
+	outbuf[map->pos[j+1UL]] += (inbuf[map->pos[j]] * v);
+      inbuf = &inbuf[map->ichan];
+      outbuf = &outbuf[map->ochan];
+    }
+}
+
+void dspd_pcm_chmap_write_buf32_simple(const struct dspd_pcm_chmap * __restrict map, 
+				       const float                 * __restrict inbuf,
+				       float                       * __restrict outbuf,
+				       size_t                                   frames,
+				       double                                   volume)
+{
+  size_t i, j;
+  float v = volume;
+  if ( map->count == map->ichan && map->count == map->ochan )
+    {
+      //Same layout on both sides, so this is one flat loop.
+      frames *= map->count;
+      for ( i = 0; i < frames; i++ )
+	outbuf[i] += (inbuf[i] * v);
+      return;
+    }
+  for ( i = 0; i < frames; i++ )
+    {
+      for ( j = 0; j < map->count; j++ )
+	outbuf[j] += (inbuf[j] * v);
+      inbuf = &inbuf[map->ichan];
+      outbuf = &outbuf[map->ochan];
+    }
+}
+
+
+/*
+  Fused write kernels for the common cases.  Each one does volume scaling,
+  routing, and accumulation into the mix buffer in one pass with the channel
+  counts fixed at compile time so the inner loops are fully unrolled.  They
+  are generated for both mix buffer types.
+*/
+#define chmap_write_identity(_name, _otype)				\
+  static void _name(const struct dspd_pcm_chmap * __restrict map,	\
+		    const float                 * __restrict inbuf,	\
+		    _otype                      * __restrict outbuf,	\
+		    size_t                                   frames,	\
+		    double                                   volume)	\
+  {									\
+    size_t i, n = frames * map->count;					\
+    _otype v = volume;							\
+    for ( i = 0; i < n; i++ )						\
+      outbuf[i] += (inbuf[i] * v);					\
+  }
+
+#define chmap_write_mono_stereo(_name, _otype)				\
+  static void _name(const struct dspd_pcm_chmap * __restrict map,	\
+		    const float                 * __restrict inbuf,	\
+		    _otype                      * __restrict outbuf,	\
+		    size_t                                   frames,	\
+		    double                                   volume)	\
+  {									\
+    size_t i;								\
+    _otype v = volume, s;						\
+    for ( i = 0; i < frames; i++ )					\
+      {									\
+	s = inbuf[i] * v;						\
+	outbuf[0] += s;							\
+	outbuf[1] += s;							\
+	outbuf = &outbuf[2];						\
+      }									\
+  }
+
+#define chmap_write_stereo_stereo(_name, _otype)			\
+  static void _name(const struct dspd_pcm_chmap * __restrict map,	\
+		    const float                 * __restrict inbuf,	\
+		    _otype                      * __restrict outbuf,	\
+		    size_t                                   frames,	\
+		    double                                   volume)	\
+  {									\
+    size_t i, l = map->pos[0], r = map->pos[1];				\
+    _otype v = volume;							\
+    for ( i = 0; i < frames; i++ )					\
+      {									\
+	outbuf[l] += (inbuf[0] * v);					\
+	outbuf[r] += (inbuf[1] * v);					\
+	inbuf = &inbuf[2];						\
+	outbuf = &outbuf[2];						\
+      }									\
+  }
+
+/*
+  Mix _ichan channels down to stereo.  The map is turned into a gain matrix
+  (with the volume applied) once per call so each frame is a couple of dot
+  products.
+*/
+#define chmap_write_downmix(_name, _otype, _ichan)			\
+  static void _name(const struct dspd_pcm_chmap * __restrict map,	\
+		    const float                 * __restrict inbuf,	\
+		    _otype                      * __restrict outbuf,	\
+		    size_t                                   frames,	\
+		    double                                   volume)	\
+  {									\
+    _otype gl[_ichan], gr[_ichan], l, r;				\
+    size_t i, j;							\
+    chmap_stereo_gains(map, _ichan, volume, gl, gr);			\
+    for ( i = 0; i < frames; i++ )					\
+      {									\
+	l = 0; r = 0;							\
+	for ( j = 0; j < (_ichan); j++ )				\
+	  {								\
+	    l += inbuf[j] * gl[j];					\
+	    r += inbuf[j] * gr[j];					\
+	  }								\
+	outbuf[0] += l;							\
+	outbuf[1] += r;							\
+	inbuf = &inbuf[_ichan];						\
+	outbuf = &outbuf[2];						\
+      }									\
+  }
+
+#define chmap_stereo_gains(_map, _ichan, _volume, _gl, _gr)		\
+  do {									\
+    size_t _j, _in, _out;						\
+    memset(_gl, 0, sizeof(_gl));					\
+    memset(_gr, 0, sizeof(_gr));					\
+    for ( _j = 0; _j < (_map)->count; _j++ )				\
+      {									\
+	if ( (_map)->flags & DSPD_CHMAP_MULTI )				\
+	  {								\
+	    _in = (_map)->pos[_j];					\
+	    _j++;							\
+	    _out = (_map)->pos[_j];					\
+	  } else							\
+	  {								\
+	    _in = _j;							\
+	    _out = (_map)->pos[_j];					\
+	  }								\
+	if ( _in < (_ichan) && _out == 0 )				\
+	  _gl[_in] += (_volume);					\
+	else if ( _in < (_ichan) && _out == 1 )				\
+	  _gr[_in] += (_volume);					\
+      }									\
+  } while(0)
+
+chmap_write_identity(write_identity, double);
+chmap_write_identity(write32_identity, float);
+chmap_write_mono_stereo(write_mono_stereo, double);
+chmap_write_mono_stereo(write32_mono_stereo, float);
+chmap_write_stereo_stereo(write_stereo_stereo, double);
+chmap_write_stereo_stereo(write32_stereo_stereo, float);
+chmap_write_downmix(write_stereo_mix, double, 2);
+chmap_write_downmix(write32_stereo_mix, float, 2);
+chmap_write_downmix(write_51_stereo, double, 6);
+chmap_write_downmix(write32_51_stereo, float, 6);
+
+enum chmap_write_type {
+  CHMAP_WRITE_GENERIC,
+  CHMAP_WRITE_MULTI,
+  CHMAP_WRITE_SIMPLE,
+  CHMAP_WRITE_IDENTITY,
+  CHMAP_WRITE_MONO_STEREO,
+  CHMAP_WRITE_STEREO_STEREO,
+  CHMAP_WRITE_STEREO_MIX,
+  CHMAP_WRITE_51_STEREO,
+};
+
+static const dspd_chmap_write_t write_kernels[] = {
+  [CHMAP_WRITE_GENERIC] = dspd_pcm_chmap_write_buf,
+  [CHMAP_WRITE_MULTI] = dspd_pcm_chmap_write_buf_multi,
+  [CHMAP_WRITE_SIMPLE] = dspd_pcm_chmap_write_buf_simple,
+  [CHMAP_WRITE_IDENTITY] = write_identity,
+  [CHMAP_WRITE_MONO_STEREO] = write_mono_stereo,
+  [CHMAP_WRITE_STEREO_STEREO] = write_stereo_stereo,
+  [CHMAP_WRITE_STEREO_MIX] = write_stereo_mix,
+  [CHMAP_WRITE_51_STEREO] = write_51_stereo,
+};
+
+static const dspd_chmap_write32_t write32_kernels[] = {
+  [CHMAP_WRITE_GENERIC] = dspd_pcm_chmap_write_buf32,
+  [CHMAP_WRITE_MULTI] = dspd_pcm_chmap_write_buf32_multi,
+  [CHMAP_WRITE_SIMPLE] = dspd_pcm_chmap_write_buf32_simple,
+  [CHMAP_WRITE_IDENTITY] = write32_identity,
+  [CHMAP_WRITE_MONO_STEREO] = write32_mono_stereo,
+  [CHMAP_WRITE_STEREO_STEREO] = write32_stereo_stereo,
+  [CHMAP_WRITE_STEREO_MIX] = write32_stereo_mix,
+  [CHMAP_WRITE_51_STEREO] = write32_51_stereo,
+};
+
+static enum chmap_write_type chmap_write_type(const struct dspd_pcm_chmap *map)
+{
+  size_t i;
+  if ( map->flags & DSPD_CHMAP_SIMPLE )
+    {
+      if ( map->count == map->ichan && map->count == map->ochan )
+	return CHMAP_WRITE_IDENTITY;
+      return CHMAP_WRITE_SIMPLE;
+    }
+  if ( map->flags & DSPD_CHMAP_MULTI )
+    {
+      if ( map->ochan == 2U )
+	{
+	  if ( map->ichan == 1U && map->count == 4U &&
+	       map->pos[0] == 0 && map->pos[2] == 0 &&
+	       map->pos[1] < 2U && map->pos[3] < 2U && map->pos[1] != map->pos[3] )
+	    return CHMAP_WRITE_MONO_STEREO;
+	  if ( map->ichan == 2U )
+	    return CHMAP_WRITE_STEREO_MIX;
+	  if ( map->ichan == 6U )
+	    return CHMAP_WRITE_51_STEREO;
+	}
+      return CHMAP_WRITE_MULTI;
+    }
+  if ( map->ochan == 2U && map->ichan == 2U && map->count == 2U &&
+       map->pos[0] < 2U && map->pos[1] < 2U )
+    {
+      if ( map->pos[0] == 0 && map->pos[1] == 1U )
+	return CHMAP_WRITE_IDENTITY;
+      return CHMAP_WRITE_STEREO_STEREO;
+    }
+  if ( map->ochan == 2U && map->ichan == 6U && map->count == 6U )
+    return CHMAP_WRITE_51_STEREO;
+  if ( map->count == map->ichan && map->count == map->ochan )
+    {
+      for ( i = 0; i < map->count; i++ )
+	{
+	  if ( map->pos[i] != i )
+	    break;
+	}
+      if ( i == map->count )
+	return CHMAP_WRITE_IDENTITY;
+    }
+  return CHMAP_WRITE_GENERIC;
+}
+
+dspd_chmap_write_t dspd_pcm_chmap_get_write_buf(const struct dspd_pcm_chmap *map)
+{
+  return write_kernels[chmap_write_type(map)];
+}
+
+dspd_chmap_write32_t dspd_pcm_chmap_get_write_buf32(const struct dspd_pcm_chmap *map)
+{
+  return write32_kernels[chmap_write_type(map)];
+}
+
 void dspd_pcm_chmap_read_buf(const struct dspd_pcm_chmap * __restrict map, 
 			     const float                 * __restrict inbuf,
 			     float                       * __restrict outbuf,
@@ -112,6 +112,29 @@ ssize_t dspd_pcm_chmap_index(const char *name);
 int32_t dspd_pcm_chmap_from_string(const char *str, struct dspd_pcm_chmap_container *map);
 ssize_t dspd_pcm_chmap_to_string(const struct dspd_pcm_chmap *map, char *buf, size_t len);
 
+typedef void (*dspd_chmap_write_t)(const struct dspd_pcm_chmap * __restrict map, 
+				   const float                 * __restrict inbuf,
+				   double                      * __restrict outbuf,
+				   size_t                                   frames,
+				   double                                   volume);
+typedef void (*dspd_chmap_write32_t)(const struct dspd_pcm_chmap * __restrict map, 
+				     const float                 * __restrict inbuf,
+				     float                       * __restrict outbuf,
+				     size_t                                   frames,
+				     double                                   volume);
+typedef void (*dspd_chmap_read_t)(const struct dspd_pcm_chmap * __restrict map, 
+				  const float                 * __restrict inbuf,
+				  float                       * __restrict outbuf,
+				  size_t                                   frames,
+				  float                                    volume);
+/*
+  Get the fastest routine for mixing with a channel map.  Common layouts
+  (identity, mono and stereo to stereo, 5.1 to stereo) get fused kernels
+  and everything else gets one of the generic routines below.
+*/
+dspd_chmap_write_t dspd_pcm_chmap_get_write_buf(const struct dspd_pcm_chmap *map);
+dspd_chmap_write32_t dspd_pcm_chmap_get_write_buf32(const struct dspd_pcm_chmap *map);
+
 void dspd_pcm_chmap_write_buf(const struct dspd_pcm_chmap * __restrict map, 
 			      const float                 * __restrict inbuf,
 			      double                      * __restrict outbuf,
@@ -127,6 +150,21 @@ void dspd_pcm_chmap_write_buf_simple(const struct dspd_pcm_chmap * __restrict ma
 				     double                      * __restrict outbuf,
 				     size_t                                   frames,
 				     double                                   volume);
+void dspd_pcm_chmap_write_buf32(const struct dspd_pcm_chmap * __restrict map, 
+				const float                 * __restrict inbuf,
+				float                       * __restrict outbuf,
+				size_t                                   frames,
+				double                                   volume);
+void dspd_pcm_chmap_write_buf32_multi(const struct dspd_pcm_chmap * __restrict map, 
+				      const float                 * __restrict inbuf,
+				      float                       * __restrict outbuf,
+				      size_t                                   frames,
+				      double                                   volume);
+void dspd_pcm_chmap_write_buf32_simple(const struct dspd_pcm_chmap * __restrict map, 
+				       const float                 * __restrict inbuf,
+				       float                       * __restrict outbuf,
+				       size_t                                   frames,
+				       double                                   volume);
 void dspd_pcm_chmap_read_buf(const struct dspd_pcm_chmap * __restrict map, 
 			     const float                 * __restrict inbuf,
 			     float                       * __restrict outbuf,
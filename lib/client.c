@@ -33,6 +33,9 @@
 #include "syncgroup.h"
 
 
+//Samples converted per block when mixing or resampling a raw fifo
+#define DSPD_CLIENT_RAW_SAMPLES 2048
+
 struct dspd_client {
   struct dspd_client_stream     playback;
   struct dspd_client_stream     capture;
@@ -51,11 +54,8 @@ struct dspd_client {
   struct dspd_pcm_chmap_container capture_usermap;
 
   struct dspd_pcm_chmap_container playback_mixmap;
-  void (*playback_write)(const struct dspd_pcm_chmap * __restrict map, 
-			 const float                 * __restrict inbuf,
-			 double                      * __restrict outbuf,
-			 size_t                                   frames,
-			 double                                   volume);
+  dspd_chmap_write_t             playback_write;
+  dspd_chmap_write32_t           playback_write32;
   struct dspd_pcm_chmap_container capture_mixmap;
   void (*capture_read)(const struct dspd_pcm_chmap * __restrict map, 
 		       const float                 * __restrict inbuf,
@@ -135,11 +135,12 @@ static int32_t get_playback_status(void     *dev,
 				   uint64_t *pointer,
 				   uint64_t *start_count,
 				   uint32_t *latency,
-				   uintptr_t frames,
+				   const struct dspd_io_cycle *cycle,
 				   const struct dspd_pcm_status *status);
+static bool get_playback_bus(void *dev, void *client, uint32_t *rate, int32_t *quality);
 static void playback_xfer(void                            *dev,
 			  void                            *client,
-			  double                          *buf,
+			  void                            *buf,
 			  uintptr_t                        frames,
 			  const struct dspd_io_cycle      *cycle,
 			  const struct dspd_pcm_status    *status);
@@ -205,6 +206,7 @@ static const struct dspd_client_ops client_ops = {
   .capture_xfer = capture_xfer,
  
   .error = client_error,
+  .get_playback_bus = get_playback_bus,
 };
 
 int32_t dspd_client_get_index(void *client)
@@ -798,12 +800,8 @@ static int32_t refresh_chmap(struct dspd_client *cli, int32_t sbit)
     {
       if ( sbit == DSPD_PCM_SBIT_PLAYBACK )
 	{
-	  if ( mixmap->map.flags & DSPD_CHMAP_SIMPLE )
-	    cli->playback_write = dspd_pcm_chmap_write_buf_simple;
-	  else if ( mixmap->map.flags & DSPD_CHMAP_MULTI )
-	    cli->playback_write = dspd_pcm_chmap_write_buf_multi;
-	  else
-	    cli->playback_write = dspd_pcm_chmap_write_buf;
+	  cli->playback_write = dspd_pcm_chmap_get_write_buf(&mixmap->map);
+	  cli->playback_write32 = dspd_pcm_chmap_get_write_buf32(&mixmap->map);
 	} else if ( sbit == DSPD_PCM_SBIT_CAPTURE )
 	{
 	  if ( mixmap->map.flags & DSPD_CHMAP_SIMPLE )
@@ -828,11 +826,14 @@ static int32_t dspd_stream_setparams(struct dspd_client_stream *stream,
   int ret;
   struct dspd_shm_addr a;
   int c;
+  const struct pcm_conv *conv = NULL;
+  size_t frame_size;
  
   if ( params )
     c = params->channels;
   else
     c = 0;
+  stream->raw_conv = NULL;
   dspd_fifo_destroy(&stream->fifo);
   dspd_mbx_destroy(&stream->mbx);
   dspd_shm_close(&stream->shm);
@@ -845,8 +846,25 @@ static int32_t dspd_stream_setparams(struct dspd_client_stream *stream,
 
   stream->params.stream = params->stream;
   stream->ready = 0;
-  addr[0].length = dspd_fifo_size(params->bufsize,
-				  params->channels * sizeof(float));
+
+  /*
+    A raw fifo only works for playback and only if the format can be
+    converted.  Float32 clients already write what the mixer wants.
+  */
+  if ( (params->flags & DSPD_CLI_FLAG_RAWFIFO) &&
+       params->stream == DSPD_PCM_SBIT_PLAYBACK &&
+       params->format != DSPD_PCM_FORMAT_FLOAT_NE )
+    {
+      conv = dspd_getconv(params->format);
+      if ( conv != NULL && conv->tofloat32 == NULL )
+	conv = NULL;
+    }
+  if ( conv )
+    frame_size = dspd_get_pcm_format_size(params->format) * params->channels;
+  else
+    frame_size = sizeof(float) * params->channels;
+
+  addr[0].length = dspd_fifo_size(params->bufsize, frame_size);
   addr[0].section_id = DSPD_CLIENT_SECTION_FIFO;
   addr[0].addr = NULL;
 
@@ -855,7 +873,7 @@ static int32_t dspd_stream_setparams(struct dspd_client_stream *stream,
   addr[1].addr = NULL;
   
   if ( params->flags & DSPD_CLI_FLAG_SHM )
-    stream->shm.flags = 0;
+    stream->shm.flags = dspd_dctx.shm_hugepages ? DSPD_SHM_FLAG_HUGEPAGE : 0;
   else
     stream->shm.flags = DSPD_SHM_FLAG_PRIVATE;
   stream->shm.flags |= (DSPD_SHM_FLAG_READ | DSPD_SHM_FLAG_WRITE);
@@ -886,12 +904,18 @@ static int32_t dspd_stream_setparams(struct dspd_client_stream *stream,
 	  if ( ret == 0 )
 	    ret = dspd_fifo_init(&stream->fifo,
 				 params->bufsize,
-				 sizeof(float) * params->channels,
+				 frame_size,
 				 a.addr);
 	}
       if ( ret == 0 )
 	{
 	  memcpy(&stream->params, params, sizeof(*params));
+	  //Tell the client what kind of fifo it really got.
+	  if ( conv )
+	    stream->raw_conv = conv->tofloat32;
+	  else
+	    stream->params.flags &= ~DSPD_CLI_FLAG_RAWFIFO;
+	  stream->frame_size = frame_size;
 	  stream->sample_time = 1000000000 / params->rate;
 	  stream->ready = true;
 	}
@@ -908,7 +932,7 @@ static int32_t get_playback_status(void     *dev,
 				   uint64_t *pointer,    
 				   uint64_t *start_count,
 				   uint32_t *latency,
-				   uintptr_t frames,
+				   const struct dspd_io_cycle *cycle,
 				   const struct dspd_pcm_status *status)
 {
   int32_t ret;
@@ -1011,8 +1035,9 @@ static int32_t get_playback_status(void     *dev,
       if ( start_valid && status->tstamp )
 	{
 	  dspd_time_t diff, sample_time;
-	  if ( cli->playback_src.rate > 0 )
-	    sample_time = 1000000000 / cli->playback_src.rate;
+	  //The status is in device or submix bus frames.
+	  if ( cycle->rate > 0 )
+	    sample_time = 1000000000 / cycle->rate;
 	  else
 	    sample_time = 1000000000 / cli->playback.params.rate;
 	  if ( status->tstamp >= start_tstamp )
@@ -1024,7 +1049,7 @@ static int32_t get_playback_status(void     *dev,
 	      diff = start_tstamp - status->tstamp;
 	      diff /= sample_time;
 	      *pointer = diff + status->hw_ptr;
-	      if ( *pointer >= (status->appl_ptr + frames) )
+	      if ( *pointer >= (status->appl_ptr + cycle->len) )
 		{
 		  *latency = diff;
 		  return -EAGAIN;
@@ -1045,7 +1070,7 @@ static int32_t get_playback_status(void     *dev,
       if ( dspd_fifo_len(&cli->playback.fifo, &len) != 0 )
 	ret = -EAGAIN;
       else if ( len == 0 )
-	ret = -EAGAIN;
+	ret = -ENODATA; //The device may stop checking if this keeps happening
       else
 	ret = 0;
     } else
@@ -1056,6 +1081,58 @@ static int32_t get_playback_status(void     *dev,
   return ret;
 }
 
+static bool get_playback_bus(void *dev, void *client, uint32_t *rate, int32_t *quality)
+{
+  struct dspd_client *cli = client;
+  if ( cli->playback_src.rate == 0 || cli->playback_src.rate == cli->playback.params.rate )
+    return false;
+  *rate = cli->playback.params.rate;
+  *quality = cli->playback.params.src_quality;
+  return true;
+}
+
+/*
+  Convert a DSPD_CLI_FLAG_RAWFIFO buffer in blocks that fit in L1 and mix
+  each block right away, so the float samples are still in cache when the
+  channel map reads them.  The result is the same as converting the whole
+  buffer first.
+*/
+static void playback_mix_raw(struct dspd_client *cli,
+			     const void *in,
+			     void *buf,
+			     uintptr_t offset,
+			     uint32_t frames,
+			     float volume,
+			     int32_t precision)
+{
+  float tmp[DSPD_CLIENT_RAW_SAMPLES];
+  const char *ptr = in;
+  uint32_t channels = cli->playback.params.channels;
+  uint32_t maxf = DSPD_CLIENT_RAW_SAMPLES / channels, n;
+  size_t out = cli->playback_mixmap.map.ochan * offset;
+  DSPD_ASSERT(maxf > 0);
+  while ( frames > 0 )
+    {
+      n = MIN(frames, maxf);
+      cli->playback.raw_conv(ptr, tmp, n * channels);
+      if ( precision == DSPD_MIX_PRECISION_FLOAT32 )
+	cli->playback_write32(&cli->playback_mixmap.map,
+			      tmp,
+			      &((float*)buf)[out],
+			      n,
+			      volume);
+      else
+	cli->playback_write(&cli->playback_mixmap.map,
+			    tmp,
+			    &((double*)buf)[out],
+			    n,
+			    volume);
+      ptr += n * cli->playback.frame_size;
+      out += n * cli->playback_mixmap.map.ochan;
+      frames -= n;
+    }
+}
+
 static int32_t playback_src_read(struct dspd_client *cli,
 				 float **ptr,
 				 uint32_t *len,
@@ -1063,9 +1140,15 @@ static int32_t playback_src_read(struct dspd_client *cli,
 {
   size_t frames_requested = *len;
   size_t count, maxf, offset, l, infr;
-  float *sbuf, *fbuf;
-  uint32_t n;
+  float *sbuf;
+  struct dspd_src_iov iov[2];
+  size_t niov;
+  void *p1, *p2;
+  uint32_t n1, n2, n;
   int32_t ret;
+  float raw[DSPD_CLIENT_RAW_SAMPLES];
+  size_t channels = cli->playback.params.channels;
+  size_t rawmax = DSPD_CLIENT_RAW_SAMPLES / channels, c;
   if ( ! (cli->playback_src.buf && cli->playback_src.src) )
     return -1;
 
@@ -1084,11 +1167,11 @@ static int32_t playback_src_read(struct dspd_client *cli,
     {
       sbuf = &cli->playback_src.buf[offset*cli->playback.params.channels];
       l = frames_requested - offset;
-      ret = dspd_fifo_riov(&cli->playback.fifo, 
-			   (void**)&fbuf,
-			   &n);
+      //Both halves go in one call if the fifo wrapped around.
+      ret = dspd_fifo_riov2(&cli->playback.fifo, &p1, &n1, &p2, &n2);
       if ( ret < 0 )
 	break;
+      n = n1 + n2;
       //Stop when fifo is empty.
       if ( n == 0 )
 	break;
@@ -1102,15 +1185,44 @@ static int32_t playback_src_read(struct dspd_client *cli,
 	infr = n;
       if ( infr > *rem )
 	infr = *rem;
-      if ( dspd_src_process(cli->playback_src.src,
-			    0,
-			    fbuf,
-			    &infr,
-			    sbuf,
-			    &l) < 0 )
+      if ( cli->playback.raw_conv )
+	{
+	  //Convert a block to float32 and resample that.
+	  if ( infr > rawmax )
+	    infr = rawmax;
+	  c = MIN(infr, n1);
+	  cli->playback.raw_conv(p1, raw, c * channels);
+	  if ( infr > c )
+	    cli->playback.raw_conv(p2, &raw[c * channels], (infr - c) * channels);
+	  iov[0].buf = raw;
+	  iov[0].frames = infr;
+	  niov = 1;
+	} else if ( infr > n1 )
+	{
+	  iov[0].buf = p1;
+	  iov[0].frames = n1;
+	  iov[1].buf = p2;
+	  iov[1].frames = infr - n1;
+	  niov = 2;
+	} else
+	{
+	  iov[0].buf = p1;
+	  iov[0].frames = infr;
+	  niov = 1;
+	}
+      if ( dspd_src_process_v(cli->playback_src.src,
+			      0,
+			      iov,
+			      niov,
+			      &infr,
+			      sbuf,
+			      &l) < 0 )
 	{
 	  break;
 	}
+      //The resampler is not making progress, so more calls won't help.
+      if ( infr == 0 && l == 0 )
+	break;
       dspd_fifo_rcommit(&cli->playback.fifo, infr);
       (*rem) -= infr;
       if ( count > 0 )
@@ -1126,7 +1238,7 @@ static int32_t playback_src_read(struct dspd_client *cli,
 
 static void playback_xfer(void                            *dev,
 			  void                            *client,
-			  double                          *buf,
+			  void                            *buf,
 			  uintptr_t                        frames,
 			  const struct dspd_io_cycle      *cycle,
 			  const struct dspd_pcm_status    *status)
@@ -1134,7 +1246,7 @@ static void playback_xfer(void                            *dev,
   struct dspd_client *cli = client;
   uintptr_t offset = 0;
   float *ptr;
-  double *out;
+  size_t out;
   int32_t ret;
   uint32_t count, commit_size;
   struct dspd_pcm_status *cs;
@@ -1147,6 +1259,8 @@ static void playback_xfer(void                            *dev,
   uint32_t client_aptr;
   uint32_t rem;
   int32_t mbxidx;
+  //Resampled raw data is converted before it gets here.
+  bool raw = cli->playback.raw_conv != NULL && cycle->rate == cli->playback.params.rate;
   client_hwptr = dspd_fifo_optr(&cli->playback.fifo);
   client_aptr = dspd_fifo_iptr(&cli->playback.fifo);
 
@@ -1161,7 +1275,8 @@ static void playback_xfer(void                            *dev,
   while ( offset < frames && rem > 0 )
     {
       commit_size = 0;
-      if ( cli->playback_src.rate != cli->playback.params.rate )
+      //A submix bus runs at the client rate and resamples later.
+      if ( cycle->rate != cli->playback.params.rate )
 	{
 	  count = frames - offset;
 	  ret = playback_src_read(cli,
@@ -1193,17 +1308,27 @@ static void playback_xfer(void                            *dev,
 	      ret = -EAGAIN;
 	    }
 	}
-      if ( ret == 0 )
+      if ( ret == 0 && raw )
+	{
+	  playback_mix_raw(cli, ptr, buf, offset, count, volume, cycle->precision);
+	  offset += count;
+	} else if ( ret == 0 )
 	{
 	  
-	  //Pointer to this block of output
-	  out = &buf[cli->playback_mixmap.map.ochan*offset];
-
-	  cli->playback_write(&cli->playback_mixmap.map,
-			      ptr,
-			      out,
-			      count,
-			      volume);
+	  //Offset of this block of output
+	  out = cli->playback_mixmap.map.ochan*offset;
+	  if ( cycle->precision == DSPD_MIX_PRECISION_FLOAT32 )
+	    cli->playback_write32(&cli->playback_mixmap.map,
+				  ptr,
+				  &((float*)buf)[out],
+				  count,
+				  volume);
+	  else
+	    cli->playback_write(&cli->playback_mixmap.map,
+				ptr,
+				&((double*)buf)[out],
+				count,
+				volume);
 	  offset += count;
 	} else
 	{
@@ -1220,6 +1345,10 @@ static void playback_xfer(void                            *dev,
     
   DSPD_ASSERT(offset <= frames);
 
+  //Wake up a client that is sleeping on the fifo.  No syscall if nobody is.
+  if ( rem != (client_aptr - client_hwptr) )
+    dspd_fifo_wake(&cli->playback.fifo);
+
   if ( dspd_dctx.debug && offset < frames )
     fprintf(stderr, "CLIENT PLAYBACK XRUN: wanted %lu got %lu\n", (long)offset, (long)frames);
 
@@ -1271,7 +1400,7 @@ static void playback_xfer(void                            *dev,
 	previous timestamp.  If not, then interpolating with the current monotonic time should fix it.
       */
       len = status->delay + (cli->playback.dev_appl_ptr - status->appl_ptr);
-      if ( cli->playback_src.rate != cli->playback.params.rate )
+      if ( cycle->rate != cli->playback.params.rate )
 	{
 	  cs->delay = dspd_src_get_frame_count(cli->playback_src.rate,
 					       cli->playback.params.rate,
@@ -1322,8 +1451,8 @@ static void playback_xfer(void                            *dev,
 	{
 
 	  dspd_time_t diff, sample_time;
-	  if ( cli->playback_src.rate > 0 )
-	    sample_time = 1000000000ULL / cli->playback_src.rate;
+	  if ( cycle->rate > 0 )
+	    sample_time = 1000000000ULL / cycle->rate;
 	  else
 	    sample_time = 1000000000ULL / cli->playback.params.rate;
 	  diff = status->appl_ptr - status->hw_ptr;
@@ -1638,7 +1767,7 @@ static void capture_xfer(void                            *dev,
   uintptr_t offset = 0;
   int32_t ret;
   float *ptr;
-  const float *in;
+  const float *in, *cached = NULL;
   uint32_t count = 0;
   struct dspd_pcm_status *cs;
   volatile size_t c;
@@ -1664,13 +1793,23 @@ static void capture_xfer(void                            *dev,
   if ( frames > n )
     frames = n;
 
-  
-
+  //Clients that would do the same conversion share it through the device.
+  if ( volume == 1.0f )
+    cached = dspd_pcm_device_capture_map(dev,
+					 &cli->capture_mixmap.map,
+					 cli->capture_read,
+					 buf,
+					 frames);
  
   while ( offset < frames && space > 0 )
     {
       
-      if ( do_src )
+      if ( do_src && cached )
+	{
+	  count = frames - offset;
+	  ptr = (float*)&cached[cli->capture_mixmap.map.ochan * offset];
+	  ret = 0;
+	} else if ( do_src )
 	{
 	  count = cli->capture_src.nsamples / cli->capture_mixmap.map.ichan;
 	  ptr = cli->capture_src.buf;
@@ -1689,22 +1828,30 @@ static void capture_xfer(void                            *dev,
 	  if ( count > c )
 	    count = c;
 	  c = count * cli->capture_mixmap.map.ichan;
-
-	  //Clear out the memory so the channel map
-	  //can be mixed correctly.  I don't think it is likely
-	  //that anyone would use a channel map this way but 
-	  //it probably won't hurt peformance to bad to allow it.
-	  memset(ptr, 0, sizeof(*ptr) * c);
+	  if ( cached )
+	    {
+	      if ( ! do_src )
+		memcpy(ptr,
+		       &cached[cli->capture_mixmap.map.ochan * offset],
+		       sizeof(*ptr) * count * cli->capture_mixmap.map.ochan);
+	    } else
+	    {
+	      //Clear out the memory so the channel map
+	      //can be mixed correctly.  I don't think it is likely
+	      //that anyone would use a channel map this way but 
+	      //it probably won't hurt peformance to bad to allow it.
+	      memset(ptr, 0, sizeof(*ptr) * c);
 
 	  
 	  
-	  in = &buf[cli->capture_mixmap.map.ichan * offset];
+	      in = &buf[cli->capture_mixmap.map.ichan * offset];
 
-	  cli->capture_read(&cli->capture_mixmap.map, 
-			    in,
-			    ptr,
-			    count,
-			    volume);
+	      cli->capture_read(&cli->capture_mixmap.map, 
+				in,
+				ptr,
+				count,
+				volume);
+	    }
 	  offset += count;
 	  cli->capture.dev_appl_ptr += count;
 	  if ( do_src )
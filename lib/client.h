@@ -42,6 +42,8 @@ struct dspd_client_stream {
   union dspd_atomic_float32     volume;
   dspd_time_t                   last_hw_tstamp;
   size_t                        frame_size;
+  //Converts DSPD_CLI_FLAG_RAWFIFO samples to float32.  NULL if the fifo holds float32.
+  void (*raw_conv)(const void * __restrict in, float * __restrict out, size_t len);
   bool                          started;
   uint32_t                      last_hw;
   uint64_t                      curr_hw;
@@ -60,18 +62,21 @@ struct dspd_pcmcli_status {
 
 
 struct dspd_client_ops {
-
+  /*
+    Returns 0 if there is data, -EAGAIN if the client is not ready, or
+    -ENODATA if the fifo is empty.
+  */
   int32_t (*get_playback_status)(void     *dev,
 				 void     *client,      
 				 uint64_t *pointer,
 				 uint64_t *start_count,
 				 uint32_t *latency,
-				 uintptr_t  frames,
+				 const struct dspd_io_cycle   *cycle,
 				 const struct dspd_pcm_status *status);
   
   void (*playback_xfer)(void                            *dev,
 			void                            *client,
-			double                          *buf,
+			void                            *buf, //double or float (see cycle->precision)
 			uintptr_t                        frames,
 			const struct dspd_io_cycle   *cycle,
 			const struct dspd_pcm_status *status);
@@ -90,6 +95,12 @@ struct dspd_client_ops {
 		       const struct dspd_pcm_status *status);
 
   void (*error)(void *dev, int32_t index, void *client, int32_t err);
+
+  /*
+    Optional.  Returns true and the client rate and resampler quality if the
+    client needs resampled and may be mixed on a shared submix bus.
+  */
+  bool (*get_playback_bus)(void *dev, void *client, uint32_t *rate, int32_t *quality);
   
   
 };
@@ -1077,6 +1077,21 @@ int dspd_daemon_init(struct dspd_daemon_ctx *ctx, int argc, char **argv)
 	single_io_thread = !atoi(value);
     }
   ctx->single_io_thread = single_io_thread;
+  if ( dspd_dict_find_value(dcfg, "mix_threads", &value) )
+    {
+      if ( value )
+	ctx->mix_threads = atoi(value);
+    }
+  if ( dspd_dict_find_value(dcfg, "shm_hugepages", &value) )
+    {
+      if ( value )
+	ctx->shm_hugepages = !!atoi(value);
+    }
+  if ( dspd_dict_find_value(dcfg, "src_quality", &value) )
+    {
+      if ( value )
+	ctx->src_quality = atoi(value);
+    }
 
   //The SCHED_DEADLINE and SCHED_ISO policies are safer than SCHED_RR and SCHED_FIFO.
   //If a safe policy is specified and it isn't available then try another safe policy.
@@ -1305,6 +1320,7 @@ int dspd_daemon_init(struct dspd_daemon_ctx *ctx, int argc, char **argv)
 	   ctx->rtio_policy, ctx->rtio_priority,
 	   ctx->rtsvc_policy, ctx->rtsvc_priority);
   dspd_log(0, "Glitch correction policy is %d", ctx->glitch_correction);
+  dspd_log(0, "PCM conversion routines: %s", dspd_pcm_isa_name(dspd_pcm_isa()));
 
   ret = dspd_hotplug_init(&dspd_dctx);
   if ( ret )
@@ -2041,7 +2057,7 @@ static struct dspd_dict *find_config(struct dspd_drv_params *params, const struc
   return dict;
 }
 
-static void apply_config(struct dspd_dict *dict, struct dspd_drv_params *params)
+void dspd_daemon_apply_config(const struct dspd_dict *dict, struct dspd_drv_params *params)
 {
   char *ptr;
   int32_t val;
@@ -2087,6 +2103,15 @@ static void apply_config(struct dspd_dict *dict, struct dspd_drv_params *params)
       if ( dspd_strtoi32(ptr, &val, 0) == 0 )
 	params->min_dma = val;
     }
+  if ( dspd_dict_find_value(dict, "mix_precision", &ptr) )
+    {
+      if ( strcmp(ptr, "float32") == 0 )
+	params->mix_precision = DSPD_MIX_PRECISION_FLOAT32;
+      else if ( strcmp(ptr, "float64") == 0 )
+	params->mix_precision = DSPD_MIX_PRECISION_FLOAT64;
+      else
+	dspd_log(0, "Invalid mix_precision '%s'", ptr);
+    }
 }
 
 
@@ -2119,13 +2144,13 @@ int dspd_daemon_get_config(const struct dspd_dict *dict,
   if ( dspd_dict_find_value(dict, DSPD_HOTPLUG_DESC, &ptr) )
     {
       params->desc = strdup(ptr);
-      if ( ! params->addr )
+      if ( ! params->desc )
 	goto out;
     }
   if ( dspd_dict_find_value(dict, DSPD_HOTPLUG_HWID, &ptr) )
     {
       params->hwid = strdup(ptr);
-      if ( ! params->addr )
+      if ( ! params->hwid )
 	goto out;
     }
 
@@ -2160,13 +2185,13 @@ int dspd_daemon_get_config(const struct dspd_dict *dict,
 	{
 	  d = dspd_dict_find_section(cfg, "PLAYBACK");
 	  if ( d )
-	    apply_config(d, params);
+	    dspd_daemon_apply_config(d, params);
 	} 
       if ( params->stream == DSPD_PCM_STREAM_CAPTURE || params->stream == DSPD_PCM_STREAM_FULLDUPLEX )
 	{
 	  d = dspd_dict_find_section(cfg, "CAPTURE");
 	  if ( d )
-	    apply_config(d, params);
+	    dspd_daemon_apply_config(d, params);
 	}
       dspd_dict_free(cfg);
     }
@@ -2178,6 +2203,7 @@ int dspd_daemon_get_config(const struct dspd_dict *dict,
   free(params->name);
   free(params->bus);
   free(params->desc);
+  free(params->hwid);
   memset(params, 0, sizeof(*params));
   dspd_dict_free(cfg);
   return ret;
@@ -2304,6 +2330,10 @@ int dspd_daemon_run(void)
 	}
     }
   
+  //Modules are loaded by now, so this goes to whichever resampler is in use.
+  if ( dspd_dctx.src_quality > 0 )
+    dspd_src_set_default_quality(dspd_dctx.src_quality);
+
   dspd_log(0, "Running startup commands...");
   for ( curr = dspd_dctx.startup_callbacks; curr; curr = curr->next )
     {
@@ -173,6 +173,12 @@ struct dspd_daemon_ctx {
   struct dspd_scheduler *rtio_sched;
   dspd_thread_t          rtio_thread;
   bool                   single_io_thread;
+  //Playback mixing threads per device (0=disabled)
+  int32_t                mix_threads;
+  //Back shared client buffers with sealed huge page memfds
+  bool                   shm_hugepages;
+  //Default resampler quality (0=leave the resampler default)
+  int32_t                src_quality;
 };
 
 
@@ -191,6 +197,8 @@ void dspd_daemon_hotplug_shutdown(struct dspd_daemon_ctx *ctx);
 int dspd_hotplug_delete(const struct dspd_dict *dict);
 int dspd_daemon_get_config(const struct dspd_dict *sect,
 			   struct dspd_drv_params *params);
+//Apply format, rate, buffer, and latency settings from a config section.
+void dspd_daemon_apply_config(const struct dspd_dict *dict, struct dspd_drv_params *params);
 int dspd_daemon_add_device(void **handles, 
 			   int32_t stream,
 			   uint64_t hotplug_event_id,
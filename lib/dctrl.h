@@ -95,6 +95,7 @@ enum dspd_dctl_req {
   DSPD_SCTL_SERVER_LOCK,
   DSPD_DCTL_ASYNC_EVENT,
   DSPD_SCTL_SERVER_REMOVE,
+  DSPD_SCTL_SERVER_IOSTAT, //Get io thread statistics (struct dspd_iostat_req in, struct dspd_iostat out)
   DSPD_SCTL_SERVER_PCM_LAST = DSPD_SCTL_SERVER_MIN + 256,
 
   DSPD_SCTL_SERVER_MIXER_ELEM_COUNT,
@@ -309,6 +310,32 @@ struct dspd_mix_irqinfo64 {
   uint64_t ack_count;
 };
 
+/*
+  Device io thread statistics.  The io thread records them without locking, so
+  a snapshot may be a few samples behind.  A reset is done by the io thread on
+  its next cycle after the snapshot is taken.
+*/
+enum dspd_iostat_hist {
+  DSPD_IOSTAT_WAKEUP_JITTER, //How late the io thread woke up after a timed sleep (ns)
+  DSPD_IOSTAT_CYCLE_TIME,    //Time spent in one playback io cycle (ns)
+  DSPD_IOSTAT_CLIENTS,       //Clients serviced per mixing pass
+  DSPD_IOSTAT_REWINDS,       //Rewinds done per playback io cycle
+  DSPD_IOSTAT_COUNT
+};
+struct dspd_iostat_req {
+  uint32_t hist;
+#define DSPD_IOSTAT_RESET 1U //Reset all histograms and counters
+  uint32_t flags;
+};
+struct dspd_iostat {
+  uint32_t         hist;
+  uint32_t         reserved;
+  uint64_t         xruns;      //Recoveries caused by -EPIPE
+  uint64_t         recoveries; //All stream recoveries
+  uint64_t         tstamp;     //Time of the last reset
+  struct dspd_hist data;
+};
+
 struct dspd_sync_cmd {
   uint32_t streams;
 #define SGCMD_START 1
@@ -33,6 +33,9 @@
 #define _DSPD_CTL_MACROS
 #include "sslib.h"
 #include "daemon.h"
+#include "mixpool.h"
+#include "submix.h"
+#include "capcache.h"
 /*
   Lock optimization saves up to 30% CPU.  The idea is that any io cycle that is split into
   multiple chunks can avoid locking and unlocking a client multiple times during the io cycle.
@@ -44,6 +47,62 @@
   iterations until it is time to sleep or start a new io cycle.
 */
 #define ENABLE_LOCK_OPTIMIZATION
+
+/*
+  Parallel mixing.  Playback transfers that do not need the driver (no rewind
+  or pointer adjustment) are queued while the io thread walks the client list.
+  The queue is split evenly across the worker threads and each worker mixes
+  into its own zeroed partial buffer.  The io thread then adds the partials to
+  the device buffer.  Clients stay locked until their transfer is done and
+  capture for a queued client runs afterwards so a client is never touched by
+  two threads at once.
+*/
+#define DSPD_MIX_PARALLEL_MIN 4
+
+/*
+  Idle playback clients.  A triggered client that has had an empty fifo for
+  DSPD_IDLE_CYCLES io cycles in a row is marked silent.  Silent clients are
+  skipped without taking the lock until the hardware pointer has moved half
+  of the client latency or the client is triggered again.
+*/
+#define DSPD_IDLE_CYCLES 16
+#define DSPD_ACTIVE_BITS (sizeof(AO_t) * 8UL)
+#define DSPD_ACTIVE_WORDS ((DSPD_MAX_OBJECTS + DSPD_ACTIVE_BITS - 1UL) / DSPD_ACTIVE_BITS)
+struct dspd_client_idle {
+  uint64_t recheck;     //Hardware pointer to look at the client again
+  uint64_t start_count; //Device instance the recheck pointer belongs to
+  uint32_t cycles;      //Consecutive cycles with an empty fifo
+  uint8_t  seq;         //trigger_seq when the client went silent
+};
+struct dspd_mix_job {
+  void                         *client;
+  const struct dspd_client_ops *ops;
+  uintptr_t                     frames;
+  uint32_t                      index;
+  bool                          capture;
+  bool                          unlock;
+};
+struct dspd_mix_partial {
+  void      *buf;
+  uintptr_t  frames; //Frames zeroed so far this cycle
+  ssize_t    job;    //Current job or -1 if finished
+};
+
+/*
+  Submix buses.  Playback clients that need resampled are grouped by rate
+  and quality, mixed at their own rate and resampled once per bus.  A bus
+  keeps running with silent input for a few cycles after its last client
+  stops so the end of the stream makes it out of the resampler.
+
+  Buses are never allocated or freed by the io thread.  When a playback
+  client is configured the control path makes a bus for its rate and leaves
+  it in submix_spare.  The io thread moves a spare into a free or idle slot
+  when a client needs it and leaves the old bus in submix_dead for the
+  control path to free.
+*/
+#define DSPD_SUBMIX_BUSES 4
+#define DSPD_SUBMIX_DRAIN_CYCLES 2
+
 struct dspd_pcm_device {
   struct dspd_pcmdev_stream        playback;
   struct dspd_pcmdev_stream        capture;
@@ -107,6 +166,44 @@ struct dspd_pcm_device {
   uintptr_t  pxferlen_hint, cxferlen_hint;
 
   bool must_spin;
+
+  /*
+    Dense copies of the trigger bits in reg.client_mask.  These are written
+    with the device locked and let the io thread find triggered clients a word
+    at a time.  The sequence number changes whenever a client is triggered.
+  */
+  volatile AO_t    playback_active[DSPD_ACTIVE_WORDS];
+  volatile AO_t    capture_active[DSPD_ACTIVE_WORDS];
+  volatile uint8_t trigger_seq[DSPD_MAX_OBJECTS];
+  //Playback clients that have been idle long enough to skip (io thread only)
+  AO_t                     silent_mask[DSPD_ACTIVE_WORDS];
+  struct dspd_client_idle  idle_clients[DSPD_MAX_OBJECTS];
+
+  //Parallel mixing (optional)
+  struct dspd_mixpool     *mixpool;
+  struct dspd_mix_partial *mix_partials;
+  struct dspd_mix_job      mix_jobs[DSPD_MAX_OBJECTS];
+  size_t                   mix_njobs;
+
+  //Shared resamplers (io thread only)
+  struct dspd_submix      *submix[DSPD_SUBMIX_BUSES];
+  //Bus handoff between the control path (device locked) and the io thread
+  volatile AO_t            submix_spare[DSPD_SUBMIX_BUSES];
+  volatile AO_t            submix_dead[DSPD_SUBMIX_BUSES];
+  uint32_t                 submix_begun; //Buses set up this cycle
+  uint32_t                 submix_fed;   //Buses that got client data this cycle
+  uint64_t                 submix_cycle;
+
+  //Shared capture channel map conversions (io thread only)
+  struct dspd_capcache     capture_cache;
+
+  //io thread statistics (written by the io thread only, see DSPD_SCTL_SERVER_IOSTAT)
+  struct dspd_hist         iostat[DSPD_IOSTAT_COUNT];
+  volatile uint64_t        xruns, recoveries;
+  dspd_time_t              iostat_tstamp;
+  volatile AO_t            iostat_reset;
+  AO_t                     iostat_reset_seen;
+  uint32_t                 cycle_rewinds;
 };
 
 #define DSPD_DEV_USE_TLS
@@ -551,10 +648,29 @@ static uint8_t get_trigger_mask(const uint8_t *mask, uintptr_t index)
 }
 
 
+static inline void set_active_bit(volatile AO_t *mask, uint32_t client, bool active)
+{
+  uintptr_t w = client / DSPD_ACTIVE_BITS;
+  AO_t b = (AO_t)1 << (client % DSPD_ACTIVE_BITS);
+  if ( active )
+    AO_store(&mask[w], mask[w] | b);
+  else
+    AO_store(&mask[w], mask[w] & ~b);
+}
+
+//Set the trigger bits for a client.  The device must be locked.
+static void set_client_trigger(struct dspd_pcm_device *dev, uint32_t client, uint8_t bits)
+{
+  set_trigger_mask((uint8_t*)dev->reg.client_mask, client * 2U, bits);
+  set_active_bit(dev->playback_active, client, bits & DSPD_PCM_SBIT_PLAYBACK);
+  set_active_bit(dev->capture_active, client, bits & DSPD_PCM_SBIT_CAPTURE);
+  if ( bits & DSPD_PCM_SBIT_PLAYBACK )
+    dev->trigger_seq[client]++;
+}
+
 static int32_t dspd_dev_client_settrigger(struct dspd_pcm_device *dev, uint32_t client, uint32_t bits, bool now)
 {
   int32_t ret, cbits;
-  uintptr_t b;
   if ( client < DSPD_MAX_OBJECTS )
     {
       cbits = dev->client_configs[client];
@@ -567,8 +683,7 @@ static int32_t dspd_dev_client_settrigger(struct dspd_pcm_device *dev, uint32_t
 	  dev->client_configs[client] = cbits;
 	  if ( now )
 	    {
-	      b = client * 2;
-	      set_trigger_mask((uint8_t*)dev->reg.client_mask, b, cbits);
+	      set_client_trigger(dev, client, cbits);
 	      dspd_sched_trigger(dev->sched);
 	    }
 	} else
@@ -623,11 +738,75 @@ static int32_t dspd_dev_params_get_min_latency(struct dspd_pcm_device *dev)
 
 
 
+/*
+  Make sure a playback client that mixes through a bus has one waiting for it
+  and free the buses the io thread is done with.  The device must be locked.
+*/
+static void prepare_client_submix(struct dspd_pcm_device *dev, uint32_t client)
+{
+  void *cli = NULL, *srv_ops = NULL;
+  struct dspd_client_ops *cli_ops = NULL;
+  struct dspd_submix *bus;
+  uint32_t rate;
+  int32_t quality;
+  size_t i, slot = DSPD_SUBMIX_BUSES;
+  for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+    {
+      bus = (struct dspd_submix*)AO_load(&dev->submix_dead[i]);
+      if ( bus )
+	{
+	  AO_store(&dev->submix_dead[i], 0);
+	  dspd_submix_delete(bus);
+	}
+    }
+  if ( ! dev->playback.ops )
+    return;
+  dspd_slist_entry_get_pointers(dev->list, client, &cli, &srv_ops, (void**)&cli_ops);
+  if ( ! (cli && cli_ops && cli_ops->get_playback_bus &&
+	  cli_ops->get_playback_bus(dev, cli, &rate, &quality)) )
+    return;
+  /*
+    The io thread only moves buses out of submix_spare and into
+    submix_dead, so a bus seen in an active slot or a spare slot here
+    is not freed before this returns.
+  */
+  for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+    {
+      bus = dev->submix[i];
+      if ( bus != NULL && bus->rate == rate && bus->quality == quality )
+	return;
+      bus = (struct dspd_submix*)AO_load(&dev->submix_spare[i]);
+      if ( bus != NULL && bus->rate == rate && bus->quality == quality )
+	return;
+      if ( bus == NULL )
+	slot = i;
+    }
+  if ( slot == DSPD_SUBMIX_BUSES )
+    {
+      //Replace a spare that nobody has asked for.
+      for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+	{
+	  bus = (struct dspd_submix*)AO_load(&dev->submix_spare[i]);
+	  if ( bus != NULL && AO_compare_and_swap(&dev->submix_spare[i], (AO_t)bus, 0) )
+	    {
+	      dspd_submix_delete(bus);
+	      slot = i;
+	      break;
+	    }
+	}
+      if ( slot == DSPD_SUBMIX_BUSES )
+	return;
+    }
+  if ( dspd_submix_new(&bus, rate, quality, &dev->playback.params) == 0 &&
+       ! AO_compare_and_swap(&dev->submix_spare[slot], 0, (AO_t)bus) )
+    dspd_submix_delete(bus);
+}
+
 static int32_t dspd_dev_client_configure(struct dspd_pcm_device *dev, uint32_t client)
 {
   //Setup the configuration registers.  That means find the lowest latency,
   //set the bitmask (register) for this client, and find the highest client index.
-  uint32_t config = 0, b;
+  uint32_t config = 0;
   int32_t i, cbits, maxp = -1, maxc = -1, min_latency, l;
   min_latency = dspd_dev_params_get_max_latency(dev);
 
@@ -659,12 +838,13 @@ static int32_t dspd_dev_client_configure(struct dspd_pcm_device *dev, uint32_t c
 
   cbits = dev->client_configs[client];
 
+  if ( (cbits & DSPD_CBIT_PRESENT) && (cbits & DSPD_PCM_SBIT_PLAYBACK) )
+    prepare_client_submix(dev, client);
 
-  b = client * 2;
   if ( cbits & DSPD_CBIT_PRESENT )
-    set_trigger_mask((uint8_t*)dev->reg.client_mask, b, cbits);
+    set_client_trigger(dev, client, cbits);
   else
-    set_trigger_mask((uint8_t*)dev->reg.client_mask, b, 0);
+    set_client_trigger(dev, client, 0);
   
   dspd_dev_config_set_stream_count(dev,
 				   &config,
@@ -1077,8 +1257,9 @@ static bool process_rewound_playback(struct dspd_pcm_device *dev,
 {
   uintptr_t offset = 0, l, o;
   int ret;
-  double *buf;
+  char *buf;
   uintptr_t len;
+  size_t framesize = DSPD_MIX_SAMPLE_SIZE(dev->playback.cycle.precision) * dev->playback.params.channels;
   bool result = true;
   uintptr_t rem = dev->playback.cycle.remaining, cl = dev->playback.cycle.len;
   dev->playback.cycle.remaining = frames;
@@ -1098,7 +1279,7 @@ static bool process_rewound_playback(struct dspd_pcm_device *dev,
       dev->playback.cycle.len = len;
       ops->playback_xfer(dev,
 			 client,
-			 &buf[o * dev->playback.params.channels],
+			 &buf[o * framesize],
 			 len,
 			 &dev->playback.cycle,
 			 dev->playback.status);
@@ -1119,13 +1300,70 @@ static bool process_rewound_playback(struct dspd_pcm_device *dev,
   return result;
 }
 
-static intptr_t safe_rewindable(struct dspd_pcm_device *dev, intptr_t latency)
+/*
+  Add a client to frames that were already mixed and committed.  The device
+  pointer does not move, so the client sees a copy of the status with the
+  application pointer where the rewrite starts.
+*/
+static bool process_rewritten_playback(struct dspd_pcm_device *dev,
+				       void *client,
+				       const struct dspd_client_ops *ops,
+				       uint64_t *pointer,
+				       uintptr_t back,
+				       uintptr_t frames)
+{
+  struct dspd_pcm_status status = *dev->playback.status;
+  struct dspd_io_cycle cycle = dev->playback.cycle;
+  size_t framesize = DSPD_MIX_SAMPLE_SIZE(dev->playback.cycle.precision) * dev->playback.params.channels;
+  uintptr_t offset = 0, o, len;
+  intptr_t ret;
+  char *buf;
+  status.appl_ptr -= back;
+  status.fill -= back;
+  status.space += back;
+  status.delay -= back;
+  cycle.remaining = frames;
+  while ( offset < frames )
+    {
+      len = frames - offset;
+      ret = dev->playback.ops->rewrite_begin(dev->playback.handle,
+					     back - offset,
+					     (void**)&buf,
+					     &o,
+					     &len);
+      if ( ret < 0 )
+	return false;
+      if ( len == 0 )
+	break;
+      cycle.addr = buf;
+      cycle.offset = o;
+      cycle.len = len;
+      ops->playback_xfer(dev,
+			 client,
+			 &buf[o * framesize],
+			 len,
+			 &cycle,
+			 &status);
+      ret = dev->playback.ops->rewrite_commit(dev->playback.handle, o, len);
+      if ( ret < 0 )
+	return false;
+      cycle.remaining -= len;
+      status.appl_ptr += len;
+      status.fill += len;
+      status.space -= len;
+      status.delay += len;
+      offset += len;
+    }
+  (*pointer) += offset;
+  return true;
+}
+
+static intptr_t safe_rewindable(struct dspd_pcm_device *dev, intptr_t latency, intptr_t rw)
 {
-  intptr_t rw, minfill, rwf;
+  intptr_t minfill, rwf;
   minfill = 10000000 / dev->playback.sample_time;
   if ( minfill > latency )
     minfill = latency;
-  rw = dev->playback.ops->rewindable(dev->playback.handle);
   if ( rw > 0 )
     {
       rwf = dev->playback.status->fill - rw;
@@ -1138,16 +1376,53 @@ static intptr_t safe_rewindable(struct dspd_pcm_device *dev, intptr_t latency)
 }
 
 
+static void client_idle(struct dspd_pcm_device *dev, uint32_t client, uint32_t latency)
+{
+  struct dspd_client_idle *idle = &dev->idle_clients[client];
+  if ( idle->cycles < DSPD_IDLE_CYCLES )
+    {
+      idle->cycles++;
+      if ( idle->cycles < DSPD_IDLE_CYCLES )
+	return;
+    }
+  idle->recheck = dev->playback.status->hw_ptr + (latency / 2U);
+  idle->start_count = dev->playback.cycle.start_count;
+  idle->seq = dev->trigger_seq[client];
+  dev->silent_mask[client / DSPD_ACTIVE_BITS] |= (AO_t)1 << (client % DSPD_ACTIVE_BITS);
+}
+
+static inline void client_active(struct dspd_pcm_device *dev, uint32_t client)
+{
+  dev->idle_clients[client].cycles = 0;
+  dev->silent_mask[client / DSPD_ACTIVE_BITS] &= ~((AO_t)1 << (client % DSPD_ACTIVE_BITS));
+}
+
+//See if a silent playback client can be skipped without locking it.
+static inline bool client_is_silent(struct dspd_pcm_device *dev, uint32_t client)
+{
+  struct dspd_client_idle *idle = &dev->idle_clients[client];
+  if ( ! (dev->silent_mask[client / DSPD_ACTIVE_BITS] & ((AO_t)1 << (client % DSPD_ACTIVE_BITS))) )
+    return false;
+  if ( idle->seq == dev->trigger_seq[client] &&
+       idle->start_count == dev->playback.cycle.start_count &&
+       (int64_t)(idle->recheck - dev->playback.status->hw_ptr) > 0 )
+    return true;
+  //Look at it again.  It is marked silent again if the fifo is still empty.
+  dev->silent_mask[client / DSPD_ACTIVE_BITS] &= ~((AO_t)1 << (client % DSPD_ACTIVE_BITS));
+  return false;
+}
+
 static bool process_client_playback(struct dspd_pcm_device *dev,
 				    void *client,
-				    const struct dspd_client_ops *ops)
+				    const struct dspd_client_ops *ops,
+				    struct dspd_mix_job *job)
 {
   uint64_t pointer, start_count;
   uint32_t latency;
   int32_t ret;
   uint64_t diff, client_gap, client_space, orig_ptr;
   intptr_t rw, frames;
-  double *ptr;
+  char *ptr;
   bool starting;
   size_t offset = 0;
   //This is the actual latency.  In glitch correction mode this is often more than
@@ -1164,9 +1439,13 @@ static bool process_client_playback(struct dspd_pcm_device *dev,
 				     &pointer,
 				     &start_count,
 				     &latency,
-				     dev->playback.cycle.len,
+				     &dev->playback.cycle,
 				     dev->playback.status);
-      if ( ret == -EAGAIN )
+      if ( ret == -ENODATA )
+	client_idle(dev, dev->current_client, latency);
+      else
+	client_active(dev, dev->current_client);
+      if ( ret == -EAGAIN || ret == -ENODATA )
 	{
 	  if ( latency < dev->playback.latency &&
 	       latency < dev->playback.early_cycle )
@@ -1226,12 +1505,42 @@ static bool process_client_playback(struct dspd_pcm_device *dev,
       client_gap = 0;
     }
  
-  if ( client_gap )
+  if ( client_gap && dev->playback.ops->rewritable )
+    rw = dev->playback.ops->rewritable(dev->playback.handle);
+  else
+    rw = -ENOTSUP;
+  if ( client_gap && rw != -ENOTSUP )
     {
+      //Add the client to the frames that are already mixed.
+      if ( rw < 0 )
+	goto out;
       if ( starting )
-	rw = safe_rewindable(dev, latency);
-      else
-	rw = dev->playback.ops->rewindable(dev->playback.handle);
+	rw = safe_rewindable(dev, latency, rw);
+      if ( dspd_dctx.debug && rw < client_gap )
+	fprintf(stderr, "Error rewriting for client: wanted %ld, got %ld\n", (long)client_gap, (long)rw);
+      if ( rw > (intptr_t)client_gap )
+	rw = client_gap;
+      if ( rw > 0 )
+	{
+	  dev->cycle_rewinds++;
+	  pointer = dev->playback.status->appl_ptr - rw;
+	  frames = rw;
+	  if ( frames > client_space )
+	    frames = client_space;
+	  client_space -= frames;
+	  if ( ! process_rewritten_playback(dev,
+					    client,
+					    ops,
+					    &pointer,
+					    rw,
+					    frames) )
+	    goto out;
+	}
+    } else if ( client_gap )
+    {
+      rw = dev->playback.ops->rewindable(dev->playback.handle);
+      if ( starting )
+	rw = safe_rewindable(dev, latency, rw);
       if ( rw < 0 )
 	goto out;
       if ( dspd_dctx.debug && rw < client_gap )
@@ -1247,6 +1556,7 @@ static bool process_client_playback(struct dspd_pcm_device *dev,
 	    goto out;
 	  if ( rw > 0 )
 	    {
+	      dev->cycle_rewinds++;
 
 	      //The pointer is possibly ahead of the clients application pointer
 	      //because rewinding that far isn't always possible.
@@ -1294,6 +1604,12 @@ static bool process_client_playback(struct dspd_pcm_device *dev,
 	  if ( offset < client_space )
 	    {
 	      client_space -= offset;
+	      if ( job != NULL && offset == 0 )
+		{
+		  //Nothing else to do with the driver, so this can be mixed on a worker.
+		  job->frames = client_space;
+		  return true;
+		}
 	      intptr_t f;
 	      if ( offset > 0 )
 		{
@@ -1302,8 +1618,8 @@ static bool process_client_playback(struct dspd_pcm_device *dev,
 		{
 		  f = 0;
 		}
-	      offset *= dev->playback.params.channels;
-	      offset += dev->playback.cycle.offset * dev->playback.params.channels;
+	      offset += dev->playback.cycle.offset;
+	      offset *= DSPD_MIX_SAMPLE_SIZE(dev->playback.cycle.precision) * dev->playback.params.channels;
 	      ptr = dev->playback.cycle.addr;
 	      ops->playback_xfer(dev,
 				 client,
@@ -1331,6 +1647,161 @@ static bool process_client_playback(struct dspd_pcm_device *dev,
 
 }
 
+//Take a ready made bus for rate and quality from the control path.
+static struct dspd_submix *take_spare_submix(struct dspd_pcm_device *dev, uint32_t rate, int32_t quality)
+{
+  size_t i;
+  struct dspd_submix *bus;
+  for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+    {
+      bus = (struct dspd_submix*)AO_load(&dev->submix_spare[i]);
+      if ( bus != NULL && bus->rate == rate && bus->quality == quality &&
+	   AO_compare_and_swap(&dev->submix_spare[i], (AO_t)bus, 0) )
+	return bus;
+    }
+  return NULL;
+}
+
+//Find the submix bus for a client.  Returns -1 if the client is mixed by itself.
+static int32_t get_client_submix(struct dspd_pcm_device *dev,
+				 void *client,
+				 const struct dspd_client_ops *ops)
+{
+  uint32_t rate, i, dead, slot = DSPD_SUBMIX_BUSES;
+  int32_t quality;
+  struct dspd_submix *bus;
+  if ( ! (ops->get_playback_bus && ops->get_playback_bus(dev, client, &rate, &quality)) )
+    return -1;
+  for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+    {
+      bus = dev->submix[i];
+      if ( bus != NULL && bus->rate == rate && bus->quality == quality )
+	break;
+      if ( bus == NULL )
+	slot = i;
+    }
+  if ( i == DSPD_SUBMIX_BUSES )
+    {
+      //Take over a bus that has not been used in a while.
+      for ( i = 0; i < DSPD_SUBMIX_BUSES && slot == DSPD_SUBMIX_BUSES; i++ )
+	{
+	  bus = dev->submix[i];
+	  if ( bus->drain == 0 &&
+	       (dev->submix_cycle - bus->last_used) > DSPD_IDLE_CYCLES )
+	    slot = i;
+	}
+      if ( slot == DSPD_SUBMIX_BUSES )
+	return -1;
+      //Only the control path empties these, so a free one stays free.
+      for ( dead = 0; dead < DSPD_SUBMIX_BUSES; dead++ )
+	{
+	  if ( AO_load(&dev->submix_dead[dead]) == 0 )
+	    break;
+	}
+      if ( dead == DSPD_SUBMIX_BUSES )
+	return -1;
+      bus = take_spare_submix(dev, rate, quality);
+      if ( bus == NULL )
+	return -1;
+      if ( dev->submix[slot] )
+	AO_store(&dev->submix_dead[dead], (AO_t)dev->submix[slot]);
+      dev->submix[slot] = bus;
+      i = slot;
+    }
+  bus = dev->submix[i];
+  if ( ! (dev->submix_begun & (1U << i)) )
+    {
+      dspd_submix_begin(bus, &dev->playback.cycle, dev->playback.status);
+      dev->submix_begun |= 1U << i;
+    }
+  bus->last_used = dev->submix_cycle;
+  return i;
+}
+
+static void process_submix_client(struct dspd_pcm_device *dev,
+				  int32_t index,
+				  void *client,
+				  const struct dspd_client_ops *ops)
+{
+  struct dspd_submix *bus = dev->submix[index];
+  uint64_t pointer = bus->status.appl_ptr, start_count = bus->cycle.start_count;
+  uint32_t latency = ((uint64_t)dev->playback.latency * bus->rate) / bus->dev_rate;
+  uintptr_t offset = 0;
+  int32_t ret;
+  ret = ops->get_playback_status(dev,
+				 client,
+				 &pointer,
+				 &start_count,
+				 &latency,
+				 &bus->cycle,
+				 &bus->status);
+  //The scheduling is done in device frames.
+  latency = ((uint64_t)latency * bus->dev_rate) / bus->rate;
+  if ( ret == -ENODATA )
+    client_idle(dev, dev->current_client, latency);
+  else
+    client_active(dev, dev->current_client);
+  if ( ret == -EAGAIN || ret == -ENODATA )
+    {
+      if ( latency < dev->playback.latency &&
+	   latency < dev->playback.early_cycle )
+	dev->playback.early_cycle = latency;
+      return;
+    }
+  if ( latency < dev->playback.early_cycle && 
+       (latency < (dev->playback.status->fill+dev->playback.cycle.len) ||
+	latency < dev->playback.latency))
+    dev->playback.early_cycle = latency;
+
+  /*
+    Nothing on a bus can be rewound.  A client that fell behind continues at
+    the bus pointer and a starting client may begin part way into the cycle.
+  */
+  if ( start_count != bus->cycle.start_count && pointer > bus->status.appl_ptr )
+    offset = pointer - bus->status.appl_ptr;
+  if ( offset >= bus->cycle.len )
+    return;
+  //Same as adjust_pointer() on a device
+  bus->status.appl_ptr += offset;
+  bus->status.delay += offset;
+  ops->playback_xfer(dev,
+		     client,
+		     &((float*)bus->cycle.addr)[offset * bus->channels],
+		     bus->cycle.len - offset,
+		     &bus->cycle,
+		     &bus->status);
+  bus->status.appl_ptr -= offset;
+  bus->status.delay -= offset;
+  dev->submix_fed |= 1U << index;
+}
+
+//Resample the buses and add them to the device buffer.
+static void finish_submix(struct dspd_pcm_device *dev)
+{
+  size_t i;
+  uint32_t bit;
+  struct dspd_submix *bus;
+  if ( ! (dev->playback.cycle.addr && dev->playback.cycle.len) )
+    return;
+  for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+    {
+      bus = dev->submix[i];
+      bit = 1U << i;
+      if ( bus == NULL )
+	continue;
+      if ( dev->submix_fed & bit )
+	bus->drain = DSPD_SUBMIX_DRAIN_CYCLES;
+      else if ( bus->drain > 0 )
+	bus->drain--; //Flush the resampler with silence
+      else if ( ! (dev->submix_begun & bit) )
+	continue;
+      if ( ! (dev->submix_begun & bit) )
+	dspd_submix_begin(bus, &dev->playback.cycle, dev->playback.status);
+      dspd_submix_end(bus, &dev->playback.cycle, dev->playback.status);
+    }
+  dev->submix_cycle++;
+}
+
 static bool process_rewound_capture(struct dspd_pcm_device *dev,
 				    void *client,
 				    const struct dspd_client_ops *ops,
@@ -1375,6 +1846,15 @@ static bool process_rewound_capture(struct dspd_pcm_device *dev,
   return result;
 }
 
+const float *dspd_pcm_device_capture_map(struct dspd_pcm_device *dev,
+					 const struct dspd_pcm_chmap *map,
+					 dspd_chmap_read_t read,
+					 const float *buf,
+					 uintptr_t frames)
+{
+  return dspd_capcache_map(&dev->capture_cache, map, read, buf, frames);
+}
+
 static void process_client_capture(struct dspd_pcm_device *dev,
 				   void *client,
 				   const struct dspd_client_ops *ops)
@@ -1505,7 +1985,7 @@ static void _alert_one_client(struct dspd_pcm_device *dev, int32_t client, int32
 	  if ( cli_ops->error )
 	    cli_ops->error(dev, dev->key, cli, EFAULT);
 	}
-      dspd_client_srv_unlock(dev->list, client);
+      dspd_client_srv_unlock(dev->list, client, dev->key);
       dspd_daemon_unref(client); //Might sleep and free resources
       dspd_clr_bit(dev->lock_mask, client);
       return;
@@ -1548,7 +2028,7 @@ static void _alert_one_client(struct dspd_pcm_device *dev, int32_t client, int32
 		    cli_ops->error(dev, dev->key, cli, error);
 		}
 	      dspd_clr_bit(dev->lock_mask, client);
-	      dspd_client_srv_unlock(dev->list, client);
+	      dspd_client_srv_unlock(dev->list, client, dev->key);
 	    }
 	  dspd_daemon_unref(client); //Might sleep and free resources
 	}
@@ -1583,13 +2063,129 @@ static void unlock_all_clients(struct dspd_pcm_device *dev)
   for ( i = 0; i < DSPD_MAX_OBJECTS; i++ )
     {
       if ( dspd_test_bit(dev->lock_mask, i) )
-	dspd_client_srv_unlock(dev->list, i);
+	dspd_client_srv_unlock(dev->list, i, dev->key);
     }
   memset(dev->lock_mask, 0, sizeof(dev->lock_mask));
   dev->lock_count = 0;
 #endif
 }
 
+static void mix_worker(void *arg, size_t worker, size_t nworkers)
+{
+  struct dspd_pcm_device *dev = arg;
+  struct dspd_mix_partial *p = &dev->mix_partials[worker];
+  struct dspd_mix_job *job;
+  size_t i, last = (dev->mix_njobs * (worker + 1UL)) / nworkers;
+  size_t fs = DSPD_MIX_SAMPLE_SIZE(dev->playback.cycle.precision) * dev->playback.params.channels;
+  char *buf = p->buf;
+  p->frames = 0;
+  for ( i = (dev->mix_njobs * worker) / nworkers; i < last; i++ )
+    {
+      job = &dev->mix_jobs[i];
+      if ( job->frames > p->frames )
+	{
+	  memset(&buf[p->frames * fs], 0, (job->frames - p->frames) * fs);
+	  p->frames = job->frames;
+	}
+      //If the client causes a SIGBUS then this is how the device finds out which one.
+      p->job = i;
+      job->ops->playback_xfer(dev,
+			      job->client,
+			      buf,
+			      job->frames,
+			      &dev->playback.cycle,
+			      dev->playback.status);
+    }
+  p->job = -1;
+}
+
+static void mix_reduce(struct dspd_pcm_device *dev, const struct dspd_mix_partial *p)
+{
+  size_t i, n = p->frames * dev->playback.params.channels;
+  size_t offset = dev->playback.cycle.offset * dev->playback.params.channels;
+  if ( dev->playback.cycle.precision == DSPD_MIX_PRECISION_FLOAT32 )
+    {
+      float *out = &((float*)dev->playback.cycle.addr)[offset];
+      const float *in = p->buf;
+      for ( i = 0; i < n; i++ )
+	out[i] += in[i];
+    } else
+    {
+      double *out = &((double*)dev->playback.cycle.addr)[offset];
+      const double *in = p->buf;
+      for ( i = 0; i < n; i++ )
+	out[i] += in[i];
+    }
+}
+
+static void kick_faulted_client(struct dspd_pcm_device *dev, int32_t client);
+
+static void finish_mix_jobs(struct dspd_pcm_device *dev, bool err)
+{
+  size_t i, n;
+  struct dspd_mix_job *job;
+  struct dspd_mix_partial *p;
+  if ( ! err )
+    {
+      if ( dev->mix_njobs >= DSPD_MIX_PARALLEL_MIN )
+	n = dspd_mixpool_workers(dev->mixpool);
+      else
+	n = 1;
+      for ( i = 0; i < n; i++ )
+	dev->mix_partials[i].job = -1;
+      if ( n > 1 )
+	dspd_mixpool_run(dev->mixpool);
+      else
+	mix_worker(dev, 0, 1);
+      for ( i = 0; i < n; i++ )
+	{
+	  p = &dev->mix_partials[i];
+	  mix_reduce(dev, p);
+	  if ( p->job >= 0 )
+	    {
+	      //The rest of the jobs for this worker are skipped this time.
+	      job = &dev->mix_jobs[p->job];
+	      kick_faulted_client(dev, job->index);
+	      dspd_clr_bit(dev->lock_mask, job->index);
+	      job->capture = false;
+	      job->unlock = false;
+	    }
+	}
+    }
+  /*
+    An error means the stream was recovered and all clients were unlocked.
+    Otherwise finish up what was skipped in process_clients_once().
+  */
+  for ( i = 0; i < dev->mix_njobs; i++ )
+    {
+      job = &dev->mix_jobs[i];
+      if ( ! dspd_test_bit(dev->lock_mask, job->index) )
+	continue;
+      if ( job->capture )
+	{
+	  dev->current_client = job->index;
+	  process_client_capture(dev, job->client, job->ops);
+	  dev->current_client = -1;
+	}
+      if ( job->unlock || dev->must_unlock )
+	{
+	  dspd_client_srv_unlock(dev->list, job->index, dev->key);
+	  dspd_clr_bit(dev->lock_mask, job->index);
+	}
+    }
+  dev->mix_njobs = 0;
+}
+
+//Get lock_mask bits for one word of the active client bitmaps.
+static inline AO_t get_lock_word(const struct dspd_pcm_device *dev, size_t w)
+{
+  AO_t ret = 0;
+  size_t i, n = DSPD_ACTIVE_BITS / 8U, o = w * n;
+  for ( i = 0; i < n && (o + i) < DSPD_MASK_SIZE; i++ )
+    ret |= (AO_t)dev->lock_mask[o + i] << (i * 8U);
+  return ret;
+}
+
 static bool process_clients_once(struct dspd_pcm_device *dev, uint32_t ops)
 {
   //Process all clients.  Must lock and unlock as they
@@ -1603,6 +2199,11 @@ static bool process_clients_once(struct dspd_pcm_device *dev, uint32_t ops)
   struct dspd_pcmsrv_ops *srv_ops;
   void *cli;
   bool unlock;
+  struct dspd_mix_job *job = NULL;
+  size_t w;
+  AO_t bits;
+  int32_t bus;
+  uint64_t nclients = 0;
   if ( (ops & (EPOLLIN|EPOLLOUT)) == (EPOLLIN|EPOLLOUT) )
     {
       if ( dev->playback.streams > dev->capture.streams )
@@ -1624,78 +2225,138 @@ static bool process_clients_once(struct dspd_pcm_device *dev, uint32_t ops)
     }
   if ( dev->process_data )
     dev->process_data(dev->arg, dev);
+  dev->submix_begun = 0;
+  dev->submix_fed = 0;
+  if ( capture )
+    dspd_capcache_next_cycle(&dev->capture_cache);
 
   if ( maxidx < dev->lock_count )
     maxidx = dev->lock_count;
 
-  
-
-  for ( i = 0; i < maxidx; i++ )
-    {
-      trigger_index = i << 1U; //i*2
-      tm = get_trigger_mask((uint8_t*)dev->reg.client_mask, trigger_index);
-      playback_ready = playback && (tm & DSPD_PCM_SBIT_PLAYBACK);
-      capture_ready = capture && (tm & DSPD_PCM_SBIT_CAPTURE);
-      ready = playback_ready | capture_ready;
+  /*
+    Scan the active client bitmaps a word at a time.  Locked clients must be
+    visited too since they might need to be unlocked.
+  */
+  for ( w = 0; w < DSPD_ACTIVE_WORDS && (w * DSPD_ACTIVE_BITS) < maxidx; w++ )
+    {
+      bits = 0;
+      if ( playback )
+	bits |= AO_load(&dev->playback_active[w]);
+      if ( capture )
+	bits |= AO_load(&dev->capture_active[w]);
+      if ( dev->lock_count > w * DSPD_ACTIVE_BITS )
+	bits |= get_lock_word(dev, w);
+      while ( bits )
+	{
+	  i = (w * DSPD_ACTIVE_BITS) + __builtin_ctzl(bits);
+	  bits &= bits - 1U;
+	  if ( i >= maxidx )
+	    break;
+	  trigger_index = i << 1U; //i*2
+	  tm = get_trigger_mask((uint8_t*)dev->reg.client_mask, trigger_index);
+	  playback_ready = playback && (tm & DSPD_PCM_SBIT_PLAYBACK);
+	  capture_ready = capture && (tm & DSPD_PCM_SBIT_CAPTURE);
+	  ready = playback_ready | capture_ready;
      
 
-      if ( ready )
-	{
-#ifdef ENABLE_LOCK_OPTIMIZATION
-	  if ( ! dspd_test_bit(dev->lock_mask, i) )
+	  if ( ready )
 	    {
-	      if ( ! dspd_client_srv_trylock(dev->list, i, dev->key) )
+	      //Idle playback only clients do not need locked.
+	      if ( playback_ready && ! capture_ready &&
+		   ! dspd_test_bit(dev->lock_mask, i) &&
+		   client_is_silent(dev, i) )
 		continue;
-	      dspd_set_bit(dev->lock_mask, i);
-	      if ( i >= dev->lock_count )
-		dev->lock_count = i + 1U;
-	    }
+#ifdef ENABLE_LOCK_OPTIMIZATION
+	      if ( ! dspd_test_bit(dev->lock_mask, i) )
+		{
+		  if ( ! dspd_client_srv_trylock(dev->list, i, dev->key) )
+		    continue;
+		  dspd_set_bit(dev->lock_mask, i);
+		  if ( i >= dev->lock_count )
+		    dev->lock_count = i + 1U;
+		}
 #else
-	  if ( dspd_client_srv_trylock(dev->list, i, dev->key) )
+	      if ( dspd_client_srv_trylock(dev->list, i, dev->key) )
 #endif
-	    {
-	      dev->current_client = i;
-	      //Try again with the lock held
-	      tm = get_trigger_mask((uint8_t*)dev->reg.client_mask, trigger_index);
-	      playback_ready = playback && (tm & DSPD_PCM_SBIT_PLAYBACK);
-	      capture_ready = capture && (tm & DSPD_PCM_SBIT_CAPTURE);
-	      ready = playback_ready | capture_ready;
-	      dspd_slist_entry_get_pointers(dev->list,
-					    i,
-					    &cli,
-					    (void**)&srv_ops,
-					    (void**)&cli_ops);
+		{
+		  dev->current_client = i;
+		  nclients++;
+		  //Try again with the lock held
+		  tm = get_trigger_mask((uint8_t*)dev->reg.client_mask, trigger_index);
+		  playback_ready = playback && (tm & DSPD_PCM_SBIT_PLAYBACK);
+		  capture_ready = capture && (tm & DSPD_PCM_SBIT_CAPTURE);
+		  ready = playback_ready | capture_ready;
+		  dspd_slist_entry_get_pointers(dev->list,
+						i,
+						&cli,
+						(void**)&srv_ops,
+						(void**)&cli_ops);
 	    
-	      if ( playback_ready )
-		err = ! process_client_playback(dev, cli, cli_ops);
+		  if ( playback_ready && (bus = get_client_submix(dev, cli, cli_ops)) >= 0 )
+		    {
+		      process_submix_client(dev, bus, cli, cli_ops);
+		    } else if ( playback_ready )
+		    {
+		      if ( dev->mixpool && dev->playback.cycle.addr && dev->playback.cycle.len )
+			{
+			  job = &dev->mix_jobs[dev->mix_njobs];
+			  job->frames = 0;
+			}
+		      err = ! process_client_playback(dev, cli, cli_ops, job);
+		      if ( job != NULL && job->frames > 0 && ! err )
+			{
+			  job->client = cli;
+			  job->ops = cli_ops;
+			  job->index = i;
+			  job->capture = capture_ready;
+			  dev->mix_njobs++;
+			} else
+			{
+			  job = NULL;
+			}
+		    }
 	      
-	      if ( capture_ready )
-		process_client_capture(dev, cli, cli_ops);
-	      dev->current_client = -1;
-
-	      //This could have been two branches (not considering what the cc optimizer might do), but
-	      //it can easily be a NOT, OR, and branch (JMP).
-	      //if ( dev->must_unlock || ready == false )
-	      unlock = !ready; unlock |= dev->must_unlock; if ( unlock ) { 
-		dspd_client_srv_unlock(dev->list, i);
-		dspd_clr_bit(dev->lock_mask, i);
-	      }
+		  if ( capture_ready && job == NULL )
+		    process_client_capture(dev, cli, cli_ops);
+		  dev->current_client = -1;
+
+		  //This could have been two branches (not considering what the cc optimizer might do), but
+		  //it can easily be a NOT, OR, and branch (JMP).
+		  //if ( dev->must_unlock || ready == false )
+		  unlock = !ready; unlock |= dev->must_unlock; if ( job ) {
+		    //Unlock after mixing
+		    job->unlock = unlock;
+		    job = NULL;
+		  } else if ( unlock ) { 
+		    dspd_client_srv_unlock(dev->list, i, dev->key);
+		    dspd_clr_bit(dev->lock_mask, i);
+		  }
 	      
-	      if ( err )
-		break;
-	    }
-	} else if ( dev->must_unlock && dspd_test_bit(dev->lock_mask, i) )
-	{
+		  if ( err )
+		    break;
+		}
+	    } else if ( dev->must_unlock && dspd_test_bit(dev->lock_mask, i) )
+	    {
 #ifdef ENABLE_LOCK_OPTIMIZATION
-	  dspd_client_srv_unlock(dev->list, i);
-	  dspd_clr_bit(dev->lock_mask, i);
+	      dspd_client_srv_unlock(dev->list, i, dev->key);
+	      dspd_clr_bit(dev->lock_mask, i);
 #endif
+	    }
 	}
+      if ( err )
+	break;
     }
 
 
+  if ( dev->mix_njobs > 0 )
+    finish_mix_jobs(dev, err);
+  if ( playback && ! err )
+    finish_submix(dev);
+
   if ( dev->must_unlock )
     dev->lock_count = 0;
+  if ( maxidx > 0 )
+    dspd_hist_add(&dev->iostat[DSPD_IOSTAT_CLIENTS], nclients);
   return err;
 }
 
@@ -1721,6 +2382,9 @@ static int stream_prepare(struct dspd_pcmdev_stream *stream)
 static int _stream_recover_fcn(struct dspd_pcmdev_stream *stream)
 {
   unlock_all_clients(stream->dev);
+  stream->dev->recoveries++;
+  if ( stream->ops->get_error == NULL || stream->ops->get_error(stream->handle) == -EPIPE )
+    stream->dev->xruns++;
   stream->started = false;
   stream->status = NULL;
   stream->cycle.start_count++;
@@ -1888,14 +2552,15 @@ static int stream_drop(struct dspd_pcmdev_stream *stream)
   stream->cycle.len = 0;
   stream->cycle.offset = 0;
   memset(&stream->cycle, 0, sizeof(stream->cycle));
+  stream->cycle.precision = stream->params.mix_precision;
+  stream->cycle.rate = stream->params.rate;
   stream->last_hw = 0;
   dspd_intrp_reset(&stream->intrp);
   return stream->ops->drop(stream->handle);
 }
 
-static void schedule_playback_wake(void *userdata)
+static void playback_wake(struct dspd_pcm_device *dev)
 {
-  struct dspd_pcm_device *dev = userdata;
   int32_t ret;
   uintptr_t len, count, i, l, written = 0, total, n;
   uint16_t revents;
@@ -2102,6 +2767,44 @@ static void schedule_playback_wake(void *userdata)
   return;
 }
 
+//Clear the statistics if DSPD_SCTL_SERVER_IOSTAT asked for it.
+static void iostat_check_reset(struct dspd_pcm_device *dev, dspd_time_t now)
+{
+  AO_t r = AO_load(&dev->iostat_reset);
+  if ( r != dev->iostat_reset_seen )
+    {
+      dev->iostat_reset_seen = r;
+      memset(dev->iostat, 0, sizeof(dev->iostat));
+      dev->xruns = 0;
+      dev->recoveries = 0;
+      dev->iostat_tstamp = now;
+    }
+}
+
+/*
+  The wakeup jitter is only known when the last sleep was a timed wait.  Waking up
+  early for a client trigger or fd event is not jitter, so that is ignored.
+*/
+static void schedule_playback_wake(void *userdata)
+{
+  struct dspd_pcm_device *dev = userdata;
+  dspd_time_t t = dspd_get_time();
+  iostat_check_reset(dev, t);
+  if ( dev->playback.next_wakeup != 0 )
+    {
+      if ( t >= dev->playback.next_wakeup )
+	dspd_hist_add(&dev->iostat[DSPD_IOSTAT_WAKEUP_JITTER], t - dev->playback.next_wakeup);
+      dev->playback.next_wakeup = 0;
+    }
+  dev->cycle_rewinds = 0;
+  playback_wake(dev);
+  if ( dev->playback.running )
+    {
+      dspd_hist_add(&dev->iostat[DSPD_IOSTAT_CYCLE_TIME], dspd_get_time() - t);
+      dspd_hist_add(&dev->iostat[DSPD_IOSTAT_REWINDS], dev->cycle_rewinds);
+    }
+}
+
 static bool schedule_capture_sleep(void *data, uint64_t *abstime, uint64_t *deadline, int32_t *reltime)
 {
   struct dspd_pcm_device *dev = data;
@@ -2170,6 +2873,9 @@ static void schedule_capture_wake(void *data)
   int32_t ret;
   if ( AO_load(&dev->error) != 0 )
     dspd_sched_abort(dev->sched);
+  //Full duplex devices already did this in schedule_playback_wake()
+  if ( ! dev->playback.ops )
+    iostat_check_reset(dev, dspd_get_time());
 
   dev->trigger = false; //If it triggered then that was processed already.
   dspd_sync_reg(dev);
@@ -2293,6 +2999,7 @@ static void dev_started(void *user_data)
 {
   struct dspd_pcm_device *dev = user_data;
   struct dspd_scheduler *sched = dev->sched;
+  dev->iostat_tstamp = dspd_get_time();
   if ( ! (sched->flags & DSPD_SCHED_SLAVE) )
     dspd_daemon_set_thread_nice(-1, DSPD_THREADATTR_RTIO);
     
@@ -2379,46 +3086,52 @@ static bool schedule_fullduplex_sleep(void *data, uint64_t *abstime, uint64_t *d
   return ret;
 }
 
-static void schedule_sigbus_handler(void *data)
+//The client must be locked by the device.
+static void kick_faulted_client(struct dspd_pcm_device *dev, int32_t client)
 {
-  struct dspd_pcm_device *dev = data;
-  if ( dev->current_client >= 0 )
+  uint32_t refcnt;
+  uint64_t slotid = dspd_slist_id(dev->list, client); //get slot id while we have a reference
+  dspd_client_srv_unlock(dev->list, client, dev->key); //Still locked from earlier
+  dspd_slist_entry_wrlock(dev->list, client); //This lock must be taken first
+  //Try to get a reference count
+  refcnt = dspd_slist_ref(dev->list, client);
+  if ( refcnt <= 1 )
+    dspd_slist_unref(dev->list, client);
+  dspd_slist_entry_rw_unlock(dev->list, client);
+
+  if ( refcnt > 1 )
     {
-      uint32_t refcnt;
-      uint64_t slotid = dspd_slist_id(dev->list, dev->current_client); //get slot id while we have a reference
-      dspd_client_srv_unlock(dev->list, dev->current_client); //Still locked from earlier
-      dspd_slist_entry_wrlock(dev->list, dev->current_client); //This lock must be taken first
-      //Try to get a reference count
-      refcnt = dspd_slist_ref(dev->list, dev->current_client);
-      if ( refcnt <= 1 )
-	dspd_slist_unref(dev->list, dev->current_client);
-      dspd_slist_entry_rw_unlock(dev->list, dev->current_client);
-
-      if ( refcnt > 1 )
+      /*
+	At this point the device either owns the client or the trigger
+	bits should not be set because the slot is either empty or belongs
+	to something else.
+      */
+      if ( dspd_slist_id(dev->list, client) == slotid )
 	{
 	  /*
-	    At this point the device either owns the client or the trigger
-	    bits should not be set because the slot is either empty or belongs
-	    to something else.
+	    The slot is still the one we think it is.
 	  */
-	  if ( dspd_slist_id(dev->list, dev->current_client) == slotid )
-	    {
-	      /*
-		The slot is still the one we think it is.
-	      */
-	      dspd_dev_lock(dev);
-	      dspd_dev_client_settrigger(dev, dev->current_client, 0, 0);
-	      dspd_dev_unlock(dev);
-	    }
-	  //This is a good place to call shutdown(client_sock, SHUT_RDWR).
-	  //Anyone who causes a SIGBUS needs kicked off, even at the cost of
-	  //increasing the chances of a glitch.
-	  alert_one_client(dev, dev->current_client, EFAULT);
-	  dspd_slist_entry_wrlock(dev->list, dev->current_client);
-	  dspd_slist_unref(dev->list, dev->current_client);
-	  dspd_slist_entry_rw_unlock(dev->list, dev->current_client);
+	  dspd_dev_lock(dev);
+	  dspd_dev_client_settrigger(dev, client, 0, 0);
+	  dspd_dev_unlock(dev);
 	}
+      //This is a good place to call shutdown(client_sock, SHUT_RDWR).
+      //Anyone who causes a SIGBUS needs kicked off, even at the cost of
+      //increasing the chances of a glitch.
+      alert_one_client(dev, client, EFAULT);
+      dspd_slist_entry_wrlock(dev->list, client);
+      dspd_slist_unref(dev->list, client);
+      dspd_slist_entry_rw_unlock(dev->list, client);
     }
+}
+
+static void schedule_sigbus_handler(void *data)
+{
+  struct dspd_pcm_device *dev = data;
+  if ( dev->current_client >= 0 )
+    kick_faulted_client(dev, dev->current_client);
+  //Queued jobs are lost, but their clients are still locked.
+  dev->mix_njobs = 0;
   unlock_all_clients(dev);
 }
 
@@ -2593,10 +3306,10 @@ static void dspd_dev_mq_event(void *udata, int32_t fd, void *fdata, uint32_t eve
 	  if ( tm & DSPD_PCM_SBIT_PLAYBACK )
 	    {
 	      dev->playback.cycle.len = 0; //Not ready, must rewind.
-	      error = ! process_client_playback(dev, cli, cli_ops);
+	      error = ! process_client_playback(dev, cli, cli_ops, NULL);
 	    }
 	  dev->current_client = -1;
-	  dspd_client_srv_unlock(dev->list, client);
+	  dspd_client_srv_unlock(dev->list, client, dev->key);
 	  dspd_clr_bit(dev->lock_mask, client);
 	}
     }
@@ -2621,6 +3334,27 @@ static void dspd_dev_mq_event(void *udata, int32_t fd, void *fdata, uint32_t eve
 }
 
    
+static int32_t dspd_dev_init_mixpool(struct dspd_pcm_device *dev, intptr_t index)
+{
+  int32_t i, ret;
+  char name[32];
+  size_t len = dev->playback.params.bufsize * dev->playback.params.channels * sizeof(double);
+  dev->mix_partials = calloc(dspd_dctx.mix_threads, sizeof(*dev->mix_partials));
+  if ( ! dev->mix_partials )
+    return -errno;
+  for ( i = 0; i < dspd_dctx.mix_threads; i++ )
+    {
+      dev->mix_partials[i].buf = calloc(1, len);
+      if ( ! dev->mix_partials[i].buf )
+	return -errno;
+    }
+  snprintf(name, sizeof(name), "dspd-mix-%ld", (long)index);
+  ret = dspd_mixpool_new(&dev->mixpool, dspd_dctx.mix_threads, name, mix_worker, dev);
+  if ( ret == 0 )
+    dspd_log(0, "Device %ld mixes playback with %d threads", (long)index, dspd_dctx.mix_threads);
+  return ret;
+}
+
 int32_t dspd_pcm_device_new(void **dev,
 			    uint64_t hotplug_event_id,
 			    const struct dspd_pcmdev_params *params,
@@ -2726,6 +3460,17 @@ int32_t dspd_pcm_device_new(void **dev,
       ret = sptr->ops->get_params(h, &sptr->params);
       if ( ret != 0 )
 	goto out;
+      sptr->cycle.precision = sptr->params.mix_precision;
+      sptr->cycle.rate = sptr->params.rate;
+      if ( sptr->cycle.precision == DSPD_MIX_PRECISION_FLOAT32 )
+	dspd_log(0, "Device %ld uses a single precision mix buffer", (long)index);
+      if ( sptr == &devptr->playback && dspd_dctx.mix_threads > 1 )
+	{
+	  //Not fatal: mixing falls back to the io thread.
+	  ret = dspd_dev_init_mixpool(devptr, index);
+	  if ( ret < 0 )
+	    dspd_log(0, "Could not create mixing threads for device %ld: error %d", (long)index, ret);
+	}
       sptr->handle = h;
       sptr->volume = 1.0;
       sptr->sample_time = 1000000000 / sptr->params.rate;
@@ -2780,6 +3525,11 @@ int32_t dspd_pcm_device_new(void **dev,
       sptr->intrp.sample_time = sptr->sample_time;
       sptr->intrp.maxdiff = sptr->sample_time / 10;
       dspd_dev_set_stream_volume(devptr, DSPD_PCM_STREAM_CAPTURE, 1.0);
+      ret = dspd_capcache_init(&devptr->capture_cache,
+			       sptr->params.bufsize,
+			       sptr->params.channels);
+      if ( ret != 0 )
+	goto out;
     }
 
   struct dspd_sched_params schedparams;
@@ -2945,6 +3695,7 @@ void dspd_pcm_device_delete(struct dspd_pcm_device *dev)
 
 void dspd_pcm_device_delete_ex(struct dspd_pcm_device *dev, bool closedev)
 {
+  int32_t i;
   DSPD_ASSERT(dev);
   dspd_sched_abort(dev->sched);
   dspd_sched_trigger(dev->sched);
@@ -2971,6 +3722,20 @@ void dspd_pcm_device_delete_ex(struct dspd_pcm_device *dev, bool closedev)
     }
   if ( dev->sched )
     dspd_sched_delete(dev->sched);
+  for ( i = 0; i < DSPD_SUBMIX_BUSES; i++ )
+    {
+      dspd_submix_delete(dev->submix[i]);
+      dspd_submix_delete((struct dspd_submix*)dev->submix_spare[i]);
+      dspd_submix_delete((struct dspd_submix*)dev->submix_dead[i]);
+    }
+  dspd_capcache_destroy(&dev->capture_cache);
+  dspd_mixpool_delete(dev->mixpool);
+  if ( dev->mix_partials )
+    {
+      for ( i = 0; i < dspd_dctx.mix_threads; i++ )
+	free(dev->mix_partials[i].buf);
+      free(dev->mix_partials);
+    }
   free(dev);
   return ;
 }
@@ -3803,6 +4568,33 @@ static int32_t server_remove(struct dspd_rctx *context,
   return dspd_req_reply_err(context, 0, 0);
 }
 
+static int32_t server_iostat(struct dspd_rctx *context,
+			     uint32_t      req,
+			     const void   *inbuf,
+			     size_t        inbufsize,
+			     void         *outbuf,
+			     size_t        outbufsize)
+{
+  struct dspd_pcm_device *dev = dspd_req_userdata(context);
+  const struct dspd_iostat_req *r = inbuf;
+  struct dspd_iostat *st = outbuf;
+  if ( r->hist >= DSPD_IOSTAT_COUNT )
+    return dspd_req_reply_err(context, 0, EINVAL);
+  memset(st, 0, sizeof(*st));
+  st->hist = r->hist;
+  st->xruns = dev->xruns;
+  st->recoveries = dev->recoveries;
+  st->tstamp = dev->iostat_tstamp;
+  memcpy(&st->data, &dev->iostat[r->hist], sizeof(st->data));
+  if ( r->flags & DSPD_IOSTAT_RESET )
+    {
+      //The io thread does the reset so it never sees a half cleared histogram.
+      AO_fetch_and_add1(&dev->iostat_reset);
+      dspd_sched_trigger(dev->sched);
+    }
+  return dspd_req_reply_buf(context, 0, st, sizeof(*st));
+}
+
 static const struct dspd_req_handler device_req_handlers[] = {
   [SRVIDX(DSPD_SCTL_SERVER_MIN)] = {
     .handler = server_filter,
@@ -3913,6 +4705,13 @@ static const struct dspd_req_handler device_req_handlers[] = {
     .inbufsize = 0,
     .outbufsize = 0
   },
+  [SRVIDX(DSPD_SCTL_SERVER_IOSTAT)] = {
+    .handler = server_iostat,
+    .xflags = DSPD_REQ_FLAG_CMSG_FD,
+    .rflags = 0,
+    .inbufsize = sizeof(struct dspd_iostat_req),
+    .outbufsize = sizeof(struct dspd_iostat),
+  },
   
 };
 
@@ -12,6 +12,7 @@
 
 struct dspd_pcmcli_status;
 struct dspd_client_ops;
+struct dspd_pcm_chmap;
 
 #include "atomic.h"
 //Maximum objects supported.  Don't change this.
@@ -49,7 +50,17 @@ struct dspd_drv_params {
   uint32_t  min_latency;
   uint32_t  max_latency;
   uint32_t  min_dma;
+
+  /*
+    Sample type of the playback mix buffer returned by mmap_begin().  The
+    default is double.  Single precision halves the memory traffic of
+    each io cycle at the expense of headroom.
+  */
+#define DSPD_MIX_PRECISION_FLOAT64 0
+#define DSPD_MIX_PRECISION_FLOAT32 1
+  int32_t   mix_precision;
 };
+#define DSPD_MIX_SAMPLE_SIZE(_p) ((_p) == DSPD_MIX_PRECISION_FLOAT32 ? sizeof(float) : sizeof(double))
 
 struct dspd_mq_notification {
   uint32_t client;
@@ -225,7 +236,26 @@ struct dspd_pcmdrv_ops {
 
   void (*set_scheduler)(void *handle, struct dspd_scheduler *scheduler);
 
-  
+  /*
+    Optional.  Add to frames that were already committed without moving the
+    application pointer.  This is cheaper than rewind and forward and still
+    works when the driver can't rewind very far.
+    
+    rewritable:     Get amount that can be safely rewritten or -ENOTSUP.
+    rewrite_begin:  Get the mix buffer area starting back frames before the
+                    application pointer.  It holds the mix that was committed
+                    there, so new data must be added to it.
+    rewrite_commit: Send the changed area to the device.
+  */
+  intptr_t (*rewritable)(void *handle);
+  int32_t (*rewrite_begin)(void *handle,
+			   uintptr_t back,
+			   void **buf,
+			   uintptr_t *offset,
+			   uintptr_t *frames);
+  intptr_t (*rewrite_commit)(void *handle,
+			     uintptr_t offset,
+			     uintptr_t frames);
 };
 
 
@@ -253,6 +283,10 @@ struct dspd_io_cycle {
   //This counter is always nonzero when a client is called.
   uint64_t   start_count;
   uintptr_t  remaining;
+  //Playback mix buffer sample type (DSPD_MIX_PRECISION_*)
+  int32_t    precision;
+  //Sample rate of the buffer.  This is the bus rate for clients on a submix bus.
+  uint32_t   rate;
 };
 
 struct dspd_pcm_status;
@@ -362,6 +396,12 @@ struct dspd_cli_params {
   int32_t latency;
 #define DSPD_CLI_FLAG_SHM (1<<0)
 #define DSPD_CLI_FLAG_DONTROUTE (1<<1)
+  /*
+    The playback fifo holds samples in the client format instead of
+    float32 and the server converts them while mixing.  The server clears
+    this flag if it can't do that for the format or stream.
+  */
+#define DSPD_CLI_FLAG_RAWFIFO (1<<2)
 #define DSPD_CLI_FLAG_RESERVED (1<<31)
   int32_t flags;
 
@@ -516,4 +556,14 @@ int32_t dspd_pcm_device_new(void **dev,
 
 
 void *dspd_pcm_device_get_driver_handle(struct dspd_pcm_device *dev, uint32_t stream);
+/*
+  Convert capture frames with a channel map at unity volume using the device
+  capture cache.  Returns the converted frames, or NULL if the caller should
+  convert them itself.  Only valid in the device io thread during capture_xfer.
+*/
+const float *dspd_pcm_device_capture_map(struct dspd_pcm_device *dev,
+					 const struct dspd_pcm_chmap *map,
+					 dspd_chmap_read_t read,
+					 const float *buf,
+					 uintptr_t frames);
 #endif
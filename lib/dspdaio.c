@@ -121,6 +121,95 @@ int dspd_aio_sync_ctl(struct dspd_aio_ctx *ctx,
 }
 
 
+static int32_t sequential_ctl(struct dspd_aio_ctx *ctx, struct dspd_async_op *ops, size_t count)
+{
+  size_t i;
+  int32_t ret = 0;
+  for ( i = 0; i < count; i++ )
+    {
+      if ( ret < 0 )
+	{
+	  ops[i].error = -ECANCELED;
+	  ops[i].xfer = 0;
+	  continue;
+	}
+      ret = dspd_aio_sync_ctl(ctx,
+			      ops[i].stream,
+			      ops[i].req,
+			      ops[i].inbuf,
+			      ops[i].inbufsize,
+			      ops[i].outbuf,
+			      ops[i].outbufsize,
+			      &ops[i].xfer);
+      ops[i].error = ret;
+    }
+  return ret;
+}
+
+/*
+  Run a list of requests in one round trip with DSPD_SOCKSRV_REQ_COMPOUND.
+  Only stream, req, and the buffers in each op are used.  The results are
+  stored in error and xfer.  Requests after the first failure are not run
+  and get -ECANCELED.  The return value is the first error or 0.  Servers
+  that don't have compound requests get the requests one at a time.
+*/
+int32_t dspd_aio_compound_ctl(struct dspd_aio_ctx *ctx, struct dspd_async_op *ops, size_t count)
+{
+  char inbuf[SS_MAX_PAYLOAD], outbuf[SS_MAX_PAYLOAD];
+  struct socksrv_compound_req *req;
+  const struct socksrv_compound_reply *rep;
+  size_t i, ilen = 0, olen = 0, br;
+  int32_t ret;
+  for ( i = 0; i < count; i++ )
+    {
+      ilen += sizeof(*req) + DSPD_COMPOUND_ALIGN(ops[i].inbufsize);
+      olen += sizeof(*rep) + DSPD_COMPOUND_ALIGN(ops[i].outbufsize);
+    }
+  if ( count == 0 || count > DSPD_COMPOUND_MAX || ilen > sizeof(inbuf) || olen > sizeof(outbuf) )
+    return sequential_ctl(ctx, ops, count);
+
+  ilen = 0;
+  for ( i = 0; i < count; i++ )
+    {
+      req = (struct socksrv_compound_req*)&inbuf[ilen];
+      req->req = ops[i].req;
+      req->stream = ops[i].stream;
+      req->inbufsize = ops[i].inbufsize;
+      req->outbufsize = ops[i].outbufsize;
+      ilen += sizeof(*req);
+      if ( ops[i].inbufsize > 0 )
+	memcpy(&inbuf[ilen], ops[i].inbuf, ops[i].inbufsize);
+      ilen += DSPD_COMPOUND_ALIGN(ops[i].inbufsize);
+      ops[i].error = -ECANCELED;
+      ops[i].xfer = 0;
+    }
+  ret = dspd_aio_sync_ctl(ctx, -1, DSPD_SOCKSRV_REQ_COMPOUND, inbuf, ilen, outbuf, olen, &br);
+  if ( ret == -EINVAL )
+    return sequential_ctl(ctx, ops, count);
+  else if ( ret < 0 )
+    return ret;
+
+  olen = 0;
+  for ( i = 0; i < count && (olen + sizeof(*rep)) <= br; i++ )
+    {
+      rep = (const struct socksrv_compound_reply*)&outbuf[olen];
+      olen += sizeof(*rep);
+      if ( rep->req != ops[i].req || rep->len > ops[i].outbufsize || rep->len > (br - olen) )
+	return -EPROTO;
+      if ( rep->len > 0 )
+	memcpy(ops[i].outbuf, &outbuf[olen], rep->len);
+      ops[i].xfer = rep->len;
+      ops[i].error = rep->error;
+      olen += DSPD_COMPOUND_ALIGN(rep->len);
+      if ( rep->error < 0 )
+	return rep->error;
+    }
+  //Everything must have run if nothing failed.
+  if ( i < count )
+    ret = -EPROTO;
+  return ret;
+}
+
 int32_t dspd_aio_set_info(struct dspd_aio_ctx *ctx, 
 			  const struct dspd_cli_info *info,
 			  dspd_aio_ccb_t complete,
@@ -141,6 +141,7 @@ int dspd_aio_sync_ctl(struct dspd_aio_ctx *ctx,
 		      void         *outbuf,
 		      size_t        outbufsize,
 		      size_t       *bytes_returned);
+int32_t dspd_aio_compound_ctl(struct dspd_aio_ctx *ctx, struct dspd_async_op *ops, size_t count);
 int32_t dspd_aio_send(struct dspd_aio_ctx *ctx);
 int32_t dspd_aio_recv(struct dspd_aio_ctx *ctx);
 int32_t dspd_aio_block_directions(struct dspd_aio_ctx *ctx);
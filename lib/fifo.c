@@ -21,10 +21,16 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "fifo.h"
 #include "atomic.h"
+#include "dspd_time.h"
 
 uint32_t dspd_fifo_peek(const struct dspd_fifo_header *fifo,
 			uint32_t offset,
@@ -61,6 +67,8 @@ void dspd_fifo_reset(struct dspd_fifo_header *fifo)
 {
   dspd_store_uint32(&fifo->data->obj_in, 0);
   dspd_store_uint32(&fifo->data->obj_out, 0);
+  fifo->in_cache = 0;
+  fifo->out_cache = 0;
 }
 
 /*
@@ -178,29 +186,33 @@ int dspd_fifo_wiov_ex(struct dspd_fifo_header *fifo,
 		      uint32_t *offset,
 		      uint32_t *len)
 {
-  int ret;
-  uint32_t space, o, l, p, in, out;
-  ret = dspd_fifo_space_ptrs(fifo, &space, &in, &out);
-  if ( ret == 0 )
+  uint32_t space, o, l, in, used;
+  in = dspd_load_uint32(&fifo->data->obj_in);
+  o = in % fifo->max_obj;
+  l = fifo->max_obj - o;
+  if ( l > *len )
+    l = *len;
+  used = in - fifo->out_cache;
+  if ( used > fifo->max_obj || (fifo->max_obj - used) < l )
     {
-      if ( space == 0 )
-	{
-	  *len = 0;
-	  *ptr = fifo->data->data;
-	} else
-	{
-	  p = in;
-	  o = p % fifo->max_obj;
-	  *ptr = fifo->data->data;
-	  *offset = o;
-	  l = fifo->max_obj - o;
-	  if ( l < space )
-	    space = l;
-	  if ( space < *len )
-	    *len = space;
-	}
+      fifo->out_cache = dspd_load_uint32(&fifo->data->obj_out);
+      used = in - fifo->out_cache;
+      if ( used > fifo->max_obj )
+	return -EIO;
     }
-  return ret;
+  space = fifo->max_obj - used;
+  *ptr = fifo->data->data;
+  if ( space == 0 )
+    {
+      *len = 0;
+    } else
+    {
+      *offset = o;
+      if ( space < l )
+	l = space;
+      *len = l;
+    }
+  return 0;
 }
 
 
@@ -238,28 +250,59 @@ int dspd_fifo_riov_ex(struct dspd_fifo_header *fifo,
 		      void **ptr,
 		      uint32_t *offset,
 		      uint32_t *len)
+{
+  uint32_t avail, o, l, out;
+  out = dspd_load_uint32(&fifo->data->obj_out);
+  o = out % fifo->max_obj;
+  l = fifo->max_obj - o;
+  if ( l > *len )
+    l = *len;
+  avail = fifo->in_cache - out;
+  if ( avail > fifo->max_obj || avail < l )
+    {
+      fifo->in_cache = dspd_load_uint32(&fifo->data->obj_in);
+      avail = fifo->in_cache - out;
+      if ( avail > fifo->max_obj )
+	return -EIO;
+    }
+  *ptr = fifo->data->data;
+  if ( avail == 0 )
+    {
+      *len = 0;
+      *offset = 0;
+    } else
+    {
+      if ( avail < l )
+	l = avail;
+      *len = l;
+      *offset = o;
+    }
+  return 0;
+}
+
+int dspd_fifo_riov2(struct dspd_fifo_header *fifo,
+		    void **ptr1,
+		    uint32_t *len1,
+		    void **ptr2,
+		    uint32_t *len2)
 {
   int ret;
-  uint32_t avail, o, l, p, in, out;
+  uint32_t avail, o, l, in, out;
   ret = dspd_fifo_len_ptrs(fifo, &avail, &in, &out);
   if ( ret == 0 )
     {
-      if ( avail == 0 )
+      *ptr2 = fifo->data->data;
+      o = out % fifo->max_obj;
+      *ptr1 = &fifo->data->data[o * fifo->obj_size];
+      l = fifo->max_obj - o;
+      if ( l < avail )
 	{
-	  *len = 0;
-	  *ptr = fifo->data->data;
-	  *offset = 0;
+	  *len1 = l;
+	  *len2 = avail - l;
 	} else
 	{
-	  p = out;
-	  o = p % fifo->max_obj;
-	  *ptr = fifo->data->data;
-	  l = fifo->max_obj - o;
-	  if ( l < avail )
-	    avail = l;
-	  if ( avail < *len )
-	    *len = avail;
-	  *offset = o;
+	  *len1 = avail;
+	  *len2 = 0;
 	}
     }
   return ret;
@@ -328,18 +371,23 @@ int dspd_fifo_new(struct dspd_fifo_header **fifo,
   struct dspd_fifo_header *hdr = NULL;
   int err = 0;
   uintptr_t s;
-  char *a;
+  void *a;
+  //The data section starts on a cache line after the header.
+  size_t h = DSPD_CACHELINE_ALIGN(sizeof(*hdr));
   if ( addr == NULL )
     s = dspd_fifo_bufsize(nmemb, size);
   else
     s = 0;
-  a = calloc(1UL, sizeof(*hdr)+s);
-  if ( ! a )
+  err = posix_memalign(&a, DSPD_CACHELINE_SIZE, h + s);
+  if ( err )
     {
-      err = -errno;
+      err *= -1;
       goto out;
     }
-  hdr = (struct dspd_fifo_header*)a;
+  memset(a, 0, h + s);
+  hdr = a;
+  if ( addr == NULL )
+    addr = (char*)a + h;
   err = dspd_fifo_init(hdr, nmemb, size, addr);
   if ( err )
     goto out;
@@ -451,6 +499,69 @@ int32_t dspd_fifo_get_error(const struct dspd_fifo_header *fifo)
 void dspd_fifo_set_error(const struct dspd_fifo_header *fifo, int32_t error)
 {
   if ( fifo->data )
-    dspd_store_uint32(&fifo->data->error, error);
+    {
+      dspd_store_uint32(&fifo->data->error, error);
+      //dspd_fifo_wake() always wakes up waiters if there is an error.
+      if ( error )
+	dspd_fifo_wake((struct dspd_fifo_header*)fifo);
+    }
+}
+
+
+/*
+  The waiter increments waiters before it checks the fifo and the reader
+  commits before it checks waiters.  Both have a full barrier in between,
+  so either the waiter sees the new space or the reader sees the waiter.
+  The sequence number closes the gap between the check and FUTEX_WAIT.
+*/
+int32_t dspd_fifo_wait_space(struct dspd_fifo_header *fifo, uint32_t space, uint64_t abstime)
+{
+  struct timespec ts;
+  uint32_t seq, avail;
+  int32_t ret;
+  int op = FUTEX_WAIT_BITSET;
+  if ( space > fifo->max_obj )
+    space = fifo->max_obj;
+  if ( dspd_get_clockid() == CLOCK_REALTIME )
+    op |= FUTEX_CLOCK_REALTIME;
+  ts.tv_sec = abstime / 1000000000ULL;
+  ts.tv_nsec = abstime % 1000000000ULL;
+  seq = dspd_load_uint32(&fifo->data->wait_seq);
+  dspd_store_uint32(&fifo->data->wait_space, space);
+  AO_int_fetch_and_add1_full(&fifo->data->waiters);
+  if ( dspd_fifo_get_error(fifo) )
+    {
+      ret = -EIO;
+    } else
+    {
+      ret = dspd_fifo_space(fifo, &avail);
+      if ( ret == 0 && avail < space )
+	{
+	  if ( syscall(__NR_futex, &fifo->data->wait_seq, op, seq, &ts, NULL, FUTEX_BITSET_MATCH_ANY) < 0 )
+	    {
+	      ret = -errno;
+	      //The sequence changed before the wait started.
+	      if ( ret == -EAGAIN )
+		ret = 0;
+	    }
+	  if ( ret == 0 && dspd_fifo_get_error(fifo) )
+	    ret = -EIO;
+	}
+    }
+  AO_int_fetch_and_sub1_full(&fifo->data->waiters);
+  return ret;
 }
 
+void dspd_fifo_wake(struct dspd_fifo_header *fifo)
+{
+  uint32_t avail;
+  dspd_mb();
+  if ( dspd_load_uint32(&fifo->data->waiters) == 0 )
+    return;
+  if ( dspd_fifo_get_error(fifo) == 0 &&
+       dspd_fifo_space(fifo, &avail) == 0 &&
+       avail < dspd_load_uint32(&fifo->data->wait_space) )
+    return;
+  AO_int_fetch_and_add1_full(&fifo->data->wait_seq);
+  syscall(__NR_futex, &fifo->data->wait_seq, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
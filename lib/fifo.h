@@ -2,11 +2,28 @@
 #define _DSPD_FIFO_H_
 #include <stdint.h>
 #include "atomic.h"
+/*
+  Shared memory layout version 1 (DSPD_SHM_VERSION).  The producer and
+  consumer pointers are on separate cache lines so the two sides don't
+  invalidate each other's line on every commit, and the data starts on a
+  cache line.  Everything that changes rarely shares the third line.
+*/
 struct dspd_fifo_data {
+  //Written by the producer
   volatile uint32_t obj_in;
+  char              pad_in[DSPD_CACHELINE_SIZE - sizeof(uint32_t)];
+  //Written by the consumer
   volatile uint32_t obj_out;
+  char              pad_out[DSPD_CACHELINE_SIZE - sizeof(uint32_t)];
   volatile uint32_t rate;
   volatile uint32_t error;
+  //Futex word for dspd_fifo_wait_space().  Incremented for each wakeup.
+  volatile uint32_t wait_seq;
+  //Number of threads sleeping on wait_seq
+  volatile uint32_t waiters;
+  //Free space the waiters want
+  volatile uint32_t wait_space;
+  char              pad[DSPD_CACHELINE_SIZE - (5 * sizeof(uint32_t))];
   char              data[0];
 };
 
@@ -17,6 +34,14 @@ struct dspd_fifo_header {
 #define DSPD_FIFO_FLAG_INIT 1
   uint32_t                   flags;
   struct dspd_fifo_data     *data;
+  /*
+    Last pointer values seen from the other side.  dspd_fifo_wiov_ex() and
+    dspd_fifo_riov_ex() only read the other side's cache line when these
+    are too old to cover the request.  Each side of a shared fifo has its
+    own header, so these are never shared.
+  */
+  uint32_t                   out_cache;
+  uint32_t                   in_cache;
   char                       bytes[0];
 };
 
@@ -36,6 +61,21 @@ struct dspd_block_footer {
 };
 #define DSPD_BLOCK_HFLEN (sizeof(struct dspd_block_footer)+sizeof(struct dspd_block_header))
 
+/*
+  Sleep until at least space objects are free, the fifo has an error, or
+  abstime passes.  The time is in the dspd_get_time() clock.  Returns 0
+  if the space is available or the reader woke the caller up, otherwise
+  -ETIMEDOUT, -EINTR, or -EIO if the fifo has an error.  This works across processes
+  since the futex is in the fifo data section.
+*/
+int32_t dspd_fifo_wait_space(struct dspd_fifo_header *fifo, uint32_t space, uint64_t abstime);
+/*
+  Wake threads in dspd_fifo_wait_space() if there is enough space.  The
+  reader calls this after dspd_fifo_rcommit().  It does not make a system
+  call unless somebody is waiting.
+*/
+void dspd_fifo_wake(struct dspd_fifo_header *fifo);
+
 int32_t dspd_fifo_get_error(const struct dspd_fifo_header *fifo);
 void dspd_fifo_set_error(const struct dspd_fifo_header *fifo, int32_t err);
 uint32_t dspd_fifo_optr(const struct dspd_fifo_header *fifo);
@@ -56,7 +96,12 @@ int dspd_fifo_riov(struct dspd_fifo_header *fifo,
 		   void **ptr,
 		   uint32_t *len);
 
-//Works like snd_pcm_mmap_begin()
+/*
+  Works like snd_pcm_mmap_begin().  These check the cached pointer of the
+  other side first and only load the real one if the request doesn't fit.
+  The consumer must not use dspd_fifo_riov_ex() if the producer moves its
+  pointer backwards.
+*/
 int dspd_fifo_wiov_ex(struct dspd_fifo_header *fifo,
 		      void **ptr,
 		      uint32_t *offset,
@@ -65,6 +110,12 @@ int dspd_fifo_riov_ex(struct dspd_fifo_header *fifo,
 		      void **ptr,
 		      uint32_t *offset,
 		      uint32_t *len);
+//Both readable segments.  The second one is the part that wrapped around to the start.
+int dspd_fifo_riov2(struct dspd_fifo_header *fifo,
+		    void **ptr1,
+		    uint32_t *len1,
+		    void **ptr2,
+		    uint32_t *len2);
 
 
 int dspd_fifo_init(struct dspd_fifo_header *hdr, 
@@ -104,7 +104,7 @@ void dspd_seqlock32_init(struct dspd_seqlock32 *lock)
 */
 uint32_t dspd_mbx_bufsize(uint32_t blocksize)
 {
-  return (blocksize * DSPD_MBX_BLOCKS) + sizeof(struct dspd_mbx_data);
+  return (DSPD_CACHELINE_ALIGN(blocksize) * DSPD_MBX_BLOCKS) + sizeof(struct dspd_mbx_data);
 }
 
 
@@ -127,7 +127,7 @@ int dspd_mbx_init(struct dspd_mbx_header *mbx,
   DSPD_ASSERT(mbx->blocksize);
   mbx->flags |= DSPD_MBX_FLAG_INIT;
   for ( i = 0; i < DSPD_MBX_BLOCKS; i++ )
-    dspd_seqlock32_init(&mbx->data->locks[i]);
+    dspd_seqlock32_init(&mbx->data->locks[i].lock);
   DSPD_ASSERT(mbx->blocksize);
   dspd_mbx_reset(mbx);
   DSPD_ASSERT(mbx->blocksize);
@@ -159,16 +159,23 @@ int dspd_mbx_new(struct dspd_mbx_header **mbx,
   struct dspd_mbx_header *hdr = NULL;
   int err = 0;
   uintptr_t s;
+  void *a;
+  //The data section starts on a cache line after the header.
+  size_t h = DSPD_CACHELINE_ALIGN(sizeof(*hdr));
   if ( addr == NULL )
     s = dspd_mbx_bufsize(blocksize);
   else
     s = 0;
-  hdr = calloc(1UL, sizeof(*hdr)+s);
-  if ( ! hdr )
+  err = posix_memalign(&a, DSPD_CACHELINE_SIZE, h + s);
+  if ( err )
     {
-      err = -errno;
+      err *= -1;
       goto out;
     }
+  memset(a, 0, h + s);
+  hdr = a;
+  if ( addr == NULL )
+    addr = (char*)a + h;
   err = dspd_mbx_init(hdr, blocksize, addr);
   if ( err )
     goto out;
@@ -210,8 +217,8 @@ void *dspd_mbx_write_lock(struct dspd_mbx_header *mbx, int32_t *idx)
   else
     i = (unsigned)(i + 1) % DSPD_MBX_BLOCKS;
   *idx = i;
-  dspd_seqlock32_write_lock(&mbx->data->locks[i]);
-  return &mbx->data->data[i * mbx->blocksize];
+  dspd_seqlock32_write_lock(&mbx->data->locks[i].lock);
+  return &mbx->data->data[i * DSPD_CACHELINE_ALIGN(mbx->blocksize)];
 }
 
 /*
@@ -219,7 +226,7 @@ void *dspd_mbx_write_lock(struct dspd_mbx_header *mbx, int32_t *idx)
  */
 void dspd_mbx_write_unlock(struct dspd_mbx_header *mbx, int32_t idx)
 {
-  dspd_seqlock32_write_unlock(&mbx->data->locks[idx]);
+  dspd_seqlock32_write_unlock(&mbx->data->locks[idx].lock);
   dspd_store_uint32((uint32_t*)&mbx->data->index, (uint32_t)idx);
 }
 
@@ -235,10 +242,10 @@ void *dspd_mbx_read(struct dspd_mbx_header *mbx, void *buf, size_t len)
       while ( (idx = dspd_load_uint32((uint32_t*)&mbx->data->index)) >= 0 )
 	{
 	  idx %= DSPD_MBX_BLOCKS;
-	  if ( dspd_seqlock32_read_begin(&mbx->data->locks[idx], &ctx) )
+	  if ( dspd_seqlock32_read_begin(&mbx->data->locks[idx].lock, &ctx) )
 	    {
-	      memcpy(buf, &mbx->data->data[idx * mbx->blocksize], len);
-	      if ( dspd_seqlock32_read_complete(&mbx->data->locks[idx], ctx) )
+	      memcpy(buf, &mbx->data->data[idx * DSPD_CACHELINE_ALIGN(mbx->blocksize)], len);
+	      if ( dspd_seqlock32_read_complete(&mbx->data->locks[idx].lock, ctx) )
 		{
 		  ret = buf;
 		  break;
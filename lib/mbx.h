@@ -24,11 +24,21 @@ struct dspd_mbx_header {
   char                  ibytes[]; //Inline data
 };
 
+/*
+  Shared memory layout version 1 (DSPD_SHM_VERSION).  The index, each lock,
+  and each data block start on their own cache line, so a reader copying
+  one block isn't disturbed by the writer filling the next one.
+*/
+struct dspd_mbx_lock {
+  struct dspd_seqlock32 lock;
+  char                  pad[DSPD_CACHELINE_SIZE - sizeof(struct dspd_seqlock32)];
+};
+
 struct dspd_mbx_data {
   volatile int32_t      index; //Index of last write
-  volatile int32_t      pad;
-  struct dspd_seqlock32 locks[DSPD_MBX_BLOCKS];
-  char                  data[]; //Data blocks
+  char                  pad[DSPD_CACHELINE_SIZE - sizeof(int32_t)];
+  struct dspd_mbx_lock  locks[DSPD_MBX_BLOCKS];
+  char                  data[]; //Data blocks, each padded to a cache line
 };
 
 //Get size of struct dspd_mbx_data
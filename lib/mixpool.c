@@ -0,0 +1,196 @@
+/*
+ *  MIXPOOL - Fork/join worker threads for device io cycles
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <setjmp.h>
+#include "sslib.h"
+#include "daemon.h"
+#include "scheduler.h"
+#include "dspdtls.h"
+#include "mixpool.h"
+
+struct dspd_mixpool_thread {
+  struct dspd_mixpool *pool;
+  dspd_thread_t        thread;
+  size_t               index;
+  //Only used by the SIGBUS and SIGXCPU handlers.
+  struct dspd_scheduler tls;
+};
+
+struct dspd_mixpool {
+  dspd_mutex_t       lock;
+  dspd_cond_t        start;
+  dspd_cond_t        done;
+  uint64_t           generation;
+  size_t             pending;
+  bool               shutdown;
+  size_t             nworkers;
+  dspd_mixpool_cb_t  callback;
+  void              *arg;
+  char               name[16];
+  struct dspd_mixpool_thread *threads;
+};
+
+static void *mixpool_thread(void *p)
+{
+  struct dspd_mixpool_thread *t = p;
+  struct dspd_mixpool *pool = t->pool;
+  uint64_t gen = 0;
+  char name[32];
+  sigset_t set;
+  snprintf(name, sizeof(name), "%s-%lu", pool->name, (unsigned long)t->index);
+  set_thread_name(name);
+  t->tls.tid = dspd_gettid();
+  dspdtls_set(&t->tls);
+  sigemptyset(&set);
+  sigaddset(&set, SIGBUS);
+  dspd_mutex_lock(&pool->lock);
+  while ( ! pool->shutdown )
+    {
+      if ( pool->generation == gen )
+	{
+	  dspd_cond_wait(&pool->start, &pool->lock);
+	  continue;
+	}
+      gen = pool->generation;
+      dspd_mutex_unlock(&pool->lock);
+      if ( sigsetjmp(t->tls.sigbus_env, 0) == 0 )
+	pool->callback(pool->arg, t->index, pool->nworkers);
+      else
+	pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+      dspd_mutex_lock(&pool->lock);
+      pool->pending--;
+      if ( pool->pending == 0 )
+	dspd_cond_signal(&pool->done);
+    }
+  dspd_mutex_unlock(&pool->lock);
+  dspdtls_clear();
+  return NULL;
+}
+
+void dspd_mixpool_run(struct dspd_mixpool *pool)
+{
+  dspd_mutex_lock(&pool->lock);
+  pool->generation++;
+  pool->pending = pool->nworkers;
+  dspd_cond_broadcast(&pool->start);
+  while ( pool->pending > 0 )
+    dspd_cond_wait(&pool->done, &pool->lock);
+  dspd_mutex_unlock(&pool->lock);
+}
+
+size_t dspd_mixpool_workers(const struct dspd_mixpool *pool)
+{
+  return pool->nworkers;
+}
+
+void dspd_mixpool_delete(struct dspd_mixpool *pool)
+{
+  size_t i;
+  if ( ! pool )
+    return;
+  if ( pool->threads )
+    {
+      dspd_mutex_lock(&pool->lock);
+      pool->shutdown = true;
+      dspd_cond_broadcast(&pool->start);
+      dspd_mutex_unlock(&pool->lock);
+      for ( i = 0; i < pool->nworkers; i++ )
+	dspd_thread_join(&pool->threads[i].thread, NULL);
+      free(pool->threads);
+    }
+  dspd_cond_destroy(&pool->done);
+  dspd_cond_destroy(&pool->start);
+  dspd_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+int32_t dspd_mixpool_new(struct dspd_mixpool **pool,
+			 size_t nworkers,
+			 const char *name,
+			 dspd_mixpool_cb_t callback,
+			 void *arg)
+{
+  struct dspd_mixpool *p;
+  dspd_threadattr_t attr = { .init = 0 };
+  int32_t ret;
+  size_t i;
+  if ( nworkers < 2UL )
+    return -EINVAL;
+  p = calloc(1, sizeof(*p));
+  if ( ! p )
+    return -errno;
+  p->callback = callback;
+  p->arg = arg;
+  strlcpy(p->name, name, sizeof(p->name));
+  if ( (ret = dspd_mutex_init(&p->lock, NULL)) != 0 ||
+       (ret = dspd_cond_init(&p->start, NULL)) != 0 ||
+       (ret = dspd_cond_init(&p->done, NULL)) != 0 )
+    {
+      ret *= -1;
+      goto out;
+    }
+  p->threads = calloc(nworkers, sizeof(*p->threads));
+  if ( ! p->threads )
+    {
+      ret = -errno;
+      goto out;
+    }
+  //Workers need the same priority as the io thread or they will hold it up.
+  ret = dspd_daemon_threadattr_init(&attr, sizeof(attr), DSPD_THREADATTR_RTIO);
+  if ( ret != 0 )
+    {
+      ret *= -1;
+      goto out;
+    }
+  for ( i = 0; i < nworkers; i++ )
+    {
+      p->threads[i].pool = p;
+      p->threads[i].index = i;
+      ret = dspd_thread_create(&p->threads[i].thread, &attr, mixpool_thread, &p->threads[i]);
+      if ( ret == EPERM )
+	{
+	  dspd_threadattr_destroy(&attr);
+	  ret = dspd_daemon_threadattr_init(&attr, sizeof(attr), 0);
+	  if ( ret == 0 )
+	    ret = dspd_thread_create(&p->threads[i].thread, &attr, mixpool_thread, &p->threads[i]);
+	}
+      if ( ret != 0 )
+	{
+	  ret *= -1;
+	  goto out;
+	}
+      p->nworkers++;
+    }
+  dspd_threadattr_destroy(&attr);
+  *pool = p;
+  return 0;
+
+ out:
+  dspd_threadattr_destroy(&attr);
+  dspd_mixpool_delete(p);
+  return ret;
+}
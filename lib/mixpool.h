@@ -0,0 +1,22 @@
+#ifndef _DSPD_MIXPOOL_H_
+#define _DSPD_MIXPOOL_H_
+#include <stdint.h>
+#include <stddef.h>
+/*
+  Fork/join thread pool for splitting an io cycle across cores.  A SIGBUS
+  (truncated client shm) in a worker returns from the callback early, so
+  the callback must keep enough state to tell which item faulted.
+*/
+struct dspd_mixpool;
+typedef void (*dspd_mixpool_cb_t)(void *arg, size_t worker, size_t nworkers);
+
+int32_t dspd_mixpool_new(struct dspd_mixpool **pool,
+			 size_t nworkers,
+			 const char *name,
+			 dspd_mixpool_cb_t callback,
+			 void *arg);
+void dspd_mixpool_delete(struct dspd_mixpool *pool);
+//Run the callback on every worker and wait for all of them to return.
+void dspd_mixpool_run(struct dspd_mixpool *pool);
+size_t dspd_mixpool_workers(const struct dspd_mixpool *pool);
+#endif
@@ -29,6 +29,8 @@
 #include <stdio.h>
 #include <sys/syscall.h>
 #include <unistd.h>
+#include <time.h>
+#include <linux/futex.h>
 #include "objlist.h"
 #include "atomic.h"
 #include "req.h"
@@ -258,16 +260,143 @@ struct dspd_slist_entry {
   uint64_t slot_id;
   struct keyed_lock lock;
   pthread_rwlock_t  rwlock;
+  /*
+    Server lock generation.  It is odd while a writer owns the entry.  The
+    device side of the lock only marks the entry busy in its own row of
+    dspd_slist.busy and checks the generation, so servicing a client does
+    not need any atomic operations.
+  */
+  volatile uint32_t gen;
+  volatile uint32_t wake;
+  volatile AO_t     waiting;
 };
 
+/*
+  The device side of the server lock is a store followed by a load, which
+  needs a full barrier to order against a writer doing the same thing in the
+  other order.  With membarrier() the writer makes every thread in the
+  process execute that barrier for it and the device side only needs to stop
+  the compiler from reordering.
+*/
+#ifdef __NR_membarrier
+#ifndef MEMBARRIER_CMD_PRIVATE_EXPEDITED
+#define MEMBARRIER_CMD_PRIVATE_EXPEDITED (1 << 3)
+#define MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED (1 << 4)
+#endif
+#endif
+static bool have_membarrier;
+static pthread_once_t membarrier_once = PTHREAD_ONCE_INIT;
+
+static void membarrier_init(void)
+{
+#ifdef __NR_membarrier
+  have_membarrier = syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#endif
+}
+
+static inline void light_barrier(void)
+{
+  if ( have_membarrier )
+    __asm__ __volatile__("" ::: "memory");
+  else
+    AO_nop_full();
+}
+
+static inline void heavy_barrier(void)
+{
+#ifdef __NR_membarrier
+  if ( have_membarrier && syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) == 0 )
+    return;
+#endif
+  AO_nop_full();
+}
+
 struct dspd_slist {
   pthread_rwlock_t   lock;
   uint32_t           count;
   pthread_mutex_t    idlock;
   uint64_t           last_id;
   struct dspd_slist_entry *entries;
+  //One row per device key and one byte per entry.
+  volatile uint8_t  *busy;
 };
 
+static inline void entry_futex_wait(volatile uint32_t *addr, uint32_t val)
+{
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000000 };
+  //The timeout covers the case where membarrier() failed after registration.
+  syscall(__NR_futex, addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+}
+
+static inline void entry_futex_wake(volatile uint32_t *addr)
+{
+  syscall(__NR_futex, addr, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
+
+static bool entry_is_busy(struct dspd_slist *list, uint32_t entry)
+{
+  size_t i;
+  for ( i = 0; i < list->count; i++ )
+    {
+      if ( list->busy[(i * list->count) + entry] )
+	return true;
+    }
+  return false;
+}
+
+//Take the entry away from the devices.  Waits for them to finish with it.
+static void entry_write_lock(struct dspd_slist *list, uint32_t entry)
+{
+  struct dspd_slist_entry *e = &list->entries[entry];
+  uint32_t w;
+  kl_lock(&e->lock);
+  e->gen++;
+  AO_fetch_and_add1(&e->waiting);
+  heavy_barrier();
+  for ( ;; )
+    {
+      w = e->wake;
+      AO_nop_full();
+      if ( ! entry_is_busy(list, entry) )
+	break;
+      entry_futex_wait(&e->wake, w);
+    }
+  AO_fetch_and_sub1(&e->waiting);
+}
+
+static void entry_write_unlock(struct dspd_slist *list, uint32_t entry)
+{
+  struct dspd_slist_entry *e = &list->entries[entry];
+  AO_nop_full();
+  e->gen++;
+  entry_futex_wake(&e->gen);
+  kl_unlock(&e->lock);
+}
+
+static inline void entry_leave(struct dspd_slist *list, uint32_t entry, uint32_t key)
+{
+  struct dspd_slist_entry *e = &list->entries[entry];
+  light_barrier();
+  list->busy[(key * list->count) + entry] = 0;
+  light_barrier();
+  if ( e->waiting )
+    {
+      e->wake++;
+      entry_futex_wake(&e->wake);
+    }
+}
+
+static inline bool entry_enter(struct dspd_slist *list, uint32_t entry, uint32_t key)
+{
+  struct dspd_slist_entry *e = &list->entries[entry];
+  list->busy[(key * list->count) + entry] = 1;
+  light_barrier();
+  if ( (e->gen & 1U) == 0 && e->used && kl_get_key(&e->lock) == key )
+    return true;
+  entry_leave(list, entry, key);
+  return false;
+}
+
 uintptr_t dspd_slist_get_object_mask(struct dspd_slist *list,
 				     uint8_t *mask, 
 				     size_t   mask_size,
@@ -320,20 +449,30 @@ struct dspd_slist *dspd_slist_new(uint32_t entries)
       free(l);
       return NULL;
     }
+  l->busy = calloc(entries, entries);
+  if ( ! l->busy )
+    {
+      free(l->entries);
+      free(l);
+      return NULL;
+    }
   if ( pthread_rwlock_init(&l->lock, NULL) != 0 )
     {
+      free((void*)l->busy);
       free(l->entries);
       free(l);
       return NULL;
     }
   if ( pthread_mutex_init(&l->idlock, NULL) != 0 )
     {
+      free((void*)l->busy);
       free(l->entries);
       free(l);
       pthread_rwlock_destroy(&l->lock);
       return NULL;
     }
   
+  pthread_once(&membarrier_once, membarrier_init);
   l->count = entries;
   for ( i = 0; i < l->count; i++ )
     {
@@ -357,6 +496,7 @@ struct dspd_slist *dspd_slist_new(uint32_t entries)
  out:
   pthread_rwlock_destroy(&l->lock);
   pthread_mutex_destroy(&l->idlock);
+  free((void*)l->busy);
   free(l->entries);
   free(l);
   return NULL;
@@ -367,6 +507,7 @@ void dspd_slist_delete(struct dspd_slist *l)
   unwind(l);
   pthread_rwlock_destroy(&l->lock);
   pthread_mutex_destroy(&l->idlock);
+  free((void*)l->busy);
   free(l->entries);
   free(l);
 }
@@ -385,7 +526,7 @@ intptr_t dspd_slist_get_free(struct dspd_slist *list, int32_t whence)
       if ( ! e->used )
 	{
 	  pthread_rwlock_wrlock(&e->rwlock);
-	  kl_lock(&e->lock);
+	  entry_write_lock(list, idx);
 	  return idx;
 	}
     }
@@ -432,8 +573,7 @@ void dspd_slist_entry_set_used(struct dspd_slist *list, uint32_t entry, bool use
 
 void dspd_slist_entry_srvlock(struct dspd_slist *list, uint32_t entry)
 {
-  struct dspd_slist_entry *e = &list->entries[entry];
-  kl_lock(&e->lock);
+  entry_write_lock(list, entry);
 }
 
 void dspd_slist_entry_set_key(struct dspd_slist *list, uint32_t entry, uint32_t key)
@@ -450,8 +590,7 @@ uint32_t dspd_slist_entry_get_key(struct dspd_slist *list, uint32_t entry)
 
 void dspd_slist_entry_srvunlock(struct dspd_slist *list, uint32_t entry)
 {
-  struct dspd_slist_entry *e = &list->entries[entry];
-  kl_unlock(&e->lock);
+  entry_write_unlock(list, entry);
 }
 
 int32_t dspd_slist_entry_wrlock(struct dspd_slist *list, uint32_t entry)
@@ -498,47 +637,34 @@ void dspd_slist_unlock(struct dspd_slist *list)
 bool dspd_client_srv_lock(struct dspd_slist *list, uint32_t index, uint32_t key)
 {
   struct dspd_slist_entry *e = &list->entries[index];
-  bool ret;
-  if ( e->used )
-    {
-      ret = kl_lock_keyed(&e->lock, key);
-      if ( ret )
-	{
-	  ret = e->used;
-	  if ( ! ret )
-	    kl_unlock(&e->lock);
-	}
-    } else
+  uint32_t gen;
+  if ( key >= list->count )
+    return false;
+  while ( e->used && kl_get_key(&e->lock) == key )
     {
-      ret = false;
+      if ( entry_enter(list, index, key) )
+	return true;
+      gen = e->gen;
+      if ( gen & 1U )
+	entry_futex_wait(&e->gen, gen);
     }
-  return ret;
+  return false;
 }
 
 bool dspd_client_srv_trylock(struct dspd_slist *list, uint32_t index, uint32_t key)
 {
   struct dspd_slist_entry *e = &list->entries[index];
   bool ret;
-  if ( e->used )
-    {
-      ret = kl_trylock_keyed(&e->lock, key);
-      if ( ret )
-	{
-	  ret = e->used;
-	  if ( ! ret )
-	    kl_unlock(&e->lock);
-	}
-    } else
-    {
-      ret = false;
-    }
+  if ( e->used && key < list->count )
+    ret = entry_enter(list, index, key);
+  else
+    ret = false;
   return ret;
 }
 
-void dspd_client_srv_unlock(struct dspd_slist *list, uint32_t index)
+void dspd_client_srv_unlock(struct dspd_slist *list, uint32_t index, uint32_t key)
 {
-  struct dspd_slist_entry *e = &list->entries[index];
-  kl_unlock(&e->lock);
+  entry_leave(list, index, key);
 }
 
 //Must have the rwlock
@@ -36,9 +36,14 @@ void dspd_slist_entry_rw_unlock(struct dspd_slist *list, uint32_t entry);
 void dspd_slist_rdlock(struct dspd_slist *list);
 void dspd_slist_wrlock(struct dspd_slist *list);
 void dspd_slist_unlock(struct dspd_slist *list);
+/*
+  Device side of the server lock.  These do not exclude each other, only the
+  writers using dspd_slist_entry_srvlock().  The key is the device index and
+  must be the same for lock and unlock.
+*/
 bool dspd_client_srv_lock(struct dspd_slist *list, uint32_t index, uint32_t key);
 bool dspd_client_srv_trylock(struct dspd_slist *list, uint32_t index, uint32_t key);
-void dspd_client_srv_unlock(struct dspd_slist *list, uint32_t index);
+void dspd_client_srv_unlock(struct dspd_slist *list, uint32_t index, uint32_t key);
 uintptr_t dspd_slist_get_object_mask(struct dspd_slist *list,
 				     uint8_t *mask, 
 				     size_t   mask_size,
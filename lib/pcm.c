@@ -24,21 +24,27 @@
 #include <byteswap.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
 #include "pcm.h"
+#include "pcm_simd.h"
 #include "util.h"
 
 #if defined(__x86_64) || defined(i386)
+/*
+  fistpl only stores 32 bits, so the result must not be a long or the
+  upper half would be uninitialized on x86_64.
+*/
 #ifdef __SSE3__
-static inline long _float2int(float64 f)
+static inline int32_t _float2int(float64 f)
 {  
-  long i;
+  int32_t i;
   __asm__ __volatile__ ( "fisttpl %0" : "=m" (i) : "t" (f) : "st" );
   return i;
 }
 #else
-static inline long _float2int(float64 f)
+static inline int32_t _float2int(float64 f)
 {	
-  long i;
+  int32_t i;
   __asm__ __volatile__ ("fistpl %0" : "=m" (i) : "t" (f) : "st");
   return i;
 }
@@ -1620,7 +1626,7 @@ void float32_to_float32_array(const float32 * _r in, float32 * _r out, size_t le
   for ( i = 0; i < len; i++ )
     out[i] = in[i];
 }
-void float32_to_float32_array_wv(const float32 * _r in, float32 * _r out, size_t len, float32 volume)
+void float32_to_float32_array_wv(const float32 * _r in, float32 * _r out, size_t len, float64 volume)
 {
   size_t i;
   for ( i = 0; i < len; i++ )
@@ -1647,7 +1653,7 @@ void float32_to_float64_array(const float32 * _r in, float64 * _r out, size_t le
     out[i] = in[i];
 }
 
-void float64_to_float32_array_wv(const float64 * _r in, float32 * _r out, size_t len, float32 volume)
+void float64_to_float32_array_wv(const float64 * _r in, float32 * _r out, size_t len, float64 volume)
 {
   size_t i;
   for ( i = 0; i < len; i++ )
@@ -2207,10 +2213,41 @@ static struct pcm_conv conv[DSPD_PCM_FORMAT_LAST+1] = {
 
 };
 
-const struct pcm_conv *dspd_getconv(int format)
+/*
+  Copies of the conversion table with the generic routines replaced by
+  accelerated versions where available.  These are built once and the best
+  one supported by the CPU is returned by dspd_getconv().
+*/
+static struct pcm_conv isa_conv[DSPD_PCM_ISA_COUNT][DSPD_PCM_FORMAT_LAST+1];
+static bool isa_supported[DSPD_PCM_ISA_COUNT];
+static int32_t best_isa = DSPD_PCM_ISA_GENERIC;
+static pthread_once_t isa_once = PTHREAD_ONCE_INIT;
+
+static void init_isa_conv(void)
+{
+  int32_t isa;
+  int format;
+  for ( isa = 0; isa < DSPD_PCM_ISA_COUNT; isa++ )
+    {
+      if ( isa != DSPD_PCM_ISA_GENERIC && ! dspd_pcm_simd_supported(isa) )
+	continue;
+      memcpy(isa_conv[isa], conv, sizeof(conv));
+      for ( format = 0; format <= DSPD_PCM_FORMAT_LAST; format++ )
+	dspd_pcm_simd_override(isa, format, &isa_conv[isa][format]);
+      isa_supported[isa] = true;
+      best_isa = isa;
+    }
+}
+
+const struct pcm_conv *dspd_getconv_isa(int format, int32_t isa)
 {
   const char *bytes; char c = 0; size_t i;
-  if ( format < 0 || format > (int)(sizeof(conv)/sizeof(conv[0])) )
+  if ( format < 0 || format > DSPD_PCM_FORMAT_LAST )
+    return NULL;
+  if ( isa < 0 || isa >= DSPD_PCM_ISA_COUNT )
+    return NULL;
+  pthread_once(&isa_once, init_isa_conv);
+  if ( ! isa_supported[isa] )
     return NULL;
   bytes = (const char*)&conv[format];
   //If the whole struct is 0 then there is no conversion routines.
@@ -2220,7 +2257,31 @@ const struct pcm_conv *dspd_getconv(int format)
     c |= bytes[i];
   if ( ! c )
     return NULL;
-  return &conv[format];
+  return &isa_conv[isa][format];
+}
+
+const struct pcm_conv *dspd_getconv(int format)
+{
+  return dspd_getconv_isa(format, dspd_pcm_isa());
+}
+
+int32_t dspd_pcm_isa(void)
+{
+  pthread_once(&isa_once, init_isa_conv);
+  return best_isa;
+}
+
+const char *dspd_pcm_isa_name(int32_t isa)
+{
+  static const char *names[DSPD_PCM_ISA_COUNT] = {
+    [DSPD_PCM_ISA_GENERIC] = "generic",
+    [DSPD_PCM_ISA_SSE2] = "sse2",
+    [DSPD_PCM_ISA_AVX2] = "avx2",
+    [DSPD_PCM_ISA_NEON] = "neon",
+  };
+  if ( isa < 0 || isa >= DSPD_PCM_ISA_COUNT )
+    return NULL;
+  return names[isa];
 }
 
 
@@ -253,6 +253,21 @@ struct pcm_conv {
 #define DSPD_PCM_SBIT_FULLDUPLEX (DSPD_PCM_SBIT_CAPTURE|DSPD_PCM_SBIT_PLAYBACK)
 #define DSPD_PCM_SBIT_CTL DSPD_PCM_SBIT(DSPD_PCM_STREAM_CTL)
 const struct pcm_conv *dspd_getconv(int format);
+
+/*
+  Instruction sets for accelerated conversion routines.  dspd_getconv() uses
+  the best one supported by the CPU.  Entries that have no accelerated version
+  use the generic C code, which is also the reference for bit exactness.
+*/
+#define DSPD_PCM_ISA_GENERIC 0
+#define DSPD_PCM_ISA_SSE2    1
+#define DSPD_PCM_ISA_AVX2    2
+#define DSPD_PCM_ISA_NEON    3
+#define DSPD_PCM_ISA_COUNT   4
+const struct pcm_conv *dspd_getconv_isa(int format, int32_t isa);
+int32_t dspd_pcm_isa(void);
+const char *dspd_pcm_isa_name(int32_t isa);
+
 size_t dspd_get_pcm_format_size(int format);
 int dspd_pcm_build_format(unsigned int bits, unsigned int length, unsigned int usig, unsigned int big_endian, bool isfloat);
 bool dspd_pcm_format_info(int format, unsigned int *bits, unsigned int *length, unsigned int *usig, unsigned int *big_endian, bool *isfloat);
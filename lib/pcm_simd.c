@@ -0,0 +1,643 @@
+/*
+ *  PCM_SIMD - Vectorized PCM floating point conversion routines
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+  These routines must produce exactly the same output as the generic
+  routines in pcm.c.  Only the formats that are in the hot path (the native
+  endian formats that hardware and clients normally use) are implemented.
+  Everything else falls back to the generic code.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <endian.h>
+#include <sys/types.h>
+#include "pcm.h"
+#include "pcm_simd.h"
+
+#define _r __restrict
+
+//Full scale for 32 bit samples
+#define SCALE_S32 (8.0 * 0x10000000)
+//The generic 24 bit routines clip at this value instead of full scale.
+#define LIMIT_S24 (1.0 * 0x7FFFFFFF)
+
+/*
+  Each block converts a fixed number of samples.  The driver runs it over
+  the buffer and handles the remainder with a padded copy so every sample
+  goes through the same instructions.
+*/
+#define simd_driver_vol(_name, _attr, _itype, _otype, _width, _block)	\
+  _attr void _name(const _itype * _r in, _otype * _r out, size_t len, float64 volume) \
+  {									\
+    size_t i, n;							\
+    _itype ibuf[_width];						\
+    _otype obuf[_width];						\
+    for ( i = 0; (i + (_width)) <= len; i += (_width) )		\
+      _block(&in[i], &out[i], volume);					\
+    n = len - i;							\
+    if ( n > 0 )							\
+      {									\
+	memset(ibuf, 0, sizeof(ibuf));					\
+	memcpy(ibuf, &in[i], n * sizeof(_itype));			\
+	_block(ibuf, obuf, volume);					\
+	memcpy(&out[i], obuf, n * sizeof(_otype));			\
+      }									\
+  }
+
+#define simd_driver_wv(_name, _attr, _itype, _otype, _width, _block)	\
+  simd_driver_vol(_name##_wv, _attr, _itype, _otype, _width, _block)	\
+  _attr void _name(const _itype * _r in, _otype * _r out, size_t len)	\
+  { _name##_wv(in, out, len, 1.0); }
+
+/*
+  The generic float32 routines with volume widen each sample to double before
+  scaling, so these blocks do the same and reuse the float64 blocks.
+*/
+#define simd_widen_block(_name, _attr, _otype, _width, _block)		\
+  _attr void _name(const float32 *in, _otype *out, float64 volume)	\
+  {									\
+    float64 tmp[_width];						\
+    size_t i;								\
+    for ( i = 0; i < (_width); i++ )					\
+      tmp[i] = in[i];							\
+    _block(tmp, out, volume);						\
+  }
+
+#define simd_driver(_name, _attr, _itype, _otype, _width, _block)	\
+  _attr void _name(const _itype * _r in, _otype * _r out, size_t len)	\
+  {									\
+    size_t i, n;							\
+    _itype ibuf[_width];						\
+    _otype obuf[_width];						\
+    for ( i = 0; (i + (_width)) <= len; i += (_width) )		\
+      _block(&in[i], &out[i]);						\
+    n = len - i;							\
+    if ( n > 0 )							\
+      {									\
+	memset(ibuf, 0, sizeof(ibuf));					\
+	memcpy(ibuf, &in[i], n * sizeof(_itype));			\
+	_block(ibuf, obuf);						\
+	memcpy(&out[i], obuf, n * sizeof(_otype));			\
+      }									\
+  }
+
+/*
+  All instruction sets implement the same set of routines.
+*/
+#define simd_conv_table(_isa)						\
+  static const struct pcm_conv _isa##_conv[DSPD_PCM_FORMAT_LAST+1] = {	\
+    [DSPD_PCM_FORMAT_S16_NE] = {					\
+      .tofloat32 = (dspd_tofloat32_t)_isa##_int16_to_float32,		\
+      .tofloat32wv = (dspd_tofloat32wv_t)_isa##_int16_to_float32_wv,	\
+      .fromfloat32 = (dspd_fromfloat32_t)_isa##_float32_to_int16,	\
+      .fromfloat32wv = (dspd_fromfloat32wv_t)_isa##_float32_to_int16_wv, \
+      .fromfloat64 = (dspd_fromfloat64_t)_isa##_float64_to_int16,	\
+      .fromfloat64wv = (dspd_fromfloat64wv_t)_isa##_float64_to_int16_wv, \
+    },									\
+    [DSPD_PCM_FORMAT_S32_NE] = {					\
+      .tofloat32 = (dspd_tofloat32_t)_isa##_int32_to_float32,		\
+      .tofloat32wv = (dspd_tofloat32wv_t)_isa##_int32_to_float32_wv,	\
+      .fromfloat32 = (dspd_fromfloat32_t)_isa##_float32_to_int32,	\
+      .fromfloat32wv = (dspd_fromfloat32wv_t)_isa##_float32_to_int32_wv, \
+      .fromfloat64 = (dspd_fromfloat64_t)_isa##_float64_to_int32,	\
+      .fromfloat64wv = (dspd_fromfloat64wv_t)_isa##_float64_to_int32_wv, \
+    },									\
+    [DSPD_PCM_FORMAT_S24_NE] = {					\
+      .tofloat32 = (dspd_tofloat32_t)_isa##_int24_to_float32,		\
+      .tofloat32wv = (dspd_tofloat32wv_t)_isa##_int24_to_float32_wv,	\
+      .fromfloat32 = (dspd_fromfloat32_t)_isa##_float32_to_int24,	\
+      .fromfloat32wv = (dspd_fromfloat32wv_t)_isa##_float32_to_int24_wv, \
+      .fromfloat64 = (dspd_fromfloat64_t)_isa##_float64_to_int24,	\
+      .fromfloat64wv = (dspd_fromfloat64wv_t)_isa##_float64_to_int24_wv, \
+    },									\
+    [DSPD_PCM_FORMAT_FLOAT_NE] = {					\
+      .fromfloat64 = (dspd_fromfloat64_t)_isa##_float64_to_float32,	\
+      .fromfloat64wv = (dspd_fromfloat64wv_t)_isa##_float64_to_float32_wv, \
+    },									\
+  }
+
+#define simd_conv_routines(_isa, _attr)					\
+  simd_driver_wv(_isa##_float64_to_int16, _attr, float64, int16_t, _isa##_width_f64_s16, _isa##_f64_s16_block); \
+  simd_driver_wv(_isa##_float64_to_int32, _attr, float64, int32_t, _isa##_width_f64_s32, _isa##_f64_s32_block); \
+  simd_driver_wv(_isa##_float64_to_int24, _attr, float64, int32_t, _isa##_width_f64_s32, _isa##_f64_s24_block); \
+  simd_driver_wv(_isa##_float64_to_float32, _attr, float64, float32, _isa##_width_f64_s32, _isa##_f64_f32_block); \
+  simd_driver(_isa##_float32_to_int16, _attr, float32, int16_t, _isa##_width_f32_s16, _isa##_f32_s16_block); \
+  simd_driver(_isa##_float32_to_int32, _attr, float32, int32_t, _isa##_width_f32_s32, _isa##_f32_s32_block); \
+  simd_driver(_isa##_float32_to_int24, _attr, float32, int32_t, _isa##_width_f32_s32, _isa##_f32_s24_block); \
+  simd_widen_block(_isa##_f32wv_s16_block, _attr, int16_t, _isa##_width_f64_s16, _isa##_f64_s16_block); \
+  simd_widen_block(_isa##_f32wv_s32_block, _attr, int32_t, _isa##_width_f64_s32, _isa##_f64_s32_block); \
+  simd_widen_block(_isa##_f32wv_s24_block, _attr, int32_t, _isa##_width_f64_s32, _isa##_f64_s24_block); \
+  simd_driver_vol(_isa##_float32_to_int16_wv, _attr, float32, int16_t, _isa##_width_f64_s16, _isa##_f32wv_s16_block); \
+  simd_driver_vol(_isa##_float32_to_int32_wv, _attr, float32, int32_t, _isa##_width_f64_s32, _isa##_f32wv_s32_block); \
+  simd_driver_vol(_isa##_float32_to_int24_wv, _attr, float32, int32_t, _isa##_width_f64_s32, _isa##_f32wv_s24_block); \
+  simd_driver_wv(_isa##_int16_to_float32, _attr, int16_t, float32, _isa##_width_s16_f32, _isa##_s16_f32_block); \
+  simd_driver_wv(_isa##_int32_to_float32, _attr, int32_t, float32, _isa##_width_s32_f32, _isa##_s32_f32_block); \
+  simd_driver_wv(_isa##_int24_to_float32, _attr, int32_t, float32, _isa##_width_s32_f32, _isa##_s24_f32_block); \
+  simd_conv_table(_isa)
+
+
+#if defined(__x86_64) || defined(i386)
+#include <immintrin.h>
+
+#define SSE2_FUNC static __attribute__((target("sse2")))
+#define SSE2_INLINE static inline __attribute__((target("sse2"), always_inline))
+#define AVX2_FUNC static __attribute__((target("avx2")))
+#define AVX2_INLINE static inline __attribute__((target("avx2"), always_inline))
+
+/*
+  Match _float2int() in pcm.c.  It truncates with fisttp if SSE3 is enabled
+  and otherwise rounds with fistp.
+*/
+#ifdef __SSE3__
+#define sse2_cvtpd_epi32 _mm_cvttpd_epi32
+#define sse2_cvtps_epi32 _mm_cvttps_epi32
+#define avx_cvtpd_epi32 _mm256_cvttpd_epi32
+#define avx_cvtps_epi32 _mm256_cvttps_epi32
+#else
+#define sse2_cvtpd_epi32 _mm_cvtpd_epi32
+#define sse2_cvtps_epi32 _mm_cvtps_epi32
+#define avx_cvtpd_epi32 _mm256_cvtpd_epi32
+#define avx_cvtps_epi32 _mm256_cvtps_epi32
+#endif
+
+/*
+  Out of range conversions return INT32_MIN, which is already the correct
+  negative clipping value.  Values at or above the limit are replaced with
+  INT32_MAX.
+*/
+SSE2_INLINE __m128i sse2_clip_s32(__m128i val, __m128i mask)
+{
+  return _mm_or_si128(_mm_andnot_si128(mask, val),
+		      _mm_and_si128(mask, _mm_set1_epi32(INT32_MAX)));
+}
+
+//Same as dividing by 256 in C (rounds toward zero)
+SSE2_INLINE __m128i sse2_div256(__m128i val)
+{
+  __m128i bias = _mm_srli_epi32(_mm_srai_epi32(val, 31), 24);
+  return _mm_srai_epi32(_mm_add_epi32(val, bias), 8);
+}
+
+SSE2_INLINE __m128i sse2_f64_to_s32(const float64 *in, __m128d vol, __m128d limit)
+{
+  const __m128d scale = _mm_set1_pd(SCALE_S32);
+  __m128d a = _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(in), vol), scale);
+  __m128d b = _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(&in[2]), vol), scale);
+  __m128i val = _mm_unpacklo_epi64(sse2_cvtpd_epi32(a), sse2_cvtpd_epi32(b));
+  __m128 mask = _mm_shuffle_ps(_mm_castpd_ps(_mm_cmpge_pd(a, limit)),
+			       _mm_castpd_ps(_mm_cmpge_pd(b, limit)),
+			       _MM_SHUFFLE(2, 0, 2, 0));
+  return sse2_clip_s32(val, _mm_castps_si128(mask));
+}
+
+SSE2_INLINE __m128i sse2_f32_to_s32(const float32 *in)
+{
+  const __m128 scale = _mm_set1_ps(8.0f * 0x10000000);
+  __m128 a = _mm_mul_ps(_mm_loadu_ps(in), scale);
+  return sse2_clip_s32(sse2_cvtps_epi32(a), _mm_castps_si128(_mm_cmpge_ps(a, scale)));
+}
+
+/*
+  Unsigned integer (as double) to float the way the generic code does it:
+  f = (float)(val / div); out = (float)((f - 1.0) * volume)
+*/
+SSE2_INLINE __m128 sse2_u_to_f32(__m128d lo, __m128d hi, __m128d div, __m128d vol)
+{
+  const __m128d one = _mm_set1_pd(1.0);
+  __m128d a = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_div_pd(lo, div)));
+  __m128d b = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_div_pd(hi, div)));
+  a = _mm_mul_pd(_mm_sub_pd(a, one), vol);
+  b = _mm_mul_pd(_mm_sub_pd(b, one), vol);
+  return _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b));
+}
+
+#define sse2_width_f64_s16 8
+#define sse2_width_f64_s32 4
+#define sse2_width_f32_s16 8
+#define sse2_width_f32_s32 4
+#define sse2_width_s16_f32 8
+#define sse2_width_s32_f32 4
+
+SSE2_INLINE void sse2_f64_s16_block(const float64 *in, int16_t *out, float64 volume)
+{
+  __m128d vol = _mm_set1_pd(volume), limit = _mm_set1_pd(SCALE_S32);
+  __m128i a = _mm_srai_epi32(sse2_f64_to_s32(in, vol, limit), 16);
+  __m128i b = _mm_srai_epi32(sse2_f64_to_s32(&in[4], vol, limit), 16);
+  _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(a, b));
+}
+
+SSE2_INLINE void sse2_f64_s32_block(const float64 *in, int32_t *out, float64 volume)
+{
+  __m128i a = sse2_f64_to_s32(in, _mm_set1_pd(volume), _mm_set1_pd(SCALE_S32));
+  _mm_storeu_si128((__m128i*)out, a);
+}
+
+SSE2_INLINE void sse2_f64_s24_block(const float64 *in, int32_t *out, float64 volume)
+{
+  __m128i a = sse2_f64_to_s32(in, _mm_set1_pd(volume), _mm_set1_pd(LIMIT_S24));
+  _mm_storeu_si128((__m128i*)out, sse2_div256(a));
+}
+
+SSE2_INLINE void sse2_f64_f32_block(const float64 *in, float32 *out, float64 volume)
+{
+  __m128d vol = _mm_set1_pd(volume);
+  __m128 a = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(in), vol));
+  __m128 b = _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(&in[2]), vol));
+  _mm_storeu_ps(out, _mm_movelh_ps(a, b));
+}
+
+SSE2_INLINE void sse2_f32_s16_block(const float32 *in, int16_t *out)
+{
+  __m128i a = _mm_srai_epi32(sse2_f32_to_s32(in), 16);
+  __m128i b = _mm_srai_epi32(sse2_f32_to_s32(&in[4]), 16);
+  _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(a, b));
+}
+
+SSE2_INLINE void sse2_f32_s32_block(const float32 *in, int32_t *out)
+{
+  _mm_storeu_si128((__m128i*)out, sse2_f32_to_s32(in));
+}
+
+SSE2_INLINE void sse2_f32_s24_block(const float32 *in, int32_t *out)
+{
+  _mm_storeu_si128((__m128i*)out, sse2_div256(sse2_f32_to_s32(in)));
+}
+
+SSE2_INLINE void sse2_s16_f32_block(const int16_t *in, float32 *out, float64 volume)
+{
+  const __m128i bias = _mm_set1_epi32(0x8000);
+  const __m128d div = _mm_set1_pd(UINT16_MAX / 2.0);
+  __m128d vol = _mm_set1_pd(volume);
+  __m128i x = _mm_loadu_si128((const __m128i*)in);
+  __m128i lo = _mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), bias);
+  __m128i hi = _mm_add_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16), bias);
+  _mm_storeu_ps(out, sse2_u_to_f32(_mm_cvtepi32_pd(lo),
+				   _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2))),
+				   div, vol));
+  _mm_storeu_ps(&out[4], sse2_u_to_f32(_mm_cvtepi32_pd(hi),
+				       _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2))),
+				       div, vol));
+}
+
+SSE2_INLINE void sse2_s32_f32_block(const int32_t *in, float32 *out, float64 volume)
+{
+  const __m128d bias = _mm_set1_pd(2147483648.0);
+  const __m128d div = _mm_set1_pd(UINT32_MAX / 2.0);
+  __m128i x = _mm_loadu_si128((const __m128i*)in);
+  __m128d lo = _mm_add_pd(_mm_cvtepi32_pd(x), bias);
+  __m128d hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2))), bias);
+  _mm_storeu_ps(out, sse2_u_to_f32(lo, hi, div, _mm_set1_pd(volume)));
+}
+
+SSE2_INLINE void sse2_s24_f32_block(const int32_t *in, float32 *out, float64 volume)
+{
+  __m128d vol = _mm_set1_pd(volume);
+  __m128i x = _mm_slli_epi32(_mm_loadu_si128((const __m128i*)in), 8);
+  __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / (8.0f * 0x10000000)));
+  __m128d a = _mm_mul_pd(_mm_cvtps_pd(f), vol);
+  __m128d b = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)), vol);
+  _mm_storeu_ps(out, _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b)));
+}
+
+simd_conv_routines(sse2, SSE2_FUNC);
+
+
+AVX2_INLINE __m128i avx2_clip_s32(__m128i val, __m128i mask)
+{
+  return _mm_blendv_epi8(val, _mm_set1_epi32(INT32_MAX), mask);
+}
+
+AVX2_INLINE __m256i avx2_div256(__m256i val)
+{
+  __m256i bias = _mm256_srli_epi32(_mm256_srai_epi32(val, 31), 24);
+  return _mm256_srai_epi32(_mm256_add_epi32(val, bias), 8);
+}
+
+AVX2_INLINE __m128i avx2_f64_to_s32(const float64 *in, __m256d vol, __m256d limit)
+{
+  const __m256d scale = _mm256_set1_pd(SCALE_S32);
+  const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  __m256d a = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(in), vol), scale);
+  __m256i mask = _mm256_castpd_si256(_mm256_cmp_pd(a, limit, _CMP_GE_OQ));
+  mask = _mm256_permutevar8x32_epi32(mask, even);
+  return avx2_clip_s32(avx_cvtpd_epi32(a), _mm256_castsi256_si128(mask));
+}
+
+AVX2_INLINE __m256i avx2_f32_to_s32(const float32 *in)
+{
+  const __m256 scale = _mm256_set1_ps(8.0f * 0x10000000);
+  __m256 a = _mm256_mul_ps(_mm256_loadu_ps(in), scale);
+  __m256i mask = _mm256_castps_si256(_mm256_cmp_ps(a, scale, _CMP_GE_OQ));
+  return _mm256_blendv_epi8(avx_cvtps_epi32(a), _mm256_set1_epi32(INT32_MAX), mask);
+}
+
+AVX2_INLINE __m128 avx2_u_to_f32(__m256d val, __m256d div, __m256d vol)
+{
+  __m256d f = _mm256_cvtps_pd(_mm256_cvtpd_ps(_mm256_div_pd(val, div)));
+  f = _mm256_mul_pd(_mm256_sub_pd(f, _mm256_set1_pd(1.0)), vol);
+  return _mm256_cvtpd_ps(f);
+}
+
+#define avx2_width_f64_s16 16
+#define avx2_width_f64_s32 8
+#define avx2_width_f32_s16 16
+#define avx2_width_f32_s32 8
+#define avx2_width_s16_f32 8
+#define avx2_width_s32_f32 8
+
+AVX2_INLINE void avx2_f64_s16_block(const float64 *in, int16_t *out, float64 volume)
+{
+  __m256d vol = _mm256_set1_pd(volume), limit = _mm256_set1_pd(SCALE_S32);
+  __m128i a, b, c, d;
+  a = _mm_srai_epi32(avx2_f64_to_s32(in, vol, limit), 16);
+  b = _mm_srai_epi32(avx2_f64_to_s32(&in[4], vol, limit), 16);
+  c = _mm_srai_epi32(avx2_f64_to_s32(&in[8], vol, limit), 16);
+  d = _mm_srai_epi32(avx2_f64_to_s32(&in[12], vol, limit), 16);
+  _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(a, b));
+  _mm_storeu_si128((__m128i*)&out[8], _mm_packs_epi32(c, d));
+}
+
+AVX2_INLINE void avx2_f64_s32_block(const float64 *in, int32_t *out, float64 volume)
+{
+  __m256d vol = _mm256_set1_pd(volume), limit = _mm256_set1_pd(SCALE_S32);
+  _mm_storeu_si128((__m128i*)out, avx2_f64_to_s32(in, vol, limit));
+  _mm_storeu_si128((__m128i*)&out[4], avx2_f64_to_s32(&in[4], vol, limit));
+}
+
+AVX2_INLINE void avx2_f64_s24_block(const float64 *in, int32_t *out, float64 volume)
+{
+  __m256d vol = _mm256_set1_pd(volume), limit = _mm256_set1_pd(LIMIT_S24);
+  __m256i val = _mm256_castsi128_si256(avx2_f64_to_s32(in, vol, limit));
+  val = _mm256_inserti128_si256(val, avx2_f64_to_s32(&in[4], vol, limit), 1);
+  _mm256_storeu_si256((__m256i*)out, avx2_div256(val));
+}
+
+AVX2_INLINE void avx2_f64_f32_block(const float64 *in, float32 *out, float64 volume)
+{
+  __m256d vol = _mm256_set1_pd(volume);
+  _mm_storeu_ps(out, _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(in), vol)));
+  _mm_storeu_ps(&out[4], _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(&in[4]), vol)));
+}
+
+AVX2_INLINE void avx2_f32_s16_block(const float32 *in, int16_t *out)
+{
+  __m256i a = _mm256_srai_epi32(avx2_f32_to_s32(in), 16);
+  __m256i b = _mm256_srai_epi32(avx2_f32_to_s32(&in[8]), 16);
+  //packs works within 128 bit lanes so the result must be reordered
+  __m256i val = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+  _mm256_storeu_si256((__m256i*)out, val);
+}
+
+AVX2_INLINE void avx2_f32_s32_block(const float32 *in, int32_t *out)
+{
+  _mm256_storeu_si256((__m256i*)out, avx2_f32_to_s32(in));
+}
+
+AVX2_INLINE void avx2_f32_s24_block(const float32 *in, int32_t *out)
+{
+  _mm256_storeu_si256((__m256i*)out, avx2_div256(avx2_f32_to_s32(in)));
+}
+
+AVX2_INLINE void avx2_s16_f32_block(const int16_t *in, float32 *out, float64 volume)
+{
+  const __m256d div = _mm256_set1_pd(UINT16_MAX / 2.0);
+  __m256d vol = _mm256_set1_pd(volume);
+  __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)in));
+  x = _mm256_add_epi32(x, _mm256_set1_epi32(0x8000));
+  _mm_storeu_ps(out, avx2_u_to_f32(_mm256_cvtepi32_pd(_mm256_castsi256_si128(x)), div, vol));
+  _mm_storeu_ps(&out[4], avx2_u_to_f32(_mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)), div, vol));
+}
+
+AVX2_INLINE void avx2_s32_f32_block(const int32_t *in, float32 *out, float64 volume)
+{
+  const __m256d bias = _mm256_set1_pd(2147483648.0);
+  const __m256d div = _mm256_set1_pd(UINT32_MAX / 2.0);
+  __m256d vol = _mm256_set1_pd(volume);
+  __m256i x = _mm256_loadu_si256((const __m256i*)in);
+  __m256d lo = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(x)), bias);
+  __m256d hi = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)), bias);
+  _mm_storeu_ps(out, avx2_u_to_f32(lo, div, vol));
+  _mm_storeu_ps(&out[4], avx2_u_to_f32(hi, div, vol));
+}
+
+AVX2_INLINE void avx2_s24_f32_block(const int32_t *in, float32 *out, float64 volume)
+{
+  __m256d vol = _mm256_set1_pd(volume);
+  __m256i x = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)in), 8);
+  __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / (8.0f * 0x10000000)));
+  __m256d a = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(f)), vol);
+  __m256d b = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)), vol);
+  _mm_storeu_ps(out, _mm256_cvtpd_ps(a));
+  _mm_storeu_ps(&out[4], _mm256_cvtpd_ps(b));
+}
+
+simd_conv_routines(avx2, AVX2_FUNC);
+
+bool dspd_pcm_simd_supported(int32_t isa)
+{
+  bool ret = false;
+  __builtin_cpu_init();
+  if ( isa == DSPD_PCM_ISA_SSE2 )
+    ret = __builtin_cpu_supports("sse2");
+  else if ( isa == DSPD_PCM_ISA_AVX2 )
+    ret = __builtin_cpu_supports("avx2");
+  return ret;
+}
+
+static const struct pcm_conv *simd_conv(int32_t isa, int format)
+{
+  const struct pcm_conv *ret = NULL;
+  if ( isa == DSPD_PCM_ISA_SSE2 )
+    ret = &sse2_conv[format];
+  else if ( isa == DSPD_PCM_ISA_AVX2 )
+    ret = &avx2_conv[format];
+  return ret;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define NEON_FUNC static
+#define NEON_INLINE static inline __attribute__((always_inline))
+
+/*
+  The generic code uses lrint(), which rounds to nearest.  The NEON
+  conversions saturate, which gives the same clipping as the generic code.
+*/
+NEON_INLINE int32x4_t neon_f64_to_s32(const float64 *in, float64 volume)
+{
+  float64x2_t a = vmulq_n_f64(vmulq_n_f64(vld1q_f64(in), volume), SCALE_S32);
+  float64x2_t b = vmulq_n_f64(vmulq_n_f64(vld1q_f64(&in[2]), volume), SCALE_S32);
+  return vcombine_s32(vqmovn_s64(vcvtnq_s64_f64(a)), vqmovn_s64(vcvtnq_s64_f64(b)));
+}
+
+NEON_INLINE int32x4_t neon_f32_to_s32(const float32 *in)
+{
+  return vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in), 8.0f * 0x10000000));
+}
+
+NEON_INLINE int32x4_t neon_div256(int32x4_t val)
+{
+  uint32x4_t bias = vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(val, 31)), 24);
+  return vshrq_n_s32(vaddq_s32(val, vreinterpretq_s32_u32(bias)), 8);
+}
+
+NEON_INLINE float32x4_t neon_u_to_f32(float64x2_t lo, float64x2_t hi, float64 div, float64 volume)
+{
+  float64x2_t d = vdupq_n_f64(div), one = vdupq_n_f64(1.0);
+  float64x2_t a = vcvt_f64_f32(vcvt_f32_f64(vdivq_f64(lo, d)));
+  float64x2_t b = vcvt_f64_f32(vcvt_f32_f64(vdivq_f64(hi, d)));
+  a = vmulq_n_f64(vsubq_f64(a, one), volume);
+  b = vmulq_n_f64(vsubq_f64(b, one), volume);
+  return vcombine_f32(vcvt_f32_f64(a), vcvt_f32_f64(b));
+}
+
+#define neon_width_f64_s16 8
+#define neon_width_f64_s32 4
+#define neon_width_f32_s16 8
+#define neon_width_f32_s32 4
+#define neon_width_s16_f32 8
+#define neon_width_s32_f32 4
+
+NEON_INLINE void neon_f64_s16_block(const float64 *in, int16_t *out, float64 volume)
+{
+  int16x4_t a = vshrn_n_s32(neon_f64_to_s32(in, volume), 16);
+  int16x4_t b = vshrn_n_s32(neon_f64_to_s32(&in[4], volume), 16);
+  vst1q_s16(out, vcombine_s16(a, b));
+}
+
+NEON_INLINE void neon_f64_s32_block(const float64 *in, int32_t *out, float64 volume)
+{
+  vst1q_s32(out, neon_f64_to_s32(in, volume));
+}
+
+NEON_INLINE void neon_f64_s24_block(const float64 *in, int32_t *out, float64 volume)
+{
+  vst1q_s32(out, neon_div256(neon_f64_to_s32(in, volume)));
+}
+
+NEON_INLINE void neon_f64_f32_block(const float64 *in, float32 *out, float64 volume)
+{
+  float32x2_t a = vcvt_f32_f64(vmulq_n_f64(vld1q_f64(in), volume));
+  float32x2_t b = vcvt_f32_f64(vmulq_n_f64(vld1q_f64(&in[2]), volume));
+  vst1q_f32(out, vcombine_f32(a, b));
+}
+
+NEON_INLINE void neon_f32_s16_block(const float32 *in, int16_t *out)
+{
+  int16x4_t a = vshrn_n_s32(neon_f32_to_s32(in), 16);
+  int16x4_t b = vshrn_n_s32(neon_f32_to_s32(&in[4]), 16);
+  vst1q_s16(out, vcombine_s16(a, b));
+}
+
+NEON_INLINE void neon_f32_s32_block(const float32 *in, int32_t *out)
+{
+  vst1q_s32(out, neon_f32_to_s32(in));
+}
+
+NEON_INLINE void neon_f32_s24_block(const float32 *in, int32_t *out)
+{
+  vst1q_s32(out, neon_div256(neon_f32_to_s32(in)));
+}
+
+NEON_INLINE void neon_s16_f32_block(const int16_t *in, float32 *out, float64 volume)
+{
+  const int32x4_t bias = vdupq_n_s32(0x8000);
+  int16x8_t x = vld1q_s16(in);
+  int32x4_t lo = vaddq_s32(vmovl_s16(vget_low_s16(x)), bias);
+  int32x4_t hi = vaddq_s32(vmovl_s16(vget_high_s16(x)), bias);
+  vst1q_f32(out, neon_u_to_f32(vcvtq_f64_s64(vmovl_s32(vget_low_s32(lo))),
+			       vcvtq_f64_s64(vmovl_s32(vget_high_s32(lo))),
+			       UINT16_MAX / 2.0, volume));
+  vst1q_f32(&out[4], neon_u_to_f32(vcvtq_f64_s64(vmovl_s32(vget_low_s32(hi))),
+				   vcvtq_f64_s64(vmovl_s32(vget_high_s32(hi))),
+				   UINT16_MAX / 2.0, volume));
+}
+
+NEON_INLINE void neon_s32_f32_block(const int32_t *in, float32 *out, float64 volume)
+{
+  const float64x2_t bias = vdupq_n_f64(2147483648.0);
+  int32x4_t x = vld1q_s32(in);
+  float64x2_t lo = vaddq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))), bias);
+  float64x2_t hi = vaddq_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(x))), bias);
+  vst1q_f32(out, neon_u_to_f32(lo, hi, UINT32_MAX / 2.0, volume));
+}
+
+NEON_INLINE void neon_s24_f32_block(const int32_t *in, float32 *out, float64 volume)
+{
+  int32x4_t x = vshlq_n_s32(vld1q_s32(in), 8);
+  float32x4_t f = vmulq_n_f32(vcvtq_f32_s32(x), 1.0f / (8.0f * 0x10000000));
+  float64x2_t a = vmulq_n_f64(vcvt_f64_f32(vget_low_f32(f)), volume);
+  float64x2_t b = vmulq_n_f64(vcvt_high_f64_f32(f), volume);
+  vst1q_f32(out, vcombine_f32(vcvt_f32_f64(a), vcvt_f32_f64(b)));
+}
+
+simd_conv_routines(neon, NEON_FUNC);
+
+bool dspd_pcm_simd_supported(int32_t isa)
+{
+  return isa == DSPD_PCM_ISA_NEON;
+}
+
+static const struct pcm_conv *simd_conv(int32_t isa, int format)
+{
+  const struct pcm_conv *ret = NULL;
+  if ( isa == DSPD_PCM_ISA_NEON )
+    ret = &neon_conv[format];
+  return ret;
+}
+
+#else
+
+bool dspd_pcm_simd_supported(int32_t isa)
+{
+  return false;
+}
+
+static const struct pcm_conv *simd_conv(int32_t isa, int format)
+{
+  return NULL;
+}
+
+#endif
+
+#define override_conv(_c, _name) if ( (_c)->_name ) conv->_name = (_c)->_name
+
+void dspd_pcm_simd_override(int32_t isa, int format, struct pcm_conv *conv)
+{
+  const struct pcm_conv *c;
+  if ( format < 0 || format > DSPD_PCM_FORMAT_LAST )
+    return;
+  c = simd_conv(isa, format);
+  if ( c )
+    {
+      override_conv(c, tofloat32);
+      override_conv(c, tofloat64);
+      override_conv(c, tofloat64wv);
+      override_conv(c, tofloat32wv);
+      override_conv(c, fromfloat32);
+      override_conv(c, fromfloat64);
+      override_conv(c, fromfloat32wv);
+      override_conv(c, fromfloat64wv);
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef _DSPD_PCM_SIMD_H_
+#define _DSPD_PCM_SIMD_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "pcm.h"
+//Returns true if the CPU can run the routines for the instruction set.
+bool dspd_pcm_simd_supported(int32_t isa);
+//Replace generic routines with accelerated versions.  Entries without an accelerated version are not modified.
+void dspd_pcm_simd_override(int32_t isa, int format, struct pcm_conv *conv);
+#endif
@@ -480,6 +480,16 @@ int32_t dspd_pcmcli_wait(struct dspd_pcmcli *client, int32_t streams, uint32_t a
 	    {
 	      //Streams are ready now
 	      ret = client->timer_ops->fire(client->timer_arg, false);
+	    } else if ( async == false && streams == DSPD_PCM_SBIT_PLAYBACK &&
+			client->pending_op.error <= 0 && client->connfd >= 0 )
+	    {
+	      /*
+		Nothing but playback to wait for, so sleep on the fifo.  The
+		server wakes this up when there is space, which is sooner
+		than the timer if the estimate is off.  Connection events
+		are picked up on the next poll.
+	      */
+	      ret = dspd_pcmcli_stream_wait_space(&client->playback.stream, avail, next);
 	    } else
 	    {
 	      //Streams will be ready later
@@ -1031,6 +1041,129 @@ ssize_t dspd_pcmcli_read_bytes(struct dspd_pcmcli *client,
 }
 
 
+//Check if dspd_pcmcli_mmap_begin() can work on a stream without changing its state.
+bool dspd_pcmcli_can_mmap(struct dspd_pcmcli *client, int32_t stream)
+{
+  struct pcmcli_stream_data *s;
+  if ( stream == DSPD_PCM_SBIT_PLAYBACK )
+    s = &client->playback;
+  else if ( stream == DSPD_PCM_SBIT_CAPTURE )
+    s = &client->capture;
+  else
+    return false;
+  return s->enabled && client->state > PCMCLI_STATE_SETUP && dspd_pcmcli_stream_can_mmap(&s->stream);
+}
+
+/*
+  Get the contiguous part of the fifo that the caller can write (playback)
+  or read (capture) in place.  It never blocks.  The length is limited by
+  *frames on input and is 0 with -EAGAIN if nothing is available.  A stream
+  that needs a format conversion returns -ENOTSUP and is left as it was, so
+  the caller can use dspd_pcmcli_write_frames() or dspd_pcmcli_read_frames()
+  instead.
+*/
+int32_t dspd_pcmcli_mmap_begin(struct dspd_pcmcli *client, int32_t stream, void **addr, uint32_t *frames)
+{
+  int32_t ret;
+  struct pcmcli_stream_data *s;
+  struct dspd_pcmcli_status status;
+  if ( stream == DSPD_PCM_SBIT_PLAYBACK )
+    s = &client->playback;
+  else if ( stream == DSPD_PCM_SBIT_CAPTURE )
+    s = &client->capture;
+  else
+    return -EINVAL;
+  if ( client->error )
+    {
+      ret = client->error;
+    } else if ( client->state == PCMCLI_STATE_XRUN )
+    {
+      ret = -EPIPE;
+    } else if ( client->state == PCMCLI_STATE_SUSPENDED )
+    {
+      ret = -ESTRPIPE;
+    } else if ( client->state != PCMCLI_STATE_PREPARED && client->state != PCMCLI_STATE_RUNNING )
+    {
+      ret = -EBADFD;
+    } else if ( s->enabled == false )
+    {
+      ret = -EBADF;
+    } else if ( ! dspd_pcmcli_stream_can_mmap(&s->stream) )
+    {
+      //Not an error.  The caller has to use the read/write functions.
+      *frames = 0;
+      return -ENOTSUP;
+    } else if ( s->frame_off > 0 )
+    {
+      //A partial frame from dspd_pcmcli_write_bytes() or dspd_pcmcli_read_bytes()
+      ret = -EBUSY;
+    } else
+    {
+      client->paused_timers &= ~stream;
+      if ( client->no_xrun == true || (ret = dspd_pcmcli_stream_check_xrun(&s->stream)) == 0 )
+	{
+	  if ( stream == DSPD_PCM_SBIT_PLAYBACK && 
+	       client->constant_latency == true && 
+	       client->callback_pending == false )
+	    {
+	      if ( client->last_avail == 0 )
+		{
+		  ret = dspd_pcmcli_get_status(client, DSPD_PCM_SBIT_PLAYBACK, true, &status);
+		  if ( ret < 0 && ret != -EAGAIN )
+		    goto out;
+		}
+	      if ( *frames > client->last_avail )
+		*frames = client->last_avail;
+	    }
+	  if ( *frames > 0 )
+	    ret = dspd_pcmcli_stream_mmap_begin(&s->stream, addr, frames);
+	  if ( ret == 0 && *frames == 0 )
+	    ret = -EAGAIN;
+	}
+    }
+
+ out:
+  if ( ret < 0 )
+    {
+      *frames = 0;
+      set_error(client, ret);
+    }
+  return ret;
+}
+
+//Commit frames from dspd_pcmcli_mmap_begin().  Returns the number of frames.
+ssize_t dspd_pcmcli_mmap_commit(struct dspd_pcmcli *client, int32_t stream, uint32_t frames)
+{
+  ssize_t ret;
+  struct pcmcli_stream_data *s;
+  if ( stream == DSPD_PCM_SBIT_PLAYBACK )
+    s = &client->playback;
+  else if ( stream == DSPD_PCM_SBIT_CAPTURE )
+    s = &client->capture;
+  else
+    return -EINVAL;
+  if ( client->error )
+    {
+      ret = client->error;
+    } else if ( s->enabled == false )
+    {
+      ret = -EBADF;
+    } else
+    {
+      ret = dspd_pcmcli_stream_mmap_commit(&s->stream, frames);
+      if ( ret > 0 )
+	{
+	  s->xfer += ret;
+	  if ( client->callback_pending == false )
+	    dspd_pcmcli_restore_wait(client);
+	}
+    }
+  if ( ret < 0 )
+    set_error(client, ret);
+  return ret;
+}
+
+
 int32_t dspd_pcmcli_get_status(struct dspd_pcmcli *client, int32_t stream, bool hwsync, struct dspd_pcmcli_status *status)
 {
   int32_t ret;
@@ -2137,40 +2270,27 @@ int32_t dspd_pcmcli_select_byname_cb(void *arg, int32_t streams, int32_t index,
   return ret;
 }
  
-static int32_t ref_stream(struct dspd_aio_ctx *aio, struct pcmcli_stream_data *data, uint32_t sbit, uint32_t dev)
+//The device reference must be the same device that was selected.
+static int32_t check_stream_info(struct pcmcli_stream_data *data, 
+				 uint32_t sbit, 
+				 const struct dspd_device_stat *info, 
+				 size_t len)
 {
-  int32_t ret;
-  struct dspd_device_stat info;
-  uint64_t val;
-  size_t br;
-  val = sbit;
-  val <<= 32U;
-  val |= dev;
-  ret = dspd_stream_ctl(aio, 
-			-1, 
-			DSPD_SOCKSRV_REQ_RMSRV, 
-			&val, 
-			sizeof(val), 
-			&info, 
-			sizeof(info),
-			&br);
-  if ( ret == 0 )
+  int32_t ret = 0;
+  if ( len != sizeof(*info) )
     {
-      if ( br != sizeof(info) )
-	{
-	  ret = -EPROTO;
-	} else if ( strcmp(info.name, data->info.name) == 0 &&
-		    strcmp(info.bus, data->info.bus) == 0 &&
-		    strcmp(info.addr, data->info.addr) == 0 &&
-		    strcmp(info.desc, data->info.desc) == 0 &&
-		    (info.streams & sbit) == sbit )
-	{
-	  data->info = info;
-	} else
-	{
-	  //Not the same device
-	  ret = -EAGAIN;
-	}
+      ret = -EPROTO;
+    } else if ( strcmp(info->name, data->info.name) == 0 &&
+		strcmp(info->bus, data->info.bus) == 0 &&
+		strcmp(info->addr, data->info.addr) == 0 &&
+		strcmp(info->desc, data->info.desc) == 0 &&
+		(info->streams & sbit) == sbit )
+    {
+      data->info = *info;
+    } else
+    {
+      //Not the same device
+      ret = -EAGAIN;
     }
   return ret;
 }
@@ -2213,6 +2333,134 @@ static void event_cb(struct dspd_aio_ctx    *context,
   
 }
 
+/*
+  Reference the devices in one round trip, then create the client streams and
+  connect them in a second one.  The server runs the requests in order and
+  stops at the first error.  The streams are not created until the device
+  references pass the checks so nothing is left on the server if they fail.
+*/
+static int32_t open_streams(struct dspd_pcmcli *client, struct dspd_pcmcli_bindparams *params)
+{
+  struct dspd_async_op ops[2];
+  struct dspd_device_stat pinfo, cinfo;
+  uint64_t pval = 0, cval = 0;
+  int32_t s = 0, reserve = -1, ret = 0;
+  int64_t o = 0;
+  size_t n = 0, pidx = SIZE_MAX, cidx = SIZE_MAX;
+  bool fullduplex = false;
+  memset(ops, 0, sizeof(ops));
+  if ( params->playback_device >= 0 && params->capture_device >= 0 && 
+       params->playback_device == params->capture_device )
+    {
+      fullduplex = true;
+      pval = DSPD_PCM_SBIT_FULLDUPLEX;
+      pval <<= 32U;
+      pval |= params->playback_device;
+      pidx = n++;
+    } else if ( client->streams == DSPD_PCM_SBIT_FULLDUPLEX && (params->playback_device < 0 || params->capture_device < 0) )
+    {
+      return -ENOENT;
+    } else
+    {
+      if ( params->playback_device >= 0 )
+	{
+	  pval = DSPD_PCM_SBIT_PLAYBACK;
+	  pval <<= 32U;
+	  pval |= params->playback_device;
+	  pidx = n++;
+	}
+      if ( params->capture_device >= 0 )
+	{
+	  cval = DSPD_PCM_SBIT_CAPTURE;
+	  cval <<= 32U;
+	  cval |= params->capture_device;
+	  cidx = n++;
+	}
+    }
+  if ( pidx != SIZE_MAX )
+    {
+      ops[pidx].stream = -1;
+      ops[pidx].req = DSPD_SOCKSRV_REQ_RMSRV;
+      ops[pidx].inbuf = &pval;
+      ops[pidx].inbufsize = sizeof(pval);
+      ops[pidx].outbuf = &pinfo;
+      ops[pidx].outbufsize = sizeof(pinfo);
+    }
+  if ( cidx != SIZE_MAX )
+    {
+      ops[cidx].stream = -1;
+      ops[cidx].req = DSPD_SOCKSRV_REQ_RMSRV;
+      ops[cidx].inbuf = &cval;
+      ops[cidx].inbufsize = sizeof(cval);
+      ops[cidx].outbuf = &cinfo;
+      ops[cidx].outbufsize = sizeof(cinfo);
+    }
+  if ( n > 0 )
+    {
+      ret = dspd_aio_compound_ctl(params->context, ops, n);
+      if ( ret < 0 )
+	return ret;
+    }
+
+  if ( pidx != SIZE_MAX && ! fullduplex )
+    ret = check_stream_info(&client->playback, DSPD_PCM_SBIT_PLAYBACK, &pinfo, ops[pidx].xfer);
+  if ( ret == 0 && cidx != SIZE_MAX )
+    ret = check_stream_info(&client->capture, DSPD_PCM_SBIT_CAPTURE, &cinfo, ops[cidx].xfer);
+  if ( ret == 0 && pidx != SIZE_MAX && cidx != SIZE_MAX )
+    {
+      //The two devices must be two halves of the same device.
+      if ( compare_names(client->playback.info.name, client->capture.info.name) == false ||
+	   check_latencies(&client->playback.info.playback, &client->capture.info.capture) == false ||
+	   strcmp(client->playback.info.bus, client->capture.info.bus) != 0 ||
+	   client->playback.info.playback.rate != client->capture.info.capture.rate )
+	ret = -EINVAL;
+    }
+  if ( ret < 0 ||
+       ((client->streams & DSPD_PCM_SBIT_PLAYBACK) != 0 && params->playback_device < 0 ) ||
+       ((client->streams & DSPD_PCM_SBIT_CAPTURE) != 0 && params->capture_device < 0 ) )
+    return ret;
+
+  if ( params->playback_device != params->capture_device )
+    {
+      if ( params->playback_device >= 0 )
+	s |= DSPD_PCM_SBIT_PLAYBACK;
+      if ( params->capture_device >= 0 )
+	s |= DSPD_PCM_SBIT_CAPTURE;
+    }
+  memset(ops, 0, sizeof(ops));
+  ops[0].stream = -1;
+  ops[0].req = DSPD_SOCKSRV_REQ_NMCLI;
+  ops[0].inbuf = &s;
+  ops[0].inbufsize = sizeof(s);
+  ops[0].outbuf = &o;
+  ops[0].outbufsize = sizeof(o);
+  //Same as what dspd_pcmcli_bind() sends to connect the new streams.
+  ops[1].stream = -1;
+  ops[1].req = DSPD_SCTL_CLIENT_RESERVE;
+  ops[1].inbuf = &reserve;
+  ops[1].inbufsize = sizeof(reserve);
+  ret = dspd_aio_compound_ctl(params->context, ops, 2);
+  if ( ret == 0 )
+    {
+      if ( ops[0].xfer == sizeof(o) )
+	{
+	  if ( client->streams & DSPD_PCM_SBIT_PLAYBACK )
+	    params->playback_stream = o >> 32U;
+	  if ( client->streams & DSPD_PCM_SBIT_CAPTURE )
+	    params->capture_stream = o & 0xFFFFFFFFU;
+	  ret = dspd_pcmcli_bind(client, 
+				 params, 
+				 DSPD_PCMCLI_BIND_AUTOCLOSE | DSPD_PCMCLI_BIND_CONNECTED, 
+				 NULL, 
+				 NULL);
+	} else
+	{
+	  ret = -EPROTO;
+	}
+    }
+  return ret;
+}
+
 int32_t dspd_pcmcli_open_device(struct dspd_pcmcli *client, 
 				const char *server,
 				int32_t (*select_device)(void *arg, int32_t streams, int32_t index, const struct dspd_device_stat *info, struct dspd_pcmcli *client),
@@ -2227,11 +2475,7 @@ int32_t dspd_pcmcli_open_device(struct dspd_pcmcli *client,
   };
   int32_t ret;
   struct sd_args args;
-  int32_t s;
-  int64_t o;
-  int64_t val;
   size_t br;
-  struct dspd_device_stat info;
   struct dspd_device_mstat minfo;
   if ( client->state > PCMCLI_STATE_INIT )
     return -EBADFD;
@@ -2298,77 +2542,7 @@ int32_t dspd_pcmcli_open_device(struct dspd_pcmcli *client,
 
 	}
       if ( ret == 0 )
-	{
-	  if ( params.playback_device >= 0 && params.capture_device >= 0 && 
-	       params.playback_device == params.capture_device )
-	    {
- 	      val = DSPD_PCM_SBIT_FULLDUPLEX;
-	      val <<= 32U;
-	      val |= params.playback_device;
-	      ret = dspd_stream_ctl(params.context, 
-				    -1, 
-				    DSPD_SOCKSRV_REQ_RMSRV, 
-				    &val, 
-				    sizeof(val), 
-				    NULL, 
-				    sizeof(info),
-				    &br);
-	    } else
-	    {
-	      if ( client->streams == DSPD_PCM_SBIT_FULLDUPLEX && (params.playback_device < 0 || params.capture_device < 0) )
-		{
-		  ret = -ENOENT;
-		} else
-		{
-		  if ( params.playback_device >= 0 )
-		    ret = ref_stream(params.context, &client->playback, DSPD_PCM_SBIT_PLAYBACK, params.playback_device);
-		  if ( ret == 0 && params.capture_device >= 0 )
-		    ret = ref_stream(params.context, &client->capture, DSPD_PCM_SBIT_CAPTURE, params.capture_device);
-
-		  if ( params.playback_device >= 0 && params.capture_device >= 0 )
-		    {
-		      //The two devices must be two halves of the same device.
-		      if ( compare_names(client->playback.info.name, client->capture.info.name) == false ||
-			   check_latencies(&client->playback.info.playback, &client->capture.info.capture) == false ||
-			   strcmp(client->playback.info.bus, client->capture.info.bus) != 0 ||
-			   client->playback.info.playback.rate != client->capture.info.capture.rate )
-			ret = -EINVAL;
-		    }
-		}
-	    }
-	}
-	
-
-      if ( ret == 0 )
-	{
-	  if ( ! (((client->streams & DSPD_PCM_SBIT_PLAYBACK) != 0 && params.playback_device < 0 ) ||
-		  ((client->streams & DSPD_PCM_SBIT_CAPTURE) != 0 && params.capture_device < 0 )) )
-	    {
-	      s = 0;
-	      if ( params.playback_device != params.capture_device )
-		{
-		  if ( params.playback_device >= 0 )
-		    s |= DSPD_PCM_SBIT_PLAYBACK;
-		  if ( params.capture_device >= 0 )
-		    s |= DSPD_PCM_SBIT_CAPTURE;
-		}
-	      ret = dspd_stream_ctl(params.context, -1, DSPD_SOCKSRV_REQ_NMCLI, &s, sizeof(s), &o, sizeof(o), &br);
-	      if ( ret == 0 )
-		{
-		  if ( br == sizeof(o) )
-		    {
-		      if ( client->streams & DSPD_PCM_SBIT_PLAYBACK )
-			params.playback_stream = o >> 32U;
-		      if ( client->streams & DSPD_PCM_SBIT_CAPTURE )
-			params.capture_stream = o & 0xFFFFFFFFU;
-		      ret = dspd_pcmcli_bind(client, &params, DSPD_PCMCLI_BIND_AUTOCLOSE, NULL, NULL);
-		    } else
-		    {
-		      ret = -EPROTO;
-		    }
-		}
-	    }
-	}
+	ret = open_streams(client, &params);
     }
 
   if ( params.context )
@@ -2944,6 +3118,8 @@ int32_t dspd_pcmcli_hw_params_default(struct dspd_pcmcli *client, struct dspd_cl
       params->src_quality = 0; //default
       if ( ! dspd_aio_is_local(client->conn) )
 	params->flags |= DSPD_CLI_FLAG_SHM;
+      //Let the server convert playback samples while it mixes.
+      params->flags |= DSPD_CLI_FLAG_RAWFIFO;
 
     }
   return ret;
@@ -86,6 +86,9 @@ ssize_t dspd_pcmcli_write_frames(struct dspd_pcmcli *client, const void *data, s
 ssize_t dspd_pcmcli_write_bytes(struct dspd_pcmcli *client, const void *data, size_t bytes);
 ssize_t dspd_pcmcli_read_frames(struct dspd_pcmcli *client, void *data, size_t frames);
 ssize_t dspd_pcmcli_read_bytes(struct dspd_pcmcli *client, void *data, size_t bytes);
+bool dspd_pcmcli_can_mmap(struct dspd_pcmcli *client, int32_t stream);
+int32_t dspd_pcmcli_mmap_begin(struct dspd_pcmcli *client, int32_t stream, void **addr, uint32_t *frames);
+ssize_t dspd_pcmcli_mmap_commit(struct dspd_pcmcli *client, int32_t stream, uint32_t frames);
 
 
 int32_t dspd_pcmcli_get_status(struct dspd_pcmcli *client, int32_t stream, bool hwsync, struct dspd_pcmcli_status *status);
@@ -81,6 +81,7 @@ int32_t dspd_pcmcli_stream_attach(struct dspd_pcmcli_stream *stream,
   int32_t ret = 0;
   const struct pcm_conv *conv = NULL;
   size_t channels = 0;
+  bool raw;
   if ( ! (params->stream & stream->stream_flags) )
     {
       ret = -EINVAL;
@@ -126,8 +127,12 @@ int32_t dspd_pcmcli_stream_attach(struct dspd_pcmcli_stream *stream,
 		  ret = dspd_shm_get_addr(map, &addr);
 		  if ( ret == 0 )
 		    {
+		      //The server only leaves DSPD_CLI_FLAG_RAWFIFO set for playback.
+		      raw = (stream->stream_flags & DSPD_PCM_SBIT_PLAYBACK) &&
+			(params->flags & DSPD_CLI_FLAG_RAWFIFO);
 		      ret = dspd_fifo_init(&stream->fifo,
 					   params->bufsize,
+					   raw ? dspd_get_pcm_format_size(params->format) * channels :
 					   channels * sizeof(float),
 					   addr.addr);
 		      if ( ret == 0 )
@@ -135,12 +140,14 @@ int32_t dspd_pcmcli_stream_attach(struct dspd_pcmcli_stream *stream,
 			  stream->params = *params;
 			  stream->state = PCMCS_STATE_BOUND;
 			  if ( stream->stream_flags & DSPD_PCM_SBIT_PLAYBACK )
-			    stream->playback_conv = conv->tofloat32;
+			    stream->playback_conv = raw ? NULL : conv->tofloat32;
 			  else
 			    stream->capture_conv = conv->fromfloat32;
 			  stream->params = *params;
 			  stream->params.channels = channels;
 			  stream->params.xflags &= ~DSPD_CLI_XFLAG_FULLDUPLEX_CHANNELS;
+			  if ( ! raw )
+			    stream->params.flags &= ~DSPD_CLI_FLAG_RAWFIFO;
 			  stream->framesize = dspd_get_pcm_format_size(stream->params.format) * channels;
 			  stream->sample_time = 1000000000 / stream->params.rate;
 			  stream->xrun_threshold = stream->params.bufsize;
@@ -414,7 +421,18 @@ ssize_t dspd_pcmcli_stream_write(struct dspd_pcmcli_stream *stream,
 	      break;
 	    }
 	  DSPD_ASSERT(l <= (len - offset));
-	  if ( data )
+	  if ( stream->playback_conv == NULL )
+	    {
+	      //Raw fifo: the server converts while mixing.
+	      if ( data )
+		memcpy((char*)ptr + (off*stream->framesize),
+		       data+(offset*stream->framesize),
+		       stream->framesize * l);
+	      else
+		dspd_pcm_fill_silence(stream->params.format,
+				      (char*)ptr + (off*stream->framesize),
+				      stream->params.channels * l);
+	    } else if ( data )
 	    {
 	      stream->playback_conv(data+(offset*stream->framesize), 
 				    &ptr[off*stream->params.channels],
@@ -496,6 +514,79 @@ ssize_t dspd_pcmcli_stream_read(struct dspd_pcmcli_stream *stream,
 }
 
 
+/*
+  Direct access to the fifo.  The caller gets the contiguous part that can
+  be written (playback) or read (capture) without a conversion, fills or
+  drains it, then commits.  The fifo must hold the stream format, so this
+  only works for raw playback fifos and float32 capture.
+*/
+bool dspd_pcmcli_stream_can_mmap(const struct dspd_pcmcli_stream *stream)
+{
+  if ( stream->stream_flags & DSPD_PCM_SBIT_PLAYBACK )
+    return stream->playback_conv == NULL;
+  return stream->params.format == DSPD_PCM_FORMAT_FLOAT_NE;
+}
+
+int32_t dspd_pcmcli_stream_mmap_begin(struct dspd_pcmcli_stream *stream,
+				      void                     **addr,
+				      uint32_t                  *frames)
+{
+  int32_t ret;
+  uint32_t off, len = *frames;
+  void *ptr;
+  if ( stream->error )
+    {
+      ret = stream->error;
+    } else if ( stream->state < PCMCS_STATE_PREPARED )
+    {
+      ret = -EBADFD;
+    } else if ( ! dspd_pcmcli_stream_can_mmap(stream) )
+    {
+      //Not an error.  The caller has to use the read/write functions.
+      return -ENOTSUP;
+    } else if ( stream->stream_flags & DSPD_PCM_SBIT_PLAYBACK )
+    {
+      ret = dspd_fifo_wiov_ex(&stream->fifo, &ptr, &off, &len);
+    } else
+    {
+      ret = dspd_fifo_riov_ex(&stream->fifo, &ptr, &off, &len);
+    }
+  if ( ret == 0 )
+    {
+      *addr = (char*)ptr + (off * stream->framesize);
+      *frames = len;
+    }
+  check_error(stream, ret);
+  return ret;
+}
+
+ssize_t dspd_pcmcli_stream_mmap_commit(struct dspd_pcmcli_stream *stream, uint32_t frames)
+{
+  ssize_t ret;
+  if ( stream->error )
+    {
+      ret = stream->error;
+    } else if ( stream->state < PCMCS_STATE_PREPARED )
+    {
+      ret = -EBADFD;
+    } else
+    {
+      if ( stream->stream_flags & DSPD_PCM_SBIT_PLAYBACK )
+	{
+	  dspd_fifo_wcommit(&stream->fifo, frames);
+	  if ( stream->state == PCMCS_STATE_RUNNING && stream->write_size < stream->params.bufsize )
+	    stream->write_size += frames;
+	} else
+	{
+	  dspd_fifo_rcommit(&stream->fifo, frames);
+	}
+      stream->appl_ptr += frames;
+      ret = frames;
+    }
+  return ret;
+}
+
+
 int32_t dspd_pcmcli_stream_set_pointer(struct dspd_pcmcli_stream *stream, bool relative, uint64_t ptr)
 {
   int32_t ret;
@@ -833,3 +924,29 @@ int32_t dspd_pcmcli_stream_get_next_wakeup(struct dspd_pcmcli_stream *stream, co
     }
   return ret;
 }
+
+int32_t dspd_pcmcli_stream_wait_space(struct dspd_pcmcli_stream *stream, size_t avail, dspd_time_t abstime)
+{
+  int32_t ret;
+  if ( stream->error )
+    {
+      ret = stream->error;
+    } else if ( stream->state < PCMCS_STATE_PREPARED )
+    {
+      ret = -EBADF;
+    } else if ( ! (stream->stream_flags & DSPD_PCM_SBIT_PLAYBACK) )
+    {
+      ret = -EINVAL;
+    } else
+    {
+      if ( avail == 0 )
+	avail = 1;
+      else if ( avail > stream->params.bufsize )
+	avail = stream->params.bufsize;
+      ret = dspd_fifo_wait_space(&stream->fifo, avail, abstime);
+      if ( ret == -ETIMEDOUT || ret == -EINTR )
+	ret = 0;
+      check_error(stream, ret);
+    }
+  return ret;
+}
@@ -82,6 +82,11 @@ ssize_t dspd_pcmcli_stream_read(struct dspd_pcmcli_stream *stream,
 			   void                 *data,
 			   size_t                len);
 
+bool dspd_pcmcli_stream_can_mmap(const struct dspd_pcmcli_stream *stream);
+int32_t dspd_pcmcli_stream_mmap_begin(struct dspd_pcmcli_stream *stream,
+				      void                     **addr,
+				      uint32_t                  *frames);
+ssize_t dspd_pcmcli_stream_mmap_commit(struct dspd_pcmcli_stream *stream, uint32_t frames);
 
 int32_t dspd_pcmcli_stream_set_pointer(struct dspd_pcmcli_stream *stream, bool relative, uint64_t ptr);
 int32_t dspd_pcmcli_stream_rewind(struct dspd_pcmcli_stream *stream, uint64_t *frames);
@@ -101,4 +106,10 @@ int32_t dspd_pcmcli_stream_state(struct dspd_pcmcli_stream *stream);
 
 int32_t dspd_pcmcli_stream_get_next_wakeup(struct dspd_pcmcli_stream *stream, const struct dspd_pcmcli_status *status, size_t avail, dspd_time_t *next);
 
+/*
+  Sleep until a playback stream has avail frames of space or abstime passes.
+  The server wakes the stream up as soon as it reads enough.
+*/
+int32_t dspd_pcmcli_stream_wait_space(struct dspd_pcmcli_stream *stream, size_t avail, dspd_time_t abstime);
+
 #endif /*_DSPD_PCMCS_H_*/
@@ -711,7 +711,7 @@ int32_t dspd_rclient_attach(struct dspd_rclient *client,
   struct dspd_client_shm tmpshm;
   struct dspd_intrp *intrp;
   int shm_fd = -1;
-  size_t br;
+  size_t br, objsize;
   if ( params->stream == DSPD_PCM_SBIT_PLAYBACK )
     {
       map = &client->playback.shm;
@@ -833,9 +833,14 @@ int32_t dspd_rclient_attach(struct dspd_rclient *client,
     }
 
 
+  //A raw fifo holds client frames.
+  if ( params->flags & DSPD_CLI_FLAG_RAWFIFO )
+    objsize = stream->frame_size;
+  else
+    objsize = params->channels * sizeof(float);
   ret = dspd_fifo_init(&stream->fifo,
 		       params->bufsize,
-		       params->channels * sizeof(float),
+		       objsize,
 		       addr.addr);
   
   if ( ret )
@@ -845,8 +850,7 @@ int32_t dspd_rclient_attach(struct dspd_rclient *client,
     }
   DSPD_ASSERT(stream->fifo.data == addr.addr);
 
-  if ( addr.length < dspd_fifo_size(params->bufsize,
-				    params->channels * sizeof(float)) )
+  if ( addr.length < dspd_fifo_size(params->bufsize, objsize) )
     {
       ret = -EINVAL;
       goto out;
@@ -1041,7 +1045,17 @@ static int32_t rclient_write(struct dspd_rclient *client,
 			  &length);
   if ( ret == 0 )
     {
-      if ( buf )
+      if ( client->playback.params.flags & DSPD_CLI_FLAG_RAWFIFO )
+	{
+	  if ( buf )
+	    memcpy((char*)ptr + (offset * client->playback.frame_size),
+		   buf,
+		   length * client->playback.frame_size);
+	  else
+	    dspd_pcm_fill_silence(client->playback.params.format,
+				  (char*)ptr + (offset * client->playback.frame_size),
+				  client->playback.params.channels * length);
+	} else if ( buf )
 	{
 	  client->playback_conv(buf, 
 				&ptr[offset*client->playback.params.channels],
@@ -1305,10 +1319,23 @@ static int32_t dspd_rclient_wait_fd(struct dspd_rclient *client, dspd_time_t abs
   return ret;
 }
 
-static int32_t dspd_rclient_wait_nofd(struct dspd_rclient *client, dspd_time_t abstime)
+static int32_t dspd_rclient_wait_nofd(struct dspd_rclient *client, int32_t sbits, uint32_t avail_min, dspd_time_t abstime)
 {
   uint64_t waketime;
-  int ret = dspd_sleep(abstime, &waketime);
+  int ret;
+  /*
+    Playback can sleep on the fifo so the server wakes it up as soon as
+    there is space.  The timeout is still the estimated wakeup time.
+  */
+  if ( (sbits & DSPD_PCM_SBIT_PLAYBACK) && PLAYBACK_ENABLED(client) &&
+       ! ((sbits & DSPD_PCM_SBIT_CAPTURE) && CAPTURE_ENABLED(client)) )
+    {
+      ret = dspd_fifo_wait_space(&client->playback.fifo, avail_min, abstime);
+      if ( ret == -ETIMEDOUT || ret == -EINTR )
+	ret = 0;
+      return ret;
+    }
+  ret = dspd_sleep(abstime, &waketime);
   if ( ret == EINTR || ret == 0 )
     {
       if ( PLAYBACK_ENABLED(client) )
@@ -1500,7 +1527,7 @@ int32_t dspd_rclient_wait(struct dspd_rclient *client, int32_t sbits)
   if ( ret == 0 )
     {
       if ( client->eventfd < 0 )
-	ret = dspd_rclient_wait_nofd(client, t);
+	ret = dspd_rclient_wait_nofd(client, sbits, l ? l : client->swparams.avail_min, t);
       else
 	ret = dspd_rclient_wait_fd(client, t);
     }
@@ -50,6 +50,9 @@ static bool dspd_sched_run_slave_once(struct dspd_scheduler *sch);
 #define RESERVED_FD -2
 
 static void update_dl_latency(struct dspd_scheduler *sch, bool idle);
+static void record_cycle_cost(struct dspd_scheduler *sch);
+static void tune_dl_runtime(struct dspd_scheduler *sch);
+static dspd_time_t thread_cputime(void);
 
 
 static struct dspd_scheduler *get_slave(struct dspd_scheduler *sch, uintptr_t idx)
@@ -1094,8 +1097,14 @@ void *dspd_sched_run(void *arg)
     {
       if ( sch->ops->sleep(sch->udata, &abstime, &deadline, &reltime) )
 	{
-	  if ( sch->sched_policy == SCHED_DEADLINE && sch->dl_latency != sch->latency )
-	    update_dl_latency(sch, reltime == DSPD_SCHED_STOP);
+	  if ( sch->sched_policy == SCHED_DEADLINE )
+	    {
+	      record_cycle_cost(sch);
+	      if ( sch->dl_latency != sch->latency )
+		update_dl_latency(sch, reltime == DSPD_SCHED_STOP);
+	      else if ( reltime != DSPD_SCHED_STOP )
+		tune_dl_runtime(sch);
+	    }
 
 	  if ( reltime == DSPD_SCHED_STOP )
 	    {
@@ -1114,6 +1123,8 @@ void *dspd_sched_run(void *arg)
 	      if ( ret < 0 && errno != EINTR )
 		break;
 	    }
+	  if ( sch->sched_policy == SCHED_DEADLINE )
+	    sch->cycle_cputime = thread_cputime();
 	} else
 	{
 	  ret = 0;
@@ -1462,16 +1473,130 @@ void dspd_sched_set_timebase(struct dspd_scheduler *sched, int32_t t)
   sched->timebase = t;
 }
 
-static void update_dl_latency(struct dspd_scheduler *sch, bool idle)
+static int32_t set_dl_attr(struct dspd_scheduler *sch,
+			   dspd_time_t runtime,
+			   dspd_time_t deadline,
+			   dspd_time_t period)
 {
   struct sched_attr attr;
-  dspd_time_t l, l2;
+  int32_t ret;
   memset(&attr, 0, sizeof(attr));
   attr.size = sizeof(attr);
   attr.sched_flags = 0;
   attr.sched_nice = 0;
   attr.sched_priority = 0;
   attr.sched_policy = SCHED_DEADLINE;
+  attr.sched_runtime = runtime;
+  attr.sched_deadline = deadline;
+  attr.sched_period = period;
+  ret = dspd_sched_setattr(sch->tid, &attr, 0);
+  if ( ret == 0 )
+    {
+      sch->dl_runtime = runtime;
+      sch->dl_deadline = deadline;
+      sch->dl_period = period;
+    }
+  return ret;
+}
+
+static dspd_time_t thread_cputime(void)
+{
+  struct timespec ts;
+  if ( clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0 )
+    return 0;
+  return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void record_cycle_cost(struct dspd_scheduler *sch)
+{
+  dspd_time_t now, c;
+  if ( sch->cycle_cputime == 0 )
+    return;
+  now = thread_cputime();
+  if ( now > sch->cycle_cputime )
+    {
+      c = now - sch->cycle_cputime;
+      dspd_hist_add(&sch->cost_hist, c);
+      if ( c > sch->cost_max )
+	sch->cost_max = c;
+      sch->cost_cycles++;
+    }
+  sch->cycle_cputime = 0;
+}
+
+/*
+  Runtime needed for the measured cost.  The 99th percentile gets 50% extra and
+  the worst cycle in the window gets 25% extra, plus some slack for the
+  syscalls around the cycle.  It never goes above the deadline.  Without
+  any measurements the static value is used.
+*/
+#define DL_RUNTIME_SLACK 50000ULL
+#define DL_RUNTIME_MIN   100000ULL
+static dspd_time_t dl_runtime_target(const struct dspd_scheduler *sch,
+				     dspd_time_t deadline,
+				     dspd_time_t fallback)
+{
+  dspd_time_t p, m, r;
+  p = dspd_hist_percentile(&sch->cost_hist, 99.0);
+  if ( p == 0 )
+    return fallback;
+  p += p / 2ULL;
+  m = sch->cost_max + (sch->cost_max / 4ULL);
+  r = (p > m ? p : m) + DL_RUNTIME_SLACK;
+  if ( r < DL_RUNTIME_MIN )
+    r = DL_RUNTIME_MIN;
+  if ( r > deadline )
+    r = deadline;
+  return r;
+}
+
+/*
+  Renegotiate the runtime when the measured cost changes.  A cycle that used
+  more than 3/4 of the runtime raises it right away so the thread doesn't get
+  throttled when clients are added.  Lowering waits until the end of a window
+  and only happens when the new runtime is under 3/4 of the current one, so
+  a few clients coming and going don't cause a sched_setattr() every cycle.
+  The kernel may refuse more bandwidth (-EBUSY) if the admission test fails.
+  In that case try half of the increase once and don't ask for more until the
+  next window.
+*/
+static void tune_dl_runtime(struct dspd_scheduler *sch)
+{
+  dspd_time_t runtime;
+  bool window = sch->cost_cycles >= DSPD_SCHED_COST_WINDOW;
+  if ( sch->dl_runtime == 0 || sch->dl_latency == UINT64_MAX )
+    return;
+  if ( window )
+    sch->dl_refused = false;
+  if ( window || (sch->dl_refused == false && sch->cost_max > ((sch->dl_runtime * 3ULL) / 4ULL)) )
+    {
+      runtime = dl_runtime_target(sch, sch->dl_deadline, sch->dl_runtime);
+      if ( runtime > sch->dl_runtime )
+	{
+	  if ( set_dl_attr(sch, runtime, sch->dl_deadline, sch->dl_period) == -EBUSY )
+	    {
+	      sch->dl_refused = true;
+	      set_dl_attr(sch,
+			  sch->dl_runtime + ((runtime - sch->dl_runtime) / 2ULL),
+			  sch->dl_deadline,
+			  sch->dl_period);
+	    }
+	} else if ( window && runtime < ((sch->dl_runtime * 3ULL) / 4ULL) )
+	{
+	  set_dl_attr(sch, runtime, sch->dl_deadline, sch->dl_period);
+	}
+    }
+  if ( window )
+    {
+      dspd_hist_decay(&sch->cost_hist);
+      sch->cost_cycles = 0;
+      sch->cost_max = 0;
+    }
+}
+
+static void update_dl_latency(struct dspd_scheduler *sch, bool idle)
+{
+  dspd_time_t l, l2, runtime, deadline, period;
   if ( ! idle )
     {
       l = sch->latency >> 2;
@@ -1479,18 +1604,19 @@ static void update_dl_latency(struct dspd_scheduler *sch, bool idle)
 	l = 1024;
       else if ( l > 250000000ULL )
 	l = 250000000ULL;
-      attr.sched_runtime = l * 2ULL;
-      attr.sched_deadline = l * 3ULL;
-      attr.sched_period = l * 4ULL;
+      deadline = l * 3ULL;
+      period = l * 4ULL;
+      //Start from the measured cost if there is any.
+      runtime = dl_runtime_target(sch, deadline, l * 2ULL);
       l2 = sch->latency;
     } else
     {
       l = 1000000ULL; //1ms
-      attr.sched_period = l * 10UL; //10ms period
-      attr.sched_runtime = l;  //1ms run time
-      attr.sched_deadline = l * 2ULL; //2ms deadline
+      period = l * 10UL; //10ms period
+      runtime = l;  //1ms run time
+      deadline = l * 2ULL; //2ms deadline
       l2 = UINT64_MAX;
     }
-  if ( dspd_sched_setattr(sch->tid, &attr, 0) == 0 )
+  if ( set_dl_attr(sch, runtime, deadline, period) == 0 )
     sch->dl_latency = l2;
 }
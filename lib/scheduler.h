@@ -144,6 +144,18 @@ struct dspd_scheduler {
   dspd_time_t                      latency;
 
   dspd_time_t                      dl_latency;
+
+  //SCHED_DEADLINE runtime tuning.  The cpu time of each io cycle goes into a
+  //histogram.  The counts are halved every DSPD_SCHED_COST_WINDOW cycles so
+  //old clients age out.
+#define DSPD_SCHED_COST_WINDOW  256
+  struct dspd_hist                 cost_hist;
+  uint32_t                         cost_cycles;
+  dspd_time_t                      cost_max;
+  dspd_time_t                      cycle_cputime;
+  dspd_time_t                      dl_runtime, dl_deadline, dl_period;
+  //The kernel refused a bigger runtime.  Don't ask again until the next window.
+  bool                             dl_refused;
 };
 
 struct dspd_sched_params {
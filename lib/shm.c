@@ -18,7 +18,7 @@
  *
  */
 
-
+#define _GNU_SOURCE
 #include <sys/mman.h>
 #include <sys/stat.h>        /* For mode constants */
 #include <fcntl.h>
@@ -32,6 +32,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include "shm.h"
+#include "atomic.h"
 static int dspd_verify_section(const struct dspd_shm_map *map,
 			       const struct dspd_shm_section *sect,
 			       struct dspd_shm_addr *addr);
@@ -42,7 +43,8 @@ static int dspd_verify_section(const struct dspd_shm_map *map,
 static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 //static uid_t shm_user;
 #define SHM_NAME "dspd"
-#define SHM_ALIGN 16
+//Sections start on a cache line.  See DSPD_SHM_VERSION.
+#define SHM_ALIGN DSPD_CACHELINE_SIZE
 static int dspd_shm_open(int flags)
 {
   char name[33];
@@ -99,6 +101,105 @@ static int dspd_shm_open(int flags)
   return ret;
 }
 
+/*
+  Map a shared section and fault it in so the io thread never takes a page
+  fault on it.  Locking may fail because of RLIMIT_MEMLOCK.  The pages are
+  still populated in that case.
+*/
+static void *dspd_shm_map(int fd, size_t len, int prot)
+{
+  void *addr;
+  addr = mmap(NULL, len, prot, MAP_LOCKED | MAP_POPULATE | MAP_SHARED, fd, 0);
+  if ( addr == (void*)-1L )
+    {
+      addr = mmap(NULL, len, prot, MAP_POPULATE | MAP_SHARED, fd, 0);
+      if ( addr != (void*)-1L )
+	(void)mlock(addr, len);
+    }
+  return addr;
+}
+
+static size_t dspd_shm_hugepage_size(void)
+{
+  static size_t hpsize;
+  FILE *fp;
+  char line[128];
+  unsigned long kb;
+  pthread_mutex_lock(&lock);
+  if ( hpsize == 0 )
+    {
+      hpsize = 2UL * 1024UL * 1024UL;
+      fp = fopen("/proc/meminfo", "r");
+      if ( fp )
+	{
+	  while ( fgets(line, sizeof(line), fp) )
+	    {
+	      if ( sscanf(line, "Hugepagesize: %lu kB", &kb) == 1 && kb > 0 )
+		{
+		  hpsize = kb * 1024UL;
+		  break;
+		}
+	    }
+	  fclose(fp);
+	}
+    }
+  pthread_mutex_unlock(&lock);
+  return hpsize;
+}
+
+/*
+  Create and map a sealed memfd.  Huge pages are tried first.  They only work
+  if the administrator reserved some, so the fallback is a regular memfd with
+  MADV_HUGEPAGE.  That gets transparent huge pages if shmem_enabled allows it.
+  The length is updated if it was rounded up to a huge page.
+*/
+static void *dspd_shm_memfd(int prot, size_t *len, int *fd)
+{
+  void *addr = (void*)-1L;
+  size_t l;
+  int f;
+  const int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+  l = dspd_shm_hugepage_size();
+  l = ((*len + l - 1UL) / l) * l;
+  f = memfd_create(SHM_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB);
+  if ( f >= 0 )
+    {
+      if ( l <= UINT32_MAX &&
+	   ftruncate(f, l) == 0 &&
+	   fcntl(f, F_ADD_SEALS, seals) == 0 )
+	addr = dspd_shm_map(f, l, prot);
+      if ( addr == (void*)-1L )
+	close(f);
+    }
+  if ( addr == (void*)-1L )
+    {
+      l = *len;
+      f = memfd_create(SHM_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+      if ( f < 0 )
+	return NULL;
+      if ( ftruncate(f, l) == 0 &&
+	   fcntl(f, F_ADD_SEALS, seals) == 0 )
+	{
+	  addr = mmap(NULL, l, prot, MAP_SHARED, f, 0);
+	  if ( addr != (void*)-1L )
+	    {
+	      //Advise before faulting so the pages can be huge.  The caller
+	      //clears the memory, which faults in anything mlock() didn't.
+	      (void)madvise(addr, l, MADV_HUGEPAGE);
+	      (void)mlock(addr, l);
+	    }
+	}
+      if ( addr == (void*)-1L )
+	{
+	  close(f);
+	  return NULL;
+	}
+    }
+  *len = l;
+  *fd = f;
+  return addr;
+}
+
 //Returns 0 if arguments are invalid
 static size_t calculate_size(const struct dspd_shm_addr *sect,
 			     uint32_t nsect)
@@ -109,11 +210,12 @@ static size_t calculate_size(const struct dspd_shm_addr *sect,
   const struct dspd_shm_addr *sptr;
   size_t p = sysconf(_SC_PAGESIZE);
   ret += (sizeof(struct dspd_shm_section) * nsect);
+  ret = DSPD_CACHELINE_ALIGN(ret);
   for ( i = 0; i < nsect; i++ )
     {
       sptr = &sect[i];
       s = sptr->length / SHM_ALIGN;
-      if ( s % SHM_ALIGN )
+      if ( sptr->length % SHM_ALIGN )
 	s++;
       ret += (s * SHM_ALIGN);
     }
@@ -131,7 +233,7 @@ static void assign_sections(struct dspd_shm_header *hdr,
   uint32_t i, offset, l;
   const struct dspd_shm_addr *a;
   struct dspd_shm_section *o;
-  offset = sizeof(struct dspd_shm_header) + (naddr * sizeof(struct dspd_shm_section));
+  offset = DSPD_CACHELINE_ALIGN(sizeof(struct dspd_shm_header) + (naddr * sizeof(struct dspd_shm_section)));
   char *buf = (char*)hdr;
   for ( i = 0; i < naddr; i++ )
     {
@@ -178,52 +280,51 @@ int dspd_shm_create(struct dspd_shm_map *map,
   flags = map->flags;
   if ( map->flags & DSPD_SHM_FLAG_PRIVATE )
     {
-      addr = calloc(1, len);
-      if ( ! addr )
-	return errno;
+      //Page aligned like the mmap version so the sections are on cache lines.
+      ret = posix_memalign(&addr, sysconf(_SC_PAGESIZE), len);
+      if ( ret )
+	return -ret;
+      memset(addr, 0, len);
       fd = -1;
       flags = 0;
     } else
     {
       flags |= DSPD_SHM_FLAG_MMAP;
-      fd = dspd_shm_open(map->flags);
-      if ( fd >= 0 )
+      p = 0;
+      if ( map->flags & DSPD_SHM_FLAG_READ )
+	p |= PROT_READ;
+      if ( map->flags & DSPD_SHM_FLAG_WRITE )
+	p |= PROT_WRITE;
+      if ( map->flags & DSPD_SHM_FLAG_HUGEPAGE )
 	{
-	  if ( ftruncate(fd, len) == 0 )
+	  addr = dspd_shm_memfd(p, &len, &fd);
+	  if ( addr )
+	    flags |= DSPD_SHM_FLAG_MEMFD;
+	  else
 	    {
-	      p = 0;
-	      if ( map->flags & DSPD_SHM_FLAG_READ )
-		p |= PROT_READ;
-	      if ( map->flags & DSPD_SHM_FLAG_WRITE )
-		p |= PROT_WRITE;
-	      addr = mmap(NULL, 
-			  len, 
-			  p, 
-			  MAP_LOCKED | MAP_SHARED,
-			  fd,
-			  0);
-	      if ( addr == (void*)-1L )
-		addr = mmap(NULL, 
-			    len, 
-			    p, 
-			    MAP_SHARED,
-			    fd,
-			    0);
+	      flags &= ~DSPD_SHM_FLAG_HUGEPAGE;
+	      map->flags &= ~DSPD_SHM_FLAG_HUGEPAGE;
+	    }
+	}
+      if ( ! addr )
+	{
+	  fd = dspd_shm_open(map->flags);
+	  if ( fd >= 0 && ftruncate(fd, len) == 0 )
+	    {
+	      addr = dspd_shm_map(fd, len, p);
 	      if ( addr == (void*)-1L )
 		addr = NULL;
-	      
-	      if ( addr )
-		memset(addr, 0, len);
-		
 	    }
 	}
+      if ( addr )
+	memset(addr, 0, len);
     }
   if ( addr )
     {
       //fprintf(stderr, "SHM OK %ld\n", addr);
       assign_sections(addr, sect, nsect);
       map->addr = addr;
-      map->addr->version = 0;
+      map->addr->version = DSPD_SHM_VERSION;
       map->addr->length = len;
       map->addr->section_count = nsect;
       map->arg = fd;
@@ -257,19 +358,19 @@ static int dspd_shm_attach_mmap(struct dspd_shm_map *map)
     {
       if ( fi.st_size >= map->length )
 	{
-	  addr = mmap(NULL, 
-		      map->length,
-		      p,
-		      MAP_LOCKED | MAP_SHARED,
-		      map->arg,
-		      0);
-	  if ( addr == (void*)-1L )
-	    addr = mmap(NULL, 
-			map->length,
-			p,
-			MAP_SHARED,
-			map->arg,
-			0);
+	  /*
+	    A sealed memfd can't shrink under the io thread.  Don't trust
+	    the flag if the seals are missing.
+	  */
+	  if ( map->flags & DSPD_SHM_FLAG_MEMFD )
+	    {
+	      ret = fcntl(map->arg, F_GET_SEALS);
+	      if ( ret < 0 )
+		return -errno;
+	      if ( (ret & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW) )
+		return -EBADFD;
+	    }
+	  addr = dspd_shm_map(map->arg, map->length, p);
 	  if ( addr != (void*)-1L )
 	    {
 	      map->addr = addr;
@@ -318,6 +419,12 @@ int dspd_shm_attach(struct dspd_shm_map *map)
 	    {
 	      ret = dspd_shm_attach_private(map);
 	    } 
+	  /*
+	    The fifo and mbx layouts depend on the version.  The caller
+	    closes the map like it would for any other error.
+	  */
+	  if ( ret == 0 && map->addr->version != DSPD_SHM_VERSION )
+	    ret = -EPROTO;
 	}
     }
   return ret;
@@ -28,6 +28,14 @@ struct dspd_shm_addr {
   void      *addr;
 };
 
+/*
+  Layout of the shared memory sections.  Version 0 packed the fifo and
+  mbx control words together.  Version 1 puts sections, fifo pointers,
+  and mbx locks on separate cache lines.  Both sides must agree, so
+  dspd_shm_attach() fails with -EPROTO on a mismatch.
+*/
+#define DSPD_SHM_VERSION 1U
+
 struct dspd_shm_header {
   uint32_t                length;
   uint32_t                version;
@@ -43,6 +51,13 @@ struct dspd_shm_header {
 #define DSPD_SHM_FLAG_WRITE   8
 #define DSPD_SHM_FLAG_READ    16
 #define DSPD_SHM_FLAG_MEMFD   32
+/*
+  Ask for a sealed memfd backed by huge pages (MFD_HUGETLB) with a
+  fallback to a memfd that is advised to use transparent huge pages.
+  The section is created with MEMFD set if it worked.  The size can't
+  be changed after creation so a peer can't cause SIGBUS by truncating it.
+*/
+#define DSPD_SHM_FLAG_HUGEPAGE 64
 
 struct dspd_shm_map {
   int32_t                 arg;
@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <assert.h>
 #include "src.h"
+#include "src_poly.h"
 #include "util.h"
 struct dspd_bcr_params {
   const float  *inbuf;
@@ -37,6 +38,7 @@ struct dspd_bcr_params {
   unsigned int  frames_generated;
 };
 struct dspd_bcr_state {
+  struct dspd_builtin_src hdr;
   uint32_t iper, oper;
   uint32_t iclk, oclk;
   union {
@@ -53,6 +55,7 @@ struct dspd_bcr_state {
 		 size_t * __restrict gen);
 };
 static int default_quality = 0;
+static const struct dspd_src_ops bcr_ops;
 
 
 static void process_compress(struct dspd_bcr_state * __restrict st, 
@@ -189,6 +192,7 @@ static int32_t bcr_new(dspd_src_t *src,
     return -errno;
 
   st = (struct dspd_bcr_state*)ptr;
+  st->hdr.ops = &bcr_ops;
   st->data.last_sample = (float*)&ptr[offset];
 
 
@@ -228,6 +232,7 @@ static int32_t bcr_reset(dspd_src_t src)
   st->iclk = 0;
   st->oclk = 0;
   st->cont = 0;
+  st->n = 0;
   return 0;
 }
 
@@ -250,6 +255,31 @@ static int32_t bcr_process(dspd_src_t   src,
   return 0;
 }
 
+static int32_t bcr_process_v(dspd_src_t                             src,
+			     bool                                   eof,
+			     const struct dspd_src_iov * __restrict iov,
+			     size_t                                 niov,
+			     size_t                    * __restrict frames_in,
+			     float                     * __restrict outbuf,
+			     size_t                    * __restrict frames_out)
+{
+  struct dspd_bcr_state *st = src;
+  size_t i, fi, fo, itotal = 0, ototal = 0, olen = *frames_out;
+  for ( i = 0; i < niov && ototal < olen; i++ )
+    {
+      fi = iov[i].frames;
+      fo = olen - ototal;
+      st->process(st, iov[i].buf, &fi, &outbuf[ototal * st->channels], &fo);
+      itotal += fi;
+      ototal += fo;
+      if ( fi < iov[i].frames )
+	break;
+    }
+  *frames_in = itotal;
+  *frames_out = ototal;
+  return 0;
+}
+
 
 static void bcr_info(struct dspd_src_info *info)
 {
@@ -270,7 +300,7 @@ static void bcr_get_params(dspd_src_t src,
   *rate_out = 1000000000 / st->oper;
 }
 
-static const struct dspd_src_ops default_ops = {
+static const struct dspd_src_ops bcr_ops = {
   .init = NULL,
   .set_rates = bcr_set_rates,
   .reset = bcr_reset,
@@ -279,6 +309,121 @@ static const struct dspd_src_ops default_ops = {
   .freesrc = bcr_free,
   .info = bcr_info,
   .get_params = bcr_get_params,
+  .process_v = bcr_process_v,
+};
+
+/*
+  Generic versions for ops that only have process().  The frame size is
+  not known here, so process_v stops after the first segment that makes
+  output.  Callers already have to handle short reads, so that is fine.
+*/
+static int32_t generic_process_v(const struct dspd_src_ops *ops,
+				 dspd_src_t                 src,
+				 bool                       eof,
+				 const struct dspd_src_iov *iov,
+				 size_t                     niov,
+				 size_t                    *frames_in,
+				 float                     *outbuf,
+				 size_t                    *frames_out)
+{
+  size_t i, fi, fo = 0, itotal = 0;
+  int32_t ret = 0;
+  for ( i = 0; i < niov; i++ )
+    {
+      fi = iov[i].frames;
+      fo = *frames_out;
+      ret = ops->process(src, eof && i == (niov - 1), iov[i].buf, &fi, outbuf, &fo);
+      if ( ret < 0 )
+	{
+	  fo = 0;
+	  break;
+	}
+      itotal += fi;
+      if ( fo > 0 || fi < iov[i].frames )
+	break;
+    }
+  *frames_in = itotal;
+  *frames_out = fo;
+  return ret;
+}
+
+/*
+  The builtin resampler uses bcr for quality 0 and the polyphase resampler
+  for everything else.
+*/
+#define builtin_ops(_src) (((struct dspd_builtin_src*)(_src))->ops)
+
+static int32_t builtin_new(dspd_src_t *src,
+			   int quality,
+			   int channels)
+{
+  if ( quality <= 0 )
+    return bcr_ops.newsrc(src, quality, channels);
+  return dspd_src_poly_ops.newsrc(src, quality, channels);
+}
+
+static int32_t builtin_set_rates(dspd_src_t src, uint32_t in, uint32_t out)
+{
+  return builtin_ops(src)->set_rates(src, in, out);
+}
+
+static int32_t builtin_reset(dspd_src_t src)
+{
+  return builtin_ops(src)->reset(src);
+}
+
+static int32_t builtin_process(dspd_src_t   src,
+			       bool         eof,
+			       const float * __restrict inbuf,
+			       size_t      * __restrict frames_in,
+			       float       * __restrict outbuf,
+			       size_t      * __restrict frames_out)
+{
+  return builtin_ops(src)->process(src, eof, inbuf, frames_in, outbuf, frames_out);
+}
+
+static int32_t builtin_process_v(dspd_src_t                             src,
+				 bool                                   eof,
+				 const struct dspd_src_iov * __restrict iov,
+				 size_t                                 niov,
+				 size_t                    * __restrict frames_in,
+				 float                     * __restrict outbuf,
+				 size_t                    * __restrict frames_out)
+{
+  return builtin_ops(src)->process_v(src, eof, iov, niov, frames_in, outbuf, frames_out);
+}
+
+static int32_t builtin_free(dspd_src_t src)
+{
+  return builtin_ops(src)->freesrc(src);
+}
+
+static void builtin_info(struct dspd_src_info *info)
+{
+  strcpy(info->name, "DSPD Builtin Resampler");
+  info->max_quality = DSPD_SRC_POLY_MAX_QUALITY;
+  info->min_quality = 0;
+  info->step = 1;
+}
+
+static void builtin_get_params(dspd_src_t src,
+			       uint32_t *quality,
+			       uint32_t *rate_in,
+			       uint32_t *rate_out)
+{
+  builtin_ops(src)->get_params(src, quality, rate_in, rate_out);
+}
+
+static const struct dspd_src_ops default_ops = {
+  .init = NULL,
+  .set_rates = builtin_set_rates,
+  .reset = builtin_reset,
+  .process = builtin_process,
+  .newsrc = builtin_new,
+  .freesrc = builtin_free,
+  .info = builtin_info,
+  .get_params = builtin_get_params,
+  .process_v = builtin_process_v,
 };
 
 static const struct dspd_src_ops *current_ops = &default_ops;
@@ -301,6 +446,20 @@ int32_t dspd_src_process(dspd_src_t   src,
 {
   return current_ops->process(src, eof, inbuf, frames_in, outbuf, frames_out);
 }
+
+int32_t dspd_src_process_v(dspd_src_t                 src,
+			   bool                       eof,
+			   const struct dspd_src_iov *iov,
+			   size_t                     niov,
+			   size_t                    *frames_in,
+			   float                     *outbuf,
+			   size_t                    *frames_out)
+{
+  if ( current_ops->process_v )
+    return current_ops->process_v(src, eof, iov, niov, frames_in, outbuf, frames_out);
+  return generic_process_v(current_ops, src, eof, iov, niov, frames_in, outbuf, frames_out);
+}
+
 int dspd_src_init(const struct dspd_src_ops *ops)
 {
   int32_t ret;
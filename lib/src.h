@@ -9,6 +9,12 @@ struct dspd_src_info {
   uint32_t step; //Recommended step.  Resamplers will round according to this.
 };
 
+//One input segment for dspd_src_process_v()
+struct dspd_src_iov {
+  const float *buf;
+  size_t       frames;
+};
+
 uint64_t dspd_src_get_frame_count(uint64_t rate_in, uint64_t rate_out, uint64_t frames_in);
 
 int32_t dspd_src_set_rates(dspd_src_t src, int32_t in, int32_t out);
@@ -21,6 +27,18 @@ int32_t dspd_src_process(dspd_src_t   src,
 			 size_t      *frames_in,
 			 float       *outbuf,
 			 size_t      *frames_out);
+/*
+  Same as dspd_src_process() except the input is a list of segments, such
+  as both halves of a fifo that wrapped around.  Segments are used in order
+  and frames_in is the total number of frames used.
+*/
+int32_t dspd_src_process_v(dspd_src_t                 src,
+			   bool                       eof,
+			   const struct dspd_src_iov *iov,
+			   size_t                     niov,
+			   size_t                    *frames_in,
+			   float                     *outbuf,
+			   size_t                    *frames_out);
 int dspd_src_init(const struct dspd_src_ops *ops);
 int32_t dspd_src_new(dspd_src_t *newsrc, int quality, int channels);
 int32_t dspd_src_delete(dspd_src_t src);
@@ -56,6 +74,14 @@ struct dspd_src_ops {
 		     uint32_t *rate_out);
   void (*set_default_quality)(int q);
   int (*get_default_quality)(void);
+  //Optional.  The generic versions call process for each segment.
+  int32_t (*process_v)(dspd_src_t                             src,
+		       bool                                   eof,
+		       const struct dspd_src_iov * __restrict iov,
+		       size_t                                 niov,
+		       size_t                    * __restrict frames_in,
+		       float                     * __restrict outbuf,
+		       size_t                    * __restrict frames_out);
 };
 
 
@@ -0,0 +1,537 @@
+/*
+ *  SRC_POLY - Polyphase FIR sample rate conversion
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+  The conversion ratio is reduced to out/in = L/M and a windowed sinc filter is
+  split into L phases (or POLY_MAX_PHASES for odd ratios, in which case the
+  nearest phase is used).  The filter banks are shared by every stream with
+  the same ratio and quality, so the only per stream memory is the history.
+  History is kept one channel per row so each output sample is a straight
+  dot product that the SIMD kernels can handle.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include "pcm.h"
+#include "src_poly.h"
+
+#define POLY_MAX_PHASES 1024U
+//Input frames copied into the history at a time
+#define POLY_BLOCK 256U
+
+struct poly_quality {
+  uint32_t taps;   //Multiple of 8 for the SIMD kernels
+  double   cutoff; //Fraction of the lower Nyquist frequency
+  double   beta;   //Kaiser window
+};
+static const struct poly_quality poly_levels[DSPD_SRC_POLY_MAX_QUALITY + 1] = {
+  [1] = { .taps = 16,  .cutoff = 0.85, .beta = 5.0 },
+  [2] = { .taps = 32,  .cutoff = 0.90, .beta = 7.0 },
+  [3] = { .taps = 64,  .cutoff = 0.94, .beta = 8.5 },
+  [4] = { .taps = 128, .cutoff = 0.96, .beta = 10.0 },
+};
+
+typedef float (*poly_dot_t)(const float * __restrict x, const float * __restrict h, size_t n);
+
+struct poly_filter {
+  struct poly_filter *next;
+  uint32_t            refcnt;
+  uint32_t            l, m, quality;
+  uint32_t            phases;
+  uint32_t            taps;
+  poly_dot_t          dot;
+  float              *coeffs; //phases * taps
+};
+
+struct poly_state {
+  struct dspd_builtin_src hdr;
+  struct poly_filter *filter;
+  uint32_t            rate_in, rate_out;
+  uint32_t            quality;
+  uint32_t            channels;
+  uint32_t            taps;
+  //Position of the first tap, frames in the history, and the fractional position in 1/L units
+  size_t              pos, fill;
+  uint32_t            acc;
+  size_t              stride;
+  float              *hist;
+};
+
+static pthread_mutex_t filter_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct poly_filter *filter_cache;
+
+static float poly_dot_generic(const float * __restrict x, const float * __restrict h, size_t n)
+{
+  float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+  size_t i;
+  for ( i = 0; i < n; i += 4 )
+    {
+      a0 += x[i] * h[i];
+      a1 += x[i+1] * h[i+1];
+      a2 += x[i+2] * h[i+2];
+      a3 += x[i+3] * h[i+3];
+    }
+  return (a0 + a1) + (a2 + a3);
+}
+
+#if defined(__x86_64) || defined(i386)
+#include <immintrin.h>
+static __attribute__((target("sse2"))) float poly_dot_sse2(const float * __restrict x, const float * __restrict h, size_t n)
+{
+  __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+  float r[4];
+  size_t i;
+  for ( i = 0; i < n; i += 8 )
+    {
+      a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&h[i])));
+      a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(&x[i+4]), _mm_loadu_ps(&h[i+4])));
+    }
+  _mm_storeu_ps(r, _mm_add_ps(a0, a1));
+  return (r[0] + r[1]) + (r[2] + r[3]);
+}
+
+static __attribute__((target("avx2,fma"))) float poly_dot_avx2(const float * __restrict x, const float * __restrict h, size_t n)
+{
+  __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+  __m128 s;
+  size_t i;
+  for ( i = 0; (i + 16) <= n; i += 16 )
+    {
+      a0 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&h[i]), a0);
+      a1 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i+8]), _mm256_loadu_ps(&h[i+8]), a1);
+    }
+  if ( i < n )
+    a0 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&h[i]), a0);
+  a0 = _mm256_add_ps(a0, a1);
+  s = _mm_add_ps(_mm256_castps256_ps128(a0), _mm256_extractf128_ps(a0, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+static poly_dot_t poly_get_dot(void)
+{
+  int32_t isa = dspd_pcm_isa();
+  if ( isa == DSPD_PCM_ISA_AVX2 && __builtin_cpu_supports("fma") )
+    return poly_dot_avx2;
+  if ( isa == DSPD_PCM_ISA_SSE2 || isa == DSPD_PCM_ISA_AVX2 )
+    return poly_dot_sse2;
+  return poly_dot_generic;
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+static float poly_dot_neon(const float * __restrict x, const float * __restrict h, size_t n)
+{
+  float32x4_t a0 = vdupq_n_f32(0.0f), a1 = vdupq_n_f32(0.0f);
+  size_t i;
+  for ( i = 0; i < n; i += 8 )
+    {
+      a0 = vfmaq_f32(a0, vld1q_f32(&x[i]), vld1q_f32(&h[i]));
+      a1 = vfmaq_f32(a1, vld1q_f32(&x[i+4]), vld1q_f32(&h[i+4]));
+    }
+  return vaddvq_f32(vaddq_f32(a0, a1));
+}
+
+static poly_dot_t poly_get_dot(void)
+{
+  if ( dspd_pcm_isa() == DSPD_PCM_ISA_NEON )
+    return poly_dot_neon;
+  return poly_dot_generic;
+}
+#else
+static poly_dot_t poly_get_dot(void)
+{
+  return poly_dot_generic;
+}
+#endif
+
+//Zeroth order modified Bessel function of the first kind
+static double bessel_i0(double x)
+{
+  double sum = 1.0, term = 1.0, y = (x * x) / 4.0;
+  uint32_t k;
+  for ( k = 1; k < 64; k++ )
+    {
+      term *= y / ((double)k * (double)k);
+      sum += term;
+      if ( term < (sum * 1e-12) )
+	break;
+    }
+  return sum;
+}
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b)
+{
+  uint32_t t;
+  while ( b )
+    {
+      t = a % b;
+      a = b;
+      b = t;
+    }
+  return a;
+}
+
+static int32_t poly_filter_init(struct poly_filter *f)
+{
+  const struct poly_quality *q = &poly_levels[f->quality];
+  uint32_t p, j;
+  double fc, t, half, w, sum, x, ib;
+  float *c;
+  f->taps = q->taps;
+  f->phases = f->l > POLY_MAX_PHASES ? POLY_MAX_PHASES : f->l;
+  f->coeffs = calloc((size_t)f->phases * f->taps, sizeof(float));
+  if ( ! f->coeffs )
+    return -errno;
+  f->dot = poly_get_dot();
+  //Cut off below the lower of the two Nyquist frequencies (in input sample units).
+  fc = q->cutoff;
+  if ( f->l < f->m )
+    fc *= (double)f->l / (double)f->m;
+  half = f->taps / 2.0;
+  ib = bessel_i0(q->beta);
+  for ( p = 0; p < f->phases; p++ )
+    {
+      c = &f->coeffs[(size_t)p * f->taps];
+      sum = 0.0;
+      for ( j = 0; j < f->taps; j++ )
+	{
+	  //Tap j multiplies input sample n + j - (taps/2 - 1) for output time n + p/phases
+	  t = ((double)j - (half - 1.0)) - ((double)p / f->phases);
+	  x = t / half;
+	  if ( x <= -1.0 || x >= 1.0 )
+	    {
+	      w = 0.0;
+	    } else
+	    {
+	      w = bessel_i0(q->beta * sqrt(1.0 - (x * x))) / ib;
+	      if ( t != 0.0 )
+		w *= sin(M_PI * fc * t) / (M_PI * fc * t);
+	    }
+	  c[j] = w;
+	  sum += w;
+	}
+      //Unity gain at DC for every phase
+      if ( sum != 0.0 )
+	{
+	  for ( j = 0; j < f->taps; j++ )
+	    c[j] /= sum;
+	}
+    }
+  return 0;
+}
+
+static void poly_filter_put(struct poly_filter *f)
+{
+  struct poly_filter **p;
+  if ( ! f )
+    return;
+  pthread_mutex_lock(&filter_lock);
+  f->refcnt--;
+  if ( f->refcnt == 0 )
+    {
+      for ( p = &filter_cache; *p; p = &(*p)->next )
+	{
+	  if ( *p == f )
+	    {
+	      *p = f->next;
+	      break;
+	    }
+	}
+    } else
+    {
+      f = NULL;
+    }
+  pthread_mutex_unlock(&filter_lock);
+  if ( f )
+    {
+      free(f->coeffs);
+      free(f);
+    }
+}
+
+//Get a shared filter bank for the ratio and quality, creating it if necessary.
+static int32_t poly_filter_get(struct poly_filter **filter, uint32_t in, uint32_t out, uint32_t quality)
+{
+  struct poly_filter *f;
+  uint32_t g = gcd_u32(in, out), l = out / g, m = in / g;
+  int32_t ret = 0;
+  pthread_mutex_lock(&filter_lock);
+  for ( f = filter_cache; f; f = f->next )
+    {
+      if ( f->l == l && f->m == m && f->quality == quality )
+	{
+	  f->refcnt++;
+	  break;
+	}
+    }
+  if ( ! f )
+    {
+      f = calloc(1, sizeof(*f));
+      if ( ! f )
+	{
+	  ret = -errno;
+	} else
+	{
+	  f->l = l;
+	  f->m = m;
+	  f->quality = quality;
+	  ret = poly_filter_init(f);
+	  if ( ret == 0 )
+	    {
+	      f->refcnt = 1;
+	      f->next = filter_cache;
+	      filter_cache = f;
+	    } else
+	    {
+	      free(f);
+	      f = NULL;
+	    }
+	}
+    }
+  pthread_mutex_unlock(&filter_lock);
+  *filter = f;
+  return ret;
+}
+
+static int32_t poly_reset(dspd_src_t src)
+{
+  struct poly_state *st = src;
+  memset(st->hist, 0, st->stride * st->channels * sizeof(float));
+  //Start with enough silence that the first output lines up with the first input.
+  st->fill = (st->taps / 2U) - 1U;
+  st->pos = 0;
+  st->acc = 0;
+  return 0;
+}
+
+static int32_t poly_set_rates(dspd_src_t src, uint32_t in, uint32_t out)
+{
+  struct poly_state *st = src;
+  struct poly_filter *f;
+  int32_t ret;
+  if ( in == 0 || out == 0 )
+    return -EINVAL;
+  if ( in == st->rate_in && out == st->rate_out && st->filter )
+    return 0;
+  ret = poly_filter_get(&f, in, out, st->quality);
+  if ( ret == 0 )
+    {
+      poly_filter_put(st->filter);
+      st->filter = f;
+      st->rate_in = in;
+      st->rate_out = out;
+      poly_reset(st);
+    }
+  return ret;
+}
+
+static int32_t poly_new(dspd_src_t *src, int quality, int channels)
+{
+  struct poly_state *st;
+  if ( channels <= 0 )
+    return -EINVAL;
+  if ( quality < DSPD_SRC_POLY_MIN_QUALITY )
+    quality = DSPD_SRC_POLY_MIN_QUALITY;
+  else if ( quality > DSPD_SRC_POLY_MAX_QUALITY )
+    quality = DSPD_SRC_POLY_MAX_QUALITY;
+  st = calloc(1, sizeof(*st));
+  if ( ! st )
+    return -errno;
+  st->hdr.ops = &dspd_src_poly_ops;
+  st->quality = quality;
+  st->channels = channels;
+  st->taps = poly_levels[quality].taps;
+  st->stride = st->taps + POLY_BLOCK;
+  st->hist = calloc(st->stride * channels, sizeof(float));
+  if ( ! st->hist )
+    {
+      free(st);
+      return -errno;
+    }
+  poly_reset(st);
+  *src = st;
+  return 0;
+}
+
+static int32_t poly_free(dspd_src_t src)
+{
+  struct poly_state *st = src;
+  poly_filter_put(st->filter);
+  free(st->hist);
+  free(st);
+  return 0;
+}
+
+//Make room in the history and copy (or skip) input.  Returns the number of input frames used.
+static size_t poly_load(struct poly_state *st, const float * __restrict in, size_t avail)
+{
+  size_t c, i, n;
+  float *h;
+  if ( st->pos >= st->fill )
+    {
+      st->pos -= st->fill;
+      st->fill = 0;
+    } else if ( st->pos > 0 )
+    {
+      n = st->fill - st->pos;
+      for ( c = 0; c < st->channels; c++ )
+	{
+	  h = &st->hist[c * st->stride];
+	  memmove(h, &h[st->pos], n * sizeof(float));
+	}
+      st->fill = n;
+      st->pos = 0;
+    }
+  if ( st->pos > 0 )
+    {
+      //Downsampling can step over input that is never used.
+      n = st->pos < avail ? st->pos : avail;
+      st->pos -= n;
+      return n;
+    }
+  n = st->stride - st->fill;
+  if ( n > avail )
+    n = avail;
+  for ( c = 0; c < st->channels; c++ )
+    {
+      h = &st->hist[(c * st->stride) + st->fill];
+      for ( i = 0; i < n; i++ )
+	h[i] = in[(i * st->channels) + c];
+    }
+  st->fill += n;
+  return n;
+}
+
+static size_t poly_run(struct poly_state *st,
+		       const struct poly_filter *f,
+		       const float * __restrict inbuf,
+		       size_t *frames_in,
+		       float * __restrict outbuf,
+		       size_t olen)
+{
+  size_t i = 0, o = 0, c, ilen = *frames_in, p;
+  const float *h;
+  float *out;
+  while ( o < olen )
+    {
+      if ( (st->pos + f->taps) > st->fill )
+	{
+	  if ( i == ilen )
+	    break;
+	  i += poly_load(st, &inbuf[i * st->channels], ilen - i);
+	  continue;
+	}
+      if ( f->phases == f->l )
+	h = &f->coeffs[(size_t)st->acc * f->taps];
+      else
+	{
+	  //Nearest phase.  The last one is as close as it gets before the next input frame.
+	  p = (((uint64_t)st->acc * f->phases) + (f->l / 2U)) / f->l;
+	  if ( p >= f->phases )
+	    p = f->phases - 1U;
+	  h = &f->coeffs[p * f->taps];
+	}
+      out = &outbuf[o * st->channels];
+      for ( c = 0; c < st->channels; c++ )
+	out[c] = f->dot(&st->hist[(c * st->stride) + st->pos], h, f->taps);
+      o++;
+      st->acc += f->m;
+      st->pos += st->acc / f->l;
+      st->acc %= f->l;
+    }
+  *frames_in = i;
+  return o;
+}
+
+static int32_t poly_process(dspd_src_t   src,
+			    bool         eof,
+			    const float * __restrict inbuf,
+			    size_t      * __restrict frames_in,
+			    float       * __restrict outbuf,
+			    size_t      * __restrict frames_out)
+{
+  struct poly_state *st = src;
+  if ( ! st->filter )
+    return -EINVAL;
+  *frames_out = poly_run(st, st->filter, inbuf, frames_in, outbuf, *frames_out);
+  return 0;
+}
+
+static int32_t poly_process_v(dspd_src_t                             src,
+			      bool                                   eof,
+			      const struct dspd_src_iov * __restrict iov,
+			      size_t                                 niov,
+			      size_t                    * __restrict frames_in,
+			      float                     * __restrict outbuf,
+			      size_t                    * __restrict frames_out)
+{
+  struct poly_state *st = src;
+  size_t i, fi, itotal = 0, ototal = 0, olen = *frames_out;
+  if ( ! st->filter )
+    return -EINVAL;
+  for ( i = 0; i < niov && ototal < olen; i++ )
+    {
+      fi = iov[i].frames;
+      ototal += poly_run(st, st->filter, iov[i].buf, &fi, &outbuf[ototal * st->channels], olen - ototal);
+      itotal += fi;
+      if ( fi < iov[i].frames )
+	break;
+    }
+  *frames_in = itotal;
+  *frames_out = ototal;
+  return 0;
+}
+
+static void poly_info(struct dspd_src_info *info)
+{
+  strcpy(info->name, "DSPD Polyphase Resampler");
+  info->max_quality = DSPD_SRC_POLY_MAX_QUALITY;
+  info->min_quality = DSPD_SRC_POLY_MIN_QUALITY;
+  info->step = 1;
+}
+
+static void poly_get_params(dspd_src_t src,
+			    uint32_t *quality,
+			    uint32_t *rate_in,
+			    uint32_t *rate_out)
+{
+  struct poly_state *st = src;
+  *quality = st->quality;
+  *rate_in = st->rate_in;
+  *rate_out = st->rate_out;
+}
+
+const struct dspd_src_ops dspd_src_poly_ops = {
+  .init = NULL,
+  .set_rates = poly_set_rates,
+  .reset = poly_reset,
+  .process = poly_process,
+  .process_v = poly_process_v,
+  .newsrc = poly_new,
+  .freesrc = poly_free,
+  .info = poly_info,
+  .get_params = poly_get_params,
+};
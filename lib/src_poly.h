@@ -0,0 +1,21 @@
+#ifndef _DSPD_SRC_POLY_H_
+#define _DSPD_SRC_POLY_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "src.h"
+/*
+  Every builtin resampler object starts with this header so the builtin
+  ops in src.c can pass calls on to whichever implementation was chosen
+  when the object was created.
+*/
+struct dspd_builtin_src {
+  const struct dspd_src_ops *ops;
+};
+
+//Polyphase FIR quality levels.  Quality 0 is the linear "bcr" resampler.
+#define DSPD_SRC_POLY_MIN_QUALITY 1
+#define DSPD_SRC_POLY_MAX_QUALITY 4
+
+extern const struct dspd_src_ops dspd_src_poly_ops;
+#endif
@@ -54,8 +54,32 @@ enum dspd_ssctl_req {
 #define DSPD_SOCKSRV_CTLADDR_RAW    0
 #define DSPD_SOCKSRV_CTLADDR_SIMPLE 1
   DSPD_SOCKSRV_REQ_OPEN_BY_NAME,
+  DSPD_SOCKSRV_REQ_COMPOUND,
  };
 
+/*
+  A compound request is a list of sub-requests that the server runs in order
+  as if they were sent one at a time.  Each one is a struct socksrv_compound_req
+  followed by its input padded to DSPD_COMPOUND_ALIGN.  The reply has one
+  struct socksrv_compound_reply and padded output for each sub-request that
+  was run.  The server stops after the first error, so the last reply is the
+  one that failed.  Sub-requests can't send or receive file descriptors.
+*/
+#define DSPD_COMPOUND_MAX 16
+#define DSPD_COMPOUND_ALIGN(_n) (((_n) + 7U) & ~7U)
+struct socksrv_compound_req {
+  uint32_t req;
+  int32_t  stream;
+  uint32_t inbufsize;
+  uint32_t outbufsize;
+};
+struct socksrv_compound_reply {
+  uint32_t req;
+  int32_t  error;
+  uint32_t len;
+  uint32_t reserved;
+};
+
 struct socksrv_open_req {
   uint32_t sbits;
   uint32_t flags;
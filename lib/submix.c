@@ -0,0 +1,208 @@
+/*
+ *  SUBMIX - Shared resampler buses for playback clients
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "sslib.h"
+#include "submix.h"
+
+//Device frames to bus frames
+static inline uint64_t to_bus(const struct dspd_submix *bus, uint64_t frames)
+{
+  return (frames * bus->rate) / bus->dev_rate;
+}
+
+void dspd_submix_delete(struct dspd_submix *bus)
+{
+  if ( ! bus )
+    return;
+  if ( bus->src )
+    dspd_src_delete(bus->src);
+  free(bus->in);
+  free(bus->out);
+  free(bus);
+}
+
+int32_t dspd_submix_new(struct dspd_submix **bus,
+			uint32_t rate,
+			int32_t quality,
+			const struct dspd_drv_params *params)
+{
+  struct dspd_submix *b;
+  int32_t ret;
+  if ( rate == 0 || params->rate == 0 || params->channels == 0 )
+    return -EINVAL;
+  b = calloc(1, sizeof(*b));
+  if ( ! b )
+    return -errno;
+  b->rate = rate;
+  b->quality = quality;
+  b->dev_rate = params->rate;
+  b->channels = params->channels;
+  //A device cycle is never more than the buffer size.
+  b->in_frames = dspd_src_get_frame_count(b->dev_rate, b->rate, params->bufsize) + 2UL;
+  b->out_frames = params->bufsize * 2UL;
+  b->in = calloc(b->in_frames * b->channels, sizeof(*b->in));
+  b->out = calloc(b->out_frames * b->channels, sizeof(*b->out));
+  if ( ! (b->in && b->out) )
+    {
+      ret = -errno;
+      goto out;
+    }
+  ret = dspd_src_new(&b->src, quality, b->channels);
+  if ( ret < 0 )
+    {
+      b->src = NULL;
+      goto out;
+    }
+  ret = dspd_src_set_rates(b->src, b->rate, b->dev_rate);
+  if ( ret < 0 )
+    goto out;
+  b->cycle.precision = DSPD_MIX_PRECISION_FLOAT32;
+  b->cycle.rate = b->rate;
+  *bus = b;
+  return 0;
+
+ out:
+  dspd_submix_delete(b);
+  return ret;
+}
+
+static void submix_reset(struct dspd_submix *bus,
+			 const struct dspd_io_cycle *cycle,
+			 const struct dspd_pcm_status *status)
+{
+  uint64_t p;
+  dspd_src_reset(bus->src);
+  bus->out_len = 0;
+  bus->in_count = 0;
+  bus->out_count = 0;
+  //Clients remember bus pointers, so they only go backwards when the device restarts.
+  p = to_bus(bus, status->appl_ptr);
+  if ( cycle->start_count != bus->cycle.start_count || p > bus->status.appl_ptr )
+    bus->status.appl_ptr = p;
+  bus->cycle.start_count = cycle->start_count;
+}
+
+void dspd_submix_begin(struct dspd_submix *bus,
+		       const struct dspd_io_cycle *cycle,
+		       const struct dspd_pcm_status *status)
+{
+  size_t n = 0;
+  uint64_t queued, delay, sent;
+  if ( cycle->start_count != bus->cycle.start_count || status->appl_ptr != bus->dev_ptr )
+    submix_reset(bus, cycle, status);
+  if ( cycle->addr && cycle->len > bus->out_len )
+    {
+      //Ask for an extra frame so the resampler does not come up short.  Leftovers are used next time.
+      n = dspd_src_get_frame_count(bus->dev_rate, bus->rate, cycle->len - bus->out_len) + 1UL;
+      if ( n > bus->in_frames )
+	n = bus->in_frames;
+      memset(bus->in, 0, n * bus->channels * sizeof(*bus->in));
+    }
+
+  /*
+    Bus frames still inside the resampler or waiting in the output buffer
+    are just as late as the ones in the device buffer, so the delay seen by
+    the clients includes both.
+  */
+  sent = to_bus(bus, bus->out_count);
+  if ( bus->in_count > sent )
+    queued = bus->in_count - sent;
+  else
+    queued = 0;
+  delay = queued;
+  if ( status->delay > 0 )
+    delay += to_bus(bus, status->delay);
+  bus->status.tstamp = status->tstamp;
+  bus->status.delay = delay;
+  bus->status.fill = delay;
+  if ( bus->status.appl_ptr > delay )
+    bus->status.hw_ptr = bus->status.appl_ptr - delay;
+  else
+    bus->status.hw_ptr = 0;
+  bus->status.space = to_bus(bus, status->space);
+  bus->status.error = status->error;
+  bus->status.cycle_length = 0;
+
+  bus->cycle.addr = bus->in;
+  bus->cycle.len = n;
+  bus->cycle.offset = 0;
+  bus->cycle.remaining = n;
+  if ( cycle->remaining > cycle->len )
+    bus->cycle.remaining += to_bus(bus, cycle->remaining - cycle->len);
+}
+
+void dspd_submix_end(struct dspd_submix *bus,
+		     const struct dspd_io_cycle *cycle,
+		     const struct dspd_pcm_status *status)
+{
+  size_t fi, fo, o = 0, i, n, offset;
+  const float *in;
+  if ( ! (cycle->addr && cycle->len) )
+    return;
+  while ( o < bus->cycle.len && bus->out_len < bus->out_frames )
+    {
+      fi = bus->cycle.len - o;
+      fo = bus->out_frames - bus->out_len;
+      if ( dspd_src_process(bus->src,
+			    false,
+			    &bus->in[o * bus->channels],
+			    &fi,
+			    &bus->out[bus->out_len * bus->channels],
+			    &fo) < 0 )
+	break;
+      if ( fi == 0 && fo == 0 )
+	break;
+      o += fi;
+      bus->out_len += fo;
+    }
+  bus->in_count += o;
+  bus->status.appl_ptr += bus->cycle.len;
+
+  n = bus->out_len;
+  if ( n > cycle->len )
+    n = cycle->len;
+  in = bus->out;
+  //The resampler holds back a few frames at first.  Start a little late instead of leaving a hole.
+  offset = cycle->offset;
+  if ( bus->out_count == 0 )
+    offset += cycle->len - n;
+  if ( cycle->precision == DSPD_MIX_PRECISION_FLOAT32 )
+    {
+      float *out = &((float*)cycle->addr)[offset * bus->channels];
+      for ( i = 0; i < n * bus->channels; i++ )
+	out[i] += in[i];
+    } else
+    {
+      double *out = &((double*)cycle->addr)[offset * bus->channels];
+      for ( i = 0; i < n * bus->channels; i++ )
+	out[i] += in[i];
+    }
+  bus->out_len -= n;
+  if ( bus->out_len > 0 )
+    memmove(bus->out, &bus->out[n * bus->channels], bus->out_len * bus->channels * sizeof(*bus->out));
+  bus->out_count += n;
+  bus->dev_ptr = status->appl_ptr + cycle->len;
+  bus->cycle.len = 0;
+}
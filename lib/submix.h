@@ -0,0 +1,51 @@
+#ifndef _DSPD_SUBMIX_H_
+#define _DSPD_SUBMIX_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+/*
+  Playback clients with the same sample rate and resampler quality are mixed
+  at their own rate and then resampled once.  To the clients a bus looks like
+  a device running at their rate: it has its own io cycle and status and the
+  pointers count bus frames.  Bus clients can not be rewound.
+*/
+struct dspd_submix {
+  uint32_t               rate;
+  int32_t                quality;
+  uint32_t               dev_rate;
+  uint32_t               channels;
+  dspd_src_t             src;
+  //Bus rate mix buffer
+  float                 *in;
+  size_t                 in_frames;
+  //Resampled frames that did not fit in the last device cycle
+  float                 *out;
+  size_t                 out_frames;
+  size_t                 out_len;
+  //Bus frames resampled and device frames written since the last reset
+  uint64_t               in_count;
+  uint64_t               out_count;
+  //Device application pointer expected by the next cycle
+  uint64_t               dev_ptr;
+  //Silent cycles left to flush the resampler after the last client stops
+  uint32_t               drain;
+  //Device cycle when a client last used this bus
+  uint64_t               last_used;
+  struct dspd_io_cycle   cycle;
+  struct dspd_pcm_status status;
+};
+
+int32_t dspd_submix_new(struct dspd_submix **bus,
+			uint32_t rate,
+			int32_t quality,
+			const struct dspd_drv_params *params);
+void dspd_submix_delete(struct dspd_submix *bus);
+//Set up the bus cycle and status for the current device cycle and clear the mix buffer.
+void dspd_submix_begin(struct dspd_submix *bus,
+		       const struct dspd_io_cycle *cycle,
+		       const struct dspd_pcm_status *status);
+//Resample the bus and add it to the device buffer.
+void dspd_submix_end(struct dspd_submix *bus,
+		     const struct dspd_io_cycle *cycle,
+		     const struct dspd_pcm_status *status);
+#endif
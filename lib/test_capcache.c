@@ -0,0 +1,298 @@
+#include "sslib.h"
+#include "capcache.h"
+
+/*
+  Capture clients share channel map conversions through the cache.  Each
+  client fills its own fifo like capture_xfer() does, copying or resampling
+  the cached frames when it gets them and converting by itself when it
+  doesn't.  A reference client with the same map always converts by itself
+  and both fifos must end up the same.
+*/
+
+#define TEST_CHANNELS 4U
+#define TEST_OCHAN    2U
+#define TEST_BUFSIZE  1024U
+#define TEST_FRAGSIZE 256U
+#define TEST_CYCLES   16U
+#define TEST_FIFOLEN  (TEST_FRAGSIZE * TEST_CYCLES * 2U)
+#define TEST_MAPS     (DSPD_CAPCACHE_SLOTS + 1U)
+
+static const uint32_t test_maps[TEST_MAPS][TEST_CHANNELS] = {
+  { 0, 1, 0, 1 },
+  { 1, 0, 1, 0 },
+  { 0, 0, 1, 1 },
+  { 1, 1, 0, 0 },
+  { 0, 1, 1, 0 },
+};
+
+static float devbuf[TEST_BUFSIZE * TEST_CHANNELS];
+
+struct test_client {
+  struct dspd_pcm_chmap_container map;
+  struct dspd_fifo_header        *fifo;
+  dspd_src_t                      src;
+  bool                            cached;
+  size_t                          hits;
+  float                           tmp[TEST_BUFSIZE * TEST_OCHAN];
+  float                           out[TEST_BUFSIZE * TEST_OCHAN];
+};
+
+static void make_map(struct dspd_pcm_chmap_container *map, size_t idx)
+{
+  size_t i;
+  memset(map, 0, sizeof(*map));
+  map->map.ichan = TEST_CHANNELS;
+  map->map.ochan = TEST_OCHAN;
+  map->map.count = TEST_CHANNELS;
+  map->map.flags = DSPD_CHMAP_MATRIX;
+  for ( i = 0; i < TEST_CHANNELS; i++ )
+    map->map.pos[i] = test_maps[idx][i];
+}
+
+static void fill_devbuf(uint32_t cycle)
+{
+  size_t i;
+  for ( i = 0; i < ARRAY_SIZE(devbuf); i++ )
+    devbuf[i] = (float)(((cycle * 7919U) + i) % 2000U) / 1000.0f - 1.0f;
+}
+
+static void client_init(struct test_client *tc, size_t map, uint32_t rate, bool cached)
+{
+  memset(tc, 0, sizeof(*tc));
+  make_map(&tc->map, map);
+  tc->cached = cached;
+  DSPD_ASSERT(dspd_fifo_new(&tc->fifo, TEST_FIFOLEN, sizeof(float) * TEST_OCHAN, NULL) == 0);
+  if ( rate )
+    {
+      DSPD_ASSERT(dspd_src_new(&tc->src, 3, TEST_OCHAN) == 0);
+      DSPD_ASSERT(dspd_src_set_rates(tc->src, 48000, rate) == 0);
+    }
+}
+
+static void client_destroy(struct test_client *tc)
+{
+  if ( tc->src )
+    dspd_src_delete(tc->src);
+  dspd_fifo_delete(tc->fifo);
+}
+
+static void client_xfer(struct dspd_capcache *cache, struct test_client *tc, const float *buf, size_t frames)
+{
+  const float *in = NULL;
+  size_t fi, fo, offset = 0;
+  if ( tc->cached )
+    in = dspd_capcache_map(cache, &tc->map.map, dspd_pcm_chmap_read_buf, buf, frames);
+  if ( in )
+    {
+      tc->hits++;
+    } else
+    {
+      memset(tc->tmp, 0, frames * TEST_OCHAN * sizeof(*tc->tmp));
+      dspd_pcm_chmap_read_buf(&tc->map.map, buf, tc->tmp, frames, 1.0f);
+      in = tc->tmp;
+    }
+  if ( tc->src )
+    {
+      while ( offset < frames )
+	{
+	  fi = frames - offset;
+	  fo = TEST_BUFSIZE;
+	  DSPD_ASSERT(dspd_src_process(tc->src, false, &in[offset * TEST_OCHAN], &fi, tc->out, &fo) == 0);
+	  DSPD_ASSERT(dspd_fifo_write(tc->fifo, tc->out, fo) == (int32_t)fo || fo == 0);
+	  offset += fi;
+	}
+    } else
+    {
+      DSPD_ASSERT(dspd_fifo_write(tc->fifo, in, frames) == (int32_t)frames);
+    }
+}
+
+static void compare_fifos(struct test_client *a, struct test_client *b)
+{
+  uint32_t la, lb;
+  DSPD_ASSERT(dspd_fifo_len(a->fifo, &la) == 0);
+  DSPD_ASSERT(dspd_fifo_len(b->fifo, &lb) == 0);
+  DSPD_ASSERT(la == lb && la > 0);
+  DSPD_ASSERT(la <= TEST_BUFSIZE);
+  DSPD_ASSERT(dspd_fifo_read(a->fifo, a->out, la) == (int32_t)la);
+  DSPD_ASSERT(dspd_fifo_read(b->fifo, b->out, lb) == (int32_t)lb);
+  DSPD_ASSERT(memcmp(a->out, b->out, la * TEST_OCHAN * sizeof(float)) == 0);
+}
+
+static ssize_t find_slot(const struct dspd_capcache *cache, size_t map)
+{
+  struct dspd_pcm_chmap_container m;
+  size_t i, len;
+  make_map(&m, map);
+  len = dspd_pcm_chmap_sizeof(m.map.count, m.map.flags);
+  for ( i = 0; i < DSPD_CAPCACHE_SLOTS; i++ )
+    {
+      if ( cache->slots[i].maplen == len && memcmp(&cache->slots[i].map, &m, len) == 0 )
+	return i;
+    }
+  return -1;
+}
+
+/*
+  Two clients on one map, one alone on another and a resampling client on
+  the second map.  The first client of a map only converts by itself until
+  the cache has seen two clients.
+*/
+static void test_shared(void)
+{
+  struct dspd_capcache cache;
+  struct test_client *cli, *ref;
+  static const size_t maps[] = { 0, 0, 1, 1, 2 };
+  static const uint32_t rates[] = { 0, 0, 0, 44100, 0 };
+  size_t i, n = ARRAY_SIZE(maps);
+  uint32_t c;
+  cli = calloc(n * 2U, sizeof(*cli));
+  DSPD_ASSERT(cli != NULL);
+  ref = &cli[n];
+  DSPD_ASSERT(dspd_capcache_init(&cache, TEST_BUFSIZE, TEST_CHANNELS) == 0);
+  for ( i = 0; i < n; i++ )
+    {
+      client_init(&cli[i], maps[i], rates[i], true);
+      client_init(&ref[i], maps[i], rates[i], false);
+    }
+  for ( c = 0; c < TEST_CYCLES; c++ )
+    {
+      fill_devbuf(c);
+      dspd_capcache_next_cycle(&cache);
+      for ( i = 0; i < n; i++ )
+	{
+	  client_xfer(&cache, &cli[i], devbuf, TEST_FRAGSIZE);
+	  client_xfer(&cache, &ref[i], devbuf, TEST_FRAGSIZE);
+	}
+      if ( (c % 4U) == 3U )
+	{
+	  for ( i = 0; i < n; i++ )
+	    compare_fifos(&cli[i], &ref[i]);
+	}
+    }
+  //The resampling client read from the cache every cycle.
+  DSPD_ASSERT(cli[0].hits == TEST_CYCLES - 1U);
+  DSPD_ASSERT(cli[1].hits == TEST_CYCLES);
+  DSPD_ASSERT(cli[2].hits == TEST_CYCLES - 1U);
+  DSPD_ASSERT(cli[3].hits == TEST_CYCLES);
+  DSPD_ASSERT(cli[4].hits == 0);
+  for ( i = 0; i < n * 2U; i++ )
+    client_destroy(&cli[i]);
+  free(cli);
+  dspd_capcache_destroy(&cache);
+}
+
+static void expect_frames(const float *cached, const float *buf, size_t map, size_t frames)
+{
+  struct dspd_pcm_chmap_container m;
+  static float tmp[TEST_BUFSIZE * TEST_OCHAN];
+  make_map(&m, map);
+  memset(tmp, 0, frames * TEST_OCHAN * sizeof(*tmp));
+  dspd_pcm_chmap_read_buf(&m.map, buf, tmp, frames, 1.0f);
+  DSPD_ASSERT(memcmp(cached, tmp, frames * TEST_OCHAN * sizeof(*tmp)) == 0);
+}
+
+/*
+  Later clients that want more frames extend what is cached without
+  converting the start again.  A client somewhere else in the device buffer
+  converts by itself.
+*/
+static void test_extend(void)
+{
+  struct dspd_capcache cache;
+  struct dspd_pcm_chmap_container m;
+  static float saved[TEST_BUFSIZE * TEST_CHANNELS];
+  const float *p, *q;
+  DSPD_ASSERT(dspd_capcache_init(&cache, TEST_BUFSIZE, TEST_CHANNELS) == 0);
+  make_map(&m, 0);
+  fill_devbuf(0);
+  memcpy(saved, devbuf, sizeof(saved));
+  dspd_capcache_next_cycle(&cache);
+  DSPD_ASSERT(dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 64) == NULL);
+  p = dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 128);
+  DSPD_ASSERT(p != NULL);
+  expect_frames(p, devbuf, 0, 128);
+
+  //Frames that were already converted must not be converted again.
+  fill_devbuf(1);
+  memcpy(&devbuf[128U * TEST_CHANNELS], &saved[128U * TEST_CHANNELS], (TEST_BUFSIZE - 128U) * TEST_CHANNELS * sizeof(float));
+  q = dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 512);
+  DSPD_ASSERT(q == p);
+  expect_frames(q, saved, 0, 512);
+  q = dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 32);
+  DSPD_ASSERT(q == p);
+  DSPD_ASSERT(cache.slots[find_slot(&cache, 0)].frames == 512);
+
+  DSPD_ASSERT(dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, &devbuf[64U * TEST_CHANNELS], 64) == NULL);
+
+  //A new cycle starts over.
+  fill_devbuf(2);
+  dspd_capcache_next_cycle(&cache);
+  p = dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 256);
+  DSPD_ASSERT(p != NULL);
+  expect_frames(p, devbuf, 0, 256);
+
+  //The cache doesn't have room for this many output channels.
+  m.map.ochan = TEST_CHANNELS * 2U;
+  DSPD_ASSERT(dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 256) == NULL);
+  DSPD_ASSERT(dspd_capcache_map(&cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, 256) == NULL);
+  dspd_capcache_destroy(&cache);
+}
+
+//Two lookups for a map in the current cycle.  The second one must hit.
+static void lookup_twice(struct dspd_capcache *cache, size_t map, bool first_hits)
+{
+  struct dspd_pcm_chmap_container m;
+  const float *p;
+  make_map(&m, map);
+  p = dspd_capcache_map(cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, TEST_FRAGSIZE);
+  DSPD_ASSERT((p != NULL) == first_hits);
+  p = dspd_capcache_map(cache, &m.map, dspd_pcm_chmap_read_buf, devbuf, TEST_FRAGSIZE);
+  DSPD_ASSERT(p != NULL);
+  expect_frames(p, devbuf, map, TEST_FRAGSIZE);
+}
+
+//One more map than there are slots.  The map that went unused the longest is replaced.
+static void test_evict(void)
+{
+  struct dspd_capcache cache;
+  size_t i;
+  DSPD_ASSERT(dspd_capcache_init(&cache, TEST_BUFSIZE, TEST_CHANNELS) == 0);
+  fill_devbuf(0);
+  dspd_capcache_next_cycle(&cache);
+  for ( i = 0; i < DSPD_CAPCACHE_SLOTS; i++ )
+    lookup_twice(&cache, i, false);
+  for ( i = 0; i < DSPD_CAPCACHE_SLOTS; i++ )
+    DSPD_ASSERT(find_slot(&cache, i) >= 0);
+
+  fill_devbuf(1);
+  dspd_capcache_next_cycle(&cache);
+  for ( i = 1; i < DSPD_CAPCACHE_SLOTS; i++ )
+    lookup_twice(&cache, i, true);
+  lookup_twice(&cache, TEST_MAPS - 1U, false);
+  DSPD_ASSERT(find_slot(&cache, 0) < 0);
+  for ( i = 1; i < TEST_MAPS; i++ )
+    DSPD_ASSERT(find_slot(&cache, i) >= 0);
+
+  //No map is used two cycles in a row, so the slots keep getting replaced.
+  dspd_capcache_next_cycle(&cache);
+  for ( i = 0; i < TEST_CYCLES; i++ )
+    {
+      fill_devbuf(i + 2U);
+      dspd_capcache_next_cycle(&cache);
+      lookup_twice(&cache, i % TEST_MAPS, false);
+      lookup_twice(&cache, (i + 2U) % TEST_MAPS, false);
+    }
+  dspd_capcache_destroy(&cache);
+}
+
+int main(void)
+{
+  printf("Testing capture cache...");
+  fflush(stdout);
+  test_shared();
+  test_extend();
+  test_evict();
+  printf("OK\n");
+  return 0;
+}
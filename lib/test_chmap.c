@@ -412,6 +412,118 @@ void test_chmap_translate(void)
 }
 
 
+/*
+  Compare the fused write kernels with the generic routines.  The downmix
+  kernels sum in a different order so allow a little rounding error.
+*/
+static void check_write(const struct dspd_pcm_chmap *map, dspd_chmap_write_t generic, dspd_chmap_write32_t generic32)
+{
+  float in[64UL * 8UL];
+  double ref[64UL * 8UL], out[64UL * 8UL];
+  float ref32[64UL * 8UL], out32[64UL * 8UL];
+  size_t i, frames = 61UL, n = frames * map->ochan;
+  dspd_chmap_write_t w = dspd_pcm_chmap_get_write_buf(map);
+  dspd_chmap_write32_t w32 = dspd_pcm_chmap_get_write_buf32(map);
+  DSPD_ASSERT(w != NULL && w32 != NULL);
+  for ( i = 0; i < ARRAY_SIZE(in); i++ )
+    in[i] = (float)((i * 37UL) % 101UL) / 50.0f - 1.0f;
+  for ( i = 0; i < ARRAY_SIZE(ref); i++ )
+    {
+      ref[i] = out[i] = (double)(i % 7UL) / 10.0;
+      ref32[i] = out32[i] = ref[i];
+    }
+  generic(map, in, ref, frames, 0.75);
+  w(map, in, out, frames, 0.75);
+  generic32(map, in, ref32, frames, 0.75);
+  w32(map, in, out32, frames, 0.75);
+  for ( i = 0; i < ARRAY_SIZE(ref); i++ )
+    {
+      if ( i >= n )
+	{
+	  //Must not write past the end
+	  DSPD_ASSERT(out[i] == ref[i] && out32[i] == ref32[i]);
+	} else
+	{
+	  DSPD_ASSERT(fabs(out[i] - ref[i]) < 1e-9);
+	  DSPD_ASSERT(fabsf(out32[i] - ref32[i]) < 1e-5f);
+	}
+    }
+}
+
+void test_chmap_write(void)
+{
+  struct dspd_pcm_chmap_container m;
+  size_t i;
+  printf("Testing fused write kernels...");
+
+  //Identity (simple)
+  memset(&m, 0, sizeof(m));
+  m.map.flags = DSPD_CHMAP_SIMPLE;
+  m.map.ichan = m.map.ochan = m.map.count = 2;
+  check_write(&m.map, dspd_pcm_chmap_write_buf_simple, dspd_pcm_chmap_write_buf32_simple);
+
+  //Simple with fewer input channels
+  m.map.ichan = m.map.count = 1;
+  check_write(&m.map, dspd_pcm_chmap_write_buf_simple, dspd_pcm_chmap_write_buf32_simple);
+
+  //Stereo to stereo, swapped and identity
+  memset(&m, 0, sizeof(m));
+  m.map.flags = DSPD_CHMAP_MATRIX;
+  m.map.ichan = m.map.ochan = m.map.count = 2;
+  m.map.pos[0] = 1;
+  m.map.pos[1] = 0;
+  check_write(&m.map, dspd_pcm_chmap_write_buf, dspd_pcm_chmap_write_buf32);
+  m.map.pos[0] = 0;
+  m.map.pos[1] = 1;
+  check_write(&m.map, dspd_pcm_chmap_write_buf, dspd_pcm_chmap_write_buf32);
+
+  //Mono to stereo
+  memset(&m, 0, sizeof(m));
+  m.map.flags = DSPD_CHMAP_MATRIX | DSPD_CHMAP_MULTI;
+  m.map.ichan = 1;
+  m.map.ochan = 2;
+  m.map.count = 4;
+  m.map.pos[3] = 1;
+  check_write(&m.map, dspd_pcm_chmap_write_buf_multi, dspd_pcm_chmap_write_buf32_multi);
+
+  //Stereo to stereo with both channels in the center
+  m.map.ichan = 2;
+  m.map.count = 8;
+  m.map.pos[0] = 0; m.map.pos[1] = 0;
+  m.map.pos[2] = 0; m.map.pos[3] = 1;
+  m.map.pos[4] = 1; m.map.pos[5] = 0;
+  m.map.pos[6] = 1; m.map.pos[7] = 1;
+  check_write(&m.map, dspd_pcm_chmap_write_buf_multi, dspd_pcm_chmap_write_buf32_multi);
+
+  //5.1 to stereo: FL FR RL RR FC LFE with center in both and no LFE
+  memset(&m, 0, sizeof(m));
+  m.map.flags = DSPD_CHMAP_MATRIX | DSPD_CHMAP_MULTI;
+  m.map.ichan = 6;
+  m.map.ochan = 2;
+  static const uint32_t dm[] = { 0, 0, 1, 1, 2, 0, 3, 1, 4, 0, 4, 1 };
+  for ( i = 0; i < ARRAY_SIZE(dm); i++ )
+    m.map.pos[i] = dm[i];
+  m.map.count = ARRAY_SIZE(dm);
+  check_write(&m.map, dspd_pcm_chmap_write_buf_multi, dspd_pcm_chmap_write_buf32_multi);
+
+  //Plain 5.1 to stereo matrix
+  memset(&m, 0, sizeof(m));
+  m.map.flags = DSPD_CHMAP_MATRIX;
+  m.map.ichan = m.map.count = 6;
+  m.map.ochan = 2;
+  for ( i = 0; i < 6; i++ )
+    m.map.pos[i] = i % 2;
+  check_write(&m.map, dspd_pcm_chmap_write_buf, dspd_pcm_chmap_write_buf32);
+
+  //Something without a fused kernel
+  m.map.ochan = 3;
+  for ( i = 0; i < 6; i++ )
+    m.map.pos[i] = i % 3;
+  DSPD_ASSERT(dspd_pcm_chmap_get_write_buf(&m.map) == dspd_pcm_chmap_write_buf);
+  check_write(&m.map, dspd_pcm_chmap_write_buf, dspd_pcm_chmap_write_buf32);
+
+  printf("OK\n");
+}
 
 
 int main(void)
@@ -422,5 +534,6 @@ int main(void)
   test_chmap_index(); fflush(NULL);
   test_chmap_from_string(); fflush(NULL);
   test_chmap_translate(); fflush(NULL);
+  test_chmap_write(); fflush(NULL);
   return 0;
 }
@@ -0,0 +1,128 @@
+#include <pthread.h>
+#include "sslib.h"
+
+/*
+  A writer sleeps in dspd_fifo_wait_space() while another thread reads
+  like the device would.  The writer must wake up before its timeout
+  when the reader frees enough space, and must time out when it doesn't.
+  The layout and cached pointer checks make sure the shared memory layout
+  keeps the two sides on separate cache lines.
+*/
+
+#define TEST_FIFO_LEN  1024U
+#define TEST_AVAIL_MIN 256U
+#define TEST_CYCLES    200U
+
+static struct dspd_fifo_header *fifo;
+static volatile AO_t done;
+
+static void *reader(void *arg)
+{
+  uint32_t len;
+  while ( ! AO_load(&done) )
+    {
+      if ( dspd_fifo_len(fifo, &len) == 0 && len > 0 )
+	{
+	  if ( len > 64U )
+	    len = 64U;
+	  dspd_fifo_rcommit(fifo, len);
+	  dspd_fifo_wake(fifo);
+	}
+      usleep(100);
+    }
+  return NULL;
+}
+
+static void test_wakeup(void)
+{
+  pthread_t thr;
+  uint32_t i, space;
+  dspd_time_t t;
+  int32_t ret;
+  AO_store(&done, 0);
+  DSPD_ASSERT(pthread_create(&thr, NULL, reader, NULL) == 0);
+  for ( i = 0; i < TEST_CYCLES; i++ )
+    {
+      DSPD_ASSERT(dspd_fifo_space(fifo, &space) == 0);
+      dspd_fifo_wcommit(fifo, space);
+      //Long enough that a missed wakeup shows up as a timeout.
+      t = dspd_get_time() + 5000000000ULL;
+      ret = dspd_fifo_wait_space(fifo, TEST_AVAIL_MIN, t);
+      DSPD_ASSERT(ret == 0 || ret == -EINTR);
+      DSPD_ASSERT(dspd_get_time() < t);
+      DSPD_ASSERT(dspd_fifo_space(fifo, &space) == 0);
+      DSPD_ASSERT(ret == -EINTR || space >= TEST_AVAIL_MIN);
+    }
+  AO_store(&done, 1);
+  pthread_join(thr, NULL);
+}
+
+static void test_timeout(void)
+{
+  uint32_t space;
+  dspd_time_t t;
+  DSPD_ASSERT(dspd_fifo_space(fifo, &space) == 0);
+  dspd_fifo_wcommit(fifo, space);
+  t = dspd_get_time() + 10000000ULL;
+  DSPD_ASSERT(dspd_fifo_wait_space(fifo, 1, t) == -ETIMEDOUT);
+  DSPD_ASSERT(dspd_get_time() >= t);
+  //Already past
+  DSPD_ASSERT(dspd_fifo_wait_space(fifo, 1, 0) == -ETIMEDOUT);
+  dspd_fifo_rcommit(fifo, 1);
+  DSPD_ASSERT(dspd_fifo_wait_space(fifo, 1, 0) == 0);
+  dspd_fifo_set_error(fifo, EIO);
+  DSPD_ASSERT(dspd_fifo_wait_space(fifo, 1, 0) == -EIO);
+  dspd_fifo_set_error(fifo, 0);
+}
+
+static void test_layout(void)
+{
+  DSPD_ASSERT(offsetof(struct dspd_fifo_data, obj_out) - offsetof(struct dspd_fifo_data, obj_in) >= DSPD_CACHELINE_SIZE);
+  DSPD_ASSERT(offsetof(struct dspd_fifo_data, rate) - offsetof(struct dspd_fifo_data, obj_out) >= DSPD_CACHELINE_SIZE);
+  DSPD_ASSERT((offsetof(struct dspd_fifo_data, data) % DSPD_CACHELINE_SIZE) == 0);
+  DSPD_ASSERT(((uintptr_t)fifo->data % DSPD_CACHELINE_SIZE) == 0);
+  DSPD_ASSERT((sizeof(struct dspd_mbx_data) % DSPD_CACHELINE_SIZE) == 0);
+}
+
+//The cached pointers must never make the fifo look bigger than it is.
+static void test_cached(void)
+{
+  void *ptr;
+  uint32_t off, len, i;
+  for ( i = 0; i < TEST_FIFO_LEN * 4U; i += len )
+    {
+      len = 100U;
+      DSPD_ASSERT(dspd_fifo_wiov_ex(fifo, &ptr, &off, &len) == 0);
+      DSPD_ASSERT(len > 0);
+      DSPD_ASSERT(off == (i % TEST_FIFO_LEN));
+      dspd_fifo_wcommit(fifo, len);
+      DSPD_ASSERT(dspd_fifo_riov_ex(fifo, &ptr, &off, &len) == 0);
+      dspd_fifo_rcommit(fifo, len);
+    }
+  len = TEST_FIFO_LEN;
+  DSPD_ASSERT(dspd_fifo_wiov_ex(fifo, &ptr, &off, &len) == 0);
+  dspd_fifo_wcommit(fifo, len);
+  len = TEST_FIFO_LEN;
+  DSPD_ASSERT(dspd_fifo_riov_ex(fifo, &ptr, &off, &len) == 0);
+  DSPD_ASSERT(dspd_fifo_len(fifo, &i) == 0 && len <= i);
+  dspd_fifo_rcommit(fifo, i);
+  len = TEST_FIFO_LEN;
+  DSPD_ASSERT(dspd_fifo_riov_ex(fifo, &ptr, &off, &len) == 0 && len == 0);
+}
+
+int main(void)
+{
+  printf("Testing fifo...");
+  fflush(stdout);
+  DSPD_ASSERT(dspd_time_init() == 0);
+  DSPD_ASSERT(dspd_fifo_new(&fifo, TEST_FIFO_LEN, sizeof(float) * 2U, NULL) == 0);
+  test_layout();
+  test_cached();
+  dspd_fifo_reset(fifo);
+  test_wakeup();
+  dspd_fifo_reset(fifo);
+  test_timeout();
+  dspd_fifo_delete(fifo);
+  printf("OK\n");
+  return 0;
+}
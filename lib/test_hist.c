@@ -0,0 +1,91 @@
+#include "sslib.h"
+
+/*
+  Every value must land in a bucket whose limits hold it, the buckets must
+  cover the whole range without gaps, and the percentiles must stay within
+  one bucket width of the exact answer.
+*/
+
+static void test_buckets(void)
+{
+  uint64_t v, lo;
+  size_t b, prev = 0;
+  for ( v = 0; v < (1ULL << 34); v = v < 1024U ? v + 1U : v + (v / 7U) )
+    {
+      b = dspd_hist_bucket(v);
+      DSPD_ASSERT(b < DSPD_HIST_BUCKETS);
+      DSPD_ASSERT(b >= prev);
+      DSPD_ASSERT(v < dspd_hist_bucket_limit(b));
+      lo = b ? dspd_hist_bucket_limit(b - 1U) : 0;
+      DSPD_ASSERT(v >= lo);
+      prev = b;
+    }
+  DSPD_ASSERT(dspd_hist_bucket(UINT64_MAX) == DSPD_HIST_BUCKETS - 1U);
+  DSPD_ASSERT(dspd_hist_bucket_limit(DSPD_HIST_BUCKETS - 1U) == UINT64_MAX);
+  for ( b = 1; b < DSPD_HIST_BUCKETS; b++ )
+    DSPD_ASSERT(dspd_hist_bucket_limit(b) > dspd_hist_bucket_limit(b - 1U));
+}
+
+static void test_percentile(void)
+{
+  struct dspd_hist h;
+  uint64_t i, p;
+  memset(&h, 0, sizeof(h));
+  DSPD_ASSERT(dspd_hist_percentile(&h, 99.0) == 0);
+  //1us to 1ms like a cycle time
+  for ( i = 1; i <= 1000U; i++ )
+    dspd_hist_add(&h, i * 1000U);
+  DSPD_ASSERT(h.count == 1000U);
+  DSPD_ASSERT(h.max == 1000000U);
+  DSPD_ASSERT(h.sum == 500500000U);
+  p = dspd_hist_percentile(&h, 50.0);
+  DSPD_ASSERT(p >= 500000U && p <= 500000U + (500000U / 8U));
+  p = dspd_hist_percentile(&h, 99.0);
+  DSPD_ASSERT(p >= 990000U && p <= 1000000U);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 100.0) == 1000000U);
+  p = dspd_hist_percentile(&h, 0.0);
+  DSPD_ASSERT(p >= 1000U && p <= 1000U + (1000U / 8U));
+
+  //Small values are exact
+  memset(&h, 0, sizeof(h));
+  for ( i = 0; i < 100U; i++ )
+    dspd_hist_add(&h, i % 4U);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 25.0) == 0);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 26.0) == 1);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 100.0) == 3);
+}
+
+//Old values age out but the percentiles stay where they were.
+static void test_decay(void)
+{
+  struct dspd_hist h;
+  uint64_t i;
+  memset(&h, 0, sizeof(h));
+  for ( i = 0; i < 100U; i++ )
+    dspd_hist_add(&h, (i % 2U) ? 1000U : 2U);
+  dspd_hist_add(&h, 5U);
+  dspd_hist_decay(&h);
+  DSPD_ASSERT(h.count == 50U);
+  DSPD_ASSERT(h.buckets[dspd_hist_bucket(5U)] == 0);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 50.0) == 2U);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 100.0) >= 1000U);
+  dspd_hist_decay(&h);
+  dspd_hist_decay(&h);
+  dspd_hist_decay(&h);
+  dspd_hist_decay(&h);
+  dspd_hist_decay(&h);
+  dspd_hist_decay(&h);
+  DSPD_ASSERT(h.count == 0);
+  DSPD_ASSERT(dspd_hist_percentile(&h, 99.0) == 0);
+}
+
+int main(void)
+{
+  printf("Testing histograms...");
+  fflush(stdout);
+  test_buckets();
+  test_percentile();
+  test_decay();
+  printf("OK\n");
+  return 0;
+}
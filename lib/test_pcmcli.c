@@ -0,0 +1,116 @@
+#include "sslib.h"
+
+/*
+  Attach client streams to a private fifo like the server creates for them.
+  A stream that needs a format conversion can't be mapped, but asking must
+  not put it in an error state because the caller falls back to the normal
+  read and write functions.  A raw playback fifo must be mapped directly.
+*/
+
+#define TEST_BUFSIZE  256U
+#define TEST_CHANNELS 2U
+
+struct test_stream {
+  struct dspd_shm_map        shm;
+  struct dspd_pcmcli_stream  stream;
+};
+
+static void test_attach(struct test_stream *ts, int32_t sbit, int32_t format, int32_t flags)
+{
+  struct dspd_shm_addr addr[2];
+  struct dspd_cli_params params;
+  size_t frame_size;
+  memset(ts, 0, sizeof(*ts));
+  memset(&params, 0, sizeof(params));
+  params.format = format;
+  params.channels = TEST_CHANNELS;
+  params.rate = 48000;
+  params.bufsize = TEST_BUFSIZE;
+  params.fragsize = TEST_BUFSIZE / 4U;
+  params.stream = sbit;
+  params.flags = flags;
+  if ( flags & DSPD_CLI_FLAG_RAWFIFO )
+    frame_size = dspd_get_pcm_format_size(format) * TEST_CHANNELS;
+  else
+    frame_size = sizeof(float) * TEST_CHANNELS;
+
+  addr[0].length = dspd_fifo_size(TEST_BUFSIZE, frame_size);
+  addr[0].section_id = DSPD_CLIENT_SECTION_FIFO;
+  addr[0].addr = NULL;
+  addr[1].length = dspd_mbx_bufsize(sizeof(struct dspd_pcm_status));
+  addr[1].section_id = DSPD_CLIENT_SECTION_MBX;
+  addr[1].addr = NULL;
+  ts->shm.flags = DSPD_SHM_FLAG_PRIVATE | DSPD_SHM_FLAG_READ | DSPD_SHM_FLAG_WRITE;
+  DSPD_ASSERT(dspd_shm_create(&ts->shm, addr, 2) == 0);
+
+  DSPD_ASSERT(dspd_pcmcli_stream_init(&ts->stream, sbit) == 0);
+  DSPD_ASSERT(dspd_pcmcli_stream_attach(&ts->stream, &params, &ts->shm) == 0);
+  DSPD_ASSERT(dspd_pcmcli_stream_reset(&ts->stream) == 0);
+}
+
+static void test_detach(struct test_stream *ts)
+{
+  dspd_pcmcli_stream_destroy(&ts->stream);
+  dspd_shm_close(&ts->shm);
+}
+
+static void test_converted_playback(void)
+{
+  struct test_stream ts;
+  int16_t buf[TEST_BUFSIZE * TEST_CHANNELS];
+  void *addr = NULL;
+  uint32_t frames = TEST_BUFSIZE;
+  test_attach(&ts, DSPD_PCM_SBIT_PLAYBACK, DSPD_PCM_FORMAT_S16_NE, 0);
+  DSPD_ASSERT(dspd_pcmcli_stream_can_mmap(&ts.stream) == false);
+  DSPD_ASSERT(dspd_pcmcli_stream_mmap_begin(&ts.stream, &addr, &frames) == -ENOTSUP);
+  DSPD_ASSERT(ts.stream.error == 0);
+  DSPD_ASSERT(ts.stream.state == PCMCS_STATE_PREPARED);
+
+  memset(buf, 0, sizeof(buf));
+  DSPD_ASSERT(dspd_pcmcli_stream_write(&ts.stream, buf, TEST_BUFSIZE / 2U) == TEST_BUFSIZE / 2U);
+  DSPD_ASSERT(dspd_pcmcli_stream_write(&ts.stream, NULL, TEST_BUFSIZE / 2U) == TEST_BUFSIZE / 2U);
+  DSPD_ASSERT(ts.stream.appl_ptr == TEST_BUFSIZE);
+  test_detach(&ts);
+}
+
+static void test_converted_capture(void)
+{
+  struct test_stream ts;
+  int16_t buf[TEST_BUFSIZE * TEST_CHANNELS];
+  void *addr = NULL;
+  uint32_t frames = TEST_BUFSIZE;
+  test_attach(&ts, DSPD_PCM_SBIT_CAPTURE, DSPD_PCM_FORMAT_S16_NE, 0);
+  DSPD_ASSERT(dspd_pcmcli_stream_mmap_begin(&ts.stream, &addr, &frames) == -ENOTSUP);
+  DSPD_ASSERT(ts.stream.error == 0);
+  //Nothing was captured, which is not an error either.
+  DSPD_ASSERT(dspd_pcmcli_stream_read(&ts.stream, buf, TEST_BUFSIZE) == -EAGAIN);
+  DSPD_ASSERT(ts.stream.error == 0);
+  test_detach(&ts);
+}
+
+static void test_raw_playback(void)
+{
+  struct test_stream ts;
+  void *addr = NULL;
+  uint32_t frames = TEST_BUFSIZE;
+  test_attach(&ts, DSPD_PCM_SBIT_PLAYBACK, DSPD_PCM_FORMAT_S16_NE, DSPD_CLI_FLAG_RAWFIFO);
+  DSPD_ASSERT(dspd_pcmcli_stream_can_mmap(&ts.stream) == true);
+  DSPD_ASSERT(dspd_pcmcli_stream_mmap_begin(&ts.stream, &addr, &frames) == 0);
+  DSPD_ASSERT(addr != NULL);
+  DSPD_ASSERT(frames == TEST_BUFSIZE);
+  memset(addr, 0, frames * sizeof(int16_t) * TEST_CHANNELS);
+  DSPD_ASSERT(dspd_pcmcli_stream_mmap_commit(&ts.stream, frames) == TEST_BUFSIZE);
+  DSPD_ASSERT(ts.stream.appl_ptr == TEST_BUFSIZE);
+  test_detach(&ts);
+}
+
+int main(void)
+{
+  printf("Testing client streams...");
+  fflush(stdout);
+  test_converted_playback();
+  test_converted_capture();
+  test_raw_playback();
+  printf("OK\n");
+  return 0;
+}
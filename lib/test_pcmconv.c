@@ -0,0 +1,143 @@
+#include "sslib.h"
+
+/*
+  Make sure the accelerated conversion routines produce exactly the same
+  output as the generic C routines.
+*/
+
+#define TEST_SAMPLES 4099UL
+#define TEST_MAXLEN 67UL
+
+static const int32_t test_formats[] = {
+  DSPD_PCM_FORMAT_S16_NE,
+  DSPD_PCM_FORMAT_S32_NE,
+  DSPD_PCM_FORMAT_S24_NE,
+  DSPD_PCM_FORMAT_FLOAT_NE,
+};
+
+static const float64 test_volumes[] = { 1.0, 0.5, 0.70710678118654752, 0.0, 1.3 };
+
+static uint32_t test_seed = 12345;
+static uint32_t test_rand(void)
+{
+  test_seed = test_seed * 1103515245U + 12345U;
+  return test_seed;
+}
+
+static float64 in64[TEST_SAMPLES];
+static float32 in32[TEST_SAMPLES];
+static uint8_t inraw[TEST_SAMPLES * 8UL];
+static uint8_t ref[TEST_SAMPLES * 8UL], out[TEST_SAMPLES * 8UL];
+
+static void fill_input(void)
+{
+  size_t i;
+  static const float64 edges[] = { 0.0, 1.0, -1.0, 0.5, -0.5, 2.0, -2.0,
+				   0.99999994, -0.99999994, 1.0000001, -1.0000001,
+				   1.0 / 32768.0, -1.0 / 32768.0, 1.5 / 32768.0, -1.5 / 32768.0 };
+  for ( i = 0; i < TEST_SAMPLES; i++ )
+    {
+      if ( i < ARRAY_SIZE(edges) )
+	in64[i] = edges[i];
+      else
+	in64[i] = ((float64)test_rand() / UINT32_MAX) * 2.5 - 1.25;
+      in32[i] = in64[i];
+    }
+  for ( i = 0; i < sizeof(inraw); i++ )
+    inraw[i] = test_rand() >> 24;
+}
+
+/*
+  Run both versions over every offset and length up to TEST_MAXLEN so
+  all of the remainder handling is exercised, then over the whole buffer.
+*/
+#define compare_conv(_g, _c, _fn, _in, _isize, _osize, ...)		\
+  if ( (_c)->_fn != (_g)->_fn ) {					\
+    size_t off, len;							\
+    for ( off = 0; off < 8UL; off++ ) {					\
+      for ( len = 0; len <= TEST_MAXLEN; len++ ) {			\
+	memset(ref, 0xAA, (len+1UL) * (_osize));			\
+	memset(out, 0xAA, (len+1UL) * (_osize));			\
+	(_g)->_fn((const void*)((const char*)(_in) + off * (_isize)), (void*)ref, len, ##__VA_ARGS__); \
+	(_c)->_fn((const void*)((const char*)(_in) + off * (_isize)), (void*)out, len, ##__VA_ARGS__); \
+	if ( memcmp(ref, out, (len+1UL) * (_osize)) != 0 ) {		\
+	  fprintf(stderr, "\n%s: %s (off=%ld,len=%ld) does not match\n", \
+		  dspd_pcm_name_from_format(format), #_fn, (long)off, (long)len); \
+	  DSPD_ASSERT(memcmp(ref, out, (len+1UL) * (_osize)) == 0);	\
+	}								\
+      }									\
+    }									\
+    (_g)->_fn((const void*)(_in), (void*)ref, TEST_SAMPLES, ##__VA_ARGS__); \
+    (_c)->_fn((const void*)(_in), (void*)out, TEST_SAMPLES, ##__VA_ARGS__); \
+    if ( memcmp(ref, out, TEST_SAMPLES * (_osize)) != 0 ) {		\
+      fprintf(stderr, "\n%s: %s does not match\n",			\
+	      dspd_pcm_name_from_format(format), #_fn);			\
+      DSPD_ASSERT(memcmp(ref, out, TEST_SAMPLES * (_osize)) == 0);	\
+    }									\
+    count++;								\
+  }
+
+static size_t test_format(int32_t isa, int32_t format)
+{
+  const struct pcm_conv *g, *c;
+  size_t v, count = 0, fsize;
+  float64 vol;
+  g = dspd_getconv_isa(format, DSPD_PCM_ISA_GENERIC);
+  c = dspd_getconv_isa(format, isa);
+  DSPD_ASSERT(g != NULL);
+  DSPD_ASSERT(c != NULL);
+  fsize = dspd_get_pcm_format_size(format);
+  DSPD_ASSERT(fsize > 0);
+  compare_conv(g, c, tofloat32, inraw, fsize, sizeof(float32));
+  compare_conv(g, c, tofloat64, inraw, fsize, sizeof(float64));
+  compare_conv(g, c, fromfloat32, in32, sizeof(float32), fsize);
+  compare_conv(g, c, fromfloat64, in64, sizeof(float64), fsize);
+  for ( v = 0; v < ARRAY_SIZE(test_volumes); v++ )
+    {
+      vol = test_volumes[v];
+      compare_conv(g, c, tofloat32wv, inraw, fsize, sizeof(float32), vol);
+      compare_conv(g, c, tofloat64wv, inraw, fsize, sizeof(float64), vol);
+      compare_conv(g, c, fromfloat32wv, in32, sizeof(float32), fsize, vol);
+      compare_conv(g, c, fromfloat64wv, in64, sizeof(float64), fsize, vol);
+    }
+  return count;
+}
+
+void test_pcmconv_isa(int32_t isa)
+{
+  size_t i, count = 0;
+  printf("Testing %s conversion routines...", dspd_pcm_isa_name(isa));
+  if ( dspd_getconv_isa(DSPD_PCM_FORMAT_S16_NE, isa) == NULL )
+    {
+      printf("not supported\n");
+      return;
+    }
+  for ( i = 0; i < ARRAY_SIZE(test_formats); i++ )
+    count += test_format(isa, test_formats[i]);
+  printf("OK (%ld routines)\n", (long)count);
+}
+
+void test_pcmconv_default(void)
+{
+  int32_t isa = dspd_pcm_isa();
+  printf("Testing default conversion routines...");
+  DSPD_ASSERT(dspd_pcm_isa_name(isa) != NULL);
+  DSPD_ASSERT(dspd_getconv(DSPD_PCM_FORMAT_S16_NE) == dspd_getconv_isa(DSPD_PCM_FORMAT_S16_NE, isa));
+  DSPD_ASSERT(dspd_getconv(DSPD_PCM_FORMAT_UNKNOWN) == NULL);
+  DSPD_ASSERT(dspd_getconv(DSPD_PCM_FORMAT_LAST + 1) == NULL);
+  DSPD_ASSERT(dspd_getconv(DSPD_PCM_FORMAT_MPEG) == NULL);
+  printf("OK (%s)\n", dspd_pcm_isa_name(isa));
+}
+
+int main(void)
+{
+  int32_t isa;
+  fill_input();
+  test_pcmconv_default(); fflush(NULL);
+  for ( isa = DSPD_PCM_ISA_GENERIC + 1; isa < DSPD_PCM_ISA_COUNT; isa++ )
+    {
+      test_pcmconv_isa(isa);
+      fflush(NULL);
+    }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "sslib.h"
+
+/*
+  Create a huge page section like the server does for a client stream,
+  then attach to it through another fd like the client does.  Huge pages
+  may not be reserved, so either memfd backend is accepted, but the result
+  must be sealed so neither side can change its size.
+*/
+
+#define TEST_SECTION_LEN 65536U
+
+static void test_hugepage(void)
+{
+  struct dspd_shm_map srv, cli;
+  struct dspd_shm_addr sect, a;
+  int fd;
+  memset(&srv, 0, sizeof(srv));
+  memset(&cli, 0, sizeof(cli));
+  sect.length = TEST_SECTION_LEN;
+  sect.section_id = 1;
+  sect.addr = NULL;
+  srv.flags = DSPD_SHM_FLAG_HUGEPAGE | DSPD_SHM_FLAG_READ | DSPD_SHM_FLAG_WRITE;
+  DSPD_ASSERT(dspd_shm_create(&srv, &sect, 1) == 0);
+  DSPD_ASSERT(srv.flags & DSPD_SHM_FLAG_MMAP);
+  DSPD_ASSERT(srv.flags & DSPD_SHM_FLAG_MEMFD);
+  DSPD_ASSERT(srv.length >= TEST_SECTION_LEN);
+  DSPD_ASSERT(ftruncate(srv.arg, srv.length / 2) < 0);
+
+  fd = dup(srv.arg);
+  DSPD_ASSERT(fd >= 0);
+  cli.arg = fd;
+  cli.flags = srv.flags;
+  cli.length = srv.length;
+  cli.section_count = srv.section_count;
+  DSPD_ASSERT(dspd_shm_attach(&cli) == 0);
+
+  a.section_id = 1;
+  DSPD_ASSERT(dspd_shm_get_addr(&srv, &a) == 0);
+  memset(a.addr, 0x5a, a.length);
+  a.section_id = 1;
+  DSPD_ASSERT(dspd_shm_get_addr(&cli, &a) == 0);
+  DSPD_ASSERT(a.length == TEST_SECTION_LEN);
+  DSPD_ASSERT(((unsigned char*)a.addr)[TEST_SECTION_LEN - 1U] == 0x5a);
+
+  dspd_shm_close(&cli);
+  dspd_shm_close(&srv);
+}
+
+//A memfd without seals must not be accepted as one.
+static void test_unsealed(void)
+{
+  struct dspd_shm_map srv, cli;
+  struct dspd_shm_addr sect;
+  memset(&srv, 0, sizeof(srv));
+  memset(&cli, 0, sizeof(cli));
+  sect.length = TEST_SECTION_LEN;
+  sect.section_id = 1;
+  sect.addr = NULL;
+  srv.flags = DSPD_SHM_FLAG_READ | DSPD_SHM_FLAG_WRITE;
+  DSPD_ASSERT(dspd_shm_create(&srv, &sect, 1) == 0);
+  DSPD_ASSERT((srv.flags & DSPD_SHM_FLAG_MEMFD) == 0);
+  cli.arg = srv.arg;
+  cli.flags = srv.flags | DSPD_SHM_FLAG_MEMFD;
+  cli.length = srv.length;
+  cli.section_count = srv.section_count;
+  DSPD_ASSERT(dspd_shm_attach(&cli) < 0);
+  dspd_shm_close(&srv);
+}
+
+int main(void)
+{
+  printf("Testing shared memory...");
+  fflush(stdout);
+  test_hugepage();
+  test_unsealed();
+  printf("OK\n");
+  return 0;
+}
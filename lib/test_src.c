@@ -0,0 +1,164 @@
+#include <math.h>
+#include "sslib.h"
+
+/*
+  Run a sine wave through the builtin resampler and make sure it comes out
+  at the same frequency and level, and that the result does not depend on
+  how the input is split up.
+*/
+
+#define TEST_RATE_IN  44100U
+#define TEST_RATE_OUT 48000U
+#define TEST_FREQ     1000.0
+#define TEST_FRAMES   (TEST_RATE_IN / 2U)
+#define TEST_CHANNELS 2U
+
+static float inbuf[TEST_FRAMES * TEST_CHANNELS];
+static float out1[TEST_FRAMES * 2U * TEST_CHANNELS];
+static float out2[TEST_FRAMES * 2U * TEST_CHANNELS];
+
+static size_t run_src(dspd_src_t src, float *out, size_t chunk)
+{
+  size_t i = 0, o = 0, fi, fo;
+  DSPD_ASSERT(dspd_src_reset(src) == 0);
+  //Keep going until all of the input is used and nothing more comes out.
+  do {
+    fi = TEST_FRAMES - i;
+    if ( fi > chunk )
+      fi = chunk;
+    fo = (TEST_FRAMES * 2U) - o;
+    if ( fo > chunk )
+      fo = chunk;
+    DSPD_ASSERT(dspd_src_process(src, false, &inbuf[i * TEST_CHANNELS], &fi, &out[o * TEST_CHANNELS], &fo) == 0);
+    i += fi;
+    o += fo;
+  } while ( fi > 0 || fo > 0 );
+  DSPD_ASSERT(i == TEST_FRAMES);
+  return o;
+}
+
+//Same as run_src() but the input is split in two like a fifo that wrapped around.
+static size_t run_src_v(dspd_src_t src, float *out, size_t split, size_t chunk)
+{
+  size_t i = 0, o = 0, fi, fo, niov;
+  struct dspd_src_iov iov[2];
+  DSPD_ASSERT(dspd_src_reset(src) == 0);
+  do {
+    niov = 0;
+    if ( i < split )
+      {
+	iov[niov].buf = &inbuf[i * TEST_CHANNELS];
+	iov[niov].frames = split - i;
+	niov++;
+      }
+    iov[niov].buf = &inbuf[(i > split ? i : split) * TEST_CHANNELS];
+    iov[niov].frames = TEST_FRAMES - (i > split ? i : split);
+    niov++;
+    fo = (TEST_FRAMES * 2U) - o;
+    if ( fo > chunk )
+      fo = chunk;
+    DSPD_ASSERT(dspd_src_process_v(src, false, iov, niov, &fi, &out[o * TEST_CHANNELS], &fo) == 0);
+    i += fi;
+    o += fo;
+  } while ( fi > 0 || fo > 0 );
+  DSPD_ASSERT(i == TEST_FRAMES);
+  return o;
+}
+
+static void test_quality(int quality, uint32_t rate_out)
+{
+  dspd_src_t src;
+  size_t n1, n2, i, start, end;
+  double err, maxerr = 0.0, expected, t, phase;
+  uint32_t q, ri, ro;
+  printf("Testing polyphase resampler quality %d (%u->%u)...", quality, TEST_RATE_IN, rate_out);
+  DSPD_ASSERT(dspd_src_new(&src, -quality, TEST_CHANNELS) == 0);
+  DSPD_ASSERT(dspd_src_set_rates(src, TEST_RATE_IN, rate_out) == 0);
+  dspd_src_get_params(src, &q, &ri, &ro);
+  DSPD_ASSERT(q == (uint32_t)quality && ri == TEST_RATE_IN && ro == rate_out);
+  n1 = run_src(src, out1, TEST_FRAMES);
+  n2 = run_src(src, out2, 97);
+  DSPD_ASSERT(n1 == n2);
+  DSPD_ASSERT(memcmp(out1, out2, n1 * TEST_CHANNELS * sizeof(float)) == 0);
+  //Most of the input should have made it out (minus the filter delay).
+  DSPD_ASSERT(n1 > ((TEST_FRAMES * (size_t)rate_out) / TEST_RATE_IN) - 128U);
+
+  //Skip the start where the filter is still filling up.
+  start = 256;
+  end = n1 - 256;
+  for ( i = start; i < end; i++ )
+    {
+      t = (double)i / rate_out;
+      phase = 2.0 * M_PI * TEST_FREQ * t;
+      expected = 0.5 * sin(phase);
+      err = fabs(out1[i * TEST_CHANNELS] - expected);
+      if ( err > maxerr )
+	maxerr = err;
+      DSPD_ASSERT(out1[(i * TEST_CHANNELS) + 1U] == -out1[i * TEST_CHANNELS]);
+    }
+  dspd_src_delete(src);
+  printf("OK (max error %.6f)\n", maxerr);
+  DSPD_ASSERT(maxerr < 0.01);
+}
+
+static void test_shared(void)
+{
+  dspd_src_t a, b;
+  size_t n1, n2;
+  printf("Testing shared filter banks...");
+  DSPD_ASSERT(dspd_src_new(&a, -3, TEST_CHANNELS) == 0);
+  DSPD_ASSERT(dspd_src_new(&b, -3, TEST_CHANNELS) == 0);
+  //Same ratio, so the same filter bank.
+  DSPD_ASSERT(dspd_src_set_rates(a, TEST_RATE_IN, TEST_RATE_OUT) == 0);
+  DSPD_ASSERT(dspd_src_set_rates(b, TEST_RATE_IN / 2U, TEST_RATE_OUT / 2U) == 0);
+  n1 = run_src(a, out1, 512);
+  dspd_src_delete(a);
+  n2 = run_src(b, out2, 512);
+  DSPD_ASSERT(n1 == n2);
+  DSPD_ASSERT(memcmp(out1, out2, n1 * TEST_CHANNELS * sizeof(float)) == 0);
+  dspd_src_delete(b);
+  printf("OK\n");
+}
+
+static void test_vectored(int quality)
+{
+  dspd_src_t src;
+  size_t n1, n2;
+  uint32_t q;
+  printf("Testing vectored input with quality %d...", quality);
+  //Quality 0 is bcr, which dspd_src_new() only gives out as the minimum.
+  DSPD_ASSERT(dspd_src_new(&src, quality ? -quality : 1, TEST_CHANNELS) == 0);
+  DSPD_ASSERT(dspd_src_set_rates(src, TEST_RATE_IN, TEST_RATE_OUT) == 0);
+  dspd_src_get_params(src, &q, NULL, NULL);
+  DSPD_ASSERT(q == (uint32_t)quality);
+  n1 = run_src(src, out1, TEST_FRAMES * 2U);
+  n2 = run_src_v(src, out2, 1001, TEST_FRAMES * 2U);
+  DSPD_ASSERT(n1 == n2);
+  DSPD_ASSERT(memcmp(out1, out2, n1 * TEST_CHANNELS * sizeof(float)) == 0);
+  n2 = run_src_v(src, out2, 5003, 331);
+  DSPD_ASSERT(n1 == n2);
+  DSPD_ASSERT(memcmp(out1, out2, n1 * TEST_CHANNELS * sizeof(float)) == 0);
+  dspd_src_delete(src);
+  printf("OK\n");
+}
+
+int main(void)
+{
+  size_t i;
+  int q;
+  for ( i = 0; i < TEST_FRAMES; i++ )
+    {
+      inbuf[i * TEST_CHANNELS] = 0.5 * sin(2.0 * M_PI * TEST_FREQ * ((double)i / TEST_RATE_IN));
+      inbuf[(i * TEST_CHANNELS) + 1U] = -inbuf[i * TEST_CHANNELS];
+    }
+  for ( q = 1; q <= 4; q++ )
+    {
+      test_quality(q, TEST_RATE_OUT);
+      test_quality(q, TEST_RATE_IN / 2U);
+      fflush(NULL);
+    }
+  test_shared();
+  test_vectored(0);
+  test_vectored(3);
+  return 0;
+}
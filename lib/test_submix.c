@@ -0,0 +1,132 @@
+#include <math.h>
+#include "sslib.h"
+#include "submix.h"
+
+/*
+  Mix two clients on a submix bus and make sure the device gets the same
+  thing as resampling the sum in one go, and that the delay reported to the
+  clients covers what is still waiting inside the bus.
+*/
+
+#define TEST_BUS_RATE 44100U
+#define TEST_DEV_RATE 48000U
+#define TEST_CHANNELS 2U
+#define TEST_BUFSIZE  4096U
+#define TEST_DELAY    1024
+#define TEST_CYCLES   200U
+#define TEST_INPUT    (TEST_BUFSIZE * TEST_CYCLES)
+
+static float input[TEST_INPUT * TEST_CHANNELS];
+static float expected[TEST_INPUT * 2U * TEST_CHANNELS];
+static float devbuf[TEST_INPUT * 2U * TEST_CHANNELS];
+
+static void make_input(void)
+{
+  size_t i;
+  double t;
+  for ( i = 0; i < TEST_INPUT; i++ )
+    {
+      t = (double)i / TEST_BUS_RATE;
+      input[i * TEST_CHANNELS] = 0.25 * sin(2.0 * M_PI * 440.0 * t);
+      input[(i * TEST_CHANNELS) + 1U] = 0.25 * sin(2.0 * M_PI * 1000.0 * t);
+    }
+}
+
+//Resample the whole input at once.
+static size_t make_expected(int quality)
+{
+  dspd_src_t src;
+  size_t fi = TEST_INPUT, fo = TEST_INPUT * 2U;
+  DSPD_ASSERT(dspd_src_new(&src, quality, TEST_CHANNELS) == 0);
+  DSPD_ASSERT(dspd_src_set_rates(src, TEST_BUS_RATE, TEST_DEV_RATE) == 0);
+  DSPD_ASSERT(dspd_src_process(src, false, input, &fi, expected, &fo) == 0);
+  DSPD_ASSERT(fi == TEST_INPUT);
+  dspd_src_delete(src);
+  return fo;
+}
+
+static void test_bus(int quality)
+{
+  struct dspd_drv_params params;
+  struct dspd_submix *bus;
+  struct dspd_io_cycle cycle;
+  struct dspd_pcm_status status;
+  size_t n, i, c, frames, pos = 0, len, total, start = 0;
+  uint64_t last_appl = 0;
+  float diff, maxdiff = 0.0;
+  printf("Testing submix bus quality %d...", quality);
+  total = make_expected(quality);
+  memset(&params, 0, sizeof(params));
+  params.rate = TEST_DEV_RATE;
+  params.channels = TEST_CHANNELS;
+  params.bufsize = TEST_BUFSIZE;
+  DSPD_ASSERT(dspd_submix_new(&bus, TEST_BUS_RATE, quality, &params) == 0);
+  memset(&cycle, 0, sizeof(cycle));
+  memset(&status, 0, sizeof(status));
+  memset(devbuf, 0, sizeof(devbuf));
+  cycle.start_count = 1;
+  cycle.precision = DSPD_MIX_PRECISION_FLOAT32;
+  cycle.rate = TEST_DEV_RATE;
+  status.delay = TEST_DELAY;
+  for ( c = 0, frames = 0; c < TEST_CYCLES && frames < (TEST_INPUT * 2U); c++ )
+    {
+      //Odd sizes so the bus has leftovers.
+      len = 256U + ((c * 97U) % 700U);
+      cycle.addr = devbuf;
+      cycle.offset = frames;
+      cycle.len = len;
+      cycle.remaining = len;
+      status.appl_ptr = TEST_BUFSIZE + frames;
+      status.hw_ptr = status.appl_ptr - TEST_DELAY;
+      dspd_submix_begin(bus, &cycle, &status);
+      DSPD_ASSERT(bus->cycle.rate == TEST_BUS_RATE);
+      if ( c > 0 )
+	{
+	  //Pointers only move forward and the delay is at least the device delay.
+	  DSPD_ASSERT(bus->status.appl_ptr >= last_appl);
+	  DSPD_ASSERT(bus->status.delay >= (int32_t)((TEST_DELAY * TEST_BUS_RATE) / TEST_DEV_RATE));
+	  //There should never be much waiting in the bus.
+	  DSPD_ASSERT(bus->status.delay < (int32_t)((TEST_DELAY * TEST_BUS_RATE) / TEST_DEV_RATE) + 256);
+	  DSPD_ASSERT(bus->status.hw_ptr + bus->status.delay == bus->status.appl_ptr);
+	}
+      last_appl = bus->status.appl_ptr;
+      n = bus->cycle.len;
+      if ( pos + n > TEST_INPUT )
+	break;
+      //Two clients, each with half of the signal.
+      for ( i = 0; i < n * TEST_CHANNELS; i++ )
+	{
+	  ((float*)bus->cycle.addr)[i] += input[(pos * TEST_CHANNELS) + i] * 0.5f;
+	  ((float*)bus->cycle.addr)[i] += input[(pos * TEST_CHANNELS) + i] * 0.5f;
+	}
+      pos += n;
+      dspd_submix_end(bus, &cycle, &status);
+      DSPD_ASSERT(bus->status.appl_ptr == last_appl + n);
+      //The first cycle comes up short and starts late.
+      if ( c == 0 )
+	start = len - bus->out_count;
+      frames += len;
+    }
+  DSPD_ASSERT(start < 256U);
+  frames -= start;
+  if ( frames > total )
+    frames = total;
+  for ( i = 0; i < frames * TEST_CHANNELS; i++ )
+    {
+      diff = fabsf(devbuf[(start * TEST_CHANNELS) + i] - expected[i]);
+      if ( diff > maxdiff )
+	maxdiff = diff;
+    }
+  dspd_submix_delete(bus);
+  printf("OK (max difference %.7f)\n", maxdiff);
+  DSPD_ASSERT(maxdiff < 0.00001);
+}
+
+int main(void)
+{
+  int q;
+  make_input();
+  for ( q = 1; q <= 4; q++ )
+    test_bus(-q);
+  return 0;
+}
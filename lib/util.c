@@ -683,3 +683,81 @@ void _dspd_assert(const char *expr, const char *file, unsigned int line)
     close(fd);
   abort();
 }
+
+size_t dspd_hist_bucket(uint64_t value)
+{
+  size_t b;
+  unsigned int l;
+  if ( value < (1U << DSPD_HIST_SUB_BITS) )
+    return value;
+  l = 63U - __builtin_clzll(value);
+  b = ((l - DSPD_HIST_SUB_BITS + 1U) << DSPD_HIST_SUB_BITS) +
+    ((value >> (l - DSPD_HIST_SUB_BITS)) & ((1U << DSPD_HIST_SUB_BITS) - 1U));
+  if ( b >= DSPD_HIST_BUCKETS )
+    b = DSPD_HIST_BUCKETS - 1U;
+  return b;
+}
+
+uint64_t dspd_hist_bucket_limit(size_t bucket)
+{
+  unsigned int l;
+  uint64_t s;
+  if ( bucket < (1U << DSPD_HIST_SUB_BITS) )
+    return bucket + 1U;
+  if ( bucket >= (DSPD_HIST_BUCKETS - 1U) )
+    return UINT64_MAX;
+  l = (bucket >> DSPD_HIST_SUB_BITS) + DSPD_HIST_SUB_BITS - 1U;
+  s = bucket & ((1U << DSPD_HIST_SUB_BITS) - 1U);
+  return ((1ULL << DSPD_HIST_SUB_BITS) + s + 1ULL) << (l - DSPD_HIST_SUB_BITS);
+}
+
+void dspd_hist_add(struct dspd_hist *hist, uint64_t value)
+{
+  hist->buckets[dspd_hist_bucket(value)]++;
+  hist->count++;
+  hist->sum += value;
+  if ( value > hist->max )
+    hist->max = value;
+}
+
+uint64_t dspd_hist_percentile(const struct dspd_hist *hist, double pct)
+{
+  uint64_t n = 0, limit, total = 0, ret;
+  size_t i;
+  /*
+    The count might be a little different from the buckets if another thread
+    is adding values, so use the buckets.
+  */
+  for ( i = 0; i < DSPD_HIST_BUCKETS; i++ )
+    total += hist->buckets[i];
+  if ( total == 0 )
+    return 0;
+  limit = (uint64_t)((total * pct) / 100.0);
+  if ( limit < total && (limit * 100.0) < (total * pct) )
+    limit++;
+  if ( limit == 0 )
+    limit = 1;
+  for ( i = 0; i < DSPD_HIST_BUCKETS; i++ )
+    {
+      n += hist->buckets[i];
+      if ( n >= limit )
+	break;
+    }
+  ret = dspd_hist_bucket_limit(i) - 1U;
+  if ( ret > hist->max )
+    ret = hist->max;
+  return ret;
+}
+
+void dspd_hist_decay(struct dspd_hist *hist)
+{
+  size_t i;
+  uint64_t total = 0;
+  for ( i = 0; i < DSPD_HIST_BUCKETS; i++ )
+    {
+      hist->buckets[i] /= 2U;
+      total += hist->buckets[i];
+    }
+  hist->count = total;
+  hist->sum /= 2U;
+}
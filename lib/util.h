@@ -136,4 +136,27 @@ static inline ssize_t dspd_write(int32_t fd, const void *buf, size_t len)
 //size of member of struct or union or class (C++ only)
 #define sizeof_m(_s, _m) sizeof(((_s*)(0x0UL))->_m)
 
+/*
+  Log-linear histogram.  Values below 8 get their own bucket and every power
+  of 2 above that is split into 8 buckets, so a bucket is never more than
+  12.5% wide.  Values of 2^34 or more go in the last bucket.  There is no
+  locking.  One thread adds values and any other thread may copy it.
+*/
+#define DSPD_HIST_SUB_BITS 3U
+#define DSPD_HIST_BUCKETS  256U
+struct dspd_hist {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint32_t buckets[DSPD_HIST_BUCKETS];
+};
+size_t dspd_hist_bucket(uint64_t value);
+//Smallest value that does not fit in the bucket
+uint64_t dspd_hist_bucket_limit(size_t bucket);
+void dspd_hist_add(struct dspd_hist *hist, uint64_t value);
+//Highest value of the bucket holding the percentile (0-100)
+uint64_t dspd_hist_percentile(const struct dspd_hist *hist, double pct);
+//Halve the counts so old values age out.  The max is not reset.
+void dspd_hist_decay(struct dspd_hist *hist);
+
 #endif
@@ -258,6 +258,8 @@ void dsp_read(struct oss_cdev_client *cli, size_t size, off_t off, int flags)
       return;
     }
   latency = dspd_rclient_get_hw_params(cli->dsp.rclient, DSPD_PCM_SBIT_CAPTURE)->latency;
+  if ( oss_cdev_client_resume(cli, &offset, &alertable, &ret) )
+    goto resume;
   while ( offset < size )
     {
       ret = dspd_rclient_read(cli->dsp.rclient,
@@ -301,7 +303,10 @@ void dsp_read(struct oss_cdev_client *cli, size_t size, off_t off, int flags)
 	      err = ret;
 	      break;
 	    }
-	  ret = dspd_cdev_client_sleep(cli, &abstime, alertable);
+	  //The worker calls this again when it is time to continue.
+	  oss_cdev_client_park(cli, abstime, alertable, offset);
+	  return;
+	resume:
 	  if ( ret != 0 )
 	    {
 	      if ( ret != ETIMEDOUT && ret != EINPROGRESS )
@@ -366,6 +371,8 @@ void dsp_write(struct oss_cdev_client *cli,
   size = (size / cli->dsp.frame_bytes) * cli->dsp.frame_bytes;
 
   hwp = dspd_rclient_get_hw_params(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK);
+  if ( oss_cdev_client_resume(cli, &offset, &alertable, &ret) )
+    goto resume;
   while ( offset < size )
     {
       ret = dspd_rclient_write(cli->dsp.rclient,
@@ -419,8 +426,9 @@ void dsp_write(struct oss_cdev_client *cli,
 		{
 		  if ( dspd_rclient_get_trigger_tstamp(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK) == 0 )
 		    {
-		      usleep(1);
-		      continue;
+		      //Not started yet, so check again soon.
+		      oss_cdev_client_park(cli, dspd_get_time() + DSP_TRIGGER_WAIT, alertable, offset);
+		      return;
 		    }
 		} else if ( ret < 0 )
 		{
@@ -434,7 +442,9 @@ void dsp_write(struct oss_cdev_client *cli,
 		break;
    
 	      
-	      ret = dspd_cdev_client_sleep(cli, &abstime, alertable);
+	      oss_cdev_client_park(cli, abstime, alertable, offset);
+	      return;
+	    resume:
 	      if ( ret != 0 )
 		{
 		  if ( ret != ETIMEDOUT && ret != EINPROGRESS )
@@ -499,23 +509,98 @@ static void dsp_poll(struct oss_cdev_client *cli, uint64_t ph)
   oss_reply_poll(cli, revents);
 }
 
-static void dsp_release(struct oss_cdev_client *cli)
+//Progress of a parked drain
+#define DSP_DRAIN_FIFO    0
+#define DSP_DRAIN_LATENCY 1
+
+/*
+  Start playback and wait for it to drain like dspd_rclient_drain() without
+  sleeping in the worker.  The request parks until the next wakeup while the
+  fifo has data, then once more for the device latency.  Returns true if the
+  request was parked, so the handler must return without replying.  Otherwise
+  the result goes in *err.
+*/
+static bool dsp_drain(struct oss_cdev_client *cli, int32_t *err)
 {
+  size_t stage;
+  bool alertable;
+  int ret;
+  int32_t avail;
   uint32_t s;
+  dspd_time_t abstime;
+  const struct dspd_cli_params *hwp;
+  *err = 0;
+  if ( oss_cdev_client_resume(cli, &stage, &alertable, &ret) )
+    {
+      if ( ret != 0 && ret != ETIMEDOUT )
+	{
+	  *err = -ret;
+	  return false;
+	}
+      if ( stage == DSP_DRAIN_LATENCY )
+	return false;
+    } else
+    {
+      s = DSPD_PCM_SBIT_PLAYBACK;
+      *err = dspd_rclient_ctl(cli->dsp.rclient,
+			      DSPD_SCTL_CLIENT_START,
+			      &s,
+			      sizeof(s),
+			      NULL,
+			      0,
+			      NULL);
+      if ( *err != 0 )
+	return false;
+    }
+  hwp = dspd_rclient_get_hw_params(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK);
+  ret = dspd_rclient_status(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK, NULL);
+  if ( ret == -EAGAIN )
+    {
+      if ( dspd_rclient_get_trigger_tstamp(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK) == 0 )
+	{
+	  //Not started yet, so check again soon.
+	  oss_cdev_client_park(cli, dspd_get_time() + DSP_TRIGGER_WAIT, false, DSP_DRAIN_FIFO);
+	  return true;
+	}
+    } else if ( ret < 0 )
+    {
+      *err = ret;
+      return false;
+    }
+  avail = dspd_rclient_avail(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK);
+  if ( avail >= 0 && avail < hwp->bufsize )
+    {
+      ret = dspd_rclient_get_next_wakeup_avail(cli->dsp.rclient,
+					       DSPD_PCM_SBIT_PLAYBACK,
+					       hwp->bufsize,
+					       &abstime);
+      if ( ret < 0 )
+	{
+	  *err = ret;
+	  return false;
+	}
+      oss_cdev_client_park(cli, abstime, false, DSP_DRAIN_FIFO);
+    } else if ( avail >= 0 || avail == -EPIPE )
+    {
+      //The fifo is empty.  Give the device time to play what it already took.
+      abstime = 1000000000ULL * hwp->latency / hwp->rate;
+      oss_cdev_client_park(cli, dspd_get_time() + abstime, false, DSP_DRAIN_LATENCY);
+    } else
+    {
+      *err = avail;
+      return false;
+    }
+  return true;
+}
+
+static void dsp_release(struct oss_cdev_client *cli)
+{
   int32_t err;
   if ( (cli->dsp.params.stream & DSPD_PCM_SBIT_PLAYBACK) != 0 &&
        (cli->error == 0) && cli->dsp.params_set )
     {
-      s = DSPD_PCM_SBIT_PLAYBACK;
-      err = dspd_rclient_ctl(cli->dsp.rclient,
-			     DSPD_SCTL_CLIENT_START,
-			     &s,
-			     sizeof(s),
-			     NULL,
-			     0,
-			     NULL);
-      if ( err == 0 )
-	dspd_rclient_drain(cli->dsp.rclient);
+      if ( dsp_drain(cli, &err) )
+	return;
     }
   oss_reply_error(cli, 0);
 }
@@ -965,21 +1050,13 @@ static int32_t dsp_req_sync(struct dspd_rctx *context,
 			    size_t        outbufsize)
 {
   int32_t err = 0;
-  struct dsp_data *dsp = REQ_DSP(context);
-  uint32_t s;
+  struct oss_cdev_client *cli = dspd_req_userdata(context);
  
-  if ( dsp->params.stream & DSPD_PCM_SBIT_PLAYBACK )
+  if ( cli->dsp.params.stream & DSPD_PCM_SBIT_PLAYBACK )
     {
-      s = DSPD_PCM_SBIT_PLAYBACK;
-      err = dspd_rclient_ctl(dsp->rclient,
-			     DSPD_SCTL_CLIENT_START,
-			     &s,
-			     sizeof(s),
-			     NULL,
-			     0,
-			     NULL);
-      if ( err == 0 )
-	err = dspd_rclient_drain(dsp->rclient);
+      //The worker calls this again when it is time to continue.
+      if ( dsp_drain(cli, &err) )
+	return 0;
     }
   return dspd_req_reply_err(context, 0, err);
 }
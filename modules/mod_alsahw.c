@@ -221,6 +221,21 @@ intptr_t alsahw_pcm_mmap_read_commit(void *handle,
   return ret;
 }
 
+//Convert the mix buffer to the hardware format.
+static inline void playback_convert(struct alsahw_handle *hdl, uintptr_t offset, void *hw_addr, uintptr_t frames)
+{
+  if ( hdl->params.mix_precision == DSPD_MIX_PRECISION_FLOAT32 )
+    hdl->convert.fromfloat(&hdl->buffer.addr32[offset * hdl->channels],
+			   hw_addr,
+			   frames * hdl->channels,
+			   hdl->volume);
+  else
+    hdl->convert.fromdouble(&hdl->buffer.addr64[offset * hdl->channels],
+			    hw_addr,
+			    frames * hdl->channels,
+			    hdl->volume);
+}
+
 int32_t alsahw_pcm_write_begin(void *handle,
 				void **ptr,
 				uintptr_t *offset,
@@ -229,7 +244,6 @@ int32_t alsahw_pcm_write_begin(void *handle,
   struct alsahw_handle *hdl = handle;
   snd_pcm_sframes_t fr;
   uintptr_t f, o;
-  double **buf = (double**)ptr;
   if ( hdl->err )
     return hdl->err;
 
@@ -257,14 +271,14 @@ int32_t alsahw_pcm_write_begin(void *handle,
     fr = f;
   *frames = fr; 
   *offset = o;
-  *buf = hdl->buffer.addr64;
+  *ptr = hdl->buffer.addr;
 
   //Force real status update next time.
   if ( fr == 0 )
     hdl->got_tstamp = 0;
   if ( fr > 0 && hdl->status.appl_ptr == hdl->erase_ptr )
     {
-      memset(&hdl->buffer.addr64[o * hdl->channels], 0, sizeof(double) * fr * hdl->channels);
+      memset((char*)hdl->buffer.addr + (o * hdl->mix_frame_size), 0, hdl->mix_frame_size * fr);
       hdl->erase_ptr += fr;
     }
 
@@ -279,10 +293,7 @@ intptr_t alsahw_pcm_write_commit(void *handle,
   struct alsahw_handle *hdl = handle;
   int ret;
   uintptr_t off = 0;
-  hdl->convert.fromdouble(&hdl->buffer.addr64[offset * hdl->channels],
-	       hdl->hw_addr,
-	       frames * hdl->channels,
-	       hdl->volume);
+  playback_convert(hdl, offset, hdl->hw_addr, frames);
   while ( off < frames )
     {
       ret = snd_pcm_writei(hdl->handle, 
@@ -320,7 +331,6 @@ int32_t alsahw_pcm_mmap_begin(void *handle,
   snd_pcm_uframes_t mm_offset, mm_frames;
   int ret;
   const snd_pcm_channel_area_t *area;
-  double **buf = (double**)ptr;
   if ( hdl->err )
     return hdl->err;
   mm_frames = *frames;
@@ -331,14 +341,14 @@ int32_t alsahw_pcm_mmap_begin(void *handle,
   if ( ret == 0 )
     {
       hdl->hw_addr = area->addr;
-      *buf = hdl->buffer.addr64;
+      *ptr = hdl->buffer.addr;
       *offset = mm_offset;
       *frames = mm_frames;
       if ( mm_frames == 0 )
 	hdl->got_tstamp = 0;
       if ( mm_frames > 0 && hdl->status.appl_ptr == hdl->erase_ptr )
 	{
-	  memset(&hdl->buffer.addr64[mm_offset * hdl->channels], 0, sizeof(double) * mm_frames * hdl->channels);
+	  memset((char*)hdl->buffer.addr + (mm_offset * hdl->mix_frame_size), 0, hdl->mix_frame_size * mm_frames);
 	  hdl->erase_ptr += mm_frames;
 	}
     } else
@@ -361,10 +371,7 @@ intptr_t alsahw_pcm_mmap_commit(void *handle,
   maxframes = hdl->erase_ptr - hdl->status.appl_ptr;
   if ( frames > maxframes )
     frames = maxframes;
-  hdl->convert.fromdouble(&hdl->buffer.addr64[offset * hdl->channels],
-			  (char*)hdl->hw_addr + (offset * hdl->frame_size),
-			  frames * hdl->channels,
-			  hdl->volume);
+  playback_convert(hdl, offset, (char*)hdl->hw_addr + (offset * hdl->frame_size), frames);
   ret = snd_pcm_mmap_commit(hdl->handle, offset, frames);
   if ( ret < 0 )
     {
@@ -873,6 +880,70 @@ intptr_t alsahw_pcm_capture_rewind(void *handle, uintptr_t frames)
 
 
 
+/*
+  Committed frames still have their mix in the mix buffer, so new data can be
+  added to them and converted straight into the DMA buffer without moving the
+  application pointer.  This uses the same hardware pointer estimate as
+  alsahw_pcm_rewindable() but does not depend on snd_pcm_rewindable().
+*/
+intptr_t alsahw_pcm_rewritable(void *handle)
+{
+  struct alsahw_handle *hdl = handle;
+  uint64_t now, diff;
+  intptr_t maxframes;
+  if ( hdl->err )
+    return hdl->err;
+  if ( ! (hdl->rewrite && hdl->hw_addr) )
+    return -ENOTSUP;
+  now = dspd_get_time();
+  diff = (now - hdl->status.tstamp) / hdl->sample_time;
+  maxframes = hdl->status.appl_ptr - (hdl->status.hw_ptr+diff);
+  if ( maxframes > (intptr_t)hdl->status.fill )
+    maxframes = hdl->status.fill;
+  //Try to stay at least 1 dma chunk ahead of hw pointer.
+  if ( maxframes <= (intptr_t)hdl->min_dma )
+    return 0;
+  maxframes -= maxframes % hdl->min_dma;
+  maxframes -= hdl->min_dma;
+  return maxframes;
+}
+
+int32_t alsahw_pcm_rewrite_begin(void *handle,
+				 uintptr_t back,
+				 void **ptr,
+				 uintptr_t *offset,
+				 uintptr_t *frames)
+{
+  struct alsahw_handle *hdl = handle;
+  uintptr_t o, f;
+  if ( hdl->err )
+    return hdl->err;
+  if ( ! (hdl->rewrite && hdl->hw_addr) )
+    return -ENOTSUP;
+  if ( back > hdl->status.fill )
+    return -EINVAL;
+  o = (hdl->status.appl_ptr - back) % hdl->params.bufsize;
+  f = hdl->params.bufsize - o;
+  if ( f > back )
+    f = back;
+  if ( *frames > f )
+    *frames = f;
+  *offset = o;
+  *ptr = hdl->buffer.addr;
+  return 0;
+}
+
+intptr_t alsahw_pcm_rewrite_commit(void *handle,
+				   uintptr_t offset,
+				   uintptr_t frames)
+{
+  struct alsahw_handle *hdl = handle;
+  if ( hdl->err )
+    return hdl->err;
+  playback_convert(hdl, offset, (char*)hdl->hw_addr + (offset * hdl->frame_size), frames);
+  return frames;
+}
+
 intptr_t alsahw_pcm_rewindable(void *handle)
 {
   struct alsahw_handle *hdl = handle;
@@ -2170,6 +2241,9 @@ static const struct dspd_pcmdrv_ops alsa_mmap_write_ops = {
   .adjust_pointer = alsahw_pcm_adjust_pointer,
   .set_scheduler = alsahw_set_scheduler,
   .io_pending = alsahw_io_pending,
+  .rewritable = alsahw_pcm_rewritable,
+  .rewrite_begin = alsahw_pcm_rewrite_begin,
+  .rewrite_commit = alsahw_pcm_rewrite_commit,
 };
 
 static const struct dspd_pcmdrv_ops alsa_write_ops = {
@@ -2421,8 +2495,11 @@ static int alsahw_open(const struct dspd_drv_params *params,
 
 
   if ( params->stream == SND_PCM_STREAM_PLAYBACK )
-    hbuf->buffer.addr = calloc(hbuf->params.bufsize, hbuf->channels * sizeof(*hbuf->buffer.addr64));
-  else
+    {
+      hbuf->params.mix_precision = params->mix_precision;
+      hbuf->mix_frame_size = hbuf->channels * DSPD_MIX_SAMPLE_SIZE(hbuf->params.mix_precision);
+      hbuf->buffer.addr = calloc(hbuf->params.bufsize, hbuf->mix_frame_size);
+    } else
     hbuf->buffer.addr = calloc(hbuf->params.bufsize, hbuf->channels * sizeof(*hbuf->buffer.addr32));
   if ( ! hbuf->buffer.addr )
     {
@@ -2447,8 +2524,12 @@ static int alsahw_open(const struct dspd_drv_params *params,
     }
   
   if ( params->stream == SND_PCM_STREAM_PLAYBACK )
-    hbuf->convert.fromdouble = conv->fromfloat64wv;
-  else
+    {
+      if ( hbuf->params.mix_precision == DSPD_MIX_PRECISION_FLOAT32 )
+	hbuf->convert.fromfloat = conv->fromfloat32wv;
+      else
+	hbuf->convert.fromdouble = conv->fromfloat64wv;
+    } else
     hbuf->convert.tofloat = conv->tofloat32wv;
 
   unsigned int minf;
@@ -2557,6 +2638,8 @@ static int alsahw_open(const struct dspd_drv_params *params,
 	*ops = &alsa_write_ops;
       else
 	*ops = &alsa_mmap_write_ops;
+      //Batch and plugin devices may have already fetched committed frames.
+      hbuf->rewrite = mmap && ! batch;
     } else
     {
       if ( mmap )
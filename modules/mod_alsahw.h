@@ -19,6 +19,15 @@ int32_t alsahw_pcm_status(void *handle, const struct dspd_pcm_status **status, b
 intptr_t alsahw_pcm_rewind(void *handle, uintptr_t frames);
 intptr_t alsahw_pcm_forward(void *handle, uintptr_t frames);
 intptr_t alsahw_pcm_rewindable(void *handle);
+intptr_t alsahw_pcm_rewritable(void *handle);
+int32_t alsahw_pcm_rewrite_begin(void *handle,
+				 uintptr_t back,
+				 void **ptr,
+				 uintptr_t *offset,
+				 uintptr_t *frames);
+intptr_t alsahw_pcm_rewrite_commit(void *handle,
+				   uintptr_t offset,
+				   uintptr_t frames);
 void alsahw_set_volume(void *handle, double volume);
 int32_t alsahw_pcm_write_begin(void *handle,
 				void **buf,
@@ -49,6 +58,7 @@ struct alsahw_handle {
   snd_pcm_t                *handle;
   union {
     dspd_fromfloat64wv_t    fromdouble;
+    dspd_fromfloat32wv_t    fromfloat;
     dspd_tofloat32wv_t      tofloat;
   } convert;
   union { 
@@ -64,6 +74,7 @@ struct alsahw_handle {
   uintptr_t                 min_dma_bytes;
   uintptr_t                 frame_size;
   uintptr_t                 channels;
+  uintptr_t                 mix_frame_size; //playback mix buffer frame size
   double                    volume;
   snd_pcm_status_t         *alsa_status;
   void                     *hw_addr;
@@ -78,6 +89,8 @@ struct alsahw_handle {
   uintptr_t                 samples_read;
   uint64_t                  saved_appl;
   bool                      is_rewound;
+  //The mmap area is the DMA buffer so committed frames can be changed in place.
+  bool                      rewrite;
   
   int                       stream;
  
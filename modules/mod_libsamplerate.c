@@ -31,6 +31,7 @@ struct dspd_src_state {
   uint32_t   rate_in, rate_out;
   uint32_t   src_type;
   uint32_t   quality;
+  uint32_t   channels;
 };
 #define MAX_QUALITY 5
 #define MIN_QUALITY 1
@@ -87,6 +88,7 @@ static int32_t src_new_cb(dspd_src_t *src, int quality, int channels)
   if ( ! st )
     return -errno;
   st->quality = quality;
+  st->channels = channels;
   st->state = src_new(src_q2t(quality), channels, &err);
   fflush(NULL);
   if ( ! st->state )
@@ -124,6 +126,39 @@ static int32_t src_process_cb(dspd_src_t   src,
   return ret;
 }
 
+static int32_t src_process_v_cb(dspd_src_t                             src,
+				bool                                   eof,
+				const struct dspd_src_iov * __restrict iov,
+				size_t                                 niov,
+				size_t                    * __restrict frames_in,
+				float                     * __restrict outbuf,
+				size_t                    * __restrict frames_out)
+{
+  struct dspd_src_state *st = src;
+  size_t i, itotal = 0, ototal = 0, olen = *frames_out;
+  int ret = 0;
+  for ( i = 0; i < niov && ototal < olen; i++ )
+    {
+      st->data.end_of_input = eof && i == (niov - 1);
+      st->data.input_frames = iov[i].frames;
+      st->data.output_frames = olen - ototal;
+      st->data.data_in = (float*)iov[i].buf;
+      st->data.data_out = &outbuf[ototal * st->channels];
+      if ( src_process(st->state, &st->data) )
+	{
+	  ret = -EINVAL;
+	  break;
+	}
+      itotal += st->data.input_frames_used;
+      ototal += st->data.output_frames_gen;
+      if ( st->data.input_frames_used < iov[i].frames )
+	break;
+    }
+  *frames_in = itotal;
+  *frames_out = ototal;
+  return ret;
+}
+
 
 static void src_info_cb(struct dspd_src_info *info)
 {
@@ -174,6 +209,7 @@ static struct dspd_src_ops src_ops = {
   .set_rates = src_set_rates_cb,
   .reset = src_reset_cb,
   .process = src_process_cb,
+  .process_v = src_process_v_cb,
   .newsrc = src_new_cb,
   .freesrc = src_free_cb,
   .info = src_info_cb,
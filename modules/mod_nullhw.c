@@ -0,0 +1,936 @@
+/*
+ *  NULLHW - Null sound card driver
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+  A sound card that has no hardware.  The hardware pointer is calculated from
+  the daemon clock, so the io thread sleeps and wakes up exactly like it does
+  for a real card and the whole mixing path (clients, mix buffer, format
+  conversion) runs.  Playback is converted to the configured format and
+  thrown away.  Capture is silence, or in loopback mode it is whatever a full
+  duplex device played when the frame was captured.
+
+  Devices are listed in mod_nullhw.conf.  Each section is a hotplug event:
+
+  [null0]
+  name=null:0
+  description=Null Device
+  stream=fullduplex
+  loopback=1
+  rate=48000
+  channels=2
+  format=S16_LE
+  bufsize=8192
+  fragsize=1024
+*/
+
+#include <unistd.h>
+#include <errno.h>
+#include "../lib/sslib.h"
+#include "../lib/daemon.h"
+
+#define NULLHW_DEVTYPE "null"
+
+struct nullhw_handle {
+  int32_t                   stream;
+  int32_t                   err;
+  struct dspd_drv_params    params;
+  struct dspd_pcm_status    status;
+  const struct pcm_conv    *conv;
+  //Playback mix buffer (double or float) or capture buffer (float)
+  union {
+    double                 *addr64;
+    float                  *addr32;
+    void                   *addr;
+  } buffer;
+  size_t                    mix_frame_size;
+  //Fake DMA buffer in the device format
+  char                     *hw_buf;
+  size_t                    frame_size;
+  uint64_t                  erase_ptr;
+  //Time of frame 0 or 0 if not started
+  dspd_time_t               start_time;
+  uintptr_t                 vbufsize;
+  uintptr_t                 min_dma;
+  double                    volume;
+  int32_t                   stream_index;
+  uint64_t                  hotplug_event_id;
+  struct dspd_pcm_chmap_container channel_map;
+  //Full duplex: the other half.  Capture reads from it in loopback mode.
+  struct nullhw_handle     *other;
+  bool                      loopback;
+};
+
+static struct dspd_dict *config_sections;
+
+//Frames played or captured in t nanoseconds.
+static uint64_t nullhw_frames(const struct nullhw_handle *hdl, dspd_time_t t)
+{
+  return ((t / 1000000000ULL) * hdl->params.rate) +
+    (((t % 1000000000ULL) * hdl->params.rate) / 1000000000ULL);
+}
+
+static inline void calculate_playback_space(struct nullhw_handle *hdl)
+{
+  if ( hdl->status.fill >= hdl->vbufsize )
+    hdl->status.space = 0;
+  else
+    hdl->status.space = hdl->vbufsize - hdl->status.fill;
+}
+
+static void nullhw_update(struct nullhw_handle *hdl)
+{
+  dspd_time_t now = dspd_get_time();
+  uint64_t pos = 0;
+  if ( hdl->start_time != 0 && now > hdl->start_time )
+    pos = nullhw_frames(hdl, now - hdl->start_time);
+  hdl->status.tstamp = now;
+  if ( hdl->stream == DSPD_PCM_STREAM_PLAYBACK )
+    {
+      //Same as ALSA: it is an underrun when the hardware catches up.
+      if ( hdl->start_time != 0 && pos >= hdl->status.appl_ptr )
+	{
+	  pos = hdl->status.appl_ptr;
+	  hdl->err = -EPIPE;
+	}
+      hdl->status.hw_ptr = pos;
+      hdl->status.fill = hdl->status.appl_ptr - pos;
+      hdl->status.delay = hdl->status.fill;
+      calculate_playback_space(hdl);
+    } else
+    {
+      hdl->status.hw_ptr = pos;
+      hdl->status.fill = pos - hdl->status.appl_ptr;
+      if ( pos - hdl->status.appl_ptr > hdl->params.bufsize )
+	{
+	  hdl->err = -EPIPE;
+	  hdl->status.space = 0;
+	} else
+	{
+	  hdl->status.space = hdl->params.bufsize - hdl->status.fill;
+	}
+      hdl->status.delay = hdl->status.fill;
+    }
+  hdl->status.error = hdl->err;
+}
+
+static void nullhw_reset(struct nullhw_handle *hdl)
+{
+  hdl->err = 0;
+  hdl->erase_ptr = 0;
+  hdl->start_time = 0;
+  memset(&hdl->status, 0, sizeof(hdl->status));
+  if ( hdl->stream == DSPD_PCM_STREAM_PLAYBACK )
+    hdl->status.space = hdl->vbufsize;
+  else
+    hdl->status.space = hdl->params.bufsize;
+}
+
+//How many frames can be changed without getting too close to the hardware pointer.
+static intptr_t nullhw_playback_rewindable(struct nullhw_handle *hdl)
+{
+  intptr_t maxframes;
+  if ( hdl->err )
+    return hdl->err;
+  nullhw_update(hdl);
+  if ( hdl->err )
+    return hdl->err;
+  maxframes = hdl->status.fill;
+  if ( maxframes <= (intptr_t)hdl->min_dma )
+    return 0;
+  maxframes -= maxframes % hdl->min_dma;
+  maxframes -= hdl->min_dma;
+  return maxframes;
+}
+
+static inline void playback_convert(struct nullhw_handle *hdl, uintptr_t offset, uintptr_t frames)
+{
+  char *hw = &hdl->hw_buf[offset * hdl->frame_size];
+  if ( hdl->params.mix_precision == DSPD_MIX_PRECISION_FLOAT32 )
+    hdl->conv->fromfloat32wv(&hdl->buffer.addr32[offset * hdl->params.channels],
+			     hw,
+			     frames * hdl->params.channels,
+			     hdl->volume);
+  else
+    hdl->conv->fromfloat64wv(&hdl->buffer.addr64[offset * hdl->params.channels],
+			     hw,
+			     frames * hdl->params.channels,
+			     hdl->volume);
+}
+
+static int32_t nullhw_mmap_begin(void *handle,
+				 void **ptr,
+				 uintptr_t *offset,
+				 uintptr_t *frames)
+{
+  struct nullhw_handle *hdl = handle;
+  uintptr_t o, f;
+  if ( hdl->err )
+    return hdl->err;
+  f = hdl->status.space;
+  if ( f > *frames )
+    f = *frames;
+  o = hdl->status.appl_ptr % hdl->params.bufsize;
+  if ( f > hdl->params.bufsize - o )
+    f = hdl->params.bufsize - o;
+  if ( f > 0 && hdl->status.appl_ptr == hdl->erase_ptr )
+    {
+      memset((char*)hdl->buffer.addr + (o * hdl->mix_frame_size), 0, hdl->mix_frame_size * f);
+      hdl->erase_ptr += f;
+    }
+  *ptr = hdl->buffer.addr;
+  *offset = o;
+  *frames = f;
+  return 0;
+}
+
+static intptr_t nullhw_mmap_commit(void *handle,
+				   uintptr_t offset,
+				   uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  uintptr_t maxframes;
+  if ( hdl->err )
+    return hdl->err;
+  maxframes = hdl->erase_ptr - hdl->status.appl_ptr;
+  if ( frames > maxframes )
+    frames = maxframes;
+  playback_convert(hdl, offset, frames);
+  hdl->status.appl_ptr += frames;
+  hdl->status.fill += frames;
+  hdl->status.delay += frames;
+  calculate_playback_space(hdl);
+  return frames;
+}
+
+/*
+  Convert captured frames starting at device frame 'frame'.  In loopback mode
+  the frame that was playing at the same time is used if it is still in the
+  playback buffer.  Everything else is silence.
+*/
+static void capture_fill(struct nullhw_handle *hdl, uint64_t frame, float *out, uintptr_t frames)
+{
+  struct nullhw_handle *src = hdl->loopback ? hdl->other : NULL;
+  int64_t p, lo, hi, delta = 0;
+  uintptr_t n, o;
+  bool valid;
+  if ( src != NULL && src->start_time != 0 && hdl->start_time != 0 && src->err == 0 )
+    {
+      if ( hdl->start_time >= src->start_time )
+	delta = nullhw_frames(hdl, hdl->start_time - src->start_time);
+      else
+	delta = -(int64_t)nullhw_frames(hdl, src->start_time - hdl->start_time);
+    } else
+    {
+      src = NULL;
+    }
+  while ( frames > 0 )
+    {
+      n = frames;
+      valid = false;
+      o = 0;
+      if ( src )
+	{
+	  p = (int64_t)frame + delta;
+	  hi = src->status.appl_ptr;
+	  lo = hi - (int64_t)src->params.bufsize;
+	  if ( lo < 0 )
+	    lo = 0;
+	  if ( p < lo )
+	    {
+	      if ( (uint64_t)(lo - p) < n )
+		n = lo - p;
+	    } else if ( p < hi )
+	    {
+	      if ( (uint64_t)(hi - p) < n )
+		n = hi - p;
+	      o = p % src->params.bufsize;
+	      if ( src->params.bufsize - o < n )
+		n = src->params.bufsize - o;
+	      valid = true;
+	    }
+	}
+      if ( valid )
+	hdl->conv->tofloat32wv(&src->hw_buf[o * src->frame_size],
+			       out,
+			       n * hdl->params.channels,
+			       hdl->volume);
+      else
+	memset(out, 0, n * hdl->params.channels * sizeof(*out));
+      out += n * hdl->params.channels;
+      frame += n;
+      frames -= n;
+    }
+}
+
+static int32_t nullhw_read_begin(void *handle,
+				 void **ptr,
+				 uintptr_t *offset,
+				 uintptr_t *frames)
+{
+  struct nullhw_handle *hdl = handle;
+  uintptr_t o, f;
+  if ( hdl->err )
+    return hdl->err;
+  f = hdl->status.fill;
+  if ( f > *frames )
+    f = *frames;
+  o = hdl->status.appl_ptr % hdl->params.bufsize;
+  if ( f > hdl->params.bufsize - o )
+    f = hdl->params.bufsize - o;
+  if ( f > 0 )
+    capture_fill(hdl, hdl->status.appl_ptr, &hdl->buffer.addr32[o * hdl->params.channels], f);
+  *ptr = hdl->buffer.addr32;
+  *offset = o;
+  *frames = f;
+  return 0;
+}
+
+static intptr_t nullhw_read_commit(void *handle,
+				   uintptr_t offset,
+				   uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  if ( hdl->err )
+    return hdl->err;
+  if ( frames > hdl->status.fill )
+    frames = hdl->status.fill;
+  hdl->status.appl_ptr += frames;
+  hdl->status.fill -= frames;
+  hdl->status.space += frames;
+  hdl->status.delay -= frames;
+  return frames;
+}
+
+static int32_t nullhw_recover(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  nullhw_reset(hdl);
+  return 0;
+}
+
+static int32_t nullhw_start(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  if ( hdl->err )
+    return hdl->err;
+  hdl->start_time = dspd_get_time();
+  if ( hdl->start_time == 0 )
+    hdl->err = -EIO;
+  return hdl->err;
+}
+
+static int32_t nullhw_drop(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  nullhw_reset(hdl);
+  return 0;
+}
+
+static int32_t nullhw_prepare(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  nullhw_reset(hdl);
+  return 0;
+}
+
+static int32_t nullhw_status(void *handle, const struct dspd_pcm_status **status, bool hwsync)
+{
+  struct nullhw_handle *hdl = handle;
+  if ( hdl->err == 0 )
+    nullhw_update(hdl);
+  *status = &hdl->status;
+  return hdl->err;
+}
+
+static intptr_t nullhw_rewind(void *handle, uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  intptr_t rw = nullhw_playback_rewindable(hdl);
+  if ( rw < 0 )
+    return rw;
+  if ( frames > (uintptr_t)rw )
+    frames = rw;
+  hdl->status.appl_ptr -= frames;
+  hdl->status.fill -= frames;
+  hdl->status.delay -= frames;
+  calculate_playback_space(hdl);
+  return frames;
+}
+
+static intptr_t nullhw_forward(void *handle, uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  uintptr_t maxfw;
+  if ( hdl->err )
+    return hdl->err;
+  maxfw = hdl->erase_ptr - hdl->status.appl_ptr;
+  if ( frames > maxfw )
+    frames = maxfw;
+  hdl->status.appl_ptr += frames;
+  hdl->status.fill += frames;
+  hdl->status.delay += frames;
+  calculate_playback_space(hdl);
+  return frames;
+}
+
+static intptr_t nullhw_rewindable(void *handle)
+{
+  return nullhw_playback_rewindable(handle);
+}
+
+static int32_t nullhw_rewrite_begin(void *handle,
+				    uintptr_t back,
+				    void **ptr,
+				    uintptr_t *offset,
+				    uintptr_t *frames)
+{
+  struct nullhw_handle *hdl = handle;
+  uintptr_t o, f;
+  if ( hdl->err )
+    return hdl->err;
+  if ( back > hdl->status.fill )
+    return -EINVAL;
+  o = (hdl->status.appl_ptr - back) % hdl->params.bufsize;
+  f = hdl->params.bufsize - o;
+  if ( f > back )
+    f = back;
+  if ( *frames > f )
+    *frames = f;
+  *offset = o;
+  *ptr = hdl->buffer.addr;
+  return 0;
+}
+
+static intptr_t nullhw_rewrite_commit(void *handle,
+				      uintptr_t offset,
+				      uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  if ( hdl->err )
+    return hdl->err;
+  playback_convert(hdl, offset, frames);
+  return frames;
+}
+
+//Captured frames stay in the fake hardware buffer until it wraps around.
+static intptr_t nullhw_capture_rewindable(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  uint64_t ret;
+  if ( hdl->err )
+    return hdl->err;
+  ret = hdl->params.bufsize - hdl->status.fill;
+  if ( ret > hdl->status.appl_ptr )
+    ret = hdl->status.appl_ptr;
+  return ret;
+}
+
+static intptr_t nullhw_capture_rewind(void *handle, uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  intptr_t rw = nullhw_capture_rewindable(handle);
+  if ( rw < 0 )
+    return rw;
+  if ( frames > (uintptr_t)rw )
+    frames = rw;
+  hdl->status.appl_ptr -= frames;
+  hdl->status.fill += frames;
+  hdl->status.delay += frames;
+  hdl->status.space -= frames;
+  return frames;
+}
+
+static intptr_t nullhw_capture_forward(void *handle, uintptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  if ( hdl->err )
+    return hdl->err;
+  if ( frames > hdl->status.fill )
+    frames = hdl->status.fill;
+  hdl->status.appl_ptr += frames;
+  hdl->status.fill -= frames;
+  hdl->status.delay -= frames;
+  hdl->status.space += frames;
+  return frames;
+}
+
+static intptr_t nullhw_adjust_pointer(void *handle, intptr_t frames)
+{
+  struct nullhw_handle *hdl = handle;
+  intptr_t ret;
+  if ( hdl->err )
+    ret = 0;
+  else
+    ret = frames;
+  hdl->status.appl_ptr += frames;
+  if ( hdl->stream == DSPD_PCM_STREAM_PLAYBACK )
+    {
+      hdl->status.delay += frames;
+      hdl->status.fill += frames;
+      calculate_playback_space(hdl);
+    } else
+    {
+      hdl->status.delay -= frames;
+      hdl->status.fill -= frames;
+      hdl->status.space += frames;
+    }
+  return ret;
+}
+
+static void nullhw_set_volume(void *handle, double volume)
+{
+  struct nullhw_handle *hdl = handle;
+  hdl->volume = volume;
+}
+
+static uintptr_t nullhw_set_latency(void *handle, uintptr_t buffer_size, uintptr_t latency)
+{
+  struct nullhw_handle *hdl = handle;
+  if ( buffer_size < hdl->params.min_latency )
+    hdl->vbufsize = hdl->params.min_latency;
+  else if ( buffer_size > hdl->params.max_latency )
+    hdl->vbufsize = hdl->params.max_latency;
+  else
+    hdl->vbufsize = buffer_size;
+  if ( hdl->stream == DSPD_PCM_STREAM_PLAYBACK )
+    calculate_playback_space(hdl);
+  return hdl->vbufsize;
+}
+
+/*
+  There is nothing to poll.  The io thread already sleeps on its own timer
+  until the time calculated from the status timestamp, which is the same
+  clock the hardware pointer comes from.
+*/
+static int32_t nullhw_poll_descriptors_count(void *handle)
+{
+  return 0;
+}
+
+static int32_t nullhw_poll_descriptors(void *handle,
+				       struct pollfd *pfds,
+				       uint32_t space)
+{
+  return 0;
+}
+
+static int32_t nullhw_poll_revents(void *handle,
+				   struct pollfd *pfds,
+				   uint32_t nfds,
+				   uint16_t *revents)
+{
+  *revents = 0;
+  return 0;
+}
+
+static int32_t nullhw_get_params(void *handle, struct dspd_drv_params *params)
+{
+  struct nullhw_handle *hdl = handle;
+  memcpy(params, &hdl->params, sizeof(*params));
+  return 0;
+}
+
+static void nullhw_destructor(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  int32_t p = -1, c = -1;
+  if ( hdl->stream == DSPD_PCM_STREAM_PLAYBACK )
+    p = hdl->stream_index;
+  else
+    c = hdl->stream_index;
+  if ( hdl->other )
+    {
+      if ( hdl->other->stream == DSPD_PCM_STREAM_PLAYBACK )
+	p = hdl->other->stream_index;
+      else
+	c = hdl->other->stream_index;
+      hdl->other->other = NULL;
+      hdl->other->loopback = false;
+    }
+  dspd_daemon_vctrl_unregister(p, c, &hdl->hotplug_event_id);
+  free(hdl->buffer.addr);
+  free(hdl->hw_buf);
+  free(hdl->params.desc);
+  free(hdl->params.name);
+  free(hdl);
+}
+
+static void nullhw_set_stream_index(void *handle, int32_t idx)
+{
+  struct nullhw_handle *hdl = handle;
+  hdl->stream_index = idx;
+}
+
+static int32_t nullhw_get_error(void *handle)
+{
+  struct nullhw_handle *hdl = handle;
+  return hdl->err;
+}
+
+static int32_t nullhw_get_chmap(void *handle, struct dspd_pcm_chmap *map)
+{
+  struct nullhw_handle *hdl = handle;
+  memcpy(map,
+	 &hdl->channel_map.map,
+	 dspd_pcm_chmap_sizeof(hdl->channel_map.map.count, hdl->channel_map.map.flags));
+  return 0;
+}
+
+static const struct dspd_pcmdrv_ops nullhw_playback_ops = {
+  .mmap_begin = nullhw_mmap_begin,
+  .mmap_commit = nullhw_mmap_commit,
+  .recover = nullhw_recover,
+  .start = nullhw_start,
+  .prepare = nullhw_prepare,
+  .status = nullhw_status,
+  .rewind = nullhw_rewind,
+  .forward = nullhw_forward,
+  .rewindable = nullhw_rewindable,
+  .set_volume = nullhw_set_volume,
+  .set_latency = nullhw_set_latency,
+  .drop = nullhw_drop,
+  .poll_descriptors_count = nullhw_poll_descriptors_count,
+  .poll_descriptors = nullhw_poll_descriptors,
+  .poll_revents = nullhw_poll_revents,
+  .get_params = nullhw_get_params,
+  .destructor = nullhw_destructor,
+  .get_error = nullhw_get_error,
+  .set_stream_index = nullhw_set_stream_index,
+  .get_chmap = nullhw_get_chmap,
+  .adjust_pointer = nullhw_adjust_pointer,
+  .rewritable = nullhw_rewindable,
+  .rewrite_begin = nullhw_rewrite_begin,
+  .rewrite_commit = nullhw_rewrite_commit,
+};
+
+static const struct dspd_pcmdrv_ops nullhw_capture_ops = {
+  .mmap_begin = nullhw_read_begin,
+  .mmap_commit = nullhw_read_commit,
+  .recover = nullhw_recover,
+  .start = nullhw_start,
+  .prepare = nullhw_prepare,
+  .status = nullhw_status,
+  .rewind = nullhw_capture_rewind,
+  .forward = nullhw_capture_forward,
+  .rewindable = nullhw_capture_rewindable,
+  .set_volume = nullhw_set_volume,
+  .set_latency = nullhw_set_latency,
+  .drop = nullhw_drop,
+  .poll_descriptors_count = nullhw_poll_descriptors_count,
+  .poll_descriptors = nullhw_poll_descriptors,
+  .poll_revents = nullhw_poll_revents,
+  .get_params = nullhw_get_params,
+  .destructor = nullhw_destructor,
+  .get_error = nullhw_get_error,
+  .set_stream_index = nullhw_set_stream_index,
+  .get_chmap = nullhw_get_chmap,
+  .adjust_pointer = nullhw_adjust_pointer,
+};
+
+static int32_t nullhw_open(const struct dspd_drv_params *params,
+			   int32_t stream,
+			   uint64_t eid,
+			   struct nullhw_handle **handle)
+{
+  struct nullhw_handle *hdl;
+  int32_t ret;
+  size_t sample_size, min_latency;
+  dspd_time_t sample_time;
+  hdl = calloc(1, sizeof(*hdl));
+  if ( ! hdl )
+    return -errno;
+  hdl->params = *params;
+  hdl->params.stream = stream;
+  hdl->params.bus = NULL;
+  hdl->params.addr = NULL;
+  hdl->params.hwid = NULL;
+  hdl->params.name = params->name ? strdup(params->name) : NULL;
+  hdl->params.desc = params->desc ? strdup(params->desc) : NULL;
+  hdl->stream = stream;
+  hdl->stream_index = -1;
+  hdl->hotplug_event_id = eid;
+  hdl->volume = 1.0;
+  ret = -EINVAL;
+  if ( (params->name && ! hdl->params.name) || (params->desc && ! hdl->params.desc) )
+    {
+      ret = -ENOMEM;
+      goto out;
+    }
+  if ( hdl->params.rate == 0 || hdl->params.channels == 0 ||
+       hdl->params.channels > DSPD_CHMAP_MAXCHAN ||
+       hdl->params.bufsize == 0 || hdl->params.fragsize == 0 ||
+       hdl->params.fragsize > hdl->params.bufsize )
+    goto out;
+  hdl->conv = dspd_getconv(hdl->params.format);
+  sample_size = dspd_get_pcm_format_size(hdl->params.format);
+  if ( hdl->conv == NULL || sample_size == 0 )
+    goto out;
+  hdl->frame_size = sample_size * hdl->params.channels;
+  hdl->hw_buf = calloc(hdl->params.bufsize, hdl->frame_size);
+  if ( stream == DSPD_PCM_STREAM_PLAYBACK )
+    hdl->mix_frame_size = hdl->params.channels * DSPD_MIX_SAMPLE_SIZE(hdl->params.mix_precision);
+  else
+    hdl->mix_frame_size = hdl->params.channels * sizeof(*hdl->buffer.addr32);
+  hdl->buffer.addr = calloc(hdl->params.bufsize, hdl->mix_frame_size);
+  if ( ! (hdl->hw_buf && hdl->buffer.addr) )
+    {
+      ret = -ENOMEM;
+      goto out;
+    }
+
+  //There is no DMA, so the margin is just enough to cover timer slack.
+  sample_time = 1000000000 / hdl->params.rate;
+  if ( hdl->params.min_dma == 0 )
+    {
+      hdl->min_dma = 1;
+      while ( hdl->min_dma * sample_time < 1000000 )
+	hdl->min_dma *= 2;
+    } else
+    {
+      hdl->min_dma = hdl->params.min_dma;
+    }
+  if ( hdl->min_dma > hdl->params.fragsize )
+    hdl->min_dma = hdl->params.fragsize;
+  hdl->params.min_dma = hdl->min_dma;
+
+  if ( hdl->params.min_latency == 0 )
+    {
+      min_latency = dspd_get_min_latency() / sample_time;
+      hdl->params.min_latency = hdl->min_dma * 2;
+      while ( hdl->params.min_latency < min_latency )
+	hdl->params.min_latency *= 2;
+    }
+  if ( hdl->params.min_latency > hdl->params.bufsize )
+    hdl->params.min_latency = hdl->params.bufsize;
+  if ( hdl->params.max_latency == 0 || hdl->params.max_latency > hdl->params.bufsize )
+    hdl->params.max_latency = hdl->params.bufsize;
+  if ( hdl->params.max_latency < hdl->params.min_latency )
+    hdl->params.max_latency = hdl->params.min_latency;
+  hdl->vbufsize = hdl->params.bufsize;
+
+  hdl->channel_map.map.count = hdl->params.channels;
+  ret = dspd_pcm_chmap_any(NULL, &hdl->channel_map.map);
+  if ( ret < 0 )
+    goto out;
+  if ( stream == DSPD_PCM_STREAM_PLAYBACK )
+    hdl->channel_map.map.flags |= DSPD_PCM_SBIT_PLAYBACK;
+  else
+    hdl->channel_map.map.flags |= DSPD_PCM_SBIT_CAPTURE;
+  nullhw_reset(hdl);
+  *handle = hdl;
+  return 0;
+
+ out:
+  free(hdl->buffer.addr);
+  free(hdl->hw_buf);
+  free(hdl->params.name);
+  free(hdl->params.desc);
+  free(hdl);
+  return ret;
+}
+
+static int nullhw_score(void *arg, const struct dspd_dict *device)
+{
+  int ret;
+  if ( dspd_dict_test_value(device, DSPD_HOTPLUG_DEVTYPE, NULLHW_DEVTYPE) )
+    ret = 127;
+  else
+    ret = 0;
+  return ret;
+}
+
+static int nullhw_add(void *arg, const struct dspd_dict *device)
+{
+  struct dspd_drv_params params;
+  struct nullhw_handle *hlist[2] = { NULL, NULL };
+  void *handles[2] = { NULL, NULL };
+  char *desc = NULL, *eidstr = NULL, *val = NULL;
+  uint64_t eid = 0;
+  int32_t ret, err, sbits = 0;
+  char str[DSPD_MIX_NAME_MAX];
+  struct dspd_vctrl_reg info;
+  memset(&info, 0, sizeof(info));
+  dspd_dict_find_value(device, DSPD_HOTPLUG_DESC, &desc);
+  dspd_dict_find_value(device, DSPD_HOTPLUG_EVENT_ID, &eidstr);
+  if ( eidstr )
+    dspd_strtou64(eidstr, &eid, 0);
+
+  ret = dspd_daemon_get_config(device, &params);
+  if ( ret )
+    return ret;
+  //The hotplug event is the whole config for this device.
+  dspd_daemon_apply_config(device, &params);
+
+  if ( params.stream == DSPD_PCM_STREAM_PLAYBACK || params.stream == DSPD_PCM_STREAM_FULLDUPLEX )
+    {
+      ret = nullhw_open(&params, DSPD_PCM_STREAM_PLAYBACK, eid, &hlist[DSPD_PCM_STREAM_PLAYBACK]);
+      if ( ret < 0 )
+	goto out;
+      sbits |= DSPD_PCM_SBIT_PLAYBACK;
+    }
+  if ( params.stream == DSPD_PCM_STREAM_CAPTURE || params.stream == DSPD_PCM_STREAM_FULLDUPLEX )
+    {
+      ret = nullhw_open(&params, DSPD_PCM_STREAM_CAPTURE, eid, &hlist[DSPD_PCM_STREAM_CAPTURE]);
+      if ( ret < 0 )
+	goto out;
+      sbits |= DSPD_PCM_SBIT_CAPTURE;
+    }
+  if ( sbits == DSPD_PCM_SBIT_FULLDUPLEX )
+    {
+      hlist[DSPD_PCM_STREAM_PLAYBACK]->other = hlist[DSPD_PCM_STREAM_CAPTURE];
+      hlist[DSPD_PCM_STREAM_CAPTURE]->other = hlist[DSPD_PCM_STREAM_PLAYBACK];
+      if ( dspd_dict_find_value(device, "loopback", &val) && val != NULL &&
+	   strcmp(val, "0") != 0 && strcasecmp(val, "no") != 0 )
+	hlist[DSPD_PCM_STREAM_CAPTURE]->loopback = true;
+      handles[DSPD_PCM_STREAM_PLAYBACK] = hlist[DSPD_PCM_STREAM_PLAYBACK];
+      handles[DSPD_PCM_STREAM_CAPTURE] = hlist[DSPD_PCM_STREAM_CAPTURE];
+    } else if ( sbits == DSPD_PCM_SBIT_PLAYBACK )
+    {
+      handles[0] = hlist[DSPD_PCM_STREAM_PLAYBACK];
+    } else if ( sbits == DSPD_PCM_SBIT_CAPTURE )
+    {
+      handles[0] = hlist[DSPD_PCM_STREAM_CAPTURE];
+    } else
+    {
+      ret = -EINVAL;
+      goto out;
+    }
+
+  dspd_log(0, "nullhw: Adding '%s' rate=%u channels=%u bufsize=%u fragsize=%u loopback=%d",
+	   desc, params.rate, params.channels, params.bufsize, params.fragsize,
+	   hlist[DSPD_PCM_STREAM_CAPTURE] ? hlist[DSPD_PCM_STREAM_CAPTURE]->loopback : 0);
+
+  ret = dspd_daemon_add_device(handles,
+			       sbits,
+			       eid,
+			       (sbits & DSPD_PCM_SBIT_PLAYBACK) ? &nullhw_playback_ops : NULL,
+			       (sbits & DSPD_PCM_SBIT_CAPTURE) ? &nullhw_capture_ops : NULL);
+  if ( ret < 0 )
+    goto out;
+
+  if ( sbits == DSPD_PCM_SBIT_PLAYBACK )
+    snprintf(str, sizeof(str), "%d: %s Playback", ret, desc);
+  else if ( sbits == DSPD_PCM_SBIT_CAPTURE )
+    snprintf(str, sizeof(str), "%d: %s Capture", ret, desc);
+  else
+    snprintf(str, sizeof(str), "%d: %s", ret, desc);
+  info.type = DSPD_VCTRL_DEVICE;
+  info.initval = 1.0;
+  info.hotplug_event_id = eid;
+  info.displayname = str;
+  info.playback = (sbits & DSPD_PCM_SBIT_PLAYBACK) ? ret : -1;
+  info.capture = (sbits & DSPD_PCM_SBIT_CAPTURE) ? ret : -1;
+  err = dspd_daemon_vctrl_register(&info);
+  if ( err < 0 )
+    dspd_log(0, "nullhw: Could not register virtual control: error %d", err);
+  hlist[0] = NULL;
+  hlist[1] = NULL;
+
+ out:
+  if ( hlist[DSPD_PCM_STREAM_PLAYBACK] )
+    nullhw_destructor(hlist[DSPD_PCM_STREAM_PLAYBACK]);
+  if ( hlist[DSPD_PCM_STREAM_CAPTURE] )
+    nullhw_destructor(hlist[DSPD_PCM_STREAM_CAPTURE]);
+  free(params.addr);
+  free(params.name);
+  free(params.bus);
+  free(params.desc);
+  free(params.hwid);
+  return ret;
+}
+
+static int nullhw_remove(void *arg, const struct dspd_dict *device)
+{
+  const char *slot = dspd_dict_value_for_key(device, DSPD_HOTPLUG_SLOT);
+  int32_t idx;
+  if ( slot == NULL || dspd_strtoi32(slot, &idx, 0) < 0 || idx <= 0 )
+    return -ENODEV;
+  if ( dspd_daemon_ref(idx, DSPD_DCTL_ENUM_TYPE_SERVER) == 0 )
+    {
+      (void)dspd_stream_ctl(&dspd_dctx, idx, DSPD_SCTL_SERVER_REMOVE, NULL, 0, NULL, 0, NULL);
+      dspd_daemon_unref(idx);
+    }
+  return 0;
+}
+
+static struct dspd_hotplug_cb nullhw_hotplug = {
+  .score = nullhw_score,
+  .add = nullhw_add,
+  .remove = nullhw_remove,
+};
+
+static void trigger_hotplug_events(void *arg)
+{
+  struct dspd_dict *curr;
+  char eid[32UL], *e, *desc;
+  int ret;
+  for ( curr = config_sections; curr; curr = curr->next )
+    {
+      if ( ! dspd_dict_find_value(curr, DSPD_HOTPLUG_EVENT_ID, &e) )
+	{
+	  dspd_daemon_hotplug_event_id(eid);
+	  if ( ! dspd_dict_insert_value(curr, DSPD_HOTPLUG_EVENT_ID, eid) )
+	    continue;
+	}
+      if ( ! dspd_dict_find_value(curr, DSPD_HOTPLUG_DEVTYPE, &e) )
+	{
+	  if ( ! dspd_dict_insert_value(curr, DSPD_HOTPLUG_DEVTYPE, NULLHW_DEVTYPE) )
+	    continue;
+	}
+      if ( ! dspd_dict_find_value(curr, DSPD_HOTPLUG_DEVNAME, &e) )
+	{
+	  if ( ! dspd_dict_insert_value(curr, DSPD_HOTPLUG_DEVNAME, curr->name) )
+	    continue;
+	}
+      desc = NULL;
+      dspd_dict_find_value(curr, DSPD_HOTPLUG_DESC, &desc);
+      dspd_log(0, "nullhw: Adding '%s'...", desc);
+      ret = dspd_daemon_hotplug_add(curr);
+      dspd_log(0, "nullhw: result is %d.", ret);
+    }
+}
+
+static int nullhw_init(struct dspd_daemon_ctx *daemon, void **context)
+{
+  int ret = dspd_daemon_hotplug_register(&nullhw_hotplug, NULL);
+  if ( ret != 0 )
+    {
+      dspd_log(0, "Could not register hotplug handler for nullhw: error %d", ret);
+      return ret;
+    }
+  config_sections = dspd_read_config("mod_nullhw", true);
+  if ( config_sections )
+    dspd_daemon_register_startup(trigger_hotplug_events, NULL);
+  else
+    dspd_log(0, "nullhw: No devices configured");
+  return 0;
+}
+
+static void nullhw_close(struct dspd_daemon_ctx *daemon, void **context)
+{
+
+}
+
+struct dspd_mod_cb dspd_mod_nullhw = {
+  .init_priority = DSPD_MOD_INIT_PRIO_HWDRV,
+  .desc = "Null PCM Driver",
+  .init = nullhw_init,
+  .close = nullhw_close,
+};
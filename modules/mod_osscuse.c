@@ -29,8 +29,8 @@
   2.  It spawns threads while processing.
   3.  It calls malloc() while processing.
   4.  It requires at least one thread per device.  I think it is possible to do
-  all of each type of device node on 1 thread per type.  Then use a thread per client
-  and another to defer blocking work.
+  all of each type of device node on 1 thread per type.  Then use a small pool
+  of workers for the clients and park requests that would block.
 
 
   
@@ -75,7 +75,8 @@ static const struct snd_mixer_oss_assign_table ossv4_table[];
 #define CTL_PKTLEN 5120
 
 static struct dspd_oss_server server_context;
-static void *dsp_worker(void *p);
+static void dsp_worker_add(struct oss_cdev_client *cli);
+static void dsp_client_wake(struct oss_cdev_client *cli);
 static void remove_cdev(struct oss_dsp_cdev *cdev);
 
 static void insert_cdev(struct oss_dsp_cdev *cdev);
@@ -462,13 +463,7 @@ static int dsp_queue_req(struct oss_cdev_client *cli, struct rtcuse_ipkt *pkt, v
   AO_store(&p->canceled, IORP_OK);
   p->unique = pkt->header.unique;
   dspd_fifo_wcommit(cli->eventq, 1);
-  if ( AO_test_and_set(&cli->wakeup) != AO_TS_SET )
-    {
-      dspd_mutex_lock(&cli->lock);
-      assert(pthread_mutex_trylock(&cli->lock.mutex) != 0);
-      dspd_cond_signal(&cli->event);
-      dspd_mutex_unlock(&cli->lock);
-    }
+  dsp_client_wake(cli);
   return 0;
 }
 
@@ -507,8 +502,6 @@ static void free_client_cb(struct cbpoll_ctx *ctx,
       dspd_rclient_delete(cli->dsp.rclient);
       dspd_rtalloc_delete(cli->alloc);
       dspd_fifo_delete(cli->eventq);
-      dspd_mutex_destroy(&cli->lock);
-      dspd_cond_destroy(&cli->event);
       free(cli->dsp.readbuf);
       cli->dsp.readbuf = NULL;
       dspd_stream_ctl(&dspd_dctx, 
@@ -590,10 +583,7 @@ static void dsp_cdev_seterror_cb(struct cbpoll_ctx *ctx, struct cbpoll_msg *evt,
 	    {
 	      cli->op_error = evt->index;
 	      if ( ! dev->is_mixer )
-		{
-		  cli->wakeup = AO_TS_SET;
-		  dspd_cond_signal(&cli->event);
-		}
+		dsp_client_wake(cli);
 	    }
 	  count++;
 	}
@@ -700,12 +690,6 @@ static void async_dsp_new_client(struct cbpoll_ctx *ctx,
 
 
   cli->cdev_slot = slot;
-  err = dspd_cond_init(&cli->event, &server_context.client_condattr);
-  if ( err )
-    goto error;
-  err = dspd_mutex_init(&cli->lock, NULL);
-  if ( err )
-    goto error;
 
   cli->flags = req->flags;
   cli->unique = req->unique;
@@ -910,20 +894,8 @@ static void async_dsp_new_client(struct cbpoll_ctx *ctx,
   if ( err )
     goto error;
  
-  err = pthread_create(&cli->thread, &server_context.client_threadattr, dsp_worker, cli);
-  if ( err == EPERM )
-    {
-      pthread_attr_t attr;
-      if ( dspd_daemon_threadattr_init(&attr,
-				       sizeof(attr),
-				       DSPD_THREADATTR_DETACHED) == 0 )
-	{
-	  err = pthread_create(&cli->thread, &server_context.client_threadattr, dsp_worker, cli);
-	  pthread_attr_destroy(&attr);
-	}
-    }
-  if ( err )
-    goto error;
+  //The worker replies to the open request when it picks up the client.
+  dsp_worker_add(cli);
  
   
 
@@ -943,8 +915,6 @@ static void async_dsp_new_client(struct cbpoll_ctx *ctx,
 	dspd_rtalloc_delete(cli->alloc);
       if ( cli->eventq )
 	dspd_fifo_delete(cli->eventq);
-      dspd_cond_destroy(&cli->event);
-      dspd_mutex_destroy(&cli->lock);
 
       free(cli->dsp.readbuf);
       free(cli);
@@ -1486,24 +1456,6 @@ int oss_reply_error(struct oss_cdev_client *cli, int32_t error)
 
 
 
-static bool queue_ready(struct oss_cdev_client *cli)
-{
-  bool ret;
-  uint32_t len;
-  if ( cli->wakeup == AO_TS_SET )
-    {
-      AO_CLEAR(&cli->wakeup);
-      ret = 1;
-    } else if ( dspd_fifo_len(cli->eventq, &len) == 0 )
-    {
-      ret = (len > 0);
-    } else
-    {
-      ret = 0;
-    }
-  return ret;
-}
-
 static bool fifo_changed(struct oss_cdev_client *cli)
 {
   uint32_t len;
@@ -1515,80 +1467,80 @@ static bool fifo_changed(struct oss_cdev_client *cli)
   return ret;
 }
 
-int dspd_cdev_client_sleep(struct oss_cdev_client *cli, 
-			   dspd_time_t *abstime, 
-			   bool alertable)
+/*
+  Park the current read, write, or drain until abstime.  The handler must return
+  without replying.  The worker calls the same request again later and the
+  handler picks up where it left off with oss_cdev_client_resume().
+
+  Args:
+  cli         A dsp client instance
+  abstime     Wait until this time
+  alertable   If true, then resume early when a new io request arrives.
+  offset      Progress so far
+*/
+void oss_cdev_client_park(struct oss_cdev_client *cli, 
+			  dspd_time_t abstime,
+			  bool alertable,
+			  size_t offset)
 {
-  /*
-
-    Try to sleep until abstime.
-
-    Args:
-    cli         A dsp client instance
-    abstime     Sleep until this time or indefinitely if NULL
-    alertable   If true, then return early when a new io request arrives.
-
-    Return values:
-    0: Possible spurious wakeup.  Caller should check some stuff and go back to sleep
-       or finish the operation if appropriate.
-    EINTR: Request interrupted.  If no further read or write happens then
-    call again with abstime.
-    EBADF: File descriptor is being closed.
-    EINPROGRESS: New requests were queued
-    ETIMEDOUT: Timed out and nothing else happened.
-   */
-  uint32_t c;
-  int ret = 0, err;
-  struct timespec t;
-  if ( abstime == NULL )
-    {
-      dspd_mutex_lock(&cli->lock);
-      while ( cli->wakeup != AO_TS_SET && cli->op_error == 0 )
-	dspd_cond_wait(&cli->event, &cli->lock);
-      dspd_mutex_unlock(&cli->lock);
-    } else
-    {
-      dspd_time_to_timespec(*abstime, &t);
-      dspd_mutex_lock(&cli->lock);
-      
-      while ( (alertable != 0 && fifo_changed(cli) == 0) || (alertable == 0) )
-	{
-	  if ( AO_load(&cli->current_iorp->canceled) )
-	    {
-	      if ( cli->current_pkt->header.opcode != FUSE_RELEASE &&
-		   cli->current_pkt->header.opcode != FUSE_IOCTL )
-		break;
-	    }
-	  ret = dspd_cond_timedwait(&cli->event, &cli->lock, &t);
-	  if ( ret == ETIMEDOUT )
-	    {
-	      dspd_mutex_unlock(&cli->lock);
-	      return ETIMEDOUT;
-	    }
-	}
-      dspd_mutex_unlock(&cli->lock);
-    }
+  cli->wait.parked = true;
+  cli->wait.abstime = abstime;
+  cli->wait.alertable = alertable;
+  cli->wait.offset = offset;
+}
 
-  err = dspd_fifo_len(cli->eventq, &c);
-  assert(err == 0);
+/*
+  Find out if a parked request should run again.  The return values are the
+  same as a sleep that ended:
+
+  0: Keep waiting.
+  EINTR: Request interrupted.
+  EBADF: File descriptor is being closed.
+  EINPROGRESS: New requests were queued
+  ETIMEDOUT: Timed out and nothing else happened.
+*/
+static int dsp_wait_result(struct oss_cdev_client *cli, dspd_time_t now)
+{
+  int ret = 0;
   if ( cli->error )
     {
       ret = EBADF;
     } else if ( AO_load(&cli->current_iorp->canceled) )
     {
       ret = EINTR;
-    } else if ( cli->current_count != c )
-    {
-      ret = EINPROGRESS;
     } else if ( cli->op_error )
     {
       ret = cli->op_error;
       if ( ret < 0 )
 	ret *= -1;
+    } else if ( cli->wait.alertable && fifo_changed(cli) )
+    {
+      ret = EINPROGRESS;
+    } else if ( now >= cli->wait.abstime )
+    {
+      ret = ETIMEDOUT;
     }
   return ret;
 }
 
+/*
+  Called at the start of a read, write, or drain.  Returns true if the request was
+  parked and fills in the saved progress and the reason it woke up.
+*/
+bool oss_cdev_client_resume(struct oss_cdev_client *cli, 
+			    size_t *offset,
+			    bool *alertable,
+			    int *result)
+{
+  if ( ! cli->wait.parked )
+    return false;
+  cli->wait.parked = false;
+  *offset = cli->wait.offset;
+  *alertable = cli->wait.alertable;
+  *result = dsp_wait_result(cli, dspd_get_time());
+  return true;
+}
+
 
 static int32_t cdev_read(struct oss_cdev_client *cli)
 {
@@ -1666,6 +1618,9 @@ static int32_t cdev_release(struct oss_cdev_client *cli)
     {
       cli->ops->release(cli);
       ret = 0;
+      //Draining playback.  The worker calls this again to finish.
+      if ( cli->wait.parked )
+	return ret;
     } else
     {
       ret = 0;
@@ -1737,164 +1692,293 @@ bool dsp_check_poll(struct oss_cdev_client *cli)
   return ret;
 }
 
-static void *dsp_worker(void *p)
-{
-  struct oss_cdev_client *cli = p;
-  struct iorp *req;
-  uint32_t len;
-  int c, ret;
-  cdev_callback_t cb;
-  dspd_time_t waketime;
-  struct timespec ts;
-  char name[33];
-  sprintf(name, "dsp-worker-%s", cli->dsp.devinfo.name);
-  prctl(PR_SET_NAME, name, 0, 0, 0);
-
+/*
+  Worker pool for /dev/dsp clients.  Each client belongs to one worker so its
+  requests still run in order.  A worker never sleeps inside a request.  A read,
+  write, or drain that has to wait parks itself (see oss_cdev_client_park()) and the
+  worker goes on to other clients until the earliest wakeup time, a new request,
+  or an error wakes it up.
+*/
+struct oss_dsp_worker {
+  dspd_mutex_t            lock;
+  dspd_cond_t             event;
+  bool                    signaled;
+  //New clients that the worker thread has not picked up yet
+  struct oss_cdev_client *incoming;
+  volatile AO_t           nclients;
+  pthread_t               thread;
+};
 
-  //Assign the slot so new messages have somewhere to go.
-  cli->cdev->clients[cli->fh >> 32] = cli;
-  if ( rtcuse_reply_open(cli->cdev->cdev,
-			 cli->unique,
-			 cli->fh,
-			 cli->flags) < 0 )
-    goto out;
-  while ( ! session_exited(cli) )
+static void dsp_client_wake(struct oss_cdev_client *cli)
+{
+  struct oss_dsp_worker *w = cli->worker;
+  if ( w != NULL && AO_test_and_set(&cli->wakeup) != AO_TS_SET )
     {
-      /*
-	Should wait for an incoming request or a change in the buffers (poll notify).
-
-	To get this running it is probably a good idea to implement raw writes and 
-	a single ioctl.  When that is verified then create an oss ioctl library
-	that uses rclient.
-
-	Note that an write callbacks will need to set up cli->fh.
+      dspd_mutex_lock(&w->lock);
+      w->signaled = true;
+      dspd_cond_signal(&w->event);
+      dspd_mutex_unlock(&w->lock);
+    }
+}
 
-      */
+static void dsp_worker_add(struct oss_cdev_client *cli)
+{
+  struct oss_dsp_worker *w = &server_context.workers[0];
+  size_t i;
+  for ( i = 1; i < server_context.nworkers; i++ )
+    {
+      if ( AO_load(&server_context.workers[i].nclients) < AO_load(&w->nclients) )
+	w = &server_context.workers[i];
+    }
+  AO_fetch_and_add1(&w->nclients);
+  dspd_mutex_lock(&w->lock);
+  cli->worker = w;
+  cli->worker_next = w->incoming;
+  w->incoming = cli;
+  w->signaled = true;
+  dspd_cond_signal(&w->event);
+  dspd_mutex_unlock(&w->lock);
+}
 
-      if ( cli->wakeup != AO_TS_SET )
+//Run the handler for the request at the head of the queue.
+static void dsp_call_req(struct oss_cdev_client *cli)
+{
+  cdev_callback_t cb;
+  int ret;
+  cb = dsp_cdev_ops[cli->current_pkt->header.opcode];
+  if ( cb == NULL )
+    {
+      if ( cli->current_pkt->header.opcode == FUSE_RELEASE )
 	{
-
-	  dspd_mutex_lock(&cli->lock);
-	 
-	  if ( ! dsp_check_poll(cli) )
-	    {
-	      if ( ! queue_ready(cli) )
-		{
-		  if ( cli->dsp.params.stream & DSPD_PCM_SBIT_PLAYBACK )
-		    dspd_rclient_status(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK, NULL);
-		  if ( cli->dsp.params.stream & DSPD_PCM_SBIT_CAPTURE )
-		    dspd_rclient_status(cli->dsp.rclient, DSPD_PCM_SBIT_CAPTURE, NULL);
-
-		  ret = dspd_rclient_get_next_wakeup(cli->dsp.rclient,
-						     cli->dsp.params.stream,
-						     &waketime);
-
-		  if ( ret == 0 )
-		    {
-		      if ( ! queue_ready(cli) )
-			{
-			  ts.tv_sec = waketime / 1000000000;
-			  ts.tv_nsec = waketime % 1000000000;
-			  dspd_cond_timedwait(&cli->event, &cli->lock, &ts);
-			}
-		    } else
-		    {
-		      usleep(1);
-		    }
-		  dsp_check_poll(cli);
-		}
-	    }
-	    
-
-	  //Sleep after notifying
-	  while ( ! (queue_ready(cli) || session_exited(cli)) )
-	    dspd_cond_wait(&cli->event, &cli->lock);
-	  dspd_mutex_unlock(&cli->lock);
-
+	  oss_reply_error(cli, 0);
+	  cli->error = EBADF;
 	} else
 	{
-	  AO_CLEAR(&cli->wakeup);
+	  oss_reply_error(cli, ENOSYS);
 	}
+    } else
+    {
+      ret = cb(cli);
+      if ( ret )
+	oss_reply_error(cli, ret);
+    }
+}
+
+static void set_next_wakeup(dspd_time_t *next, dspd_time_t t)
+{
+  if ( *next == 0 || t < *next )
+    *next = t;
+}
 
-      while ( dspd_fifo_riov(cli->eventq, (void**)&req, &len) == 0 )
+/*
+  Do everything that can be done for a client without waiting.  Returns true
+  when the session is over.  The next time the client needs to run goes in
+  *next.
+*/
+static bool dsp_client_run(struct oss_cdev_client *cli, dspd_time_t now, dspd_time_t *next)
+{
+  struct iorp *req;
+  uint32_t len;
+  int c, e;
+  dspd_time_t waketime;
+  //Clear before looking at the queue so a request that arrives now wakes the worker again.
+  AO_CLEAR(&cli->wakeup);
+  AO_nop_full();
+  if ( cli->wait.parked )
+    {
+      if ( dsp_wait_result(cli, now) == 0 )
+	{
+	  set_next_wakeup(next, cli->wait.abstime);
+	  return false;
+	}
+      dsp_call_req(cli);
+      if ( cli->wait.parked )
 	{
-	  dsp_check_poll(cli);
+	  set_next_wakeup(next, cli->wait.abstime);
+	  return session_exited(cli);
+	}
+    }
+  while ( ! session_exited(cli) && dspd_fifo_riov(cli->eventq, (void**)&req, &len) == 0 )
+    {
+      dsp_check_poll(cli);
 
-	  if ( len == 0 )
-	    break;
+      if ( len == 0 )
+	break;
 	  
-	  cli->current_iorp = req;
-	  cli->current_pkt = req->addr;
+      cli->current_iorp = req;
+      cli->current_pkt = req->addr;
 	  
-
-	  dspd_fifo_len(cli->eventq, &cli->current_count);
-	  if ( (c = AO_load(&req->canceled)) )
+      dspd_fifo_len(cli->eventq, &cli->current_count);
+      if ( (c = AO_load(&req->canceled)) )
+	{
+	  if ( c == IORP_CANCELED )
 	    {
-	      if ( c == IORP_CANCELED )
-		{
-		  if ( cli->current_pkt->header.opcode != FUSE_IOCTL && 
-		       cli->current_pkt->header.opcode != FUSE_RELEASE )
-		    {
-		      oss_reply_error(cli, EINTR);
-		      continue;
-		    }
-		} else
+	      if ( cli->current_pkt->header.opcode != FUSE_IOCTL && 
+		   cli->current_pkt->header.opcode != FUSE_RELEASE )
 		{
-		  dspd_fifo_rcommit(cli->eventq, 1);
+		  oss_reply_error(cli, EINTR);
 		  continue;
 		}
+	    } else
+	    {
+	      dspd_fifo_rcommit(cli->eventq, 1);
+	      continue;
 	    }
+	}
 
-	  if ( cli->current_pkt->header.opcode >= (sizeof(dsp_cdev_ops)/sizeof(dsp_cdev_ops[0])) )
+      if ( cli->current_pkt->header.opcode >= (sizeof(dsp_cdev_ops)/sizeof(dsp_cdev_ops[0])) )
+	{
+	  oss_reply_error(cli, ENOSYS);
+	  continue;
+	}
+      if ( cli->op_error )
+	e = cli->op_error;
+      else
+	e = cli->cdev->error;
+      if ( cli->current_pkt->header.opcode != FUSE_RELEASE && e != 0 )
+	{
+	  if ( cli->op_error == 0 )
+	    cli->op_error = e;
+	  oss_reply_error(cli, e);
+	} else
+	{
+	  dsp_call_req(cli);
+	  if ( cli->wait.parked )
 	    {
-	      oss_reply_error(cli, ENOSYS);
-	      continue;
+	      //The request stays at the head of the queue until it finishes.
+	      set_next_wakeup(next, cli->wait.abstime);
+	      return session_exited(cli);
 	    }
-	  int e;
-	  if ( cli->op_error )
-	    e = cli->op_error;
-	  else
-	    e = cli->cdev->error;
-	  if ( cli->current_pkt->header.opcode != FUSE_RELEASE && e != 0 )
+	}
+    }
+  if ( session_exited(cli) )
+    return true;
+
+  //Nothing else to do, so find out when poll() should be notified.
+  if ( cli->poll_ok && cli->poll_armed && ! dsp_check_poll(cli) )
+    {
+      if ( cli->dsp.params.stream & DSPD_PCM_SBIT_PLAYBACK )
+	dspd_rclient_status(cli->dsp.rclient, DSPD_PCM_SBIT_PLAYBACK, NULL);
+      if ( cli->dsp.params.stream & DSPD_PCM_SBIT_CAPTURE )
+	dspd_rclient_status(cli->dsp.rclient, DSPD_PCM_SBIT_CAPTURE, NULL);
+      if ( ! dsp_check_poll(cli) &&
+	   dspd_rclient_get_next_wakeup(cli->dsp.rclient,
+					cli->dsp.params.stream,
+					&waketime) == 0 )
+	set_next_wakeup(next, waketime);
+    }
+  return false;
+}
+
+static void *dsp_worker(void *p)
+{
+  struct oss_dsp_worker *w = p;
+  struct oss_cdev_client *clients = NULL, *cli, *incoming, **prev;
+  dspd_time_t next;
+  struct timespec ts;
+  prctl(PR_SET_NAME, "dsp-worker", 0, 0, 0);
+
+  dspd_mutex_lock(&w->lock);
+  while ( 1 )
+    {
+      incoming = w->incoming;
+      w->incoming = NULL;
+      w->signaled = false;
+      dspd_mutex_unlock(&w->lock);
+
+      while ( incoming )
+	{
+	  cli = incoming;
+	  incoming = cli->worker_next;
+	  //Assign the slot so new messages have somewhere to go.
+	  cli->cdev->clients[cli->fh >> 32] = cli;
+	  if ( rtcuse_reply_open(cli->cdev->cdev,
+				 cli->unique,
+				 cli->fh,
+				 cli->flags) < 0 )
 	    {
-	      if ( cli->op_error == 0 )
-		cli->op_error = e;
-	      oss_reply_error(cli, e);
+	      AO_fetch_and_sub1(&w->nclients);
+	      dsp_client_release_notify(cli->cdev, cli->cdev_slot);
 	    } else
 	    {
+	      cli->worker_next = clients;
+	      clients = cli;
+	    }
+	}
 
-	      cb = dsp_cdev_ops[cli->current_pkt->header.opcode];
-
-	      if ( cb == NULL )
-		{
-		  if ( cli->current_pkt->header.opcode == FUSE_RELEASE )
-		    {
-		      oss_reply_error(cli, 0);
-		      break;
-		    } else
-		    {
-		      oss_reply_error(cli, ENOSYS);
-		    }
-		} else
-		{
-		  ret = cb(cli);
-		  if ( ret )
-		    oss_reply_error(cli, ret);
-		}
+      next = 0;
+      prev = &clients;
+      while ( (cli = *prev) != NULL )
+	{
+	  if ( dsp_client_run(cli, dspd_get_time(), &next) )
+	    {
+	      *prev = cli->worker_next;
+	      AO_fetch_and_sub1(&w->nclients);
+	      //The client is freed after this.
+	      dsp_client_release_notify(cli->cdev, cli->cdev_slot);
+	    } else
+	    {
+	      prev = &cli->worker_next;
 	    }
-	  
+	}
 
-	  if ( session_exited(cli) )
-	    break;
+      dspd_mutex_lock(&w->lock);
+      if ( ! w->signaled )
+	{
+	  if ( next == 0 )
+	    {
+	      dspd_cond_wait(&w->event, &w->lock);
+	    } else if ( next > dspd_get_time() )
+	    {
+	      dspd_time_to_timespec(next, &ts);
+	      dspd_cond_timedwait(&w->event, &w->lock, &ts);
+	    }
 	}
     }
-
-  out:
-
-  dsp_client_release_notify(cli->cdev, cli->cdev_slot);
+  dspd_mutex_unlock(&w->lock);
   return NULL;
 }
 
+static int32_t dsp_start_workers(size_t count)
+{
+  struct oss_dsp_worker *w;
+  pthread_attr_t attr;
+  size_t i;
+  int32_t ret = 0;
+  server_context.workers = calloc(count, sizeof(*server_context.workers));
+  if ( ! server_context.workers )
+    return -ENOMEM;
+  for ( i = 0; i < count; i++ )
+    {
+      w = &server_context.workers[i];
+      ret = dspd_mutex_init(&w->lock, NULL);
+      if ( ret == 0 )
+	ret = dspd_cond_init(&w->event, &server_context.client_condattr);
+      if ( ret == 0 )
+	{
+	  ret = pthread_create(&w->thread, &server_context.client_threadattr, dsp_worker, w);
+	  if ( ret == EPERM && dspd_daemon_threadattr_init(&attr,
+							   sizeof(attr),
+							   DSPD_THREADATTR_DETACHED) == 0 )
+	    {
+	      ret = pthread_create(&w->thread, &attr, dsp_worker, w);
+	      pthread_attr_destroy(&attr);
+	    }
+	}
+      if ( ret != 0 )
+	break;
+    }
+  //Workers that started stay running.  Clients only go to those.
+  server_context.nworkers = i;
+  if ( i == 0 )
+    {
+      free(server_context.workers);
+      server_context.workers = NULL;
+      return -ret;
+    }
+  return 0;
+}
+
 
 static void cdev_destroy(struct oss_dsp_cdev *cdev)
 {
@@ -2670,6 +2754,7 @@ static int oc_init(struct dspd_daemon_ctx *daemon, void **context)
   pthread_t thr;
   struct oss_dsp_cdev *ctl;
   struct cbpoll_msg pe = { .len = sizeof(struct cbpoll_msg) };
+  int32_t workers = 2;
   server_context.cuse_helper_fd = -1;
   server_context.config = dspd_read_config("mod_osscuse", true);
   server_context.devnode_prefix = "";
@@ -2735,6 +2820,10 @@ static int oc_init(struct dspd_daemon_ctx *daemon, void **context)
 	    server_context.helper = dspd_strtoidef(val, server_context.helper);
 
 
+	  val = NULL;
+	  dspd_dict_find_value(server_context.config, "dsp_workers", (char**)&val);
+	  workers = dspd_strtoidef(val, workers);
+
 	  val = NULL;
 	  dspd_dict_find_value(server_context.config, "legacy_mixer_type", (char**)&val);
 	  if ( val )
@@ -2748,7 +2837,13 @@ static int oc_init(struct dspd_daemon_ctx *daemon, void **context)
 	    }
 	}
 
-      ret = cbpoll_init(&server_context.cbpoll, 0, DSPD_MAX_OBJECTS);
+      if ( workers < 1 )
+	workers = 1;
+      ret = dsp_start_workers(workers);
+      if ( ret != 0 )
+	dspd_log(0, "Could not start dsp worker threads: error %d", ret);
+      if ( ret == 0 )
+	ret = cbpoll_init(&server_context.cbpoll, 0, DSPD_MAX_OBJECTS);
       if ( ret == 0 )
 	ret = cbpoll_set_name(&server_context.cbpoll, "dspd-ossdsp");
       if ( ret == 0 )
@@ -9,7 +9,7 @@ enum {
   IORP_COMPLETED, //Completed and freed
 };
 /*
-  IO request packet.  This gets sent to a worker thread (one per client for /dev/dsp).
+  IO request packet.  This gets sent to the worker thread that owns the client.
   All of the fuse requests except for open start with the 64 bit identifier so the
   dispatcher should be able to copy the request to another memory queue or malloc()
   a buffer.
@@ -43,6 +43,7 @@ struct oss_cdev_ops {
 };
 
 struct oss_dsp_cdev;
+struct oss_dsp_worker;
 
 struct snd_mixer_oss_assign_table {
   int32_t      oss_id;
@@ -75,6 +76,9 @@ struct dspd_oss_server {
   int32_t cuse_helper_fd;
   int32_t helper;
 
+  //Fixed pool of threads that run /dev/dsp requests for every client.
+  struct oss_dsp_worker *workers;
+  size_t                 nworkers;
 };
 
 
@@ -106,6 +110,20 @@ struct dsp_data {
   size_t                  max_write, max_read;
   unsigned long long      channelmap;
 };
+/*
+  A read or write that is waiting on the fifo.  The handler parks the request
+  instead of sleeping and the worker thread calls it again when abstime passes,
+  the request is canceled, or (if alertable) another request arrives.
+*/
+struct oss_cdev_wait {
+  bool        parked;
+  bool        alertable;
+  size_t      offset;
+  dspd_time_t abstime;
+};
+//Retry interval for a write that is waiting for the trigger timestamp
+#define DSP_TRIGGER_WAIT 100000ULL
+
 struct oss_legacy_mixer_table;
 struct oss_cdev_client {
   struct dspd_rtalloc     *alloc;
@@ -114,10 +132,11 @@ struct oss_cdev_client {
   int32_t device_index;
   int32_t cdev_slot;
   int32_t error; //If nonzero then automatically reply to all requests with an error.
-  /*These can be used for timing and for waiting on input*/
-  dspd_mutex_t lock;
-  dspd_cond_t  event;
+  //Set when the worker thread needs to look at this client
   volatile AO_TS_t wakeup;
+  struct oss_dsp_worker  *worker;
+  struct oss_cdev_client *worker_next;
+  struct oss_cdev_wait    wait;
   struct oss_dsp_cdev *cdev;
 
   struct iorp        *current_iorp;
@@ -138,7 +157,6 @@ struct oss_cdev_client {
   //before replying.  It can't be used for ioctl because that
   //makes everything too messy.
   //pthread_mutex_t data_lock;
-  pthread_t thread;
   
   uint64_t unique;
   uint64_t fh;
@@ -204,7 +222,8 @@ typedef int32_t (*cdev_callback_t)(struct oss_cdev_client *cli);
 
 int oss_reply_write(struct oss_cdev_client *cli, size_t count);
 int oss_reply_error(struct oss_cdev_client *cli, int32_t error);
-int dspd_cdev_client_sleep(struct oss_cdev_client *cli, dspd_time_t *abstime, bool alertable);
+void oss_cdev_client_park(struct oss_cdev_client *cli, dspd_time_t abstime, bool alertable, size_t offset);
+bool oss_cdev_client_resume(struct oss_cdev_client *cli, size_t *offset, bool *alertable, int *result);
 int oss_reply_ioctl(struct oss_cdev_client *cli, uint32_t result, const void *buf, size_t size);
 
 int oss_req_interrupted(struct oss_cdev_client *cli);
@@ -127,6 +127,12 @@ static int socksrv_dispatch_multi_req(struct dspd_rctx *rctx,
 				      size_t        inbufsize,
 				      void         *outbuf,
 				      size_t        outbufsize);
+static int socksrv_req_compound(struct dspd_rctx *rctx,
+				uint32_t             req,
+				const void          *inbuf,
+				size_t        inbufsize,
+				void         *outbuf,
+				size_t        outbufsize);
 
 
 static int32_t sendreq(struct ss_cctx *cli, int32_t fd)
@@ -1401,6 +1407,13 @@ struct dspd_req_handler socksrv_req_handlers[] = {
     .inbufsize = sizeof(struct socksrv_open_req),
     .outbufsize = sizeof(struct socksrv_open_reply),
   },
+  [DSPD_SOCKSRV_REQ_COMPOUND] = {
+    .handler = socksrv_req_compound,
+    .xflags = DSPD_REQ_DEFAULT_XFLAGS,
+    .rflags = 0,
+    .inbufsize = sizeof(struct socksrv_compound_req),
+    .outbufsize = sizeof(struct socksrv_compound_reply),
+  },
 };
 
 
@@ -1618,7 +1631,7 @@ static int32_t merge_params(struct dspd_cli_params *p,
   int32_t ret;
   if ( pparams->format == cparams->format &&
        pparams->rate == cparams->rate &&
-       pparams->flags == cparams->flags &&
+       (pparams->flags & ~DSPD_CLI_FLAG_RAWFIFO) == (cparams->flags & ~DSPD_CLI_FLAG_RAWFIFO) &&
        pparams->xflags == cparams->xflags )
     {
       memset(p, 0, sizeof(*p));
@@ -1628,6 +1641,7 @@ static int32_t merge_params(struct dspd_cli_params *p,
       p->fragsize = MIN(pparams->fragsize, cparams->fragsize);
       p->stream = DSPD_PCM_SBIT_FULLDUPLEX;
       p->latency = MIN(pparams->latency, cparams->latency);
+      //Only playback uses a raw fifo.
       p->flags = pparams->flags;
       p->min_latency = 0;
       p->max_latency = 0;
@@ -2681,6 +2695,228 @@ static int socksrv_dispatch_multi_req(struct dspd_rctx *rctx,
 }
 
 
+/*
+  Send a request to the socket server, a client stream, or a device.  This
+  is the access check for both regular packets and compound sub-requests.
+*/
+static int client_route_req(struct ss_cctx *cli,
+			    struct dspd_rctx *rctx,
+			    int32_t stream,
+			    uint32_t cmd,
+			    const void *iptr,
+			    size_t len,
+			    void *optr,
+			    size_t outbufsize)
+{
+  int ret;
+  if ( stream == -1 )
+    {
+      //Socket server request
+      rctx->user_data = cli;
+      if ( cmd >= DSPD_SCTL_CLIENT_MIN && cmd <= DSPD_SCTL_CLIENT_MAX )
+	{
+	  ret = socksrv_dispatch_multi_req(rctx,
+					   cmd,
+					   iptr,
+					   len,
+					   optr,
+					   outbufsize);
+	} else
+	{
+	  ret = socksrv_dispatch_req(rctx,
+				     cmd,
+				     iptr,
+				     len,
+				     optr,
+				     outbufsize);
+	}
+    } else if ( stream == 0 )
+    {
+      //All requests to object 0 are ok because this is the special
+      //daemon context.
+      
+      ret = dspd_slist_ctl(dspd_dctx.objects,
+			   rctx,
+			   cmd,
+			   iptr,
+			   len,
+			   optr,
+			   outbufsize);
+    } else if ( stream_valid(cli, stream) )
+    {
+      //Can make any request
+      ret = dspd_slist_ctl(dspd_dctx.objects,
+			   rctx,
+			   cmd,
+			   iptr,
+			   len,
+			   optr,
+			   outbufsize);
+    } else
+    {
+      if ( cmd >= DSPD_SCTL_SERVER_MIN )
+	{
+	  //Send commands to any server.
+	  ret = dspd_daemon_ref(rctx->index, DSPD_DCTL_ENUM_TYPE_SERVER);
+	  if ( ret == 0 )
+	    {
+	      ret = dspd_slist_ctl(dspd_dctx.objects,
+				   rctx,
+				   cmd,
+				   iptr,
+				   len,
+				   optr,
+				   outbufsize);
+	      dspd_daemon_unref(rctx->index);
+	    } else
+	    {
+	      ret = dspd_req_reply_err(rctx, 0, ret);
+	    }
+	} else
+	{
+	  ret = dspd_req_reply_err(rctx, 0, EINVAL);
+	}
+    }
+  return ret;
+}
+
+/*
+  Compound sub-requests reply into the compound output buffer instead of
+  sending a packet.
+*/
+struct socksrv_compound_ctx {
+  int32_t error;
+  size_t  len;
+  bool    replied;
+};
+
+static int32_t compound_reply_buf(struct dspd_rctx *arg, 
+				  int32_t flags, 
+				  const void *buf, 
+				  size_t len)
+{
+  struct socksrv_compound_ctx *c = arg->ops_arg;
+  c->replied = true;
+  if ( len > arg->outbufsize )
+    {
+      c->error = -EPROTO;
+      c->len = 0;
+    } else
+    {
+      if ( buf != arg->outbuf && len > 0 )
+	memmove(arg->outbuf, buf, len);
+      c->error = 0;
+      c->len = len;
+    }
+  return 0;
+}
+
+static int32_t compound_reply_fd(struct dspd_rctx *arg, 
+				 int32_t flags, 
+				 const void *buf, 
+				 size_t len, 
+				 int32_t fd)
+{
+  struct socksrv_compound_ctx *c = arg->ops_arg;
+  //There is only one fd per packet and the reply header is where it would go.
+  if ( flags & DSPD_REPLY_FLAG_CLOSEFD )
+    close(fd);
+  c->replied = true;
+  c->error = -ENOTSUP;
+  c->len = 0;
+  return 0;
+}
+
+static int32_t compound_reply_err(struct dspd_rctx *arg, 
+				  int32_t flags, 
+				  int32_t err)
+{
+  struct socksrv_compound_ctx *c = arg->ops_arg;
+  if ( err > 0 )
+    err *= -1;
+  c->replied = true;
+  c->error = err;
+  c->len = 0;
+  return 0;
+}
+
+static const struct dspd_rcb compound_rcb = { 
+  .reply_buf = compound_reply_buf,
+  .reply_fd = compound_reply_fd,
+  .reply_err = compound_reply_err,
+};
+
+static int socksrv_req_compound(struct dspd_rctx *rctx,
+				uint32_t             req,
+				const void          *inbuf,
+				size_t        inbufsize,
+				void         *outbuf,
+				size_t        outbufsize)
+{
+  struct ss_cctx *cli = dspd_req_userdata(rctx);
+  const struct socksrv_compound_req *sreq;
+  struct socksrv_compound_reply *srep;
+  struct socksrv_compound_ctx c;
+  struct dspd_rctx sub;
+  const char *iptr = inbuf;
+  char *optr = outbuf;
+  size_t ioff, ooff = 0, count = 0;
+  int32_t ret;
+
+  //Check the whole list first so a bad packet doesn't run anything.
+  for ( ioff = 0; ioff < inbufsize; ioff += sizeof(*sreq) + DSPD_COMPOUND_ALIGN(sreq->inbufsize) )
+    {
+      sreq = (const struct socksrv_compound_req*)&iptr[ioff];
+      if ( (inbufsize - ioff) < sizeof(*sreq) ||
+	   sreq->inbufsize > (inbufsize - ioff - sizeof(*sreq)) ||
+	   sreq->outbufsize > outbufsize ||
+	   (sreq->stream == -1 && sreq->req == DSPD_SOCKSRV_REQ_COMPOUND) ||
+	   ++count > DSPD_COMPOUND_MAX )
+	return dspd_req_reply_err(rctx, 0, EINVAL);
+      ooff += sizeof(*srep) + DSPD_COMPOUND_ALIGN(sreq->outbufsize);
+    }
+  if ( ooff > outbufsize )
+    return dspd_req_reply_err(rctx, 0, EINVAL);
+
+  memset(&sub, 0, sizeof(sub));
+  sub.ops = &compound_rcb;
+  sub.ops_arg = &c;
+  sub.fd = -1;
+  sub.flags = rctx->flags & ~(DSPD_REQ_FLAG_POINTER|DSPD_REQ_FLAG_CMSG_FD|DSPD_REQ_FLAG_CMSG_CRED);
+  ooff = 0;
+  for ( ioff = 0; ioff < inbufsize; ioff += sizeof(*sreq) + DSPD_COMPOUND_ALIGN(sreq->inbufsize) )
+    {
+      sreq = (const struct socksrv_compound_req*)&iptr[ioff];
+      srep = (struct socksrv_compound_reply*)&optr[ooff];
+      c.error = 0;
+      c.len = 0;
+      c.replied = false;
+      sub.user_data = NULL;
+      sub.bytes_returned = 0;
+      sub.index = sreq->stream;
+      sub.outbuf = &optr[ooff + sizeof(*srep)];
+      sub.outbufsize = sreq->outbufsize;
+      ret = client_route_req(cli,
+			     &sub,
+			     sreq->stream,
+			     sreq->req,
+			     sreq->inbufsize ? &iptr[ioff + sizeof(*sreq)] : NULL,
+			     sreq->inbufsize,
+			     sreq->outbufsize ? sub.outbuf : NULL,
+			     sreq->outbufsize);
+      if ( ! c.replied )
+	c.error = ret < 0 ? ret : -EPROTO;
+      srep->req = sreq->req;
+      srep->error = c.error;
+      srep->len = c.len;
+      srep->reserved = 0;
+      ooff += sizeof(*srep) + DSPD_COMPOUND_ALIGN(c.len);
+      if ( c.error < 0 )
+	break;
+    }
+  return dspd_req_reply_buf(rctx, 0, outbuf, ooff);
+}
+
 static int client_dispatch_pkt(struct ss_cctx *cli)
 {
   struct dspd_req *req = cli->pkt_in;
@@ -2736,74 +2972,14 @@ static int client_dispatch_pkt(struct ss_cctx *cli)
 	optr = cli->rctx.outbuf;
       cli->rctx.outbuf = cli->pkt_out->pdata;
     }
-  if ( req->stream == -1 )
-    {
-      //Socket server request
-      cli->rctx.user_data = cli;
-      if ( cli->pkt_cmd >= DSPD_SCTL_CLIENT_MIN && cli->pkt_cmd <= DSPD_SCTL_CLIENT_MAX )
-	{
-	  ret = socksrv_dispatch_multi_req(&cli->rctx,
-					   cli->pkt_cmd,
-					   iptr,
-					   len,
-					   optr,
-					   cli->rctx.outbufsize);
-	} else
-	{
-	  ret = socksrv_dispatch_req(&cli->rctx,
-				     cli->pkt_cmd,
-				     iptr,
-				     len,
-				     optr,
-				     cli->rctx.outbufsize);
-	}
-    } else if ( req->stream == 0 )
-    {
-      //All requests to object 0 are ok because this is the special
-      //daemon context.
-      
-      ret = dspd_slist_ctl(dspd_dctx.objects,
-			   &cli->rctx,
-			   cli->pkt_cmd,
-			   iptr,
-			   len,
-			   optr,
-			   cli->rctx.outbufsize);
-    } else if ( stream_valid(cli, req->stream) )
-    {
-      //Can make any request
-      ret = dspd_slist_ctl(dspd_dctx.objects,
-			   &cli->rctx,
-			   cli->pkt_cmd,
-			   iptr,
-			   len,
-			   optr,
-			   cli->rctx.outbufsize);
-    } else
-    {
-      if ( cli->pkt_cmd >= DSPD_SCTL_SERVER_MIN )
-	{
-	  //Send commands to any server.
-	  ret = dspd_daemon_ref(cli->rctx.index, DSPD_DCTL_ENUM_TYPE_SERVER);
-	  if ( ret == 0 )
-	    {
-	      ret = dspd_slist_ctl(dspd_dctx.objects,
-				   &cli->rctx,
-				   cli->pkt_cmd,
-				   iptr,
-				   len,
-				   optr,
-				   cli->rctx.outbufsize);
-	      dspd_daemon_unref(cli->rctx.index);
-	    } else
-	    {
-	      ret = dspd_req_reply_err(&cli->rctx, 0, ret);
-	    }
-	} else
-	{
-	  ret = dspd_req_reply_err(&cli->rctx, 0, EINVAL);
-	}
-    }
+  ret = client_route_req(cli,
+			 &cli->rctx,
+			 req->stream,
+			 cli->pkt_cmd,
+			 iptr,
+			 len,
+			 optr,
+			 cli->rctx.outbufsize);
 
   //Close received fd if the handler did not get it.
   if ( cli->rctx.fd >= 0 )
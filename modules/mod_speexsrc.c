@@ -21,9 +21,18 @@
 #include <stdint.h>
 #include <speex/speex_resampler.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 #include "../lib/sslib.h"
 #include "../lib/daemon.h"
 
+//process_v() needs the frame size and speex does not give it back.
+struct speex_src_state {
+  SpeexResamplerState *state;
+  uint32_t             channels;
+};
+#define SPEEX_STATE(_src) (((struct speex_src_state*)(_src))->state)
+
 static int32_t speex2errno(int err)
 {
   int32_t ret;
@@ -59,31 +68,40 @@ static int32_t speex_set_rates(dspd_src_t src,
 			       uint32_t in,
 			       uint32_t out)
 {
-  return speex2errno(speex_resampler_set_rate(src,
+  return speex2errno(speex_resampler_set_rate(SPEEX_STATE(src),
 					      in,
 					      out));
 }
 
 static int32_t speex_reset(dspd_src_t src)
 {
-  return speex2errno(speex_resampler_reset_mem(src));
+  return speex2errno(speex_resampler_reset_mem(SPEEX_STATE(src)));
 }
 
 static int32_t speex_new(dspd_src_t *src, int quality, int channels)
 {
   int err;
+  struct speex_src_state *st;
   quality--;
   if ( quality < 0 )
     quality = 0;
   else if ( quality > 10 )
     quality = 10;
-  *src = speex_resampler_init(channels,
-			      48000,
-			      48000,
-			      quality,
-			      &err);
-  if ( ! *src )
-    return speex2errno(err);
+  st = calloc(1, sizeof(*st));
+  if ( ! st )
+    return -errno;
+  st->channels = channels;
+  st->state = speex_resampler_init(channels,
+				   48000,
+				   48000,
+				   quality,
+				   &err);
+  if ( ! st->state )
+    {
+      free(st);
+      return speex2errno(err);
+    }
+  *src = st;
   return 0;
 }
 
@@ -98,7 +116,7 @@ static int32_t speex_process(dspd_src_t   src,
   int32_t ret;
   in = *frames_in;
   out = *frames_out;
-  ret = speex_resampler_process_interleaved_float(src, inbuf, &in, outbuf, &out);
+  ret = speex_resampler_process_interleaved_float(SPEEX_STATE(src), inbuf, &in, outbuf, &out);
   if ( ret != 0 )
     {
       ret = speex2errno(ret);
@@ -110,6 +128,38 @@ static int32_t speex_process(dspd_src_t   src,
   return ret;
 }
 
+static int32_t speex_process_v(dspd_src_t                             src,
+			       bool                                   eof,
+			       const struct dspd_src_iov * __restrict iov,
+			       size_t                                 niov,
+			       size_t                    * __restrict frames_in,
+			       float                     * __restrict outbuf,
+			       size_t                    * __restrict frames_out)
+{
+  struct speex_src_state *st = src;
+  uint32_t in, out;
+  size_t i, itotal = 0, ototal = 0, olen = *frames_out;
+  int32_t ret = 0;
+  for ( i = 0; i < niov && ototal < olen; i++ )
+    {
+      in = iov[i].frames;
+      out = olen - ototal;
+      ret = speex_resampler_process_interleaved_float(st->state, iov[i].buf, &in, &outbuf[ototal * st->channels], &out);
+      if ( ret != 0 )
+	{
+	  ret = speex2errno(ret);
+	  break;
+	}
+      itotal += in;
+      ototal += out;
+      if ( in < iov[i].frames )
+	break;
+    }
+  *frames_in = itotal;
+  *frames_out = ototal;
+  return ret;
+}
+
 
 static void speex_info(struct dspd_src_info *info)
 {
@@ -121,7 +171,8 @@ static void speex_info(struct dspd_src_info *info)
 
 static int32_t speex_free(dspd_src_t src)
 {
-  speex_resampler_destroy(src);
+  speex_resampler_destroy(SPEEX_STATE(src));
+  free(src);
   return 0;
 }
 
@@ -131,10 +182,10 @@ static void speex_get_params(dspd_src_t src,
 			     uint32_t *rate_out)
 {
   int q;
-  speex_resampler_get_rate(src,
+  speex_resampler_get_rate(SPEEX_STATE(src),
 			   rate_in,
 			   rate_out);
-  speex_resampler_get_quality(src, &q);
+  speex_resampler_get_quality(SPEEX_STATE(src), &q);
   *quality = q + 1;
 }
 
@@ -160,6 +211,7 @@ static struct dspd_src_ops speex_ops = {
   .set_rates = speex_set_rates,
   .reset = speex_reset,
   .process = speex_process,
+  .process_v = speex_process_v,
   .newsrc = speex_new,
   .freesrc = speex_free,
   .info = speex_info,
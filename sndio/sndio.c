@@ -128,6 +128,8 @@ struct sndio_client {
   size_t      p_max, p_total;
   char        p_data[AMSG_DATAMAX];
   size_t      pxfer_offset;
+  //Receive playback data straight into the fifo instead of p_data.
+  bool        p_direct;
 
   uint8_t xrun_policy;
   bool par_set;
@@ -846,35 +848,91 @@ static ssize_t client_recv(int fd, char *buf, size_t len)
   return ret;
 }
 
+//Fill the space that the playback xrun left with silence before new data goes in.
+static void client_fill_xrun(struct sndio_client *cli)
+{
+  int32_t avail, wsil;
+  ssize_t ret;
+  if ( (cli->xrun & DSPD_PCM_SBIT_PLAYBACK) != 0 && (cli->xrun_override & DSPD_PCM_SBIT_PLAYBACK) == 0 )
+    {
+      avail = dspd_pcmcli_avail(cli->pcm, DSPD_PCM_SBIT_PLAYBACK, NULL, NULL);
+      if ( avail > cli->last_avail )
+	{
+	  wsil = avail - cli->last_avail;
+	  ret = dspd_pcmcli_write_frames(cli->pcm, NULL, wsil);
+	  if ( ret > 0 )
+	    {
+	      cli->last_avail += wsil - ret;
+	      cli->xrun_override |= DSPD_PCM_SBIT_PLAYBACK;
+	    }
+	}
+    }
+}
+
+/*
+  Receive straight into the playback fifo.  A partial frame stays in the fifo
+  until the rest of it arrives since the fifo pointer only moves by whole frames.
+  The fifo region ends at the wraparound point, so the rest of the packet goes in
+  with the next call.
+*/
+static ssize_t client_recv_fifo(struct sndio_client *cli)
+{
+  size_t partial = cli->p_offset - cli->pxfer_offset, len;
+  uint32_t frames = (cli->p_max - cli->pxfer_offset) / cli->pframe_bytes;
+  void *addr;
+  ssize_t ret;
+  ret = dspd_pcmcli_mmap_begin(cli->pcm, DSPD_PCM_SBIT_PLAYBACK, &addr, &frames);
+  if ( ret == 0 )
+    {
+      len = frames * cli->pframe_bytes;
+      DSPD_ASSERT(len > partial);
+      ret = client_recv(cli->fd, (char*)addr + partial, len - partial);
+    }
+  return ret;
+}
+
 static int client_wxfer(struct sndio_client *cli)
 {
   ssize_t ret;
   size_t fr;
+  bool direct;
   if ( cli->cstate != CLIENT_STATE_RXDATA )
     return 0;
-  ret = client_recv(cli->fd, &cli->p_data[cli->p_offset], cli->p_max - cli->p_offset);
+  direct = cli->p_direct;
+  if ( direct )
+    {
+      if ( cli->p_offset == cli->pxfer_offset )
+	client_fill_xrun(cli);
+      ret = client_recv_fifo(cli);
+      if ( ret == -ENOTSUP )
+	{
+	  //The server gave this client a float32 fifo.  A partial frame can't be
+	  //in the fifo since nothing was ever received there.
+	  DSPD_ASSERT(cli->p_offset == cli->pxfer_offset);
+	  cli->p_direct = false;
+	  direct = false;
+	} else if ( ret == -EAGAIN )
+	{
+	  //The fifo is full.  Wait for the next wakeup like a short write does.
+	  return cbpoll_set_events(cli->server->cbpoll, cli->header.reserved_slot, 0);
+	}
+    }
+  if ( ! direct )
+    ret = client_recv(cli->fd, &cli->p_data[cli->p_offset], cli->p_max - cli->p_offset);
   if ( ret >= 0 )
     {
       cli->p_offset += ret;
       fr = (cli->p_offset - cli->pxfer_offset) / cli->pframe_bytes;
       if ( fr > 0 )
 	{
-	  if ( (cli->xrun & DSPD_PCM_SBIT_PLAYBACK) != 0 && (cli->xrun_override & DSPD_PCM_SBIT_PLAYBACK) == 0 )
+	  if ( direct )
 	    {
-	      int32_t avail = dspd_pcmcli_avail(cli->pcm, DSPD_PCM_SBIT_PLAYBACK, NULL, NULL);
-	      if ( avail > cli->last_avail )
-		{
-		  int32_t wsil = avail - cli->last_avail;
-		  ret = dspd_pcmcli_write_frames(cli->pcm, NULL, wsil);
-		  if ( ret > 0 )
-		    {
-		      cli->last_avail += wsil - ret;
-		      cli->xrun_override |= DSPD_PCM_SBIT_PLAYBACK;
-		    }
-		}
+	      ret = dspd_pcmcli_mmap_commit(cli->pcm, DSPD_PCM_SBIT_PLAYBACK, fr);
+	    } else
+	    {
+	      client_fill_xrun(cli);
+	      ret = dspd_pcmcli_write_frames(cli->pcm, &cli->p_data[cli->pxfer_offset], fr);
 	    }
-
-	  ret = dspd_pcmcli_write_frames(cli->pcm, &cli->p_data[cli->pxfer_offset], fr);
 	  if ( ret == -EAGAIN )
 	    {
 	      ret = cbpoll_set_events(cli->server->cbpoll, cli->header.reserved_slot, 0);
@@ -911,6 +969,10 @@ static int client_wxfer(struct sndio_client *cli)
 		  cli->p_max = 0;
 		  cli->cstate = CLIENT_STATE_IDLE;
 		  ret = cbpoll_set_events(cli->server->cbpoll, cli->header.reserved_slot, POLLIN);
+		} else if ( direct && cli->pxfer_offset == cli->p_offset )
+		{
+		  //Stopped at the wraparound point or ran out of data, so the rest is still in the socket.
+		  ret = cbpoll_set_events(cli->server->cbpoll, cli->header.reserved_slot, POLLIN);
 		} else
 		{
 		  ret = cbpoll_set_events(cli->server->cbpoll, cli->header.reserved_slot, 0);
@@ -1152,6 +1214,9 @@ static int amsg_setpar_process(struct sndio_client *cli, void *context, struct d
       cli->pframe_bytes = dspd_pcmcli_frames_to_bytes(cli->pcm, NULL, DSPD_PCM_SBIT_PLAYBACK, 1UL);
       if ( cli->pframe_bytes > 0 )
 	cli->p_datamax = AMSG_DATAMAX / cli->pframe_bytes;
+      //Only if the server gave this client a fifo in the client format.
+      cli->p_direct = (cli->streams & DSPD_PCM_SBIT_PLAYBACK) != 0 &&
+	dspd_pcmcli_can_mmap(cli->pcm, DSPD_PCM_SBIT_PLAYBACK);
 
       cli->cframe_bytes = dspd_pcmcli_frames_to_bytes(cli->pcm, NULL, DSPD_PCM_SBIT_CAPTURE, 1UL);
       if ( cli->cframe_bytes > 0 )
@@ -1221,6 +1286,9 @@ static int amsg_setpar(struct sndio_client *cli)
 	params = &cparams;
       if ( ! cli->server->daemon )
 	params->flags |= DSPD_CLI_FLAG_SHM;
+      //Network data can go straight into the fifo if it is in the client format.
+      if ( cli->streams & DSPD_PCM_SBIT_PLAYBACK )
+	params->flags |= DSPD_CLI_FLAG_RAWFIFO;
       params->stream = cli->streams;
 #ifdef DEBUG
       dspd_dump_params(params, stdout);